@@ -306,9 +306,12 @@ int audio_init(struct state_audio **ret,
         if (opt->echo_cancellation) {
 #ifdef HAVE_SPEEXDSP
                 s->echo_state = echo_cancellation_init();
+                if (s->echo_state == NULL) {
+                        fprintf(stderr, "Echo cancellation state creation failed.\n");
+                        goto error;
+                }
                 fprintf(stderr, "Echo cancellation is currently experimental "
-                                "and may not work as expected.");
-                goto error;
+                                "and may not work as expected.\n");
 #else
                 fprintf(stderr, "Speex not compiled in. Could not enable echo cancellation.\n");
                 delete s;
@@ -537,6 +540,11 @@ void audio_done(struct state_audio *s)
         free(s->audio_network_parameters.addr);
 
         audio_codec_done(s->audio_encoder);
+#ifdef HAVE_SPEEXDSP
+        if (s->echo_state) {
+                echo_cancellation_destroy(s->echo_state);
+        }
+#endif
 
         unregister_should_exit_callback(get_root_module(s->mod.get()),
                                         should_exit_audio, s);
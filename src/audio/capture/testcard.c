@@ -57,6 +57,7 @@
 #include "utils/fs.h"
 #include "utils/macros.h"
 #include "utils/misc.h"
+#include "utils/virtual_clock.h"
 
 #include <assert.h>
 #include <string.h>
@@ -453,7 +454,11 @@ static struct audio_frame *audio_cap_testcard_read(void *state)
         time_ns_t curr_time = get_time_in_ns();
 
         if( s->next_audio_time > curr_time) {
-                usleep((s->next_audio_time - curr_time) / US_IN_NS);
+                if (virtual_clock_enabled) {
+                        virtual_clock_sleep_until(s->next_audio_time);
+                } else {
+                        usleep((s->next_audio_time - curr_time) / US_IN_NS);
+                }
         } else {
                 // we missed more than 2 "frame times", in that case, just drop the packages
                 if ((curr_time - s->next_audio_time) > (long long int) (2 * NS_IN_SEC * s->chunk_size / s->audio.sample_rate)) {
@@ -42,23 +42,45 @@
 #include "config_win32.h"
 #endif /* HAVE_CONFIG_H */
 
-#include "audio/utils.h"
+/**
+ * @file
+ * Far end (played) samples are handed over by echo_play() and near end
+ * (captured) samples by echo_cancel() through single-producer single-consumer
+ * ring buffers (see audio/echo_ring.hpp), so the playback thread never blocks.
+ * The cancellation itself (sample format conversion included) runs in
+ * a separate thread. The capture thread waits for
+ * its result at most echo-cancel-max-wait ms, samples not processed in time
+ * are returned with the next captured frame.
+ *
+ * Multiple channels on both ends are supported by the SpeexDSP multichannel
+ * canceller (every captured channel is filtered by all played channels).
+ */
+
+#include "audio/echo_ring.hpp"
 #include "audio/export.h"
+#include "audio/types.h"
 #include "debug.h"
 #include "echo.h"
 
 #include <speex/speex_echo.h>
 
 #include <stdlib.h>
-#include <mutex>
-#include <memory>
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "utils/ring_buffer.h"
+#include "utils/thread.h"
 #include "host.h"
 
-#define SAMPLES_PER_FRAME (1 << 9) //512, about 10ms at 48kHz, power of two for easy FFT
 #define DEFAULT_FILTER_LENGTH (48 * 500)
+#define DEFAULT_MAX_WAIT_MS 20
+#define RINGBUF_SIZE (1 << 21) ///< bytes, about 1 s of 8 channels of 32-bit 48 kHz audio
+#define MAX_FAR_END_SAMPLES (2 << 15) ///< per channel, older far end samples are dropped
 
 #define MOD_NAME "[Echo cancel] "
 
@@ -78,44 +100,223 @@ namespace {
 
 struct echo_cancellation {
         std::unique_ptr<SpeexEchoState, Echo_state_deleter> echo_state;
-
-        ring_buffer_uniq near_end_ringbuf;
-        ring_buffer_uniq far_end_ringbuf;
-
-        std::unique_ptr<spx_int16_t[]> frame_data;
-        struct audio_frame frame;
-
-        int requested_delay;
-        int prefill;
+        int filter_length = DEFAULT_FILTER_LENGTH;
+        int frame_size = 0; ///< samples per channel processed at once
+        bool reinit = false;
+
+        ring_buffer_uniq far_end_ringbuf;  ///< playback thread -> canceller thread
+        ring_buffer_uniq near_end_ringbuf; ///< capture thread -> canceller thread
+        ring_buffer_uniq out_ringbuf;      ///< canceller thread -> capture thread
+
+        // owned by the canceller thread
+        echo_input far_end;
+        echo_input near_end;
+        std::vector<spx_int16_t> out;
+        std::vector<spx_int16_t> dump;
+        int requested_delay = 0;
+        int prefill = 0;
         time_point next_expected_near;
-
         std::unique_ptr<struct audio_export, Export_state_deleter> exporter;
 
-        std::mutex lock;
+        // owned by the capture thread
+        std::unique_ptr<char[]> frame_data;
+        struct audio_frame frame;
+        int near_overflows = 0;
+
+        // owned by the playback thread
+        int far_overflows = 0;
+
+        std::thread thread;
+        std::chrono::milliseconds max_wait{DEFAULT_MAX_WAIT_MS};
+        std::mutex lock; ///< synchronizes capture and canceller threads only
+        std::condition_variable work_cv;
+        std::condition_variable done_cv;
+        unsigned long long submitted = 0;
+        unsigned long long processed = 0;
+        bool should_exit = false;
 };
 
 ADD_TO_PARAM("echo-cancel-dump-audio", "* echo-cancel-dump-audio\n"
                 "  Dump near end, far end and output samples in separate channels to a wav file.\n");
 
-static void reconfigure_echo (struct echo_cancellation *s, int sample_rate, int bps);
-
-static void reconfigure_echo (struct echo_cancellation *s, int sample_rate, int bps)
+/// about 10 ms, power of two for easy FFT
+static int get_frame_size(int sample_rate)
 {
-        UNUSED(bps);
+        int frame_size = 1;
+        while (frame_size * 3 / 2 < sample_rate / 100) {
+                frame_size *= 2;
+        }
+        return frame_size;
+}
 
-        s->frame.bps = 2;
-        s->frame.ch_count = 1;
-        s->frame.sample_rate = sample_rate;
+static void reconfigure_echo(struct echo_cancellation *s)
+{
+        s->reinit = false;
+        s->echo_state.reset();
+        s->exporter.reset(nullptr); //previous file gets closed
+        if (s->near_end.ch_count == 0) { // nothing captured yet
+                return;
+        }
+        s->frame_size = get_frame_size(s->near_end.sample_rate);
 
-        ring_buffer_flush(s->far_end_ringbuf.get());
-        ring_buffer_flush(s->near_end_ringbuf.get());
+        if (s->far_end.sample_rate != s->near_end.sample_rate) {
+                if (s->far_end.sample_rate != 0) {
+                        log_msg(LOG_LEVEL_WARNING, MOD_NAME "Far end sample rate %d Hz differs from near end %d Hz, "
+                                        "echo won't be cancelled.\n", s->far_end.sample_rate, s->near_end.sample_rate);
+                }
+                return;
+        }
 
-        speex_echo_ctl(s->echo_state.get(), SPEEX_ECHO_SET_SAMPLING_RATE, &sample_rate); // should the 3rd parameter be int?
+        int sample_rate = s->near_end.sample_rate;
+        s->echo_state.reset(speex_echo_state_init_mc(s->frame_size, s->filter_length,
+                                s->near_end.ch_count, s->far_end.ch_count));
+        speex_echo_ctl(s->echo_state.get(), SPEEX_ECHO_SET_SAMPLING_RATE, &sample_rate);
+        log_msg(LOG_LEVEL_NOTICE, MOD_NAME "Cancelling echo of %d played channel(s) in %d captured channel(s), "
+                        "%d Hz, %d samples per frame.\n", s->far_end.ch_count, s->near_end.ch_count,
+                        sample_rate, s->frame_size);
 
         if(get_commandline_param("echo-cancel-dump-audio")){
-                s->exporter.reset(nullptr); //previous file gets closed
                 s->exporter.reset(audio_export_init("echo_cancel_dump.wav"));
-                audio_export_configure_raw(s->exporter.get(), 2, sample_rate, 3);
+                audio_export_configure_raw(s->exporter.get(), 2, sample_rate,
+                                2 * s->near_end.ch_count + s->far_end.ch_count);
+        }
+}
+
+static void drain_far_end(struct echo_cancellation *s)
+{
+        size_t prefill_to = 0;
+        if (s->prefill != 0 && s->far_end.ch_count != 0 && s->frame_size != 0) {
+                int target = std::max(s->frame_size, (s->prefill / s->frame_size) * s->frame_size);
+                int current = s->far_end.samples.size() / s->far_end.ch_count;
+                //buffer can contain small remainder (<frame_size)
+                if (target < current) {
+                        log_msg(LOG_LEVEL_WARNING, MOD_NAME "Pre fill requested to %d, but the buffer is already %d!\n", target, current);
+                } else if (ring_get_current_size(s->far_end_ringbuf.get()) > 0) {
+                        log_msg(LOG_LEVEL_NOTICE, MOD_NAME "Pre filling far end with %d samples\n", target - current);
+                        prefill_to = (size_t) target * s->far_end.ch_count;
+                        s->prefill = 0;
+                }
+        }
+
+        s->far_end.drain(s->far_end_ringbuf.get(), prefill_to, &s->reinit);
+        if (s->far_end.trim((size_t) MAX_FAR_END_SAMPLES * s->far_end.ch_count)) {
+                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Far end buffer overflow!\n");
+        }
+}
+
+static void drain_near_end(struct echo_cancellation *s)
+{
+        if (s->near_end.drain(s->near_end_ringbuf.get(), 0, &s->reinit) == 0) {
+                return;
+        }
+        if(s->next_expected_near < steady_clock::now() && s->far_end.ch_count != 0 && s->frame_size != 0){
+                /* It is possible that the capture thread starts late or
+                 * freezes, which could create an unwanted delay between far
+                 * and near ends.  To partialy protect against this, drop the
+                 * contents of far end buffer, when the last frame arrived more
+                 * than 1s ago.
+                 */
+                auto diff = steady_clock::now() - s->next_expected_near;
+                long long delay = std::chrono::duration_cast<std::chrono::microseconds>(diff).count();
+                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Near samples late by %lldus\n", delay);
+
+                //drop only whole frames
+                s->far_end.drop_frames(s->frame_size);
+        }
+        s->next_expected_near = steady_clock::now() + std::chrono::seconds(1);
+}
+
+static void export_frame(struct echo_cancellation *s, const spx_int16_t *near_arr, const spx_int16_t *far_arr,
+                const spx_int16_t *out_arr)
+{
+        const int near_ch = s->near_end.ch_count;
+        const int far_ch = s->far_end.ch_count;
+        const int dump_ch = 2 * near_ch + far_ch;
+        s->dump.resize((size_t) s->frame_size * dump_ch);
+        for (int i = 0; i < s->frame_size; ++i) {
+                spx_int16_t *dst = &s->dump[(size_t) i * dump_ch];
+                std::copy_n(near_arr + i * near_ch, near_ch, dst);
+                if (far_arr != nullptr) {
+                        std::copy_n(far_arr + i * far_ch, far_ch, dst + near_ch);
+                } else {
+                        std::fill_n(dst + near_ch, far_ch, 0);
+                }
+                std::copy_n(out_arr + i * near_ch, near_ch, dst + near_ch + far_ch);
+        }
+        audio_export_raw(s->exporter.get(), s->dump.data(), s->dump.size() * sizeof s->dump[0]);
+}
+
+static void process(struct echo_cancellation *s)
+{
+        if (s->reinit) {
+                reconfigure_echo(s);
+        }
+        if (s->near_end.ch_count == 0) {
+                return;
+        }
+
+        const size_t near_frame_len = (size_t) s->frame_size * s->near_end.ch_count;
+        const size_t far_frame_len = (size_t) s->frame_size * s->far_end.ch_count;
+        const size_t frames_to_process = s->near_end.samples.size() / near_frame_len;
+        if (frames_to_process == 0) {
+                return;
+        }
+        if (s->echo_state && s->far_end.samples.size() / far_frame_len < frames_to_process) {
+                log_msg(LOG_LEVEL_INFO, MOD_NAME "Not enough far end samples (%zu near, %zu far)\n",
+                                s->near_end.samples.size() / s->near_end.ch_count, s->far_end.samples.size() / s->far_end.ch_count);
+
+                //The delay between far end and near end will always be at least
+                //recorded frame length
+                s->prefill = s->near_end.samples.size() / s->near_end.ch_count + s->requested_delay;
+        }
+
+        s->out.resize(frames_to_process * near_frame_len);
+        size_t far_pos = 0;
+        for (size_t i = 0; i < frames_to_process; ++i) {
+                const spx_int16_t *near_arr = &s->near_end.samples[i * near_frame_len];
+                spx_int16_t *out_arr = &s->out[i * near_frame_len];
+                const spx_int16_t *far_arr = nullptr;
+                if (s->echo_state && s->far_end.samples.size() - far_pos >= far_frame_len) {
+                        far_arr = &s->far_end.samples[far_pos];
+                        speex_echo_cancellation(s->echo_state.get(), near_arr, far_arr, out_arr);
+                        far_pos += far_frame_len;
+                } else {
+                        std::copy_n(near_arr, near_frame_len, out_arr);
+                }
+
+                if (s->exporter) {
+                        export_frame(s, near_arr, far_arr, out_arr);
+                }
+        }
+        s->near_end.samples.erase(s->near_end.samples.begin(), s->near_end.samples.begin() + frames_to_process * near_frame_len);
+        s->far_end.samples.erase(s->far_end.samples.begin(), s->far_end.samples.begin() + far_pos);
+
+        struct echo_chunk_hdr hdr = { s->near_end.sample_rate, sizeof s->out[0], s->near_end.ch_count,
+                (int) (s->out.size() * sizeof s->out[0]) };
+        if (!echo_ring_push(s->out_ringbuf.get(), &hdr, reinterpret_cast<char *>(s->out.data()))) {
+                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Output ringbuf overflow!\n");
+        }
+}
+
+static void echo_worker(struct echo_cancellation *s)
+{
+        set_thread_name(__func__);
+        std::unique_lock lk(s->lock);
+        while (true) {
+                s->work_cv.wait(lk, [s] { return s->should_exit || s->processed != s->submitted; });
+                if (s->should_exit) {
+                        break;
+                }
+                const unsigned long long target = s->submitted;
+                lk.unlock();
+
+                drain_far_end(s);
+                drain_near_end(s);
+                process(s);
+
+                lk.lock();
+                s->processed = target;
+                s->done_cv.notify_one();
         }
 }
 
@@ -129,16 +330,19 @@ ADD_TO_PARAM("echo-cancel-filter-length", "* echo-cancel-filter-length=<samples>
 ADD_TO_PARAM("echo-cancel-delay", "* echo-cancel-delay=<samples>\n"
                 "  Echo cancellation additional delay added to far end in samples, should be slightly less than output device latency.\n");
 
+ADD_TO_PARAM("echo-cancel-max-wait", "* echo-cancel-max-wait=<ms>\n"
+                "  Maximal time the capture waits for the echo canceller, samples not processed in time are sent with the next frame. (default "
+                TEXTIFY(DEFAULT_MAX_WAIT_MS) ").\n");
+
 struct echo_cancellation * echo_cancellation_init(void)
 {
         struct echo_cancellation *s = new echo_cancellation();
 
-        int filter_length = DEFAULT_FILTER_LENGTH;
         if(const char *param = get_commandline_param("echo-cancel-filter-length"); param != nullptr){
                 char *end;
                 int len = strtol(param, &end, 10);
                 if(end != param)
-                        filter_length = len;
+                        s->filter_length = len;
         }
 
         if(const char *param = get_commandline_param("echo-cancel-delay"); param != nullptr){
@@ -148,204 +352,74 @@ struct echo_cancellation * echo_cancellation_init(void)
                         s->requested_delay = len;
         }
 
-        s->echo_state.reset(speex_echo_state_init(SAMPLES_PER_FRAME, filter_length));
-
-        s->frame.data = NULL;
-        s->frame.sample_rate = s->frame.bps = 0;
-
-        const int ringbuf_sample_count = 2 << 15; //should be divisable by SAMPLES_PER_FRAME
-        constexpr int bps = 2; //TODO: assuming bps to be 2
+        if(const char *param = get_commandline_param("echo-cancel-max-wait"); param != nullptr){
+                char *end;
+                int ms = strtol(param, &end, 10);
+                if(end != param)
+                        s->max_wait = std::chrono::milliseconds(ms);
+        }
 
-        s->far_end_ringbuf.reset(ring_buffer_init(ringbuf_sample_count * bps));
-        s->near_end_ringbuf.reset(ring_buffer_init(ringbuf_sample_count * bps));
+        s->far_end_ringbuf.reset(ring_buffer_init(RINGBUF_SIZE));
+        s->near_end_ringbuf.reset(ring_buffer_init(RINGBUF_SIZE));
+        s->out_ringbuf.reset(ring_buffer_init(RINGBUF_SIZE));
 
-        s->frame_data = std::make_unique<spx_int16_t[]>(ringbuf_sample_count);
-        s->frame.data = reinterpret_cast<char *>(s->frame_data.get());
-        s->frame.max_size = ringbuf_sample_count * sizeof(s->frame_data[0]);
-        static_assert(sizeof(s->frame_data[0]) == bps);
+        s->frame_data = std::make_unique<char[]>(RINGBUF_SIZE);
+        s->frame.data = s->frame_data.get();
+        s->frame.max_size = RINGBUF_SIZE;
+        s->next_expected_near = steady_clock::now() + std::chrono::seconds(1);
 
-        log_msg(LOG_LEVEL_NOTICE, MOD_NAME "Echo cancellation initialized with filter length %d samples.\n", filter_length);
+        s->thread = std::thread(echo_worker, s);
 
-        s->prefill = 0;
+        log_msg(LOG_LEVEL_NOTICE, MOD_NAME "Echo cancellation initialized with filter length %d samples.\n", s->filter_length);
 
         return s;
 }
 
 void echo_cancellation_destroy(struct echo_cancellation *s)
 {
+        {
+                std::lock_guard lk(s->lock);
+                s->should_exit = true;
+        }
+        s->work_cv.notify_one();
+        s->thread.join();
         delete s;
 }
 
+/**
+ * Called from the playback thread, never blocks.
+ */
 void echo_play(struct echo_cancellation *s, struct audio_frame *frame)
 {
-        std::lock_guard lk(s->lock);
-
-        if(frame->ch_count != 1) {
-                static int prints = 0;
-                if(prints++ % 100 == 0) {
-                        error_msg(MOD_NAME "Echo cancellation needs 1 played channel. Disabling echo cancellation.\n"
-                                        "Use channel mapping and let only one channel played to enable this feature.\n");
+        struct echo_chunk_hdr hdr = { frame->sample_rate, frame->bps, frame->ch_count, frame->data_len };
+        if (!echo_ring_push(s->far_end_ringbuf.get(), &hdr, frame->data)) {
+                if (s->far_overflows++ % 100 == 0) {
+                        log_msg(LOG_LEVEL_WARNING, MOD_NAME "Far end ringbuf overflow!\n");
                 }
-                return;
-        }
-
-        if(s->prefill){
-                int target = std::max(SAMPLES_PER_FRAME, (s->prefill / SAMPLES_PER_FRAME) * SAMPLES_PER_FRAME);
-                int current = ring_get_current_size(s->far_end_ringbuf.get());
-                //buffer can contain small remainder (<SAMPLES_PER_FRAME)
-                int to_fill = target - current;
-                s->prefill = 0;
-                if(to_fill < 0){
-                        log_msg(LOG_LEVEL_WARNING, MOD_NAME "Pre fill requested to %d, but the buffer is already %d!\n", target, current);
-                } else {
-                        ring_advance_write_idx(s->far_end_ringbuf.get(), to_fill);
-                        log_msg(LOG_LEVEL_NOTICE, MOD_NAME "Pre filling far end with %d samples\n", to_fill);
-                }
-        }
-
-        size_t samples = frame->data_len / frame->bps;
-        size_t ringbuf_free_samples = ring_get_available_write_size(s->far_end_ringbuf.get()) / 2;
-
-        if(samples > ringbuf_free_samples){
-                samples = ringbuf_free_samples;
-                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Far end ringbuf overflow!\n");
-        }
-
-        if(frame->bps != 2) {
-                void *ptr1;
-                int size1;
-                void *ptr2;
-                int size2;
-                ring_get_write_regions(s->far_end_ringbuf.get(), samples * 2,
-                                &ptr1, &size1, &ptr2, &size2);
-
-                assert(size1 % 2 == 0);
-                int in_bytes1 = (size1 / 2) * frame->bps;
-                change_bps(static_cast<char *>(ptr1), 2, frame->data, frame->bps, in_bytes1);
-                if(ptr2){
-                        change_bps(static_cast<char *>(ptr2), 2, frame->data + in_bytes1, frame->bps, frame->data_len - in_bytes1);
-                }
-
-                ring_advance_write_idx(s->far_end_ringbuf.get(), samples * 2);
-        } else {
-                ring_buffer_write(s->far_end_ringbuf.get(), frame->data, samples * 2);
         }
 }
 
+/**
+ * Called from the capture thread, waits for the canceller thread at most
+ * echo_cancellation::max_wait.
+ *
+ * @returns processed samples (of possibly different length than frame) or NULL if none
+ */
 struct audio_frame * echo_cancel(struct echo_cancellation *s, struct audio_frame *frame)
 {
-        struct audio_frame *res;
-
-        std::lock_guard lk(s->lock);
-
-        if(frame->ch_count != 1) {
-                static int prints = 0;
-                if(prints++ % 100 == 0)
-                        error_msg(MOD_NAME "Echo cancellation needs 1 captured channel. Disabling echo cancellation.\n"
-                                        "Use '--audio-capture-channels 1' parameter to capture single channel.\n");
-                return frame;
-        }
-
-
-        if(frame->sample_rate != s->frame.sample_rate ||
-                        frame->bps != s->frame.bps) {
-                reconfigure_echo(s, frame->sample_rate, frame->bps);
-        }
-
-
-        size_t in_frame_samples = frame->data_len / frame->bps;
-
-        size_t ringbuf_free_samples = ring_get_available_write_size(s->near_end_ringbuf.get()) / 2;
-        if(in_frame_samples > ringbuf_free_samples){
-                in_frame_samples = ringbuf_free_samples;
-                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Near end ringbuf overflow\n");
-        }
-
-        if(s->next_expected_near < steady_clock::now()){
-                /* It is possible that the capture thread starts late or
-                 * freezes, which could create an unwanted delay between far
-                 * and near ends.  To partialy protect against this, drop the
-                 * contents of far end buffer, when the last frame arrived more
-                 * than 1s ago.
-                 */
-                auto diff = steady_clock::now() - s->next_expected_near;
-                long long delay = std::chrono::duration_cast<std::chrono::microseconds>(diff).count();
-                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Near samples late by %lldus\n", delay);
-
-                int current = ring_get_current_size(s->far_end_ringbuf.get());
-                //drop only whole frames
-                current = (current / SAMPLES_PER_FRAME) * SAMPLES_PER_FRAME;
-                ring_advance_read_idx(s->far_end_ringbuf.get(), current);
-        }
-        s->next_expected_near = steady_clock::now() + std::chrono::seconds(1);
-
-        if(frame->bps != 2){
-                //Need to change bps, put whole incoming frame into ringbuf
-                void *ptr1;
-                int size1;
-                void *ptr2;
-                int size2;
-                ring_get_write_regions(s->near_end_ringbuf.get(), in_frame_samples * 2,
-                                &ptr1, &size1, &ptr2, &size2);
-
-                int in_bytes1 = (size1 / 2) * frame->bps;
-                change_bps(static_cast<char *>(ptr1), 2, frame->data, frame->bps, in_bytes1);
-                if(ptr2){
-                        change_bps(static_cast<char *>(ptr2), 2, frame->data + in_bytes1, frame->bps, frame->data_len - in_bytes1);
+        struct echo_chunk_hdr hdr = { frame->sample_rate, frame->bps, frame->ch_count, frame->data_len };
+        if (!echo_ring_push(s->near_end_ringbuf.get(), &hdr, frame->data)) {
+                if (s->near_overflows++ % 100 == 0) {
+                        log_msg(LOG_LEVEL_WARNING, MOD_NAME "Near end ringbuf overflow\n");
                 }
-                ring_advance_write_idx(s->near_end_ringbuf.get(), in_frame_samples * 2);
-        } else {
-                ring_buffer_write(s->near_end_ringbuf.get(), frame->data, frame->data_len);
-        }
-
-        size_t near_end_samples = ring_get_current_size(s->near_end_ringbuf.get()) / 2;
-        size_t far_end_samples = ring_get_current_size(s->far_end_ringbuf.get()) / 2;
-
-        if(far_end_samples < near_end_samples){
-                log_msg(LOG_LEVEL_INFO, MOD_NAME "Not enough far end samples (%zu near, %zu far)\n", near_end_samples, far_end_samples);
-
-                //The delay between far end and near end will always be at least
-                //recorded frame length
-                s->prefill = in_frame_samples + s->requested_delay;
         }
 
-        size_t frames_to_process = near_end_samples / SAMPLES_PER_FRAME;
-        if(!frames_to_process){
-                return NULL;
+        {
+                std::unique_lock lk(s->lock);
+                const unsigned long long seq = ++s->submitted;
+                s->work_cv.notify_one();
+                s->done_cv.wait_for(lk, s->max_wait, [s, seq] { return s->processed >= seq; });
         }
 
-        size_t out_size = frames_to_process * SAMPLES_PER_FRAME * 2;
-        assert(static_cast<size_t>(s->frame.max_size) >= out_size);
-        s->frame.data_len = out_size;
-        res = &s->frame;
-
-        spx_int16_t *out_ptr = (spx_int16_t *)(void *) s->frame.data;
-        for(size_t i = 0; i < frames_to_process; i++){
-                spx_int16_t near_arr[SAMPLES_PER_FRAME];
-                spx_int16_t far_arr[SAMPLES_PER_FRAME];
-
-                const void *export_channels[] = {near_arr, far_arr, out_ptr, nullptr};
-                if(far_end_samples >= SAMPLES_PER_FRAME){
-                        ring_buffer_read(s->far_end_ringbuf.get(), reinterpret_cast<char *>(far_arr), SAMPLES_PER_FRAME * 2);
-                        ring_buffer_read(s->near_end_ringbuf.get(), reinterpret_cast<char *>(near_arr), SAMPLES_PER_FRAME * 2);
-
-                        speex_echo_cancellation(s->echo_state.get(), near_arr, far_arr, out_ptr); 
-                        far_end_samples -= SAMPLES_PER_FRAME;
-
-                } else {
-                        ring_buffer_read(s->near_end_ringbuf.get(), reinterpret_cast<char *>(out_ptr), SAMPLES_PER_FRAME * 2);
-                        export_channels[0] = out_ptr;
-                        export_channels[1] = out_ptr;
-                        export_channels[2] = out_ptr;
-                }
-
-                if(s->exporter){
-                        audio_export_raw_ch(s->exporter.get(), export_channels, SAMPLES_PER_FRAME);
-                }
-
-                out_ptr += SAMPLES_PER_FRAME;
-        }
-
-        return res;
+        return echo_ring_read_frame(s->out_ringbuf.get(), &s->frame) ? &s->frame : NULL;
 }
-
@@ -0,0 +1,159 @@
+/**
+ * @file   audio/echo_ring.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2026 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <algorithm>
+#include <cstring>
+
+#include "audio/echo_ring.hpp"
+#include "audio/types.h"
+#include "audio/utils.h"
+#include "utils/ring_buffer.h"
+
+/// copies len bytes from src to offset off of the area formed by 2 ring buffer regions
+static void write_to_regions(char *ptr1, int size1, char *ptr2, int *off, const char *src, int len)
+{
+        const int first = std::clamp(size1 - *off, 0, len);
+        if (first > 0) {
+                memcpy(ptr1 + *off, src, first);
+        }
+        if (len > first) {
+                memcpy(ptr2 + (*off + first - size1), src + first, len - first);
+        }
+        *off += len;
+}
+
+bool echo_ring_push(struct ring_buffer *ring, const struct echo_chunk_hdr *hdr, const char *data)
+{
+        const int len = (int) sizeof *hdr + hdr->data_len;
+        if (ring_get_available_write_size(ring) < len) {
+                return false;
+        }
+        void *ptr1;
+        int size1;
+        void *ptr2;
+        int size2;
+        ring_get_write_regions(ring, len, &ptr1, &size1, &ptr2, &size2);
+        int off = 0;
+        write_to_regions(static_cast<char *>(ptr1), size1, static_cast<char *>(ptr2), &off,
+                        reinterpret_cast<const char *>(hdr), sizeof *hdr);
+        write_to_regions(static_cast<char *>(ptr1), size1, static_cast<char *>(ptr2), &off, data, hdr->data_len);
+        ring_advance_write_idx(ring, len);
+        return true;
+}
+
+static bool peek_chunk_hdr(struct ring_buffer *ring, struct echo_chunk_hdr *hdr)
+{
+        void *ptr1;
+        int size1;
+        void *ptr2;
+        int size2;
+        if (ring_get_read_regions(ring, (int) sizeof *hdr, &ptr1, &size1, &ptr2, &size2) < (int) sizeof *hdr) {
+                return false;
+        }
+        memcpy(hdr, ptr1, size1);
+        if (ptr2) {
+                memcpy(reinterpret_cast<char *>(hdr) + size1, ptr2, size2);
+        }
+        return true;
+}
+
+bool echo_ring_read_frame(struct ring_buffer *ring, struct audio_frame *frame)
+{
+        struct echo_chunk_hdr hdr;
+        frame->data_len = 0;
+        while (peek_chunk_hdr(ring, &hdr)) {
+                if (frame->data_len > 0 && (hdr.sample_rate != frame->sample_rate
+                                        || hdr.bps != frame->bps
+                                        || hdr.ch_count != frame->ch_count
+                                        || frame->data_len + hdr.data_len > frame->max_size)) {
+                        break; // format changed, return the rest next time
+                }
+                ring_advance_read_idx(ring, sizeof hdr);
+                ring_buffer_read(ring, frame->data + frame->data_len, hdr.data_len);
+                frame->data_len += hdr.data_len;
+                frame->sample_rate = hdr.sample_rate;
+                frame->bps = hdr.bps;
+                frame->ch_count = hdr.ch_count;
+        }
+        return frame->data_len > 0;
+}
+
+int echo_input::drain(struct ring_buffer *ring, size_t prefill_to, bool *fmt_changed)
+{
+        struct echo_chunk_hdr hdr;
+        int chunks = 0;
+        while (peek_chunk_hdr(ring, &hdr)) {
+                ring_advance_read_idx(ring, sizeof hdr);
+                chunk_data.resize(hdr.data_len);
+                ring_buffer_read(ring, chunk_data.data(), hdr.data_len);
+
+                const size_t old_size = std::max(samples.size(), chunks == 0 ? prefill_to : 0);
+                const size_t chunk_samples = hdr.data_len / hdr.bps;
+                samples.resize(old_size + chunk_samples); // prefill, if any, is zeroed
+                change_bps(reinterpret_cast<char *>(samples.data() + old_size), sizeof samples[0],
+                                chunk_data.data(), hdr.bps, hdr.data_len);
+                if (hdr.sample_rate != sample_rate || hdr.ch_count != ch_count) {
+                        sample_rate = hdr.sample_rate;
+                        ch_count = hdr.ch_count;
+                        samples.erase(samples.begin(), samples.end() - chunk_samples);
+                        *fmt_changed = true;
+                }
+                chunks += 1;
+        }
+        return chunks;
+}
+
+bool echo_input::trim(size_t max_len)
+{
+        if (samples.size() <= max_len) {
+                return false;
+        }
+        samples.erase(samples.begin(), samples.end() - max_len);
+        return true;
+}
+
+void echo_input::drop_frames(int frame_size)
+{
+        const size_t frame_len = (size_t) frame_size * ch_count;
+        samples.erase(samples.begin(), samples.begin() + (samples.size() / frame_len) * frame_len);
+}
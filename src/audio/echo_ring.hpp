@@ -0,0 +1,106 @@
+/**
+ * @file   audio/echo_ring.hpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Hand-off of audio samples between the echo canceller and the playback and
+ * capture threads. Chunks consisting of echo_chunk_hdr followed by the
+ * samples in the original format are passed through single-producer
+ * single-consumer ring buffers, so format changes travel in-band. Doesn't
+ * depend on the canceller implementation.
+ */
+/*
+ * Copyright (c) 2026 CESNET z.s.p.o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ECHO_RING_HPP_8E2D4B17_61C3_4A95_B07F_3C9A52E1D6F0
+#define ECHO_RING_HPP_8E2D4B17_61C3_4A95_B07F_3C9A52E1D6F0
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct audio_frame;
+struct ring_buffer;
+
+/// precedes samples of every chunk in the ring buffers
+struct echo_chunk_hdr {
+        int sample_rate;
+        int bps;
+        int ch_count;
+        int data_len; ///< length of the following samples in bytes
+};
+
+/**
+ * Writes header and samples as a single ring buffer write so that the reader
+ * sees either both or nothing. Doesn't block or allocate.
+ *
+ * @retval false not enough space in the ring, nothing written
+ */
+bool echo_ring_push(struct ring_buffer *ring, const struct echo_chunk_hdr *hdr, const char *data);
+
+/**
+ * Reads following chunks of the same format from the ring as long as they
+ * fit in frame->max_size. A chunk of a different format is left in the ring
+ * for the next call.
+ *
+ * @returns true if frame contains some samples
+ */
+bool echo_ring_read_frame(struct ring_buffer *ring, struct audio_frame *frame);
+
+/**
+ * Canceller side of an input ring. Samples are converted to 16 bits and only
+ * samples in the most recent format are kept.
+ */
+struct echo_input {
+        int sample_rate = 0;
+        int ch_count = 0;
+        std::vector<int16_t> samples; ///< interleaved, ch_count channels
+
+        /**
+         * Reads all chunks available in the ring.
+         *
+         * @param prefill_to  samples (all channels) are zero-padded to this
+         *                    length before the first chunk is appended
+         * @param fmt_changed set to true if the stream format has changed
+         * @returns number of chunks read
+         */
+        int drain(struct ring_buffer *ring, size_t prefill_to, bool *fmt_changed);
+        /// keeps at most max_len last samples (all channels), @retval true if some were dropped
+        bool trim(size_t max_len);
+        /// drops all whole frames of frame_size samples per channel
+        void drop_frames(int frame_size);
+
+private:
+        std::vector<char> chunk_data;
+};
+
+#endif // ! defined ECHO_RING_HPP_8E2D4B17_61C3_4A95_B07F_3C9A52E1D6F0
@@ -41,7 +41,9 @@
 #include "config_win32.h"
 #endif /* HAVE_CONFIG_H */
 
+#include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -51,13 +53,21 @@
 #include "audio/wav_writer.h"
 #include "debug.h"
 #include "export.h"
+#include "tv.h"
 #include "utils/misc.h" // ug_strerror
 #include "utils/ring_buffer.h"
 
 #define CACHE_SECONDS                   10
+#define WRITE_BATCH_SIZE                (512 * 1024) ///< approximate size of a single write, worker wake-up watermark
+#define WRITE_BUF_ALIGN                 4096
+#define MAX_WAIT_MS                     100          ///< max latency of data lying in the ring below the watermark
+#define HEADER_UPDATE_INTERVAL_SEC      2            ///< WAV header is updated to be playable even if not finalized
 
 /*
  * we do not need to have possible stalls, so IO is performend in a separate thread
+ *
+ * The producer writes to the ring buffer without locking (single producer,
+ * single consumer) and wakes up the worker only when a whole batch is ready.
  */
 static void *audio_export_thread(void *arg);
 static bool configure(struct audio_export *s, struct audio_desc fmt);
@@ -69,56 +79,102 @@ struct audio_export {
         struct audio_desc saved_format;
 
         ring_buffer_t *ring;
+        char *batch_buf;        ///< aligned buffer for data wrapping around the ring end
+        int batch_size;         ///< multiple of sample size
 
         pthread_t thread_id;
         pthread_mutex_t lock;
         pthread_cond_t worker_cv;
-        volatile bool new_work_ready;
-        volatile bool worker_waiting;
-
-        volatile bool should_exit_worker;
+        atomic_bool worker_waiting;
+        atomic_bool should_exit_worker;
+        atomic_ullong dropped_bytes;
 };
 
+/// writes (at most) one batch from the ring to the file
+static void write_batch(struct audio_export *s, int avail)
+{
+        const int sample_size = s->saved_format.bps * s->saved_format.ch_count;
+        int len = MIN(avail, s->batch_size);
+        len -= len % sample_size;
+
+        void *ptr1;
+        int size1;
+        void *ptr2;
+        int size2;
+        ring_get_read_regions(s->ring, len, &ptr1, &size1, &ptr2, &size2);
+        const char *data = ptr1;
+        if (ptr2 != NULL && size2 > 0) { // wraps around - make it contiguous to issue a single write
+                memcpy(s->batch_buf, ptr1, size1);
+                memcpy(s->batch_buf + size1, ptr2, size2);
+                data = s->batch_buf;
+        }
+        int rc = wav_writer_write(s->wav, len / sample_size, data);
+        if (rc != 0) {
+                log_msg(LOG_LEVEL_ERROR, "[Audio export] Problem writing audio samples: %s\n", ug_strerror(-rc));
+        }
+        ring_advance_read_idx(s->ring, len);
+}
+
 static void *audio_export_thread(void *arg)
 {
         struct audio_export *s = arg;
-
-        while(!s->should_exit_worker) {
-                pthread_mutex_lock(&s->lock);
-                while(!s->new_work_ready) {
-                        s->worker_waiting = true;
-                        pthread_cond_wait(&s->worker_cv, &s->lock);
-                        s->worker_waiting = false;
+        time_ns_t last_header_update = get_time_in_ns();
+        bool timed_out = false;
+
+        while (1) {
+                // read the exit flag first so that no data written before it was set is lost
+                const bool should_exit = s->should_exit_worker;
+                const int avail = ring_get_current_size(s->ring);
+                if (avail >= s->batch_size || (avail > 0 && (should_exit || timed_out))) {
+                        write_batch(s, avail);
+                        timed_out = false;
+                        continue;
                 }
-
-                int size = ring_get_current_size(s->ring);
-
-                if(s->should_exit_worker && size == 0) {
-                        pthread_mutex_unlock(&s->lock);
+                if (should_exit) {
                         break;
                 }
 
-                char *data = malloc(size);
-                assert(data);
-                size_t res = ring_buffer_read(s->ring, data, size);
-                assert(res == (size_t) size);
-                assert(ring_get_current_size(s->ring) == 0);
-                s->new_work_ready = false;
-
-                pthread_mutex_unlock(&s->lock);
-
-                const int sample_size = s->saved_format.bps * s->saved_format.ch_count;
-                int rc = wav_writer_write(s->wav, size / sample_size, data);
-                if (rc != 0) {
-                        fprintf(stderr, "[Audio export] Problem writing audio samples: %s\n", ug_strerror(-rc));
+                if (get_time_in_ns() - last_header_update > HEADER_UPDATE_INTERVAL_SEC * NS_IN_SEC) {
+                        int rc = wav_writer_update_header(s->wav);
+                        if (rc != 0) {
+                                log_msg(LOG_LEVEL_ERROR, "[Audio export] Cannot update WAV header: %s\n", ug_strerror(-rc));
+                        }
+                        last_header_update = get_time_in_ns();
+                }
+                unsigned long long dropped = atomic_exchange(&s->dropped_bytes, 0);
+                if (dropped > 0) {
+                        log_msg(LOG_LEVEL_WARNING, "[Audio export] Write too slow, dropped %llu B of audio!\n", dropped);
                 }
 
-                free(data);
+                pthread_mutex_lock(&s->lock);
+                s->worker_waiting = true;
+                if (ring_get_current_size(s->ring) < s->batch_size && !s->should_exit_worker) {
+                        struct timespec ts;
+                        timespec_get(&ts, TIME_UTC);
+                        ts.tv_nsec += MAX_WAIT_MS * NS_IN_MS;
+                        ts.tv_sec += ts.tv_nsec / NS_IN_SEC;
+                        ts.tv_nsec %= NS_IN_SEC;
+                        timed_out = pthread_cond_timedwait(&s->worker_cv, &s->lock, &ts) == ETIMEDOUT;
+                }
+                s->worker_waiting = false;
+                pthread_mutex_unlock(&s->lock);
         }
 
         return NULL;
 }
 
+/// wakes up the worker if there is a batch to write (or on exit)
+static void notify_worker(struct audio_export *s, bool force)
+{
+        atomic_thread_fence(memory_order_seq_cst); // ring write vs. worker_waiting load, pairs with the worker
+        if (!s->worker_waiting || (!force && ring_get_current_size(s->ring) < s->batch_size)) {
+                return;
+        }
+        pthread_mutex_lock(&s->lock);
+        pthread_cond_signal(&s->worker_cv);
+        pthread_mutex_unlock(&s->lock);
+}
+
 static bool configure(struct audio_export *s, struct audio_desc fmt) {
         s->saved_format = fmt;
 
@@ -127,8 +183,10 @@ static bool configure(struct audio_export *s, struct audio_desc fmt) {
                 return false;
         }
 
-        s->ring = ring_buffer_init(CACHE_SECONDS * fmt.sample_rate * fmt.bps *
-                        fmt.ch_count);
+        const int sample_size = fmt.bps * fmt.ch_count;
+        s->ring = ring_buffer_init(CACHE_SECONDS * fmt.sample_rate * sample_size);
+        s->batch_size = MAX(WRITE_BATCH_SIZE / sample_size, 1) * sample_size;
+        s->batch_buf = aligned_malloc(s->batch_size, WRITE_BUF_ALIGN);
 
         return true;
 }
@@ -170,9 +228,9 @@ struct audio_export * audio_export_init(const char *filename)
 
         pthread_mutex_init(&s->lock, NULL);
         pthread_cond_init(&s->worker_cv, NULL);
-        s->new_work_ready = false;
-        s->worker_waiting = false;
-        s->should_exit_worker = false;
+        atomic_init(&s->worker_waiting, false);
+        atomic_init(&s->should_exit_worker, false);
+        atomic_init(&s->dropped_bytes, 0);
 
         s->saved_format = (struct audio_desc) { 0, 0, 0, 0 };
 
@@ -183,13 +241,8 @@ void audio_export_destroy(struct audio_export *s)
 {
         if(s) {
                 if(s->thread_id) {
-                        pthread_mutex_lock(&s->lock);
                         s->should_exit_worker = true;
-                        s->new_work_ready = true;
-                        if(s->worker_waiting) {
-                                pthread_cond_signal(&s->worker_cv);
-                        }
-                        pthread_mutex_unlock(&s->lock);
+                        notify_worker(s, true);
                         pthread_join(s->thread_id, NULL);
                 }
 
@@ -199,6 +252,7 @@ void audio_export_destroy(struct audio_export *s)
                 if (s->ring != NULL) {
                         ring_buffer_destroy(s->ring);
                 }
+                aligned_free(s->batch_buf);
                 pthread_cond_destroy(&s->worker_cv);
                 pthread_mutex_destroy(&s->lock);
                 free(s->filename);
@@ -208,14 +262,12 @@ void audio_export_destroy(struct audio_export *s)
 
 void audio_export_raw(struct audio_export *s, void *data, unsigned len){
         assert(s->saved_format.ch_count != 0 && "Export not configured");
-        pthread_mutex_lock(&s->lock);
-        ring_buffer_write(s->ring, data, len);
-        s->new_work_ready = true;
-
-        if(s->worker_waiting) {
-                pthread_cond_signal(&s->worker_cv);
+        if (ring_get_available_write_size(s->ring) < (int) len) {
+                s->dropped_bytes += len;
+                return;
         }
-        pthread_mutex_unlock(&s->lock);
+        ring_buffer_write(s->ring, data, len);
+        notify_worker(s, false);
 }
 
 void audio_export(struct audio_export *s, const struct audio_frame *frame)
@@ -267,8 +319,11 @@ void audio_export_raw_ch(struct audio_export *s,
         assert(ch_count != 0 && "Export not configured");
 
         int len = s->saved_format.ch_count * s->saved_format.bps * sample_count;
+        if (ring_get_available_write_size(s->ring) < len) {
+                s->dropped_bytes += len;
+                return;
+        }
 
-        pthread_mutex_lock(&s->lock);
         void *ptr1;
         int size1;
         void *ptr2;
@@ -284,11 +339,6 @@ void audio_export_raw_ch(struct audio_export *s,
         }
 
         ring_advance_write_idx(s->ring, avail);
-
-        s->new_work_ready = true;
-        if(s->worker_waiting) {
-                pthread_cond_signal(&s->worker_cv);
-        }
-        pthread_mutex_unlock(&s->lock);
+        notify_worker(s, false);
 }
 
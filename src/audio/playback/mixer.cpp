@@ -51,8 +51,10 @@
 #include "module.h"
 #include "rtp/rtp.h"
 #include "transmit.h"
+#include "tv.h"
 #include "utils/audio_buffer.h"
 #include "utils/thread.h"
+#include "utils/virtual_clock.h"
 #include <chrono>
 #include <iostream>
 #include <map>
@@ -167,7 +169,7 @@ struct am_participant {
         struct audio_buffer *m_buffer;
         struct rtp *m_network_device;
         struct tx *m_tx_session;
-        chrono::steady_clock::time_point last_seen;
+        time_ns_t last_seen; ///< @sa mixer_time_now()
 };
 
 template<typename source_t, typename intermediate_t>
@@ -281,18 +283,33 @@ private:
         unique_ptr<generic_mix_algo<sample_type_source, sample_type_mixed>> mixing_algorithm{new linear_mix_algo<sample_type_source, sample_type_mixed>()};
 };
 
+/// @returns virtual time if enabled, steady clock time otherwise
+static time_ns_t mixer_time_now()
+{
+        if (virtual_clock_enabled) {
+                return get_time_in_ns();
+        }
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void state_audio_mixer::worker()
 {
         set_thread_name(__func__);
-        chrono::steady_clock::time_point next_frame_time = chrono::steady_clock::now();
+        time_ns_t next_frame_time = mixer_time_now();
 
         static_assert(SAMPLES_PER_FRAME * 1000ll % SAMPLE_RATE == 0, "Sample rate is not evenly divisible by number of samples in frame");
-        const chrono::milliseconds interval(SAMPLES_PER_FRAME*1000ll/SAMPLE_RATE);
+        const time_ns_t interval = SAMPLES_PER_FRAME * NS_IN_SEC / SAMPLE_RATE;
 
         while (!should_exit) {
-                this_thread::sleep_until(next_frame_time);
+                if (virtual_clock_enabled) {
+                        virtual_clock_sleep_until(next_frame_time);
+                } else {
+                        this_thread::sleep_until(chrono::steady_clock::time_point(
+                                                chrono::duration_cast<chrono::steady_clock::duration>(
+                                                                chrono::nanoseconds(next_frame_time))));
+                }
                 next_frame_time += interval;
-                auto now = chrono::steady_clock::now();
+                const time_ns_t now = mixer_time_now();
 
                 // check if we didn't overslept much
                 if (next_frame_time < now) {
@@ -304,7 +321,7 @@ void state_audio_mixer::worker()
                 // check timeouts
                 for (auto it = participants.cbegin(); it != participants.cend(); )
                 {
-                        if (duration_cast<seconds>(now - it->second.last_seen).count() > PARTICIPANT_TIMEOUT_S) {
+                        if (now - it->second.last_seen > PARTICIPANT_TIMEOUT_S * NS_IN_SEC) {
                                 it = participants.erase(it);
                         } else {
                                 ++it;
@@ -419,7 +436,7 @@ static void audio_play_mixer_put_frame(void *state, const struct audio_frame *fr
         }
 
         audio_buffer_write(s->participants.at(ss).m_buffer, frame->data, frame->data_len);
-        s->participants.at(ss).last_seen = chrono::steady_clock::now();
+        s->participants.at(ss).last_seen = mixer_time_now();
 }
 
 static void audio_play_mixer_done(void *state)
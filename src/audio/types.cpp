@@ -48,6 +48,7 @@
 #include "debug.h"
 #include "host.h"
 #include "utils/macros.h"
+#include "utils/mem_account.h"
 
 #include <chrono>
 #include <sstream>
@@ -58,7 +59,6 @@ using std::logic_error;
 using std::ostringstream;
 using std::string;
 using std::tuple;
-using std::unique_ptr;
 using std::vector;
 
 bool audio_desc::operator!() const
@@ -155,6 +155,18 @@ void audio_frame2::replace(int channel, size_t offset, const char *data, size_t
         copy(data, data + length, channels[channel].data.get() + offset);
 }
 
+void audio_frame2::channel_data_deleter::operator()(char *data) const
+{
+        mem_account_free(MEM_ACC_AUDIO_FRAME, size);
+        delete [] data;
+}
+
+audio_frame2::channel_data audio_frame2::alloc_channel_data(size_t len)
+{
+        mem_account_alloc(MEM_ACC_AUDIO_FRAME, len);
+        return channel_data(new char[len], channel_data_deleter{len});
+}
+
 /**
  * Reserves data for every channel with the specified length.
  */
@@ -168,7 +180,7 @@ void audio_frame2::reserve(size_t length)
 void audio_frame2::reserve(int channel, size_t length)
 {
         if (channels[channel].max_len < length) {
-                unique_ptr<char []> new_data(new char[length]);
+                channel_data new_data = alloc_channel_data(length);
                 copy(channels[channel].data.get(), channels[channel].data.get() +
                                 channels[channel].len, new_data.get());
 
@@ -302,7 +314,7 @@ audio_frame2 audio_frame2::copy_with_bps_change(audio_frame2 const &frame, int n
 
         for (size_t i = 0; i < ret.channels.size(); i++) {
                 ret.channels[i].len = frame.get_data_len(i) / frame.get_bps() * new_bps;
-                ret.channels[i].data = unique_ptr<char []>(new char[ret.channels[i].len]);
+                ret.channels[i].data = alloc_channel_data(ret.channels[i].len);
                 ::change_bps(ret.channels[i].data.get(), new_bps, frame.get_data(i), frame.get_bps(),
                                 frame.get_data_len(i));
         }
@@ -320,7 +332,7 @@ void  audio_frame2::change_bps(int new_bps)
 
         for (size_t i = 0; i < channels.size(); i++) {
                 size_t new_size = channels[i].len / desc.bps * new_bps;
-                new_channels[i] = {unique_ptr<char []>(new char[new_size]), new_size, new_size, {}};
+                new_channels[i] = {alloc_channel_data(new_size), new_size, new_size, {}};
         }
 
         for (size_t i = 0; i < channels.size(); i++) {
@@ -346,7 +358,7 @@ tuple<bool, audio_frame2> audio_frame2::resample_fake(audio_frame2_resampler & r
                 // allocate new storage + 10 ms headroom
                 size_t new_size = (long long) channels[i].len * new_sample_rate_num / desc.sample_rate / new_sample_rate_den
                         + new_sample_rate_num * desc.bps / 100 / new_sample_rate_den;
-                new_channels[i] = {unique_ptr<char []>(new char[new_size]), new_size, new_size, {}};
+                new_channels[i] = {alloc_channel_data(new_size), new_size, new_size, {}};
         }
 
         auto [ret, remainder] = resampler_state.resample(*this, new_channels, new_sample_rate_num, new_sample_rate_den);
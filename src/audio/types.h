@@ -196,8 +196,14 @@ public:
         ///@ resamples to new sample rate while keeping nominal sample rate intact
         std::tuple<bool, audio_frame2> resample_fake(audio_frame2_resampler & resampler_state, int new_sample_rate_num, int new_sample_rate_den);
 private:
+        struct channel_data_deleter {
+                size_t size; ///< allocated size (for memory accounting)
+                void operator()(char *data) const;
+        };
+        using channel_data = std::unique_ptr<char [], channel_data_deleter>;
+        static channel_data alloc_channel_data(size_t len);
         struct channel {
-                std::unique_ptr<char []> data;
+                channel_data data;
                 size_t len;
                 size_t max_len;
                 struct fec_desc fec_params;
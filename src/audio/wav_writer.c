@@ -88,6 +88,8 @@ struct wav_writer_file {
         FILE *outfile;
         struct audio_desc fmt;
         long long samples_written;
+        char *tmp;           ///< conversion buffer for 8-bit samples (reused)
+        long long tmp_size;
 };
 
 #define CHECK_FWRITE(a, b, c, d) do { if (fwrite(a, b, c, d) != (c)) { \
@@ -150,68 +152,88 @@ struct wav_writer_file *wav_writer_create(const char *filename, struct audio_des
 
 int wav_writer_write(struct wav_writer_file *wav, long long sample_count, const char *data)
 {
-        char *tmp = NULL;
         if (wav->fmt.bps == 1) {
-                long long size = sample_count * wav->fmt.bps;
-                tmp = malloc(size);
-                signed2unsigned(tmp, data, size);
-                data = tmp;
+                long long size = sample_count * wav->fmt.ch_count;
+                if (size > wav->tmp_size) {
+                        free(wav->tmp);
+                        wav->tmp = malloc(size);
+                        wav->tmp_size = size;
+                }
+                signed2unsigned(wav->tmp, data, size);
+                data = wav->tmp;
         }
         size_t res = fwrite(data, wav->fmt.bps * wav->fmt.ch_count, sample_count, wav->outfile);
         wav->samples_written += res;
-        free(tmp);
         if (res != (size_t) sample_count) {
                 return -errno;
         }
         return 0;
 }
 
-bool wav_writer_close(struct wav_writer_file *wav)
+/**
+ * Writes current RIFF and data chunk sizes to the header. File position is
+ * left after the header.
+ */
+static bool wav_write_sizes(struct wav_writer_file *wav, int padding_byte_len)
 {
-        int padding_byte_len = 0;
-        if ((wav->fmt.ch_count * wav->fmt.bps * wav->samples_written) % 2 == 1) {
-                char padding_byte = '\0';
-                padding_byte_len = 1;
-                if (fwrite(&padding_byte, sizeof(padding_byte), 1, wav->outfile) != 1) {
-                        goto error;
-                }
-        }
-
         int64_t ret = _fseeki64(wav->outfile, CK_MASTER_SIZE_OFFSET, SEEK_SET);
         if (ret != 0) {
-                goto error;
+                return false;
         }
         long long ck_master_size = 4 + FMT_CHUNK_SIZE_BRUT + (DATA_CHUNK_HDR_SIZE + wav->fmt.bps *
                         wav->fmt.ch_count * wav->samples_written + padding_byte_len);
-        if (ck_master_size > UINT32_MAX) {
-                fprintf(stderr, "[WAV writer] Data size exceeding 4 GiB, resulting file may be incompatible!\n");
-        }
 
         uint32_t val = ck_master_size < UINT32_MAX ? ck_master_size : UINT32_MAX;
         size_t res = fwrite(&val, sizeof val, 1, wav->outfile);
         if(res != 1) {
-                goto error;
+                return false;
         }
 
         ret = _fseeki64(wav->outfile, CK_DATA_SIZE_OFFSET, SEEK_SET);
         if (ret != 0) {
-                goto error;
+                return false;
         }
         long long ck_data_size = wav->fmt.bps *
                         wav->fmt.ch_count * wav->samples_written;
         val = ck_data_size < UINT32_MAX ? ck_data_size : UINT32_MAX;
         res = fwrite(&val, sizeof val, 1, wav->outfile);
-        if(res != 1) {
-                goto error;
+        return res == 1;
+}
+
+int wav_writer_update_header(struct wav_writer_file *wav)
+{
+        if (!wav_write_sizes(wav, 0) || _fseeki64(wav->outfile, 0, SEEK_END) != 0 ||
+                        fflush(wav->outfile) != 0) {
+                return -errno;
         }
+        return 0;
+}
 
+bool wav_writer_close(struct wav_writer_file *wav)
+{
+        bool ret = true;
+        int padding_byte_len = 0;
+        if ((wav->fmt.ch_count * wav->fmt.bps * wav->samples_written) % 2 == 1) {
+                char padding_byte = '\0';
+                padding_byte_len = 1;
+                if (fwrite(&padding_byte, sizeof(padding_byte), 1, wav->outfile) != 1) {
+                        ret = false;
+                }
+        }
+
+        if (wav->fmt.bps * wav->fmt.ch_count * wav->samples_written > UINT32_MAX - 4 - FMT_CHUNK_SIZE_BRUT - DATA_CHUNK_HDR_SIZE) {
+                fprintf(stderr, "[WAV writer] Data size exceeding 4 GiB, resulting file may be incompatible!\n");
+        }
+        if (ret && !wav_write_sizes(wav, padding_byte_len)) {
+                ret = false;
+        }
+
+        if (!ret) {
+                fprintf(stderr, "[Audio export] Could not finalize file. Audio file may be corrupted.\n");
+        }
         fclose(wav->outfile);
+        free(wav->tmp);
         free(wav);
-        return true;
-error:
-        fprintf(stderr, "[Audio export] Could not finalize file. Audio file may be corrupted.\n");
-        fclose(wav->outfile);
-        free(wav);
-        return false;
+        return ret;
 }
 
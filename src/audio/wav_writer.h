@@ -66,6 +66,15 @@ struct wav_writer_file *wav_writer_create(const char *filename, struct audio_des
  */
 int wav_writer_write(struct wav_writer_file *wav, long long sample_count, const char *data);
 
+/**
+ * Updates sizes in the header to match the data written so far and flushes
+ * the file so that it stays playable if not closed properly.
+ *
+ * @retval      0 on success
+ * @retval -errno on failure
+ */
+int wav_writer_update_header(struct wav_writer_file *wav);
+
 /**
  * @param wav file returned by wav_write_header, will be closed by this call
  *            and must not be used after
@@ -41,27 +41,72 @@
 #include "config_win32.h"
 #endif /* HAVE_CONFIG_H */
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "capture_filter.h"
 #include "debug.h"
 #include "lib_common.h"
 #include "module.h"
+#include "tv.h"
 #include "utils/color_out.h"
 #include "utils/list.h"
+#include "utils/synchronized_queue.h"
+#include "utils/thread.h"
+#include "utils/video_frame_pool.h"
 #include "video.h"
 
+#define MOD_NAME "[capture filter] "
+#define STAGE_QUEUE_LEN 2 ///< frames waiting for a pipeline stage
+#define STATS_INTERVAL_SEC 10
+
 using namespace std;
 
-struct capture_filter {
-        struct module mod;
-        struct simple_linked_list *filters;
-};
+/// queue between pipeline stages, nullptr is the poison pill
+using stage_queue = synchronized_queue<struct video_frame *, STAGE_QUEUE_LEN>;
 
 struct capture_filter_instance {
         const struct capture_filter_info *functions;
         void *state;
+        int stage;
+        char name[32];
+};
+
+struct filter_stage {
+        thread thread_id;
+        mutex lock; ///< held while filtering, chain modifications take all
+        stage_queue *in;
+        stage_queue *out; ///< nullptr for last stage (s->output is used)
+
+        long long frames = 0;
+        time_ns_t total_ns = 0;
+        time_ns_t max_ns = 0;
 };
 
-static int create_filter(struct capture_filter *s, char *cfg)
+struct capture_filter {
+        struct module mod;
+        struct simple_linked_list *filters;
+
+        /// pipeline - empty if the filters run on the capture thread
+        vector<unique_ptr<filter_stage>> stages;
+        vector<unique_ptr<stage_queue>> queues;
+        /// unbounded - each grabbed frame produces at most one output frame
+        synchronized_queue<struct video_frame *, -1> output;
+        /// frames passed to the pipeline not yet dropped or taken from output
+        atomic<int> in_flight{0};
+        video_frame_pool pool;
+        struct video_desc pool_desc{};
+        size_t pool_len = 0;
+        time_ns_t last_report = 0;
+        /// filter that decided in capture_filter_drop_next()
+        struct capture_filter_instance *drop_decider = nullptr;
+};
+
+static int create_filter(struct capture_filter *s, char *cfg, int stage)
 {
         bool found = false;
         const char *options = "";
@@ -75,8 +120,10 @@ static int create_filter(struct capture_filter *s, char *cfg)
                 auto capture_filter_info = static_cast<const struct capture_filter_info*>(item.second);
                 if(strcasecmp(item.first.c_str(), filter_name) == 0) {
                         struct capture_filter_instance *instance = (struct capture_filter_instance *)
-                                malloc(sizeof(struct capture_filter_instance));
+                                calloc(1, sizeof(struct capture_filter_instance));
                         instance->functions = capture_filter_info;
+                        instance->stage = stage;
+                        snprintf(instance->name, sizeof instance->name, "%s", filter_name);
                         int ret = capture_filter_info->init(&s->mod, options, &instance->state);
                         if(ret < 0) {
                                 fprintf(stderr, "Unable to initialize capture filter: %s\n",
@@ -99,11 +146,124 @@ static int create_filter(struct capture_filter *s, char *cfg)
         return 0;
 }
 
+/// runs filters belonging to the stage (all if stage == -1)
+static struct video_frame *run_filters(struct capture_filter *s, int stage, struct video_frame *frame)
+{
+        for(void *it = simple_linked_list_it_init(s->filters);
+                        it != NULL;
+           ) {
+                struct capture_filter_instance *inst = (struct capture_filter_instance *) simple_linked_list_it_next(&it);
+                if (stage != -1 && inst->stage != stage) {
+                        continue;
+                }
+                frame = inst->functions->filter(inst->state, frame);
+                if(!frame) {
+                        simple_linked_list_it_destroy(it);
+                        return NULL;
+                }
+        }
+        return frame;
+}
+
+static void stage_worker(struct capture_filter *s, int idx)
+{
+        set_thread_name("capture_filter");
+        struct filter_stage *stage = s->stages[idx].get();
+        while (true) {
+                struct video_frame *frame = stage->in->pop();
+                if (frame == nullptr) {
+                        break;
+                }
+                {
+                        lock_guard<mutex> lk(stage->lock);
+                        time_ns_t t0 = get_time_in_ns();
+                        frame = run_filters(s, idx, frame);
+                        time_ns_t duration = get_time_in_ns() - t0;
+                        stage->frames += 1;
+                        stage->total_ns += duration;
+                        stage->max_ns = max(stage->max_ns, duration);
+                }
+                if (frame == nullptr) {
+                        s->in_flight -= 1;
+                        continue;
+                }
+                if (stage->out != nullptr) {
+                        stage->out->push(frame);
+                } else {
+                        s->output.push(frame);
+                }
+        }
+        if (stage->out != nullptr) {
+                stage->out->push(nullptr);
+        }
+}
+
+/**
+ * Returns per-stage timing since the last call and resets the counters.
+ */
+static void format_stage_stats(struct capture_filter *s, char *buf, size_t len)
+{
+        buf[0] = '\0';
+        for (unsigned i = 0; i < s->stages.size(); ++i) {
+                struct filter_stage *stage = s->stages[i].get();
+                lock_guard<mutex> lk(stage->lock);
+                string names;
+                for(void *it = simple_linked_list_it_init(s->filters); it != NULL; ) {
+                        auto *inst = (struct capture_filter_instance *) simple_linked_list_it_next(&it);
+                        if (inst->stage == (int) i) {
+                                names += string(names.empty() ? "" : ",") + inst->name;
+                        }
+                }
+                snprintf(buf + strlen(buf), len - strlen(buf), "%sstage %u (%s): %lld frames, avg %.2f ms, max %.2f ms",
+                                i == 0 ? "" : "; ", i, names.c_str(), stage->frames,
+                                stage->frames == 0 ? 0.0 : stage->total_ns / (double) stage->frames / NS_IN_MS,
+                                stage->max_ns / (double) NS_IN_MS);
+                stage->frames = stage->total_ns = stage->max_ns = 0;
+        }
+}
+
+static void start_pipeline(struct capture_filter *s, int stage_count)
+{
+        for (int i = 0; i < stage_count; ++i) {
+                s->queues.emplace_back(new stage_queue());
+        }
+        for (int i = 0; i < stage_count; ++i) {
+                s->stages.emplace_back(new filter_stage());
+                s->stages[i]->in = s->queues[i].get();
+                s->stages[i]->out = i + 1 < stage_count ? s->queues[i + 1].get() : nullptr;
+        }
+        for (int i = 0; i < stage_count; ++i) {
+                s->stages[i]->thread_id = thread(stage_worker, s, i);
+        }
+        s->last_report = get_time_in_ns();
+        MSG(INFO, "Running capture filters in %d pipeline stages.\n", stage_count);
+}
+
+static void stop_pipeline(struct capture_filter *s)
+{
+        if (s->stages.empty()) {
+                return;
+        }
+        s->queues[0]->push(nullptr);
+        for (auto &stage : s->stages) {
+                stage->thread_id.join();
+        }
+        struct video_frame *frame = nullptr;
+        while ((frame = s->output.pop(true)) != nullptr) {
+                VIDEO_FRAME_DISPOSE(frame);
+        }
+        s->stages.clear();
+        s->queues.clear();
+}
+
 int capture_filter_init(struct module *parent, const char *cfg, struct capture_filter **state)
 {
         if (cfg && (strcasecmp(cfg, "help") == 0 || strcasecmp(cfg, "fullhelp") == 0)) {
                 printf("Usage:\n");
-                color_printf(TERM_BOLD "\t--capture-filter <filter1>[:opts][,<filter2>[:opts][,<filter3>[:<opts>]]]" TERM_RESET " -t <capture>\n\n");
+                color_printf(TERM_BOLD "\t--capture-filter <filter1>[:opts][,<filter2>[:opts][,<filter3>[:<opts>]]]" TERM_RESET " -t <capture>\n");
+                color_printf(TERM_BOLD "\t--capture-filter <filter1>[:opts][,<filter2>[:opts]]|<filter3>[:<opts>]..." TERM_RESET " -t <capture>\n\n");
+                printf("Filter groups separated by '|' run as pipeline stages, each in its own thread.\n"
+                       "This increases throughput at the cost of a latency of one frame per stage.\n\n");
                 printf("Available capture filters:\n");
                 list_modules(LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION, strcasecmp(cfg, "fullhelp") == 0);
                 if (strcasecmp(cfg, "fullhelp") != 0) {
@@ -112,11 +272,11 @@ int capture_filter_init(struct module *parent, const char *cfg, struct capture_f
                 return 1;
         }
 
-        struct capture_filter *s = (struct capture_filter *) calloc(1, sizeof(struct capture_filter));
-        char *item, *save_ptr;
-        assert(s);
+        struct capture_filter *s = new struct capture_filter();
+        char *group = NULL, *group_save_ptr = NULL;
         char *filter_list_str = NULL,
              *tmp = NULL;
+        int stage_count = 0;
 
         s->filters = simple_linked_list_init();
 
@@ -127,47 +287,83 @@ int capture_filter_init(struct module *parent, const char *cfg, struct capture_f
         if(cfg) {
                 filter_list_str = tmp = strdup(cfg);
 
-                while((item = strtok_r(filter_list_str, ",", &save_ptr))) {
-                        char filter_name[128];
-                        strncpy(filter_name, item, sizeof filter_name - 1);
+                while ((group = strtok_r(filter_list_str, "|", &group_save_ptr))) {
+                        char *item = NULL, *save_ptr = NULL;
+                        char *group_str = group;
+                        while((item = strtok_r(group_str, ",", &save_ptr))) {
+                                char filter_name[128] = "";
+                                strncpy(filter_name, item, sizeof filter_name - 1);
 
-                        int ret = create_filter(s, filter_name);
-                        if (ret != 0) {
-                                module_done(&s->mod);
-                                free(tmp);
-                                free(s);
-                                return ret;
+                                int ret = create_filter(s, filter_name, stage_count);
+                                if (ret != 0) {
+                                        capture_filter_destroy(s);
+                                        free(tmp);
+                                        return ret;
+                                }
+                                group_str = NULL;
                         }
+                        stage_count += 1;
                         filter_list_str = NULL;
                 }
         }
 
         free(tmp);
 
+        if (stage_count > 1) {
+                start_pipeline(s, stage_count);
+        }
+
         *state = s;
 
         return 0;
 }
 
-void capture_filter_destroy(struct capture_filter *state)
+static void destroy_filters(struct capture_filter *s)
 {
-        struct capture_filter *s = state;
-
         while(simple_linked_list_size(s->filters) > 0) {
                 struct capture_filter_instance *inst = (struct capture_filter_instance *) simple_linked_list_pop(s->filters);
                 inst->functions->done(inst->state);
                 free(inst);
         }
+}
+
+void capture_filter_destroy(struct capture_filter *state)
+{
+        struct capture_filter *s = state;
+
+        stop_pipeline(s);
+        destroy_filters(s);
 
         simple_linked_list_destroy(s->filters);
 
         module_done(&s->mod);
 
-        free(state);
+        delete s;
+}
+
+/// locks all pipeline stages so that the filter list can be modified
+static vector<unique_lock<mutex>> lock_stages(struct capture_filter *s)
+{
+        vector<unique_lock<mutex>> locks;
+        for (auto &stage : s->stages) {
+                locks.emplace_back(stage->lock);
+        }
+        return locks;
 }
 
 static struct response *process_message(struct capture_filter *s, struct msg_universal *msg)
 {
+        if (strcmp("stats", msg->text) == 0) {
+                if (s->stages.empty()) {
+                        return new_response(RESPONSE_BAD_REQUEST, "not pipelined");
+                }
+                char buf[STR_LEN];
+                format_stage_stats(s, buf, sizeof buf);
+                MSG(NOTICE, "%s\n", buf);
+                return new_response(RESPONSE_OK, buf);
+        }
+
+        auto locks = lock_stages(s);
         if (strncmp("delete ", msg->text, strlen("delete ")) == 0) {
                 int index = atoi(msg->text + strlen("delete "));
                 struct capture_filter_instance *inst = (struct capture_filter_instance *)
@@ -182,19 +378,16 @@ static struct response *process_message(struct capture_filter *s, struct msg_uni
                         free(inst);
                 }
         } else if (strcmp("flush", msg->text) == 0) {
-                while(simple_linked_list_size(s->filters) > 0) {
-                        struct capture_filter_instance *inst = (struct capture_filter_instance *) simple_linked_list_pop(s->filters);
-                        inst->functions->done(inst->state);
-                        free(inst);
-                }
+                destroy_filters(s);
         } else if (strcmp("help", msg->text) == 0) {
                 printf("Capture filter control:\n"
                                 "\tflush      - remove all filters\n"
                                 "\tdelete <x> - delete x-th filter\n"
-                                "\t<filter>   - append a filter named <filter>\n");
+                                "\tstats      - timing of individual pipeline stages\n"
+                                "\t<filter>   - append a filter named <filter> (to the last stage)\n");
         } else {
                 char *fmt = strdup(msg->text);
-                if (create_filter(s, fmt) != 0) {
+                if (create_filter(s, fmt, s->stages.empty() ? 0 : (int) s->stages.size() - 1) != 0) {
                         fprintf(stderr, "Cannot create capture filter: %s.\n",
                                         msg->text);
                         free(fmt);
@@ -209,6 +402,121 @@ static struct response *process_message(struct capture_filter *s, struct msg_uni
         return new_response(RESPONSE_OK, NULL);
 }
 
+/**
+ * Frames without a dispose callback are valid only until next grab so
+ * they need to be copied before passing to the pipeline.
+ */
+static struct video_frame *get_owned_frame(struct capture_filter *s, struct video_frame *frame)
+{
+        if (frame->callbacks.dispose != nullptr) {
+                return frame;
+        }
+        struct video_desc desc = video_desc_from_frame(frame);
+        size_t len = 0;
+        for (unsigned i = 0; i < frame->tile_count; ++i) {
+                len = max<size_t>(len, frame->tiles[i].data_len);
+        }
+        if (!video_desc_eq(desc, s->pool_desc) || len > s->pool_len) {
+                s->pool.reconfigure(desc, len);
+                s->pool_desc = desc;
+                s->pool_len = len;
+        }
+        struct video_frame *copy = s->pool.get_disposable_frame();
+        vf_copy_metadata(copy, frame);
+        copy->flags |= VF_WRITABLE;
+        for (unsigned i = 0; i < frame->tile_count; ++i) {
+                memcpy(copy->tiles[i].data, frame->tiles[i].data, frame->tiles[i].data_len);
+                copy->tiles[i].data_len = frame->tiles[i].data_len;
+        }
+        return copy;
+}
+
+static struct video_frame *capture_filter_pipelined(struct capture_filter *s, struct video_frame *frame)
+{
+        if (frame != nullptr) {
+                s->in_flight += 1;
+                s->queues[0]->push(get_owned_frame(s, frame));
+        }
+        struct video_frame *out = s->output.pop(true);
+        if (out != nullptr) {
+                s->in_flight -= 1;
+        }
+
+        time_ns_t now = get_time_in_ns();
+        if (now - s->last_report > STATS_INTERVAL_SEC * NS_IN_SEC) {
+                char buf[STR_LEN];
+                format_stage_stats(s, buf, sizeof buf);
+                MSG(INFO, "%s\n", buf);
+                s->last_report = now;
+        }
+        return out;
+}
+
+/**
+ * Decides before the capture whether the next frame is going to be dropped by
+ * the first filter in the chain that is able to tell it in advance (ratelimit,
+ * every), so that the capture can skip grabbing and processing the frame. The
+ * filters preceding the deciding one are skipped for that frame as well.
+ *
+ * The search stops at the first such filter because the following ones would
+ * see the frame only if it is passed.
+ *
+ * The filter state is updated only by capture_filter_dropped() after the
+ * capture really consumed the frame.
+ */
+bool capture_filter_drop_next(struct capture_filter *state)
+{
+        struct capture_filter *s = state;
+        s->drop_decider = nullptr;
+        for(void *it = simple_linked_list_it_init(s->filters); it != NULL; ) {
+                auto *inst = (struct capture_filter_instance *) simple_linked_list_it_next(&it);
+                if (inst->functions->drop_next == nullptr) {
+                        continue;
+                }
+                simple_linked_list_it_destroy(it);
+                bool drop = false;
+                if (s->stages.empty()) {
+                        drop = inst->functions->drop_next(inst->state);
+                } else {
+                        lock_guard<mutex> lk(s->stages[inst->stage]->lock);
+                        drop = inst->functions->drop_next(inst->state);
+                }
+                if (drop) {
+                        s->drop_decider = inst;
+                }
+                return drop;
+        }
+        return false;
+}
+
+/**
+ * Commits the drop announced by capture_filter_drop_next() once the frame was
+ * consumed by the capture.
+ */
+void capture_filter_dropped(struct capture_filter *state)
+{
+        struct capture_filter *s = state;
+        struct capture_filter_instance *inst = s->drop_decider;
+        s->drop_decider = nullptr;
+        if (inst == nullptr || inst->functions->dropped == nullptr) {
+                return;
+        }
+        if (s->stages.empty()) {
+                inst->functions->dropped(inst->state);
+                return;
+        }
+        lock_guard<mutex> lk(s->stages[inst->stage]->lock);
+        inst->functions->dropped(inst->state);
+}
+
+/**
+ * Passes the frame through the filter chain.
+ *
+ * With a pipelined chain, the returned frame is one that has been grabbed
+ * earlier (if any has already passed all stages). The frame may be NULL (eg.
+ * when the capture has no new frame) to collect frames that finished the
+ * processing in the meanwhile; this call doesn't block.
+ */
 struct video_frame *capture_filter(struct capture_filter *state, struct video_frame *frame) {
         struct capture_filter *s = state;
 
@@ -218,14 +526,30 @@ struct video_frame *capture_filter(struct capture_filter *state, struct video_fr
                 free_message(msg, r);
         }
 
-        for(void *it = simple_linked_list_it_init(s->filters);
-                        it != NULL;
-           ) {
-                struct capture_filter_instance *inst = (struct capture_filter_instance *) simple_linked_list_it_next(&it);
-                frame = inst->functions->filter(inst->state, frame);
-                if(!frame)
-                        return NULL;
+        if (!s->stages.empty()) {
+                return capture_filter_pipelined(s, frame);
         }
-        return frame;
+        if (frame == nullptr) {
+                return nullptr;
+        }
+        return run_filters(s, -1, frame);
 }
 
+/**
+ * Waits for a frame still being processed by the pipelined chain, should be
+ * called repeatedly when the capture ends not to lose the last frames.
+ *
+ * @retval NULL no more frames in the pipeline (always for a serial chain)
+ */
+struct video_frame *capture_filter_drain(struct capture_filter *state)
+{
+        struct capture_filter *s = state;
+        while (s->in_flight > 0) {
+                struct video_frame *out = nullptr;
+                if (s->output.timed_pop(out, chrono::milliseconds(100)) && out != nullptr) {
+                        s->in_flight -= 1;
+                        return out;
+                }
+        }
+        return nullptr;
+}
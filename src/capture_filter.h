@@ -38,10 +38,13 @@
 #ifndef CAPTURE_FILTER_H_
 #define CAPTURE_FILTER_H_
 
-#define CAPTURE_FILTER_ABI_VERSION 3
+#define CAPTURE_FILTER_ABI_VERSION 4
 
 #ifdef __cplusplus
+#include <cstdbool>
 extern "C" {
+#else
+#include <stdbool.h>
 #endif
 
 struct module;
@@ -67,6 +70,16 @@ struct capture_filter_info {
         /// This behavior may change towards use of shared_ptr<video_frame>
         /// in future.
         struct video_frame *(*filter)(void *state, struct video_frame *f);
+        /// @brief Optional - decides in advance (before capture) whether the next
+        ///        frame is going to be dropped, eg. by rate limiting filters
+        /// The state must not be changed - the capture may fail to consume the
+        /// frame, dropped() is called only if it was consumed.
+        /// @retval true  the frame will be dropped, filter() won't be called for it
+        /// @retval false filter() will be called normally
+        bool (*drop_next)(void *state);
+        /// @brief Optional - the frame announced by drop_next() was consumed,
+        ///        the state should be updated as if filter() dropped it
+        void (*dropped)(void *state);
 };
 
 struct capture_filter;
@@ -79,6 +92,9 @@ struct video_frame;
 int capture_filter_init(struct module *parent, const char *cfg, struct capture_filter **state);
 void capture_filter_destroy(struct capture_filter *state);
 struct video_frame *capture_filter(struct capture_filter *state, struct video_frame *frame);
+bool capture_filter_drop_next(struct capture_filter *state);
+void capture_filter_dropped(struct capture_filter *state);
+struct video_frame *capture_filter_drain(struct capture_filter *state);
 
 #ifdef __cplusplus
 }
@@ -42,109 +42,113 @@
 #endif /* HAVE_CONFIG_H */
 
 #include "capture_filter.h"
+#include "debug.h"
 #include "lib_common.h"
-#include "libavcodec/utils.h"
 #include "messaging.h"
 #include "module.h"
+#include "utils/color_out.h"
+#include "utils/macros.h"
+#include "utils/pixelate.h"
 
 #include "video.h"
 #include "video_codec.h"
 
-#include <libswscale/swscale.h>
-
-#define FACTOR 6
+#define DEFAULT_BLOCK 6
+#define MAX_RECTS 64
+#define MOD_NAME "[Blank] "
 
 static int init(struct module *parent, const char *cfg, void **state);
 static void done(void *state);
 static struct video_frame *filter(void *state, struct video_frame *in);
 
+struct blank_rect {
+        double x, y, width, height; ///< in pixels or fractions of the frame size
+};
+
 struct state_blank {
         struct module mod;
 
-        int x, y, width, height;
-        double x_relative, y_relative, width_relative, height_relative;
-
-        struct video_desc saved_desc;
+        struct blank_rect rects[MAX_RECTS];
+        int rect_count;
 
         bool in_relative_units;
         bool black;
+        int block;
 
-        struct SwsContext *ctx_downscale,
-                          *ctx_upscale;
+        struct pixelator *pixelator;
+        codec_t unsupported_codec; ///< already reported
 };
 
 static bool parse(struct state_blank *s, char *cfg)
 {
-        int vals[4];
-        double vals_relative[4];
-        unsigned int counter = 0;
+        double vals[4 * MAX_RECTS];
+        int counter = 0;
         bool black = false;
-
-        memset(&s->saved_desc, 0, sizeof(s->saved_desc));
-
-        if (strchr(cfg, '%')) {
-                s->in_relative_units = true;
-        } else {
-                s->in_relative_units = false;
-        }
+        int block = DEFAULT_BLOCK;
+        const bool in_relative_units = strchr(cfg, '%') != NULL;
 
         char *item, *save_ptr = NULL;
         while ((item = strtok_r(cfg, ":", &save_ptr))) {
-                if (s->in_relative_units) {
-                        vals_relative[counter] = atof(item) / 100.0;
-                        if (vals_relative[counter] < 0.0)
-                                vals_relative[counter] = 0.0;
-                } else {
-                        vals[counter] = atoi(item);
-                        if (vals[counter] < 0)
-                                vals[counter] = 0;
-                }
-
                 cfg = NULL;
-                counter += 1;
-                if (counter == sizeof(vals) / sizeof(int))
-                        break;
-        }
-        while ((item = strtok_r(cfg, ":", &save_ptr))) {
                 if (strcmp(item, "black") == 0) {
                         black = true;
-                } else {
-                        fprintf(stderr, "[Blank] Unknown config value: %s\n",
-                                        item);
+                        continue;
+                }
+                if (strstr(item, "block=") == item) {
+                        block = atoi(item + strlen("block="));
+                        if (block <= 0 || block > PIXELATE_MAX_BLOCK) {
+                                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Block size must be in range 1-%d.\n",
+                                                PIXELATE_MAX_BLOCK);
+                                return false;
+                        }
+                        continue;
+                }
+                char *endptr = NULL;
+                double val = strtod(item, &endptr);
+                if (endptr == item || (*endptr != '\0' && strcmp(endptr, "%") != 0)) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Unknown config value: %s\n", item);
+                        return false;
+                }
+                if (counter == 4 * MAX_RECTS) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "At most %d rectangles are supported.\n", MAX_RECTS);
                         return false;
                 }
+                vals[counter++] = MAX(val, 0.0) / (in_relative_units ? 100.0 : 1.0);
         }
 
-        if(counter != sizeof(vals) / sizeof(int)) {
-                fprintf(stderr, "[Blank] Few config values.\n");
+        if (counter == 0 || counter % 4 != 0) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Few config values.\n");
                 return false;
         }
 
-        if (s->in_relative_units) {
-                s->x_relative = vals_relative[0];
-                s->y_relative = vals_relative[1];
-                s->width_relative = vals_relative[2];
-                s->height_relative = vals_relative[3];
-        } else {
-                s->x = vals[0];
-                s->y = vals[1];
-                s->width = (vals[2] + FACTOR - 1) / FACTOR * FACTOR;
-                s->height = vals[3];
+        s->rect_count = counter / 4;
+        for (int i = 0; i < s->rect_count; ++i) {
+                s->rects[i] = (struct blank_rect) { vals[4 * i], vals[4 * i + 1], vals[4 * i + 2], vals[4 * i + 3] };
         }
+        s->in_relative_units = in_relative_units;
         s->black = black;
+        s->block = block;
 
         return true;
 }
 
+static void usage(void)
+{
+        color_printf("Blanks or pixelates specified rectangular areas:\n\n");
+        color_printf(TBOLD("blank") " usage:\n");
+        printf("\tblank:x:y:width:height[:x:y:width:height...][:black][:block=<px>]\n");
+        printf("\t\tor\n");
+        printf("\tblank:x%%:y%%:width%%:height%%[:x%%:y%%:width%%:height%%...][:black][:block=<px>]\n");
+        printf("\t(all values in pixels or percents of the frame size)\n");
+        printf("\tblack      - fill the areas with black instead of pixelation\n");
+        printf("\tblock=<px> - size of the pixelation squares (default %d)\n", DEFAULT_BLOCK);
+        printf("\nSupported codecs: RGB, BGR, RGBA, UYVY, YUYV, v210, I420\n");
+}
+
 static int init(struct module *parent, const char *cfg, void **state)
 {
         if (cfg && strcasecmp(cfg, "help") == 0) {
-                printf("Blanks specified rectangular area:\n\n");
-                printf("blank usage:\n");
-                printf("\tblank:x:y:widht:height[:black]\n");
-                printf("\t\tor\n");
-                printf("\tblank:x%%:y%%:widht%%:height%%[:black]\n");
-                printf("\t(all values in pixels)\n");
+                usage();
                 return 1;
         }
 
@@ -160,6 +164,8 @@ static int init(struct module *parent, const char *cfg, void **state)
                         return -1;
                 }
         }
+        s->pixelator = pixelator_create();
+        s->unsupported_codec = VIDEO_CODEC_NONE;
 
         module_init_default(&s->mod);
         s->mod.cls = MODULE_CLASS_DATA;
@@ -174,8 +180,7 @@ static void done(void *state)
         struct state_blank *s = state;
         module_done(&s->mod);
 
-        sws_freeContext(s->ctx_downscale);
-        sws_freeContext(s->ctx_upscale);
+        pixelator_destroy(s->pixelator);
         free(s);
 }
 
@@ -188,76 +193,11 @@ static struct response * process_message(struct state_blank *s, struct msg_unive
         }
 }
 
-/**
- * @note v210 etc. will be green
- */
 static struct video_frame *filter(void *state, struct video_frame *in)
 {
         assert(in->tile_count == 1);
 
         struct state_blank *s = state;
-        codec_t codec = in->color_spec;
-        int bpp = get_bpp(codec);
-        enum AVPixelFormat av_pixfmt = AV_PIX_FMT_NONE;
-
-        if (get_ug_to_av_pixfmt(codec) != AV_PIX_FMT_NONE) {
-                av_pixfmt = get_ug_to_av_pixfmt(codec);
-        }
-
-        if (s->in_relative_units) {
-                s->x = s->x_relative * in->tiles[0].width;
-                s->y = s->y_relative * in->tiles[0].height;
-                s->width = s->width_relative * in->tiles[0].width;
-                s->width = (s->width + FACTOR - 1) / FACTOR * FACTOR;
-                s->height = s->height_relative * in->tiles[0].height;
-        }
-
-        int width = s->width;
-        int height = s->height;
-        int x = s->x;
-        int y = s->y;
-
-        x = (x + bpp - 1) / bpp * bpp;
-
-        if (y + height > (int) in->tiles[0].height) {
-                height = in->tiles[0].height - y;
-        }
-
-        if (x + width > (int) in->tiles[0].width) {
-                width = in->tiles[0].width - x;
-                width = width / FACTOR * FACTOR;
-        }
-
-        // don't know why but when not done, it leaves black or grey border on the right side
-        // for BGR
-        if (codec == BGR) {
-                width = width / (FACTOR * 3) * (FACTOR * 3);
-        }
-
-        if (!video_desc_eq(s->saved_desc,
-                                video_desc_from_frame(in))) {
-
-                if (av_pixfmt == AV_PIX_FMT_NONE || !sws_isSupportedInput(av_pixfmt) ||
-                                !sws_isSupportedOutput(av_pixfmt)) {
-                        fprintf(stderr, "Unable to find suitable pixfmt!\n");
-                        return in;
-                }
-
-                sws_freeContext(s->ctx_downscale);
-                sws_freeContext(s->ctx_upscale);
-
-                s->ctx_downscale = sws_getContext(width, height, av_pixfmt,
-                                width / FACTOR, height / FACTOR, av_pixfmt, SWS_FAST_BILINEAR,0,0,0);
-                s->ctx_upscale = sws_getContext(width / FACTOR, height / FACTOR, av_pixfmt,
-                                width, height, av_pixfmt, SWS_FAST_BILINEAR,0,0,0);
-
-                if (s->ctx_downscale == NULL || s->ctx_upscale == NULL) {
-                        fprintf(stderr, "Unable to initialize scaling context!");
-                        return in;
-                }
-
-                s->saved_desc = video_desc_from_frame(in);
-        }
 
         struct message *msg;
         while ((msg = check_message(&s->mod))) {
@@ -265,30 +205,24 @@ static struct video_frame *filter(void *state, struct video_frame *in)
                 free_message(msg, r);
         }
 
-        if (width <= 0 || height <= 0)
-                return in;
-
-        int orig_stride = vc_get_linesize(in->tiles[0].width, in->color_spec);
-        char *orig = in->tiles[0].data + x * bpp + y * orig_stride;
-        int tmp_stride = vc_get_linesize(width / FACTOR, in->color_spec);
-        size_t tmp_len = tmp_stride * (height / FACTOR);
-        uint8_t *tmp = (uint8_t *) malloc(tmp_len);
-        if (s->black) {
-                if (codec == UYVY) {
-                        unsigned char pattern[] = { 127, 0 };
-
-                        for (size_t i = 0; i < tmp_len; i += get_bpp(codec)) {
-                                memcpy(tmp + i, pattern, get_bpp(codec));
-                        }
-                } else {
-                        memset(tmp, 0, tmp_len);
+        if (!pixelator_supports(in->color_spec)) {
+                if (s->unsupported_codec != in->color_spec) {
+                        log_msg(LOG_LEVEL_WARNING, MOD_NAME "Codec %s is not supported, passing frames unchanged.\n",
+                                        get_codec_name(in->color_spec));
+                        s->unsupported_codec = in->color_spec;
                 }
-        } else {
-                sws_scale(s->ctx_downscale, (const uint8_t * const *) &orig, &orig_stride, 0, height, &tmp, &tmp_stride);
+                return in;
         }
-        sws_scale(s->ctx_upscale, (const uint8_t * const *) &tmp, &tmp_stride, 0, height / FACTOR, (uint8_t **) &orig, &orig_stride);
 
-        free(tmp);
+        struct tile *tile = &in->tiles[0];
+        const double scale_x = s->in_relative_units ? tile->width : 1.0;
+        const double scale_y = s->in_relative_units ? tile->height : 1.0;
+        for (int i = 0; i < s->rect_count; ++i) {
+                const struct blank_rect *r = &s->rects[i];
+                pixelator_apply(s->pixelator, tile->data, in->color_spec, tile->width, tile->height,
+                                r->x * scale_x, r->y * scale_y, r->width * scale_x, r->height * scale_y,
+                                s->black ? 0 : s->block);
+        }
 
         return in;
 }
@@ -297,6 +231,8 @@ static const struct capture_filter_info capture_filter_blank = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = NULL,
+        .dropped = NULL,
 };
 
 REGISTER_MODULE(blank, &capture_filter_blank, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
@@ -131,6 +131,8 @@ static const struct capture_filter_info capture_filter_change_pixfmt = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = NULL,
+        .dropped = NULL,
 };
 
 // coverity[leaked_storage:SUPPRESS]
@@ -119,6 +119,8 @@ static const struct capture_filter_info capture_filter_color = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = NULL,
+        .dropped = NULL,
 };
 
 REGISTER_MODULE(color, &capture_filter_color, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
@@ -218,6 +218,8 @@ static const struct capture_filter_info capture_filter_display = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = NULL,
+        .dropped = NULL,
 };
 
 REGISTER_HIDDEN_MODULE(display, &capture_filter_display, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
@@ -120,6 +120,8 @@ static const struct capture_filter_info capture_filter_disrupt = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = NULL,
+        .dropped = NULL,
 };
 
 REGISTER_HIDDEN_MODULE(disrupt, &capture_filter_disrupt, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
@@ -54,6 +54,8 @@ struct module;
 static int init(struct module *parent, const char *cfg, void **state);
 static void done(void *state);
 static struct video_frame *filter(void *state, struct video_frame *in);
+static bool drop_next(void *state);
+static void dropped(void *state);
 
 struct state_every {
         int num;
@@ -140,10 +142,33 @@ static struct video_frame *filter(void *state, struct video_frame *in)
         return frame;
 }
 
+/// frames that are going to be dropped are not captured at all
+static bool drop_next(void *state)
+{
+        struct state_every *s = state;
+
+        if (s->num == 0) {
+                return true;
+        }
+
+        return (s->current + 1) % s->num >= s->denom;
+}
+
+static void dropped(void *state)
+{
+        struct state_every *s = state;
+
+        if (s->num != 0) {
+                s->current = (s->current + 1) % s->num;
+        }
+}
+
 static const struct capture_filter_info capture_filter_every = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = drop_next,
+        .dropped = dropped,
 };
 
 REGISTER_MODULE(every, &capture_filter_every, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
@@ -41,111 +41,37 @@
 #include "config_win32.h"
 #endif /* HAVE_CONFIG_H */
 
-#include <iostream>
-#include <stdexcept>
-#include <thread>
-#include <vector>
+#include <cerrno>
+#include <cmath>
 
 #include "capture_filter.h"
 #include "debug.h"
 #include "lib_common.h"
+#include "utils/color_engine.h"
 #include "utils/color_out.h"
-#include "utils/worker.h"
+#include "utils/video_frame_pool.h"
 #include "video.h"
 #include "video_codec.h"
 #include "vo_postprocess/capture_filter_wrapper.h"
 
 constexpr const char *MOD_NAME = "[gamma cap. f.] ";
 
-using std::cout;
-using std::exception;
-using std::numeric_limits;
-using std::vector;
-using std::thread;
-
 struct state_capture_filter_gamma {
 public:
         int out_depth; ///< 0, 8 or 16 (0 menas keep)
         void *vo_pp_out_buffer{}; ///< buffer to write to if we use vo_pp wrapper (otherwise unused)
+        struct color_engine *engine;
+        video_frame_pool pool;
+        struct video_desc pool_desc{};
 
-        explicit state_capture_filter_gamma(double gamma, int out_depth) : out_depth(out_depth) {
-                for (int i = 0; i <= numeric_limits<uint8_t>::max(); ++i) { // 8->8
-                        lut8.push_back(pow(static_cast<double>(i)
-                                        / numeric_limits<uint8_t>::max(), gamma)
-                                * numeric_limits<uint8_t>::max());
-                }
-                for (int i = 0; i <= numeric_limits<uint16_t>::max(); ++i) { // 8->16
-                        lut16.push_back(pow(static_cast<double>(i)
-                                        / numeric_limits<uint16_t>::max(), gamma)
-                                * numeric_limits<uint16_t>::max());
-                }
-                for (int i = 0; i <= numeric_limits<uint8_t>::max(); ++i) { // 8->16
-                        lut8_16.push_back(pow(static_cast<double>(i)
-                                        / numeric_limits<uint8_t>::max(), gamma)
-                                * numeric_limits<uint16_t>::max());
-                }
-                for (int i = 0; i <= numeric_limits<uint16_t>::max(); ++i) { // 16->8
-                        lut16_8.push_back(pow(static_cast<double>(i)
-                                        / numeric_limits<uint16_t>::max(), gamma)
-                                * numeric_limits<uint8_t>::max());
-                }
-        }
-
-        void apply_gamma(int in_depth, int out_depth, size_t in_len, void const * __restrict in, void * __restrict out) {
-                if (in_depth == CHAR_BIT && out_depth == CHAR_BIT) {
-                        apply_lut<uint8_t, uint8_t>(in_len, lut8, in, out);
-                } else if (in_depth == 2 * CHAR_BIT && out_depth == 2 * CHAR_BIT) {
-                        apply_lut<uint16_t, uint16_t>(in_len, lut16, in, out);
-                } else if (in_depth == CHAR_BIT && out_depth == 2 * CHAR_BIT) {
-                        apply_lut<uint8_t, uint16_t>(in_len, lut8_16, in, out);
-                } else if (in_depth == 2 * CHAR_BIT && out_depth == CHAR_BIT) {
-                        apply_lut<uint16_t, uint8_t>(in_len, lut16_8, in, out);
-                } else {
-                        throw exception();
-                }
+        state_capture_filter_gamma(double gamma, int out_depth) : out_depth(out_depth),
+                engine(color_engine_create(nullptr, gamma)) {
         }
-
-private:
-        template<typename inT, typename outT>
-        struct data {
-                size_t len;
-                const vector<outT> &lut;
-                const inT *in;
-                outT *out;
-        };
-
-        template<typename inT, typename outT>
-        static void *compute(void *arg) {
-                auto *d = static_cast<struct data<inT, outT> *>(arg);
-                for (size_t i = 0; i < d->len; ++i) {
-                        d->out[i] = d->lut[d->in[i]];
-                }
-                return nullptr;
+        ~state_capture_filter_gamma() {
+                color_engine_destroy(engine);
         }
-
-        template<typename inT, typename outT> void apply_lut(size_t in_len, const vector<outT> &lut, void const *in, void *out)
-        {
-                auto *in_data = static_cast<const inT*>(in);
-                auto *out_data = static_cast<outT*>(out);
-                unsigned int cpus = thread::hardware_concurrency();
-                in_len /= sizeof(inT);
-                vector<data<inT, outT>> d;
-                vector<task_result_handle_t> handles(cpus);
-                for (unsigned int i = 0; i < cpus; i++) {
-                        d.push_back({in_len / cpus, lut, in_data + i * (in_len / cpus), out_data + i * (in_len / cpus)});
-                }
-                for (unsigned int i = 0; i < cpus; i++) {
-                        handles[i] = task_run_async(state_capture_filter_gamma::compute<inT, outT>, static_cast<void *>(&(d[i])));
-                }
-                for (unsigned int i = 0; i < cpus; i++) {
-                        wait_task(handles[i]);
-                }
-        }
-
-        vector<uint8_t>  lut8;
-        vector<uint16_t> lut16;
-        vector<uint8_t>  lut16_8;
-        vector<uint16_t> lut8_16;
+        state_capture_filter_gamma(const state_capture_filter_gamma &) = delete;
+        state_capture_filter_gamma &operator=(const state_capture_filter_gamma &) = delete;
 };
 
 static auto init(struct module *parent, const char *cfg, void **state)
@@ -204,23 +130,33 @@ static auto filter(void *state, struct video_frame *in) -> video_frame *
         if (s->out_depth != 0) {
                 out_desc.color_spec = s->out_depth == 8 ? RGB : RG48;
         }
-        struct video_frame *out = vf_alloc_desc(out_desc);
+
+        // other frames than writable may be reused by the capture (eg. a persistent pattern)
+        if (s->vo_pp_out_buffer == nullptr && out_desc.color_spec == in->color_spec
+                        && (in->flags & VF_WRITABLE) != 0) {
+                color_engine_apply(s->engine, in->color_spec, in->tiles[0].data,
+                                in->color_spec, in->tiles[0].data, in->tiles[0].data_len);
+                return in;
+        }
+
+        struct video_frame *out = nullptr;
         if (s->vo_pp_out_buffer != nullptr) {
+                out = vf_alloc_desc(out_desc);
                 out->tiles[0].data = (char *) s->vo_pp_out_buffer;
+                out->callbacks.dispose = vf_free;
         } else {
-                out->tiles[0].data = (char *) malloc(out->tiles[0].data_len);
-                out->callbacks.data_deleter = vf_data_deleter;
-        }
-        out->callbacks.dispose = vf_free;
-
-        try {
-                s->apply_gamma(get_bits_per_component(in->color_spec), get_bits_per_component(out_desc.color_spec), in->tiles[0].data_len, in->tiles[0].data, out->tiles[0].data);
-        } catch(...) {
-                LOG(LOG_LEVEL_ERROR) << MOD_NAME << "Only 8-bit and 16-bit codecs are currently supported!\n";
-                vf_free(out);
-                out = nullptr;
+                if (!video_desc_eq(out_desc, s->pool_desc)) {
+                        s->pool.reconfigure(out_desc);
+                        s->pool_desc = out_desc;
+                }
+                out = s->pool.get_disposable_frame();
+                vf_copy_metadata(out, in);
+                out->flags |= VF_WRITABLE;
         }
 
+        color_engine_apply(s->engine, in->color_spec, in->tiles[0].data, out_desc.color_spec,
+                        out->tiles[0].data, in->tiles[0].data_len);
+
         VIDEO_FRAME_DISPOSE(in);
 
         return out;
@@ -236,6 +172,8 @@ static const struct capture_filter_info capture_filter_gamma = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = nullptr,
+        .dropped = nullptr,
 };
 
 REGISTER_MODULE(gamma, &capture_filter_gamma, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
@@ -44,8 +44,10 @@
 #include "capture_filter.h"
 #include "debug.h"
 #include "lib_common.h"
+#include "utils/color_engine.h"
 #include "utils/color_out.h"
 #include "utils/macros.h"
+#include "utils/video_frame_pool.h"
 #include "video.h"
 #include "video_codec.h"
 #include "vo_postprocess/capture_filter_wrapper.h"
@@ -54,7 +56,10 @@
 
 struct state_capture_filter_matrix {
         double transform_matrix[9];
-        bool check_bounds;
+        double gamma;
+        struct color_engine *engine;
+        void *pool;
+        struct video_desc pool_desc;
         void *vo_pp_out_buffer; ///< buffer to write to if we use vo_pp wrapper (otherwise unused)
 };
 
@@ -65,16 +70,15 @@ static int init(struct module *parent, const char *cfg, void **state)
         if (strlen(cfg) == 0 || strcmp(cfg, "help") == 0) {
                 printf("Performs matrix transformation on input pixels.\n\n"
                        "usage:\n");
-                color_printf(TERM_BOLD "\t--capture-filter matrix:a:b:c:d:e:f:g:h:i[:no-bounds-check]\n" TERM_RESET);
+                color_printf(TERM_BOLD "\t--capture-filter matrix:a:b:c:d:e:f:g:h:i[:gamma=<g>]\n" TERM_RESET);
                 printf("where numbers a-i are members of 3x3 transformation matrix [a b c; d e f; g h i], decimals.\n"
                        "Coefficients are applied at unpacked pixels (eg. on Y Cb and Cr channels of UYVY). Result is marked as RGB.\n"
                        "Currently only RGB and UYVY is supported on input. No additional color transformation is performed.\n");
-                printf("\nOptional \"no-bounds-check\" options disables check for overflows/underflows which improves performance\n"
-                                "but may give incorrect results if operation oveflows or underflows.\n");
+                printf("\nOptional \"gamma\" applies also gamma transformation to the result (in the same pass).\n");
                 return 1;
         }
         struct state_capture_filter_matrix *s = calloc(1, sizeof(struct state_capture_filter_matrix));
-        s->check_bounds = true;
+        s->gamma = 1.0;
         char *cfg_c = strdup(cfg);
         char *item = NULL;
         char *save_ptr = NULL;
@@ -82,12 +86,15 @@ static int init(struct module *parent, const char *cfg, void **state)
         int i = 0;
         while ((item = strtok_r(tmp, ":", &save_ptr)) != NULL) {
                 if (i == 9) {
-                        if (strcmp(item, "no-bound-check") == 0) {
-                                s->check_bounds = false;
+                        if (strstr(item, "gamma=") == item) {
+                                s->gamma = strtod(item + strlen("gamma="), NULL);
+                        } else if (strcmp(item, "no-bound-check") == 0 || strcmp(item, "no-bounds-check") == 0) {
+                                // compat - bounds check is no longer expensive
                         } else {
                                 log_msg(LOG_LEVEL_WARNING, MOD_NAME "Excess initializer given: %s\n", item);
                         }
-                        break;
+                        tmp = NULL;
+                        continue;
                 }
                 char *endptr = NULL;
                 errno = 0;
@@ -105,13 +112,25 @@ static int init(struct module *parent, const char *cfg, void **state)
                 return -1;
         }
 
+        if (s->gamma <= 0.0) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong gamma value: %f\n", s->gamma);
+                free(s);
+                return -1;
+        }
+        s->engine = color_engine_create(s->transform_matrix, s->gamma);
+
         *state = s;
         return 0;
 }
 
 static void done(void *state)
 {
-        free(state);
+        struct state_capture_filter_matrix *s = state;
+        if (s->pool != NULL) {
+                video_frame_pool_destroy(s->pool);
+        }
+        color_engine_destroy(s->engine);
+        free(s);
 }
 
 static struct video_frame *filter(void *state, struct video_frame *in)
@@ -121,179 +140,41 @@ static struct video_frame *filter(void *state, struct video_frame *in)
         if (in->color_spec == UYVY) {
                 desc.color_spec = RGB;
         }
-        struct video_frame *out = vf_alloc_desc(desc);
-        if (s->vo_pp_out_buffer) {
-                out->tiles[0].data = s->vo_pp_out_buffer;
-        } else {
-                out->tiles[0].data = malloc(out->tiles[0].data_len);
-                out->callbacks.data_deleter = vf_data_deleter;
+        if (in->color_spec != UYVY && in->color_spec != RGB && in->color_spec != RG48) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Only UYVY, RGB or RG48 is currently supported!\n");
+                VIDEO_FRAME_DISPOSE(in);
+                return NULL;
         }
-        out->callbacks.dispose = vf_free;
-
-        if (s->check_bounds) {
-                if (in->color_spec == UYVY) {
-                        unsigned char *in_data = (unsigned char *) in->tiles[0].data;
-                        unsigned char *out_data = (unsigned char *) out->tiles[0].data;
 
-                        for (unsigned int i = 0; i < in->tiles[0].data_len; i += 4) {
-                                double a[3];
-                                double b[3];
-                                a[1] = b[1] = *in_data++;
-                                a[0] = *in_data++;
-                                a[2] = b[2] = *in_data++;
-                                b[0] = *in_data++;
-                                int val = s->transform_matrix[0] * (a[0] - 16) +
-                                                        s->transform_matrix[1] * (a[1] - 128) +
-                                                        s->transform_matrix[2] * (a[2] - 128);
-                                *out_data++ = CLAMP(val, 0, 255);
-                                val = s->transform_matrix[3] * (a[0] - 16) +
-                                                        s->transform_matrix[4] * (a[1] - 128) +
-                                                        s->transform_matrix[5] * (a[2] - 128);
-                                *out_data++ = CLAMP(val, 0, 255);
-                                val = s->transform_matrix[6] * (a[0] - 16) +
-                                                        s->transform_matrix[7] * (a[1] - 128) +
-                                                        s->transform_matrix[8] * (a[2] - 128);
-                                *out_data++ = CLAMP(val, 0, 255);
-                                val = s->transform_matrix[0] * (b[0] - 16) +
-                                                        s->transform_matrix[1] * (b[1] - 128) +
-                                                        s->transform_matrix[2] * (b[2] - 128);
-                                *out_data++ = CLAMP(val, 0, 255);
-                                val = s->transform_matrix[3] * (b[0] - 16) +
-                                                        s->transform_matrix[4] * (b[1] - 128) +
-                                                        s->transform_matrix[5] * (b[2] - 128);
-                                *out_data++ = CLAMP(val, 0, 255);
-                                val = s->transform_matrix[6] * (b[0] - 16) +
-                                                        s->transform_matrix[7] * (b[1] - 128) +
-                                                        s->transform_matrix[8] * (b[2] - 128),
-                                *out_data++ = CLAMP(val, 0, 255);
-                        }
-                } else if (in->color_spec == RGB) {
-                        unsigned char *in_data = (unsigned char *) in->tiles[0].data;
-                        unsigned char *out_data = (unsigned char *) out->tiles[0].data;
-
-                        for (unsigned int i = 0; i < in->tiles[0].data_len; i += 3) {
-                                double a[3];
-                                a[0] = *in_data++;
-                                a[1] = *in_data++;
-                                a[2] = *in_data++;
-                                int val = s->transform_matrix[0] * a[0] +
-                                                        s->transform_matrix[1] * a[1] +
-                                                        s->transform_matrix[2] * a[2];
-                                *out_data++ = CLAMP(val, 0, 255);
-                                val = s->transform_matrix[3] * a[0] +
-                                                        s->transform_matrix[4] * a[1] +
-                                                        s->transform_matrix[5] * a[2];
-                                *out_data++ = CLAMP(val, 0, 255);
-                                val = s->transform_matrix[6] * a[0] +
-                                                        s->transform_matrix[7] * a[1] +
-                                                        s->transform_matrix[8] * a[2];
-                                *out_data++ = CLAMP(val, 0, 255);
-                        }
-                } else if (in->color_spec == RG48) {
-                        uint16_t *in_data = (uint16_t *)(void *) in->tiles[0].data;
-                        uint16_t *out_data = (uint16_t *)(void *) out->tiles[0].data;
+        // process in place only if the frame data is not used by anyone else
+        if (s->vo_pp_out_buffer == NULL && desc.color_spec == in->color_spec
+                        && (in->flags & VF_WRITABLE) != 0) {
+                color_engine_apply(s->engine, in->color_spec, in->tiles[0].data,
+                                in->color_spec, in->tiles[0].data, in->tiles[0].data_len);
+                return in;
+        }
 
-                        for (unsigned int i = 0; i < in->tiles[0].data_len; i += 6) {
-                                double a[3];
-                                a[0] = *in_data++;
-                                a[1] = *in_data++;
-                                a[2] = *in_data++;
-                                int val = s->transform_matrix[0] * a[0] +
-                                                        s->transform_matrix[1] * a[1] +
-                                                        s->transform_matrix[2] * a[2];
-                                *out_data++ = CLAMP(val, 0, 255);
-                                val = s->transform_matrix[3] * a[0] +
-                                                        s->transform_matrix[4] * a[1] +
-                                                        s->transform_matrix[5] * a[2];
-                                *out_data++ = CLAMP(val, 0, 255);
-                                val = s->transform_matrix[6] * a[0] +
-                                                        s->transform_matrix[7] * a[1] +
-                                                        s->transform_matrix[8] * a[2];
-                                *out_data++ = CLAMP(val, 0, 255);
-                        }
-                } else {
-                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Only UYVY, RGB or RG48 is currently supported!\n");
-                        VIDEO_FRAME_DISPOSE(in);
-                        vf_free(out);
-                        return NULL;
-                }
+        struct video_frame *out = NULL;
+        if (s->vo_pp_out_buffer) {
+                out = vf_alloc_desc(desc);
+                out->tiles[0].data = s->vo_pp_out_buffer;
+                out->callbacks.dispose = vf_free;
         } else {
-                if (in->color_spec == UYVY) {
-                        unsigned char *in_data = (unsigned char *) in->tiles[0].data;
-                        unsigned char *out_data = (unsigned char *) out->tiles[0].data;
-
-                        for (unsigned int i = 0; i < in->tiles[0].data_len; i += 4) {
-                                double a[3];
-                                double b[3];
-                                a[1] = b[1] = *in_data++;
-                                a[0] = *in_data++;
-                                a[2] = b[2] = *in_data++;
-                                b[0] = *in_data++;
-                                *out_data++ = s->transform_matrix[0] * (a[0] - 16) +
-                                                        s->transform_matrix[1] * (a[1] - 128) +
-                                                        s->transform_matrix[2] * (a[2] - 128);
-                                *out_data++ = s->transform_matrix[3] * (a[0] - 16) +
-                                                        s->transform_matrix[4] * (a[1] - 128) +
-                                                        s->transform_matrix[5] * (a[2] - 128);
-                                *out_data++ = s->transform_matrix[6] * (a[0] - 16) +
-                                                        s->transform_matrix[7] * (a[1] - 128) +
-                                                        s->transform_matrix[8] * (a[2] - 128);
-                                *out_data++ = s->transform_matrix[0] * (b[0] - 16) +
-                                                        s->transform_matrix[1] * (b[1] - 128) +
-                                                        s->transform_matrix[2] * (b[2] - 128);
-                                *out_data++ = s->transform_matrix[3] * (b[0] - 16) +
-                                                        s->transform_matrix[4] * (b[1] - 128) +
-                                                        s->transform_matrix[5] * (b[2] - 128);
-                                *out_data++ = s->transform_matrix[6] * (b[0] - 16) +
-                                                        s->transform_matrix[7] * (b[1] - 128) +
-                                                        s->transform_matrix[8] * (b[2] - 128);
-                        }
-                } else if (in->color_spec == RGB) {
-                        unsigned char *in_data = (unsigned char *) in->tiles[0].data;
-                        unsigned char *out_data = (unsigned char *) out->tiles[0].data;
-
-                        for (unsigned int i = 0; i < in->tiles[0].data_len; i += 3) {
-                                double a[3];
-                                a[0] = *in_data++;
-                                a[1] = *in_data++;
-                                a[2] = *in_data++;
-                                *out_data++ = s->transform_matrix[0] * a[0] +
-                                                        s->transform_matrix[1] * a[1] +
-                                                        s->transform_matrix[2] * a[2];
-                                *out_data++ = s->transform_matrix[3] * a[0] +
-                                                        s->transform_matrix[4] * a[1] +
-                                                        s->transform_matrix[5] * a[2];
-                                *out_data++ = s->transform_matrix[6] * a[0] +
-                                                        s->transform_matrix[7] * a[1] +
-                                                        s->transform_matrix[8] * a[2];
-                        }
-                } else if (in->color_spec == RG48) {
-                        uint16_t *in_data = (uint16_t *)(void *) in->tiles[0].data;
-                        uint16_t *out_data = (uint16_t *)(void *) out->tiles[0].data;
-
-                        for (unsigned int i = 0; i < in->tiles[0].data_len; i += 6) {
-                                double a[3];
-                                a[0] = *in_data++;
-                                a[1] = *in_data++;
-                                a[2] = *in_data++;
-                                *out_data++ = s->transform_matrix[0] * a[0] +
-                                                        s->transform_matrix[1] * a[1] +
-                                                        s->transform_matrix[2] * a[2];
-                                *out_data++ = s->transform_matrix[3] * a[0] +
-                                                        s->transform_matrix[4] * a[1] +
-                                                        s->transform_matrix[5] * a[2];
-                                *out_data++ = s->transform_matrix[6] * a[0] +
-                                                        s->transform_matrix[7] * a[1] +
-                                                        s->transform_matrix[8] * a[2];
-                        }
-                } else {
-                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Only UYVY, RGB or RG48 is currently supported!\n");
-                        VIDEO_FRAME_DISPOSE(in);
-                        vf_free(out);
-                        return NULL;
+                if (s->pool == NULL) {
+                        s->pool = video_frame_pool_init(desc, 0);
+                        s->pool_desc = desc;
+                } else if (!video_desc_eq(desc, s->pool_desc)) {
+                        video_frame_pool_reconfigure(s->pool, desc);
+                        s->pool_desc = desc;
                 }
+                out = video_frame_pool_get_disposable_frame(s->pool);
+                vf_copy_metadata(out, in);
+                out->flags |= VF_WRITABLE;
         }
 
+        color_engine_apply(s->engine, in->color_spec, in->tiles[0].data, desc.color_spec,
+                        out->tiles[0].data, in->tiles[0].data_len);
+
         VIDEO_FRAME_DISPOSE(in);
 
         return out;
@@ -309,6 +190,8 @@ static const struct capture_filter_info capture_filter_matrix = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = NULL,
+        .dropped = NULL,
 };
 
 REGISTER_MODULE(matrix, &capture_filter_matrix, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
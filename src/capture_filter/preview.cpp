@@ -256,6 +256,8 @@ static const struct capture_filter_info capture_filter_preview = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = nullptr,
+        .dropped = nullptr,
 };
 
 REGISTER_HIDDEN_MODULE(preview, &capture_filter_preview, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
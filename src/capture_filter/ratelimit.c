@@ -55,10 +55,12 @@ struct module;
 static int init(struct module *parent, const char *cfg, void **state);
 static void done(void *state);
 static struct video_frame *filter(void *state, struct video_frame *in);
+static bool drop_next(void *state);
 
 struct state_ratelimit {
         time_ns_t next_frame_time;
         double fps;
+        double in_fps; ///< input frame rate, 0 if not yet known
 };
 
 static void usage() {
@@ -98,6 +100,7 @@ static struct video_frame *filter(void *state, struct video_frame *in)
 {
         struct state_ratelimit *s = state;
 
+        s->in_fps = in->fps;
         time_ns_t t = get_time_in_ns();
 
         if (t < s->next_frame_time) {
@@ -117,10 +120,26 @@ static struct video_frame *filter(void *state, struct video_frame *in)
         return frame;
 }
 
+/**
+ * The frame is going to be grabbed up to one input frame time from now, so
+ * it is dropped in advance only if it would be too early even then.
+ */
+static bool drop_next(void *state)
+{
+        struct state_ratelimit *s = state;
+
+        if (s->in_fps <= 0.0) {
+                return false;
+        }
+        return get_time_in_ns() + (time_ns_t) (NS_IN_SEC_DBL / s->in_fps) < s->next_frame_time;
+}
+
 static const struct capture_filter_info capture_filter_ratelimit = {
         .init = init,
         .done = done,
         .filter = filter,
+        .drop_next = drop_next,
+        .dropped = NULL,
 };
 
 REGISTER_MODULE(ratelimit, &capture_filter_ratelimit, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
@@ -279,6 +279,8 @@ static const struct capture_filter_info capture_filter_resize = {
     init,
     done,
     filter,
+    NULL,
+    NULL,
 };
 
 REGISTER_MODULE(resize, &capture_filter_resize, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
@@ -56,6 +56,9 @@
 #include "module.h"
 #include "rtp/net_udp.h" // socket_error
 #include "tv.h"
+#include "utils/macros.h"
+#include "utils/mem_account.h"
+#include "utils/misc.h"
 #include "utils/net.h"
 #include "utils/thread.h"
 
@@ -379,6 +382,26 @@ static int process_msg(struct control_state *s, fd_t client_fd, char *message, s
         char path_audio[1024] = ""; // auxiliary buffer used when we need to signalize both audio
                                     // and video
         char buf[1048];
+        struct module *root_module = s->root_module; ///< subtree the message is addressed to
+
+        if (prefix_matches(message, "session ")) {
+                message = suffix(message, "session ");
+                char session_path[SHORT_STR];
+                snprintf(session_path, sizeof session_path, "%s[%d]",
+                         module_class_name(MODULE_CLASS_SESSION), atoi(message));
+                while (isdigit(*message)) {
+                        message++;
+                }
+                while (isspace(*message)) {
+                        message++;
+                }
+                root_module = get_module(s->root_module, session_path);
+                if (root_module == nullptr) {
+                        snprintf(buf, sizeof buf, "(unknown session: %s)", session_path);
+                        send_response(client_fd, new_response(RESPONSE_NOT_FOUND, buf));
+                        return ret;
+                }
+        }
 
         if(prefix_matches(message, "port ")) {
                 message = suffix(message, "port ");
@@ -507,9 +530,9 @@ static int process_msg(struct control_state *s, fd_t client_fd, char *message, s
                 append_message_path(path_audio, sizeof(path_audio), path_sender_audio);
 
                 resp =
-                        send_message(s->root_module, path, (struct message *) msg);
+                        send_message(root_module, path, (struct message *) msg);
                 struct response *resp_audio =
-                        send_message(s->root_module, path_audio, (struct message *) msg_audio);
+                        send_message(root_module, path_audio, (struct message *) msg_audio);
                 free_response(resp_audio);
         } else if(prefix_matches(message, "receiver ") || prefix_matches(message, "play") ||
                         prefix_matches(message, "pause") || prefix_matches(message, "reset-ssrc")) {
@@ -535,9 +558,9 @@ static int process_msg(struct control_state *s, fd_t client_fd, char *message, s
                 append_message_path(path_audio, sizeof(path_audio), path_sender_audio);
 
                 resp =
-                        send_message(s->root_module, path, (struct message *) msg);
+                        send_message(root_module, path, (struct message *) msg);
                 struct response *resp_audio =
-                        send_message(s->root_module, path_audio, (struct message *) msg_audio);
+                        send_message(root_module, path_audio, (struct message *) msg_audio);
                 free_response(resp_audio);
         } else if (prefix_matches(message, "receiver-port ")) {
                 struct msg_receiver *msg =
@@ -563,9 +586,9 @@ static int process_msg(struct control_state *s, fd_t client_fd, char *message, s
                 append_message_path(path, sizeof(path), path_receiver);
                 append_message_path(path_audio, sizeof(path_audio), path_audio_receiver);
                 resp =
-                        send_message(s->root_module, path, (struct message *) msg);
+                        send_message(root_module, path, (struct message *) msg);
                 struct response *resp_audio =
-                        send_message(s->root_module, path_audio, (struct message *) msg_audio);
+                        send_message(root_module, path_audio, (struct message *) msg_audio);
                 free_response(resp_audio);
         } else if(prefix_matches(message, "fec ")) {
                 auto *msg = reinterpret_cast<struct msg_universal *>(new_message(sizeof(struct msg_universal)));
@@ -595,7 +618,7 @@ static int process_msg(struct control_state *s, fd_t client_fd, char *message, s
                                 append_message_path(path, sizeof(path),
                                                 path_audio_tx);
                         }
-                        resp = send_message(s->root_module, path, (struct message *) msg);
+                        resp = send_message(root_module, path, (struct message *) msg);
                 }
         } else if(prefix_matches(message, "compress ")) {
                 struct msg_change_compress_data *msg =
@@ -614,28 +637,51 @@ static int process_msg(struct control_state *s, fd_t client_fd, char *message, s
                 if(!resp) {
                         enum module_class path_compress[] = { MODULE_CLASS_SENDER, MODULE_CLASS_COMPRESS, MODULE_CLASS_NONE };
                         append_message_path(path, sizeof(path), path_compress);
-                        resp = send_message(s->root_module, path, (struct message *) msg);
+                        resp = send_message(root_module, path, (struct message *) msg);
                 }
         } else if (prefix_matches(message, "volume ") ||
                    prefix_matches(message, "mute") ||
                    prefix_matches(message, "unmute")) {
-                resp = process_audio_message(s->root_module, message);
+                resp = process_audio_message(root_module, message);
         } else if (prefix_matches(message, "av-delay ")) {
                 int val = atoi(suffix(message, "av-delay "));
                 set_audio_delay(val);
                 resp = new_response(RESPONSE_OK, NULL);
+        } else if (strcasecmp(message, "replay-dump") == 0) {
+                strncpy(path, "exporter", sizeof path);
+                struct msg_universal *msg = (struct msg_universal *) new_message(sizeof(struct msg_universal));
+                strncpy(msg->text, "dump", sizeof msg->text - 1);
+                // synchronous to report the dump directory
+                resp = send_message_sync(root_module, path, (struct message *) msg, 1000, 0);
         } else if (prefix_matches(message, "postprocess ")) {
                 strncpy(path, "display", sizeof path);
                 struct msg_universal *msg = (struct msg_universal *) new_message(sizeof(struct msg_universal));
                 strncpy(msg->text, message, sizeof msg->text - 1);
                 msg->text[sizeof msg->text - 1] = '\0';
-                resp = send_message(s->root_module, path, (struct message *) msg);
+                resp = send_message(root_module, path, (struct message *) msg);
         } else if(strcasecmp(message, "bye") == 0) {
                 ret = CONTROL_CLOSE_HANDLE;
                 resp = new_response(RESPONSE_OK, NULL);
         } else if(strcmp(message, "dump-tree") == 0) {
-                dump_tree(s->root_module, 0);
+                dump_tree(root_module, 0);
                 resp = new_response(RESPONSE_OK, NULL);
+        } else if (strcasecmp(message, "memory") == 0) {
+                char report[STR_LEN];
+                mem_account_report(report, sizeof report);
+                resp = new_response(RESPONSE_OK, report);
+        } else if (prefix_matches(message, "memory-cap ")) {
+                char *module = suffix(message, "memory-cap ");
+                char *size = strchr(module, ' ');
+                long long cap = -1;
+                if (size != nullptr) {
+                        *size++ = '\0';
+                        cap = unit_evaluate(size, nullptr);
+                }
+                if (cap >= 0 && mem_account_set_cap(module, cap)) {
+                        resp = new_response(RESPONSE_OK, NULL);
+                } else {
+                        resp = new_response(RESPONSE_BAD_REQUEST, NULL);
+                }
         } else { // assume message in format "path message"
                 struct msg_universal *msg = (struct msg_universal *)
                         new_message(sizeof(struct msg_universal));
@@ -647,7 +693,7 @@ static int process_msg(struct control_state *s, fd_t client_fd, char *message, s
                         strncpy(path, message, sizeof(path) - 1); // empty message ??
                 }
 
-                resp = send_message(s->root_module, path, (struct message *) msg);
+                resp = send_message(root_module, path, (struct message *) msg);
         }
 
         if(!resp) {
@@ -1039,7 +1085,11 @@ static void print_control_help() {
                         TBOLD("\t[un]mute-{receiver,sender}")
                                 " - (un)mutes audio sender or receiver\n"
                         TBOLD("\tpostprocess <new_postprocess> | flush") "\n"
-                        TBOLD("\tdump-tree")"\n");
+                        TBOLD("\tdump-tree")"\n"
+                        TBOLD("\treplay-dump") " - writes replay ring to disk (see \"--record=ring=<s>\")\n"
+                        TBOLD("\tmemory") " - reports current/peak[/cap] bytes per subsystem\n"
+                        TBOLD("\tmemory-cap <subsystem> <bytes>") " - sets memory cap (0 to disable)\n"
+                        TBOLD("\tsession <n> <command>") " - addresses the command to n-th session (multi-session mode)\n");
         color_printf("\nOther commands can be issued directly to individual "
                         "modules (see \"" TBOLD("dump-tree") "\"), eg.:\n"
                         "\t" TBOLD("capture.filter mirror") "\n"
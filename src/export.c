@@ -44,6 +44,7 @@
 #include <string.h>           // for strdup
 #include <sys/types.h>
 #include <time.h>
+#include <unistd.h>           // for rmdir
 
 #include "export.h"
 
@@ -58,6 +59,7 @@
 #include "utils/color_out.h"
 #include "utils/fs.h" // MAX_PATH_SIZE
 #include "utils/misc.h"
+#include "utils/replay_ring.h"
 #include "video_export.h"
 
 #define MOD_NAME "[export] "
@@ -76,6 +78,10 @@ struct exporter {
 
         long long int limit; ///< number of video frames to record, -1 == unlimited (default)
         bool exit_on_limit;
+
+        double ring_seconds;      ///< keep data in memory only, dump on request (0 - disabled)
+        long long ring_size;
+        struct replay_ring *ring;
 };
 
 static bool create_dir(struct exporter *s);
@@ -91,7 +97,7 @@ static void usage() {
         color_printf("Usage:\n");
         color_printf("\t" TBOLD(
             TRED("--record") "[=<dir>[:limit=<n>[:exit_on_limit]][:noaudio]"
-            "[:novideo][:override][:paused]] ") "\n" "\t" TBOLD(TRED("-E")
+            "[:novideo][:override][:paused][:ring=<s>[:ring-size=<b>]]] ") "\n" "\t" TBOLD(TRED("-E")
             "[<dir>[:<opts>]]") "\n\t" TBOLD("--record=help | -Ehelp") "\n");
         color_printf("where\n");
         color_printf(TERM_BOLD "\tlimit=<n>" TERM_RESET "         - write at "
@@ -101,6 +107,9 @@ static void usage() {
                                "existing files in the given directory\n");
         color_printf(TERM_BOLD "\tnoaudio | novideo" TERM_RESET " - do not export audio/video\n");
         color_printf(TERM_BOLD "\tpaused" TERM_RESET "            - use specified directory but do not export immediately (can be started with a key or through control socket)\n");
+        color_printf(TERM_BOLD "\tring=<s>" TERM_RESET "          - keep last <s> seconds in memory only, write to <dir>/export.<date> on request\n"
+                     "\t                    (control socket command \"replay-dump\")\n");
+        color_printf(TERM_BOLD "\tring-size=<b>" TERM_RESET "     - limit the ring size in bytes (k/M/G suffixes accepted)\n");
 }
 
 static bool
@@ -134,6 +143,18 @@ parse_options(struct exporter *s, const char *ccfg, bool *should_export)
                         }
                 } else if (strcmp(item, "exit_on_limit") == 0) {
                         s->exit_on_limit = true;
+                } else if (strstr(item, "ring=") == item) {
+                        s->ring_seconds = strtod(item + strlen("ring="), NULL);
+                        if (s->ring_seconds <= 0) {
+                                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong ring length: %s!\n", item + strlen("ring="));
+                                return false;
+                        }
+                } else if (strstr(item, "ring-size=") == item) {
+                        s->ring_size = unit_evaluate(item + strlen("ring-size="), NULL);
+                        if (s->ring_size <= 0) {
+                                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong ring size: %s!\n", item + strlen("ring-size="));
+                                return false;
+                        }
                 } else if (s->dir == NULL && cfg != NULL) {
                         s->dir = strdup(item);
                 } else {
@@ -159,6 +180,12 @@ struct exporter *export_init(struct module *parent, const char *cfg, bool should
         if (s->dir == NULL) {
                 s->dir_auto = true;
         }
+        if (s->ring_seconds > 0) {
+                s->ring = replay_ring_init(s->ring_seconds, s->ring_size);
+                if (s->ring == NULL) {
+                        HANDLE_ERROR
+                }
+        }
 
         if (should_export) {
                 if (!enable_export(s)) {
@@ -177,6 +204,11 @@ struct exporter *export_init(struct module *parent, const char *cfg, bool should
 
 static bool enable_export(struct exporter *s)
 {
+        if (s->ring != NULL) { // directory is created on dump
+                s->exporting = true;
+                return true;
+        }
+
         if (!create_dir(s)) {
                 goto error;
         }
@@ -295,6 +327,10 @@ static bool create_dir(struct exporter *s)
 }
 
 static void disable_export(struct exporter *s) {
+        if (s->ring != NULL) { // ring contents is kept to be dumped
+                s->exporting = false;
+                return;
+        }
         audio_export_destroy(s->audio_export);
         video_export_destroy(s->video_export);
         s->audio_export = NULL;
@@ -308,6 +344,7 @@ static void disable_export(struct exporter *s) {
 
 void export_destroy(struct exporter *s) {
         disable_export(s);
+        replay_ring_destroy(s->ring);
 
         pthread_mutex_destroy(&s->lock);
         module_done(&s->mod);
@@ -315,6 +352,37 @@ void export_destroy(struct exporter *s) {
         free(s);
 }
 
+/**
+ * Creates a new export directory (inside the one given by user, if any)
+ * and writes the ring contents there asynchronously.
+ */
+static struct response *dump_ring(struct exporter *s) {
+        if (s->ring == NULL) {
+                return new_response(RESPONSE_BAD_REQUEST, "replay ring not enabled");
+        }
+        const char *prefix = s->dir ? s->dir : ".";
+        if (mkdir(prefix, S_IRWXU | S_IRWXG | S_IRWXO) == -1 && errno != EEXIST) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Directory creation failed: %s\n", ug_strerror(errno));
+                return new_response(RESPONSE_INT_SERV_ERR, NULL);
+        }
+        char *dir = create_implicit_dir(prefix);
+        if (dir == NULL) {
+                return new_response(RESPONSE_INT_SERV_ERR, NULL);
+        }
+        struct replay_ring_stats stats;
+        replay_ring_get_stats(s->ring, &stats);
+        if (!replay_ring_dump(s->ring, dir, !s->novideo, !s->noaudio)) {
+                rmdir(dir);
+                free(dir);
+                return new_response(RESPONSE_BAD_REQUEST, "dump already in progress");
+        }
+        char text[MAX_PATH_SIZE + 64];
+        snprintf(text, sizeof text, "%s (%d video frames, %.1f s)", dir, stats.video_frames, stats.duration);
+        log_msg(LOG_LEVEL_NOTICE, MOD_NAME "Dumping replay ring to %s\n", text);
+        free(dir);
+        return new_response(RESPONSE_ACCEPTED, text);
+}
+
 static void process_messages(struct exporter *s) {
         struct message *m;
         while ((m = check_message(&s->mod))) {
@@ -331,6 +399,8 @@ static void process_messages(struct exporter *s) {
                         r = new_response(RESPONSE_OK, NULL);
                 } else if (strcmp(msg->text, "status") == 0) {
                         r = new_response(RESPONSE_OK, s->exporting ? "true" : "false");
+                } else if (strcmp(msg->text, "dump") == 0) {
+                        r = dump_ring(s);
                 } else {
                         r = new_response(RESPONSE_NOT_FOUND, NULL);
                 }
@@ -347,7 +417,13 @@ void export_audio(struct exporter *s, struct audio_frame *frame)
 
         pthread_mutex_lock(&s->lock);
         if (s->exporting) {
-                audio_export(s->audio_export, frame);
+                if (s->ring != NULL) {
+                        if (!s->noaudio) {
+                                replay_ring_add_audio(s->ring, frame);
+                        }
+                } else {
+                        audio_export(s->audio_export, frame);
+                }
         }
         pthread_mutex_unlock(&s->lock);
 }
@@ -359,6 +435,13 @@ void export_video(struct exporter *s, struct video_frame *frame)
         process_messages(s);
 
         pthread_mutex_lock(&s->lock);
+        if (s->ring != NULL) {
+                if (s->exporting && !s->novideo) {
+                        replay_ring_add_video(s->ring, frame);
+                }
+                pthread_mutex_unlock(&s->lock);
+                return;
+        }
         if (s->exporting) {
                 video_export(s->video_export, frame);
         }
@@ -93,6 +93,7 @@ struct state_transcoder_decompress : public frame_recv_delegate {
 
         virtual ~state_transcoder_decompress() {}
         void worker();
+        void push_frame(struct video_frame *f);
 
         struct capture_filter *capture_filter_state;
 
@@ -106,17 +107,26 @@ void state_transcoder_decompress::frame_arrived(struct video_frame *f, struct au
                 LOG(LOG_LEVEL_WARNING) << "Unexpectedly receiving audio!\n";
                 AUDIO_FRAME_DISPOSE(a);
         }
-        auto deleter = vf_free;
         // apply capture filter
         if (f) {
-                f = capture_filter(capture_filter_state, f);
+                push_frame(capture_filter(capture_filter_state, f));
+                return;
         }
-        if (f && f->callbacks.dispose) {
-                deleter = f->callbacks.dispose;
+        // end of stream - pass frames left in the capture filter pipeline
+        while ((f = capture_filter_drain(capture_filter_state)) != nullptr) {
+                push_frame(f);
         }
+}
+
+void state_transcoder_decompress::push_frame(struct video_frame *f)
+{
         if (!f) {
                 return;
         }
+        auto deleter = vf_free;
+        if (f->callbacks.dispose) {
+                deleter = f->callbacks.dispose;
+        }
 
         unique_lock<mutex> l(lock);
         if (received_frame.size() >= MAX_QUEUE_SIZE) {
@@ -252,6 +262,9 @@ void hd_rum_decompress_done(void *state) {
 
         s->receiver_thread.join();
 
+        // flushes the capture filter while the worker still runs
+        display_put_frame(s->display, NULL, 0);
+
         {
                 unique_lock<mutex> l(s->lock);
                 s->received_frame.push({});
@@ -261,7 +274,6 @@ void hd_rum_decompress_done(void *state) {
 
         s->worker_thread.join();
 
-        display_put_frame(s->display, NULL, 0);
         s->video_rxtx->join();
 
         delete s->video_rxtx;
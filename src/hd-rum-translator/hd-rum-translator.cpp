@@ -74,11 +74,13 @@
 #include "messaging.h"
 #include "module.h"
 #include "rtp/net_udp.h"
+#include "rtp/rtp.h"
 #include "tv.h"
 #include "ug_runtime_error.hpp"
 #include "utils/color_out.h"
 #include "utils/misc.h" // format_in_si_units, unit_evaluate
 #include "utils/net.h"
+#include "utils/random.h"
 
 using std::invalid_argument;
 using std::stoi;
@@ -87,6 +89,7 @@ using std::to_string;
 using std::vector;
 
 #define MOD_NAME "[hd-rum-trans] "
+#define KEYFRAME_REQ_RELAY_INTERVAL_MS 200
 
 #define REPLICA_MAGIC 0xd2ff3323
 
@@ -965,6 +968,88 @@ private:
         }
 };
 
+/**
+ * Relays keyframe requests (RTCP PLI/FIR) from receivers to the sender.
+ *
+ * Both the sender and the receivers send RTCP to the reflector input port + 1.
+ * The sender is recognized by sending SRs, requests from receivers are
+ * aggregated - those coming within KEYFRAME_REQ_RELAY_INTERVAL_MS (eg. after
+ * a loss affecting all receivers) are forwarded as a single PLI.
+ */
+class Keyframe_request_relay{
+public:
+        explicit Keyframe_request_relay(int port) :
+                sock(udp_init_if("localhost", nullptr, port, 0, 255, false, false), udp_exit),
+                ssrc(ug_rand()) {  }
+        ~Keyframe_request_relay(){
+                should_stop.store(true, std::memory_order_relaxed);
+                if(worker_thread.joinable())
+                    worker_thread.join();
+        }
+
+        bool run_async(){
+                if(!sock){
+                        return false;
+                }
+                worker_thread = std::thread(&Keyframe_request_relay::worker, this);
+                return true;
+        }
+
+private:
+        std::shared_ptr<socket_udp> sock;
+        uint32_t ssrc; ///< our SSRC used in the forwarded requests
+        struct sockaddr_storage sender = {};
+        socklen_t sender_len = 0;
+        time_ns_t last_forwarded = 0;
+        std::thread worker_thread;
+        std::atomic<bool> should_stop = false;
+
+        void worker(){
+            struct timeval timeout = { 1, 0 };
+            char buf[RTP_MAX_PACKET_LEN];
+
+            while(!should_stop.load(std::memory_order_relaxed)){
+                    struct sockaddr_storage sin = {};
+                    socklen_t addrlen = sizeof(sin);
+                    int size = udp_recvfrom_timeout(sock.get(), buf, std::size(buf), &timeout, (sockaddr *) &sin, &addrlen);
+
+                    if(size > 0)
+                            process((const uint8_t *) buf, size, sin, addrlen);
+            }
+        }
+
+        void process(const uint8_t *buf, int size, sockaddr_storage &sin, socklen_t addrlen){
+                const int rtcp_sr = 200;
+                if(size >= 2 && buf[1] == rtcp_sr){
+                        if(sender_len == 0 || !sockaddr_equal(&sender, &sin)){
+                                MSG(VERBOSE, "Sender RTCP address: %s\n", get_sockaddr_str((sockaddr *) &sin));
+                        }
+                        sender = sin;
+                        sender_len = addrlen;
+                        return;
+                }
+                uint32_t media_ssrc = 0;
+                if(!rtcp_find_keyframe_request(buf, size, &media_ssrc)){
+                        return;
+                }
+                if(sender_len == 0){
+                        MSG(VERBOSE, "Keyframe request from %s dropped - sender not yet known.\n", get_sockaddr_str((sockaddr *) &sin));
+                        return;
+                }
+                time_ns_t now = get_time_in_ns();
+                if(now - last_forwarded < KEYFRAME_REQ_RELAY_INTERVAL_MS * NS_IN_MS){
+                        MSG(DEBUG, "Keyframe request from %s aggregated.\n", get_sockaddr_str((sockaddr *) &sin));
+                        return;
+                }
+                last_forwarded = now;
+
+                uint8_t req[28];
+                int len = rtcp_format_keyframe_request(req, sizeof req, ssrc, media_ssrc, RTCP_PSFB_PLI, 0);
+                MSG(VERBOSE, "Forwarding keyframe request from %s.\n", get_sockaddr_str((sockaddr *) &sin));
+                udp_sendto(sock.get(), (char *) req, len, (sockaddr *) &sender, sender_len);
+        }
+};
+
 static void hd_rum_translator_should_exit_callback(void *arg) {
     volatile auto *should_exit = (volatile bool *) arg;
     *should_exit = true;
@@ -1137,6 +1222,11 @@ int main(int argc, char **argv)
             participant_mgr.run_async(state.server_socket);
     }
 
+    Keyframe_request_relay keyframe_req_relay(params.port + 1);
+    if (!keyframe_req_relay.run_async()) {
+        MSG(WARNING, "Cannot bind RTCP port %d, keyframe requests won't be relayed.\n", params.port + 1);
+    }
+
     volatile bool should_exit = false;
     register_should_exit_callback(&state.mod, hd_rum_translator_should_exit_callback, const_cast<bool *>(&should_exit));
     /* main loop */
@@ -99,6 +99,7 @@
 #include "utils/color_out.h"
 #include "utils/fs.h"                   // for MAX_PATH_SIZE
 #include "utils/misc.h" // ug_strerror
+#include "utils/parallel_probe.hpp"
 #include "utils/random.h"
 #include "utils/string.h"
 #include "utils/string_view_utils.hpp"
@@ -113,6 +114,7 @@
 #include <iomanip>
 #include <iostream>
 #include <list>
+#include <sstream>
 #include <fstream>
 #include <string>
 #include <thread>
@@ -637,8 +639,8 @@ int get_exit_status(struct module *root_mod) {
 
 using module_info_map = std::map<std::string, const void *>;
 
-static void print_device(std::string purpose, std::string const & mod, const device_info& device){
-        cout << "[capability][device] {"
+static void print_device(std::ostream &out, std::string purpose, std::string const & mod, const device_info& device){
+        out << "[capability][device] {"
                 "\"purpose\":" << std::quoted(purpose) << ", "
                 "\"module\":" << std::quoted(mod) << ", "
                 "\"device\":" << std::quoted(device.dev) << ", "
@@ -652,61 +654,64 @@ static void print_device(std::string purpose, std::string const & mod, const dev
                         break;
                 }
                 if (j > 0) {
-                        printf(", ");
+                        out << ", ";
                 }
-                std::cout << "{\"name\":" << std::quoted(device.modes[j].name) << ", "
+                out << "{\"name\":" << std::quoted(device.modes[j].name) << ", "
                         "\"opts\":" << device.modes[j].id << "}";
         }
-        std::cout << "]";
+        out << "]";
 
-        std::cout << ", \"options\": [";
+        out << ", \"options\": [";
         for(unsigned int j = 0; j < std::size(device.options); j++) {
                 if (device.options[j].key[0] == '\0') { // last item
                         break;
                 }
                 if (j > 0) {
-                        printf(", ");
+                        out << ", ";
                 }
-                cout << "{"
+                out << "{"
                     "\"display_name\":" << std::quoted(device.options[j].display_name) << ", "
                     "\"display_desc\":" << std::quoted(device.options[j].display_desc) << ", "
                     "\"key\":" << std::quoted(device.options[j].key) << ", "
                     "\"opt_str\":" << std::quoted(device.options[j].opt_str) << ", "
                     "\"is_boolean\":\"" << (device.options[j].is_boolean ? "t" : "f") << "\"}";
         }
-        std::cout << "]";
+        out << "]";
 
-        std::cout << "}\n";
+        out << "}\n";
 }
 
 template<typename T>
-static void probe_device(std::string_view cap_str, std::string const & name, const void *mod){
+static std::string probe_device(std::string_view cap_str, std::string const & name, const void *mod){
         auto vdi = static_cast<T>(mod);
         int count = 0;
         struct device_info *devices = nullptr;
         void (*deleter)(void *) = nullptr;
         vdi->probe(&devices, &count, &deleter);
+        std::ostringstream out;
         for (int i = 0; i < count; ++i) {
-                print_device(std::string(cap_str), name, devices[i]);
+                print_device(out, std::string(cap_str), name, devices[i]);
         }
         deleter ? deleter(devices) : free(devices);
+        return out.str();
 }
 
-static void probe_compress(std::string const & name, const void *mod) noexcept {
+static std::string probe_compress(std::string const & name, const void *mod) noexcept {
         auto vci = static_cast<const struct video_compress_info *>(mod);
+        std::ostringstream out;
 
         if(vci->get_module_info){
                 auto module_info = vci->get_module_info();
-                cout << "[capability][video_compress] {"
+                out << "[capability][video_compress] {"
                         "\"name\":" << std::quoted(name) << ", "
                         "\"options\": [";
 
                 int i = 0;
                 for(const auto& opt : module_info.opts){
                         if(i++ > 0)
-                                cout << ", ";
+                                out << ", ";
 
-                        cout << "{"
+                        out << "{"
                                 "\"display_name\":" << std::quoted(opt.display_name) << ", "
                                 "\"display_desc\":" << std::quoted(opt.display_desc) << ", "
                                 "\"key\":" << std::quoted(opt.key) << ", "
@@ -714,32 +719,33 @@ static void probe_compress(std::string const & name, const void *mod) noexcept {
                                 "\"is_boolean\":\"" << (opt.is_boolean ? "t" : "f") << "\"}";
                 }
 
-                cout << "], "
+                out << "], "
                         "\"codecs\": [";
 
                 int j = 0;
                 for(const auto& c : module_info.codecs){
                         if(j++ > 0)
-                                cout << ", ";
+                                out << ", ";
 
-                        cout << "{\"name\":" << std::quoted(c.name) << ", "
+                        out << "{\"name\":" << std::quoted(c.name) << ", "
                                 "\"priority\": " << c.priority << ", "
                                 "\"encoders\":[";
 
                         int z = 0;
                         for(const auto& e : c.encoders){
                                 if(z++ > 0)
-                                        cout << ", ";
+                                        out << ", ";
 
-                                cout << "{\"name\":" << std::quoted(e.name) << ", "
+                                out << "{\"name\":" << std::quoted(e.name) << ", "
                                         "\"opt_str\":" << std::quoted(e.opt_str) << "}";
                         }
-                        cout << "]}";
+                        out << "]}";
                 }
 
-                cout << "]}" << std::endl;
+                out << "]}\n";
 
         }
+        return out.str();
 }
 
 const static struct {
@@ -747,44 +753,91 @@ const static struct {
         std::string_view cap_str;
         enum library_class cls;
         int abi_ver;
-        void (*probe_print)(std::string name, const void *);
+        std::string (*probe)(std::string name, const void *);
+        bool device_probe; ///< results depend on connected devices
 } mod_classes[] = {
         {"Compressions", "compress",
                 LIBRARY_CLASS_VIDEO_COMPRESS, VIDEO_COMPRESS_ABI_VERSION,
-                [](std::string name, const void *m) { probe_compress(name, m); }},
+                [](std::string name, const void *m) { return probe_compress(name, m); }, false},
         {"Capture filters", "capture_filter",
                 LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION,
-                nullptr},
+                nullptr, false},
         {"Capturers", "capture",
                 LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION,
-                [](std::string name, const void *m){ probe_device<const video_capture_info *>("capture", name, m); }},
+                [](std::string name, const void *m){ return probe_device<const video_capture_info *>("capture", name, m); }, true},
         {"Displays", "display",
                 LIBRARY_CLASS_VIDEO_DISPLAY, VIDEO_DISPLAY_ABI_VERSION,
-                [](std::string name, const void *m){ probe_device<const video_display_info *>("video_disp", name, m); }},
+                [](std::string name, const void *m){ return probe_device<const video_display_info *>("video_disp", name, m); }, true},
         {"Audio capturers", "audio_cap",
                 LIBRARY_CLASS_AUDIO_CAPTURE, AUDIO_CAPTURE_ABI_VERSION,
-                [](std::string name, const void *m){ probe_device<const audio_capture_info *>("audio_cap", name, m); }},
+                [](std::string name, const void *m){ return probe_device<const audio_capture_info *>("audio_cap", name, m); }, true},
         {"Audio filters", "audio_filter",
                 LIBRARY_CLASS_AUDIO_FILTER, AUDIO_FILTER_ABI_VERSION,
-                nullptr},
+                nullptr, false},
         {"Audio compress", "audio_compress",
                 LIBRARY_CLASS_AUDIO_COMPRESS, AUDIO_COMPRESS_ABI_VERSION,
-                nullptr},
+                nullptr, false},
         {"Audio playback", "audio_play",
                 LIBRARY_CLASS_AUDIO_PLAYBACK, AUDIO_PLAYBACK_ABI_VERSION,
-                [](std::string name, const void *m){ probe_device<const audio_playback_info *>("audio_play", name, m); }},
+                [](std::string name, const void *m){ return probe_device<const audio_playback_info *>("audio_play", name, m); }, true},
 };
 
+ADD_TO_PARAM("capabilities-timeout", "* capabilities-timeout=<ms>\n"
+                "  Timeout for a single module probe when printing capabilities (default 3000 ms).\n");
+ADD_TO_PARAM("capabilities-cache", "* capabilities-cache=no|<file>\n"
+                "  Disables capabilities cache or uses a different cache file.\n");
+ADD_TO_PARAM("capabilities-hint", "* capabilities-hint=<token>\n"
+                "  Device-change hint - cached device probes are invalidated when the token changes.\n");
+/**
+ * @returns group of modules that must not be probed concurrently - the modules
+ * sharing a library that is not safe to be initialized from multiple threads at
+ * once (eg. Pa_Initialize()/Pa_Terminate() of both portaudio modules). Modules
+ * of different classes with the same name use usually the same library.
+ */
+static std::string get_probe_group(std::string const &name)
+{
+        const static std::map<std::string, std::string> groups = {
+                { "sdl", "SDL" }, { "sdl_mixer", "SDL" }, { "vulkan_sdl2", "SDL" },
+                { "gl", "GL" }, { "pano_gl", "GL" }, { "openxr_gl", "GL" },
+                { "screen_pw", "pipewire" },
+        };
+        auto it = groups.find(name);
+        return it != groups.end() ? it->second : name;
+}
 
+/**
+ * Probes all modules in parallel. Results are cached and reused if neither the module
+ * nor the device-change hint changed.
+ */
 static void probe_all(std::map<enum library_class, module_info_map>& class_mod_map)
 {
+        std::vector<probe_task> tasks;
         for(const auto& mod_class : mod_classes){
+                if (!mod_class.probe) {
+                        continue;
+                }
                 for(const auto& mod : class_mod_map[mod_class.cls]){
-                        if(!mod_class.probe_print)
-                                continue;
-                        mod_class.probe_print(mod.first, mod.second);
+                        auto probe = mod_class.probe;
+                        tasks.push_back({std::string(mod_class.cap_str) + ":" + mod.first,
+                                        get_probe_validator(mod.second, mod_class.device_probe),
+                                        [probe, name = mod.first, info = mod.second]() { return probe(name, info); },
+                                        get_probe_group(mod.first)});
                 }
         }
+
+        int timeout_ms = 3000;
+        if (const char *val = get_commandline_param("capabilities-timeout")) {
+                timeout_ms = atoi(val);
+        }
+        std::string cache_file = get_probe_cache_file();
+        if (const char *val = get_commandline_param("capabilities-cache")) {
+                cache_file = strcmp(val, "no") == 0 ? "" : val;
+        }
+
+        for (auto const &out : run_probes_parallel(tasks, std::chrono::milliseconds(timeout_ms), cache_file)) {
+                cout << out;
+        }
+        cout << std::flush;
 }
 
 static void print_modules(std::map<enum library_class, module_info_map>& class_mod_map)
@@ -823,11 +876,11 @@ void print_capabilities(const char *cfg)
                 auto mod_sv = tokenize(conf, ':');
 
                 enum library_class cls = LIBRARY_CLASS_UNDEFINED;
-                void (*probe_print)(std::string name, const void *) = nullptr;
+                std::string (*probe)(std::string name, const void *) = nullptr;
                 for(const auto& i : mod_classes){
                         if(i.cap_str == class_sv){
                                 cls = i.cls;
-                                probe_print = i.probe_print;
+                                probe = i.probe;
                         }
                 }
 
@@ -844,8 +897,8 @@ void print_capabilities(const char *cfg)
                         return;
                 }
 
-                if(probe_print)
-                        probe_print(std::string(mod_sv), modinfo->second);
+                if(probe)
+                        cout << probe(std::string(mod_sv), modinfo->second);
 
         }
 
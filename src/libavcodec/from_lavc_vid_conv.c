@@ -2480,12 +2480,7 @@ av_to_uv_convert_t *get_av_to_uv_conversion(int av_codec, codec_t uv_codec) {
         }
 
         codec_t mapped_pix_fmt = get_av_to_ug_pixfmt(av_codec);
-        if (mapped_pix_fmt == uv_codec) {
-                if (codec_is_planar(uv_codec)) {
-                        log_msg(LOG_LEVEL_ERROR, "Planar pixfmts not support here, please report a bug!\n");
-                        free(ret);
-                        return NULL;
-                }
+        if (mapped_pix_fmt == uv_codec) { // memcpy only
                 return ret;
         }
         if (mapped_pix_fmt != VC_NONE) {
@@ -2706,6 +2701,22 @@ do_av_to_uv_convert(const av_to_uv_convert_t *s, char *__restrict dst_buffer,
         }
 
         // memcpy only
+        if (codec_is_planar(s->dst_pixfmt)) { // planes stored contiguously, pitch not applicable
+                int sub[8];
+                codec_get_planes_subsampling(s->dst_pixfmt, sub);
+                char *planes[4]    = { NULL };
+                int   linesizes[4] = { 0 };
+                buf_get_planes(width, height, s->dst_pixfmt, dst_buffer, planes);
+                buf_get_linesizes(width, s->dst_pixfmt, linesizes);
+                for (int i = 0; i < 4 && sub[2 * i] != 0; ++i) {
+                        const int lines = (height + sub[2 * i + 1] - 1) / sub[2 * i + 1];
+                        for (ptrdiff_t y = 0; y < lines; ++y) {
+                                memcpy(planes[i] + y * linesizes[i],
+                                       in_frame->data[i] + y * in_frame->linesize[i], linesizes[i]);
+                        }
+                }
+                return;
+        }
         int linesize = vc_get_linesize(width, s->dst_pixfmt);
         for (ptrdiff_t i = 0; i < height; ++i) {
                 memcpy(dst_buffer + i * pitch, in_frame->data[0] + i * in_frame->linesize[0], linesize);
@@ -2742,7 +2753,8 @@ av_to_uv_convert(const av_to_uv_convert_t *convert,
                 return;
         }
 
-        if (codec_is_const_size(convert->dst_pixfmt)) { // VAAPI etc
+        if (codec_is_const_size(convert->dst_pixfmt) || // VAAPI etc
+            codec_is_planar(convert->dst_pixfmt)) { // cannot be split by lines
                 do_av_to_uv_convert(convert, dst, in, width, height, pitch,
                                  rgb_shift);
                 return;
@@ -1769,14 +1769,13 @@ static bool same_linesizes(codec_t codec, AVFrame *frame)
         if (!codec_is_planar(codec)) {
                 return vc_get_linesize(frame->width, codec) == frame->linesize[0];
         }
-        assert(get_bits_per_component(codec) == 8);
-        int sub[8];
-        codec_get_planes_subsampling(codec, sub);
+        int linesizes[4] = { 0 };
+        buf_get_linesizes(frame->width, codec, linesizes);
         for (ptrdiff_t i = 0; i < 4; ++i) {
-                if (sub[2 * i] == 0) {
+                if (linesizes[i] == 0) {
                         return true;
                 }
-                if (frame->linesize[i] != (frame->width + sub[2 * i] - 1) / sub[2 * i]) {
+                if (frame->linesize[i] != linesizes[i]) {
                         return false;
                 }
         }
@@ -1842,15 +1841,16 @@ struct AVFrame *to_lavc_vid_conv(struct to_lavc_vid_conv *s, char *in_data) {
                 task_run_parallel(pixfmt_conv_task, s->thread_count, data, sizeof data[0], NULL);
         } else { // no pixel format conversion needed
                 if (codec_is_planar(s->decoded_codec) && !same_linesizes(s->decoded_codec, s->out_frame)) {
-                        assert(get_bits_per_component(s->decoded_codec) == 8);
                         int sub[8];
                         codec_get_planes_subsampling(s->decoded_codec, sub);
+                        int linesizes[4] = { 0 };
+                        buf_get_linesizes(s->out_frame->width, s->decoded_codec, linesizes);
                         const unsigned char *in = decoded;
                         for (ptrdiff_t i = 0; i < 4; ++i) {
                                 if (sub[2 * i] == 0) {
                                         break;
                                 }
-                                int linesize = (s->out_frame->width + sub[2 * i] - 1) / sub[2 * i];
+                                int linesize = linesizes[i];
                                 int lines = (s->out_frame->height + sub[2 * i + 1] - 1) / sub[2 * i + 1];
                                 for (ptrdiff_t y = 0; y < lines; ++y) {
                                         memcpy(s->out_frame->data[i] + y * s->out_frame->linesize[i], in, linesize);
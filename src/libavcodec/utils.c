@@ -65,6 +65,8 @@ static const struct uv_to_av_pixfmt uv_to_av_pixfmts[] = {
         {BGR, AV_PIX_FMT_BGR24},
         //J2K,
         {I420, AV_PIX_FMT_YUVJ420P},
+        {NV12, AV_PIX_FMT_NV12},
+        {P010, AV_PIX_FMT_P010LE},
         {RG48, AV_PIX_FMT_RGB48LE},
 #if XV3X_PRESENT
         {Y416, AV_PIX_FMT_XV36},
@@ -81,6 +81,7 @@
 #include <thread>
 #include <tuple>
 #include <utility>                      // for move
+#include <vector>
 
 #include "compat/misc.h"
 #include "control_socket.h"
@@ -104,7 +105,9 @@
 #include "utils/string.h"
 #include "utils/string_view_utils.hpp"
 #include "utils/thread.h"
+#include "utils/virtual_clock.h"
 #include "utils/wait_obj.h"
+#include "utils/worker.h"
 #include "utils/udp_holepunch.h"
 #include "video.h"
 #include "video_capture.h"
@@ -144,14 +147,43 @@ static constexpr const char *DEFAULT_AUDIO_CODEC = "PCM";
 using namespace std;
 using namespace std::chrono;
 
+/// root of the module tree, shared by all sessions
+struct state_root_module {
+        state_root_module() noexcept { init_root_module(&mod); }
+        ~state_root_module() { module_done(&mod); }
+        struct module mod;
+};
+
+/**
+ * State of one capture -> compress -> tx (and rx -> display) chain. There is
+ * exactly one in the default mode, multiple in multi-session mode (see
+ * "--session" in usage()).
+ */
 struct state_uv {
         uint32_t magic = state_magic;
-        state_uv() noexcept {
-                init_root_module(&root_module);
-                register_should_exit_callback(&root_module, state_uv::should_exit_capture_callback, this);
-        }
+        state_uv() noexcept = default;
         ~state_uv() {
-                module_done(&root_module);
+                if (parent == nullptr) {
+                        return;
+                }
+                unregister_should_exit_callback(parent, state_uv::should_exit_capture_callback, this);
+                if (parent == &session_mod) {
+                        module_done(&session_mod);
+                }
+        }
+        /**
+         * Attaches the session to the module tree - directly to the root in
+         * the single-session mode, otherwise as session[idx] node.
+         */
+        void attach(struct module *root, int idx) {
+                parent = root;
+                if (idx >= 0) {
+                        module_init_default(&session_mod);
+                        session_mod.cls = MODULE_CLASS_SESSION;
+                        module_register(&session_mod, root);
+                        parent = &session_mod;
+                }
+                register_should_exit_callback(parent, state_uv::should_exit_capture_callback, this);
         }
 
         struct vidcap *capture_device{};
@@ -159,9 +191,16 @@ struct state_uv {
 
         struct state_audio *audio{};
 
-        struct module root_module;
+        struct module *parent{}; ///< module the session components are attached to
+        struct module session_mod{};
 
         video_rxtx *state_video_rxtx{};
+        struct ug_nat_traverse *nat_traverse{};
+
+        pthread_t receiver_thread_id{};
+        pthread_t capture_thread_id{};
+        bool receiver_thread_started = false;
+        bool capture_thread_started = false;
 
         static void should_exit_capture_callback(void *udata) {
                 auto *s = (state_uv *) udata;
@@ -284,6 +323,9 @@ static void usage(const char *exec_path, bool full = false)
                 print_help_item("--pix-fmts", {"list of pixel formats"});
                 print_help_item("--conv-policy [cds]{3} | help", {"pixel format conversion policy"});
                 print_help_item("--video-codecs", {"list of video codecs"});
+                print_help_item("--session", {"starts options of a next session (stream) run in the same process",
+                                "control port and --param are process-wide; use \"session <n> <cmd>\"",
+                                "to address a session over the control socket"});
         }
         print_help_item("address", {"destination address"});
         printf("\n");
@@ -339,10 +381,15 @@ static void *capture_thread(void *arg)
         const char              *print_fps_prefix =
             vidcap_get_fps_print_prefix(uv->capture_device);
 
-        while (!uv->should_exit_capture) {
+        while (true) {
                 /* Capture and transmit video... */
                 struct audio_frame *audio = nullptr;
-                struct video_frame *tx_frame = vidcap_grab(uv->capture_device, &audio);
+                struct video_frame *tx_frame = nullptr;
+                if (!uv->should_exit_capture) {
+                        tx_frame = vidcap_grab(uv->capture_device, &audio);
+                } else if ((tx_frame = vidcap_drain(uv->capture_device)) == nullptr) {
+                        break; // frames left in capture filter pipeline were sent
+                }
 
                 if (audio != nullptr) {
                         audio_sdi_send(uv->audio, audio);
@@ -1242,6 +1289,254 @@ static int adjust_params(struct ug_options *opt) {
         return 0;
 }
 
+ADD_TO_PARAM("worker-pool-limit", "* worker-pool-limit=<n>\n"
+                "  Maximal number of concurrently busy shared workers (conversions, compression tiles),\n"
+                "  0 for unlimited. Default is unlimited, CPU core count in the multi-session mode.\n");
+ADD_TO_PARAM("virtual-clock", "* virtual-clock\n"
+                "  Run with a virtual clock that fast-forwards to the next deadline when all pipeline\n"
+                "  threads are blocked (eg. for running loopback tests faster than real time).\n");
+
+/// argument vector of one session (with argv[0] prepended, NULL-terminated)
+using session_args = vector<char *>;
+
+/**
+ * Splits the command line to sessions delimited by "--session".
+ */
+static vector<session_args> split_sessions(int argc, char *argv[])
+{
+        vector<session_args> ret(1, session_args{ argv[0] });
+        for (int i = 1; i < argc; ++i) {
+                if (strcmp(argv[i], "--session") == 0) {
+                        ret.back().push_back(nullptr);
+                        ret.push_back(session_args{ argv[0] });
+                        continue;
+                }
+                ret.back().push_back(argv[i]);
+        }
+        ret.back().push_back(nullptr);
+        return ret;
+}
+
+struct uv_session {
+        ug_options opt;
+        state_uv uv;
+};
+
+static bool session_is_empty(const ug_options &opt) {
+        return opt.video_rxtx_mode == 0 &&
+               strcmp(opt.audio.send_cfg, "none") == 0 &&
+               strcmp(opt.audio.recv_cfg, "none") == 0;
+}
+
+static void print_session_config(const ug_options &opt, const audio_codec_params &ac_params)
+{
+        col() << TBOLD("Display device   : ") << opt.requested_display << "\n";
+        col() << TBOLD("Capture device   : ") << vidcap_params_get_driver(opt.vidcap_params_head) << "\n";
+        col() << TBOLD("Audio capture    : ") << opt.audio.send_cfg << "\n";
+        col() << TBOLD("Audio playback   : ") << opt.audio.recv_cfg << "\n";
+        col() << TBOLD("MTU              : ") << opt.common.mtu << " B\n";
+        col() << TBOLD("Video compression: ") << opt.requested_compression << "\n";
+        col() << TBOLD("Audio codec      : ")
+              << get_name_to_audio_codec(ac_params.codec) << "\n";
+        col() << TBOLD("Network protocol : ") << video_rxtx::get_long_name(opt.video_protocol) << "\n";
+        col() << TBOLD("Audio FEC        : ") << opt.audio.fec_cfg << "\n";
+        col() << TBOLD("Video FEC        : ") << opt.requested_video_fec << "\n";
+        col() << "\n";
+}
+
+/**
+ * Initializes session devices (audio, display, capture).
+ *
+ * @retval <0 return code whose absolute value will be passed to exit_uv()
+ * @retval 0 success
+ * @retval 1 help was printed
+ */
+static int init_session_devices(struct uv_session *s, unsigned display_flags)
+{
+        ug_options &opt = s->opt;
+        state_uv &uv = s->uv;
+
+        if(!opt.nat_traverse_config
+                        || strncmp(opt.nat_traverse_config, "holepunch", strlen("holepunch")) != 0){
+                uv.nat_traverse = start_nat_traverse(opt.nat_traverse_config, opt.requested_receiver, opt.video_rx_port, opt.audio.recv_port);
+                if(!uv.nat_traverse){
+                        return -1;
+                }
+        }
+
+        int ret = audio_init(&uv.audio, &opt.audio, &opt.common);
+        if (ret != 0) {
+                return ret < 0 ? -EXIT_FAIL_AUDIO : 1;
+        }
+
+        display_flags |= audio_get_display_flags(uv.audio);
+
+        // Display initialization should be prior to modules that may use graphic card (eg. GLSL) in order
+        // to initalize shared resource (X display) first
+        ret =
+             initialize_video_display(uv.parent, opt.requested_display, opt.display_cfg, display_flags, opt.postprocess, &uv.display_device);
+        if (ret < 0) {
+                printf("Unable to open display device: %s\n",
+                       opt.requested_display);
+                return -EXIT_FAIL_DISPLAY;
+        } else if(ret > 0) {
+                return 1;
+        }
+        log_msg(LOG_LEVEL_DEBUG, "Display initialized-%s\n", opt.requested_display);
+
+        ret = initialize_video_capture(uv.parent, opt.vidcap_params_head, &uv.capture_device);
+        if (ret < 0) {
+                printf("Unable to open capture device: %s\n",
+                                vidcap_params_get_driver(opt.vidcap_params_head));
+                return -EXIT_FAIL_CAPTURE;
+        } else if(ret > 0) {
+                return 1;
+        }
+        log_msg(LOG_LEVEL_DEBUG, "Video capture initialized-%s\n", vidcap_params_get_driver(opt.vidcap_params_head));
+        return 0;
+}
+
+/**
+ * Creates session RX/TX and starts receiver and capture threads.
+ *
+ * Throws on error (as video_rxtx::create() does).
+ * @returns false if failed
+ */
+static bool start_session(struct uv_session *s, time_ns_t start_time)
+{
+        ug_options &opt = s->opt;
+        state_uv &uv = s->uv;
+        map<string, param_u> params;
+
+        // common
+        params["compression"].str = opt.requested_compression;
+        params["rxtx_mode"].i = opt.video_rxtx_mode;
+
+        // iHDTV
+        params["capture_device"].ptr = (opt.video_rxtx_mode & MODE_SENDER) != 0U ? uv.capture_device : nullptr;
+        params["display_device"].ptr = (opt.video_rxtx_mode & MODE_RECEIVER) != 0U ? uv.display_device : nullptr;
+
+        //RTP
+        params["common"].cptr = &opt.common;
+        params["receiver"].str = opt.requested_receiver;
+        params["rx_port"].i = opt.video_rx_port;
+        params["tx_port"].i = opt.video_tx_port;
+        params["fec"].str = opt.requested_video_fec;
+        params["bitrate"].ll = opt.bitrate;
+        params["start_time"].ll = start_time;
+
+        // UltraGrid RTP
+        params["decoder_mode"].l = (long) opt.decoder_mode;
+        params["display_device"].ptr = uv.display_device;
+
+        // SAGE + RTSP
+        params["opts"].str = opt.video_protocol_opts;
+
+        if (strcmp(opt.video_protocol, "rtsp") == 0) {
+                rtsp_types_t avType = rtsp_type_none;
+                if ((strcmp("none", opt.audio.send_cfg) != 0)) {
+                        avType = (rtsp_types_t) (avType | rtsp_type_audio); // AStream
+                }
+                if (strcmp("none", vidcap_params_get_driver(
+                                       opt.vidcap_params_head)) != 0) {
+                        avType = (rtsp_types_t) (avType | rtsp_type_video); // VStream
+                }
+                if (avType == rtsp_type_none) {
+                        printf("[RTSP SERVER CHECK] no stream type... check capture devices input...\n");
+                }
+
+                params["avType"].l = (long) avType;
+        }
+
+        sdp_set_properties(opt.requested_receiver, opt.video_rxtx_mode & MODE_SENDER && strcasecmp(opt.video_protocol, "sdp") == 0, opt.audio.send_port != 0 && strcasecmp(opt.audio.proto, "sdp") == 0);
+
+        uv.state_video_rxtx = video_rxtx::create(opt.video_protocol, params);
+        if (!uv.state_video_rxtx) {
+                if (strcmp(opt.video_protocol, "help") != 0) {
+                        throw string("Requested RX/TX cannot be created (missing library?)");
+                } else {
+                        throw 0;
+                }
+        }
+
+        if ((opt.video_rxtx_mode & MODE_RECEIVER) != 0U) {
+                if (!uv.state_video_rxtx->supports_receiving()) {
+                        fprintf(stderr, "Selected RX/TX mode doesn't support receiving.\n");
+                        return false;
+                }
+                // init module here so as it is capable of receiving messages
+                if (pthread_create
+                                (&uv.receiver_thread_id, NULL, video_rxtx::receiver_thread,
+                                 (void *) uv.state_video_rxtx) != 0) {
+                        perror("Unable to create display thread!\n");
+                        return false;
+                } else {
+                        uv.receiver_thread_started = true;
+                }
+        }
+
+        if ((opt.video_rxtx_mode & MODE_SENDER) != 0U) {
+                if (pthread_create
+                                (&uv.capture_thread_id, NULL, capture_thread,
+                                 (void *) &uv) != 0) {
+                        perror("Unable to create capture thread!\n");
+                        return false;
+                } else {
+                        uv.capture_thread_started = true;
+                }
+        }
+
+        struct additional_audio_data aux = {
+                { uv.display_device, display_put_audio_frame,
+                 display_reconfigure_audio, display_ctl_property },
+                uv.state_video_rxtx,
+        };
+        audio_register_aux_data(uv.audio, aux);
+        return true;
+}
+
+static void join_session(struct uv_session *s, bool display_in_thread)
+{
+        ug_options &opt = s->opt;
+        state_uv &uv = s->uv;
+
+        if (strcmp("none", opt.requested_display) != 0 &&
+                        uv.receiver_thread_started)
+                pthread_join(uv.receiver_thread_id, NULL);
+
+        if ((opt.video_rxtx_mode & MODE_SENDER) != 0U
+                        && uv.capture_thread_started) {
+                pthread_join(uv.capture_thread_id, NULL);
+        }
+
+        /* also wait for audio threads */
+        audio_join(uv.audio);
+        if (uv.state_video_rxtx)
+                uv.state_video_rxtx->join();
+        if (display_in_thread && uv.display_device) {
+                display_join(uv.display_device);
+        }
+
+        export_destroy(opt.common.exporter);
+        opt.common.exporter = nullptr;
+}
+
+static void destroy_session(struct uv_session *s)
+{
+        state_uv &uv = s->uv;
+
+        if(uv.audio)
+                audio_done(uv.audio);
+        delete uv.state_video_rxtx;
+
+        if (uv.capture_device)
+                vidcap_done(uv.capture_device);
+        if (uv.display_device)
+                display_done(uv.display_device);
+
+        stop_nat_traverse(uv.nat_traverse);
+}
+
 #define EXIT(expr) { int rc = expr; common_cleanup(init); return rc; }
 
 int main(int argc, char *argv[])
@@ -1251,20 +1546,12 @@ int main(int argc, char *argv[])
 #if defined HAVE_SCHED_SETSCHEDULER && defined USE_RT
         struct sched_param sp;
 #endif
-        ug_options opt{};
-
-        pthread_t receiver_thread_id,
-                  capture_thread_id;
-        bool receiver_thread_started = false,
-             capture_thread_started = false;
         unsigned display_flags = 0;
         struct control_state *control = NULL;
         int ret;
 
         time_ns_t start_time = get_time_in_ns();
 
-        struct ug_nat_traverse *nat_traverse = nullptr;
-
 #ifndef _WIN32
         signal(SIGQUIT, crash_signal_handler);
 #endif
@@ -1278,97 +1565,100 @@ int main(int argc, char *argv[])
                 EXIT(EXIT_FAILURE);
         }
 
-        struct state_uv uv{};
-        keyboard_control kc{&uv.root_module};
+        struct state_root_module root;
+        keyboard_control kc{&root.mod};
         const bool show_help = tok_in_argv(uv_argv, "help");
 
         print_version();
         printf("\n");
 
-        if (int ret = parse_options(argc, argv, &opt)) {
-                EXIT(ret < 0 ? -ret : EXIT_SUCCESS);
-        }
+        vector<session_args> args = split_sessions(argc, argv);
+        const bool multi_session = args.size() > 1;
+        vector<unique_ptr<uv_session>> sessions;
+        vector<audio_codec_params> ac_params;
+        for (auto &a : args) {
+                if (!sessions.empty()) { // reinitialize getopt
+#ifdef __GLIBC__
+                        optind = 0;
+#else
+                        optind = 1;
+                        optreset = 1;
+#endif
+                }
+                sessions.emplace_back(make_unique<uv_session>());
+                ug_options &opt = sessions.back()->opt;
+                if (int ret = parse_options((int) a.size() - 1, a.data(), &opt)) {
+                        EXIT(ret < 0 ? -ret : EXIT_SUCCESS);
+                }
 
-        if (int ret = adjust_params(&opt)) {
-                EXIT(ret);
-        }
+                if (int ret = adjust_params(&opt)) {
+                        EXIT(ret);
+                }
 
-        const auto ac_params = parse_audio_codec_params(opt.audio.codec_cfg);
-        if (ac_params.codec == AC_NONE) {
-                EXIT(EXIT_FAILURE);
+                ac_params.push_back(parse_audio_codec_params(opt.audio.codec_cfg));
+                if (ac_params.back().codec == AC_NONE) {
+                        EXIT(EXIT_FAILURE);
+                }
+        }
+        // process-wide options (control port, capabilities) are taken from the first group
+        unique_ptr<uv_session> global_opts;
+        if (multi_session && session_is_empty(sessions[0]->opt)) {
+                global_opts = std::move(sessions[0]);
+                sessions.erase(sessions.begin());
+                ac_params.erase(ac_params.begin());
+        }
+        const ug_options &gopt = global_opts ? global_opts->opt : sessions[0]->opt;
+        for (unsigned i = 1; i < sessions.size(); ++i) {
+                if (sessions[i]->opt.control_port != 0 || sessions[i]->opt.requested_capabilities != nullptr) {
+                        LOG(LOG_LEVEL_WARNING) << MOD_NAME "Control port and capabilities are process-wide, "
+                                "set them for the first session only (session " << i << ")!\n";
+                }
         }
         if (!show_help) {
-                col() << TBOLD("Display device   : ") << opt.requested_display << "\n";
-                col() << TBOLD("Capture device   : ") << vidcap_params_get_driver(opt.vidcap_params_head) << "\n";
-                col() << TBOLD("Audio capture    : ") << opt.audio.send_cfg << "\n";
-                col() << TBOLD("Audio playback   : ") << opt.audio.recv_cfg << "\n";
-                col() << TBOLD("MTU              : ") << opt.common.mtu << " B\n";
-                col() << TBOLD("Video compression: ") << opt.requested_compression << "\n";
-                col() << TBOLD("Audio codec      : ")
-                      << get_name_to_audio_codec(ac_params.codec) << "\n";
-                col() << TBOLD("Network protocol : ") << video_rxtx::get_long_name(opt.video_protocol) << "\n";
-                col() << TBOLD("Audio FEC        : ") << opt.audio.fec_cfg << "\n";
-                col() << TBOLD("Video FEC        : ") << opt.requested_video_fec << "\n";
-                col() << "\n";
-        }
-
-        opt.common.parent = &uv.root_module;
-
-        opt.common.exporter = export_init(&uv.root_module, opt.export_opts, opt.should_export);
-        if (!opt.common.exporter) {
-                log_msg(LOG_LEVEL_ERROR, "Export initialization failed.\n");
-                EXIT(EXIT_FAILURE);
+                for (unsigned i = 0; i < sessions.size(); ++i) {
+                        if (multi_session) {
+                                col() << TBOLD("Session ") << i << ":\n";
+                        }
+                        print_session_config(sessions[i]->opt, ac_params[i]);
+                }
         }
 
-        if (control_init(opt.control_port, opt.connection_type, &control,
-                         &uv.root_module, opt.common.force_ip_version) != 0) {
-                LOG(LOG_LEVEL_FATAL) << "Error: Unable to initialize remote control!\n";
-                EXIT(EXIT_FAIL_CONTROL_SOCK);
+        if (get_commandline_param("virtual-clock") != nullptr) {
+                virtual_clock_set_enabled(true);
+                LOG(LOG_LEVEL_NOTICE) << MOD_NAME "Using virtual clock.\n";
         }
-
-        if(!opt.nat_traverse_config
-                        || strncmp(opt.nat_traverse_config, "holepunch", strlen("holepunch")) != 0){
-                nat_traverse = start_nat_traverse(opt.nat_traverse_config, opt.requested_receiver, opt.video_rx_port, opt.audio.recv_port);
-                if(!nat_traverse){
-                        exit_uv(1);
-                        goto cleanup;
-                }
+        if (multi_session) {
+                task_pool_set_limit(get_cpu_core_count());
         }
-
-        ret = audio_init(&uv.audio, &opt.audio, &opt.common);
-        if (ret != 0) {
-                exit_uv(ret < 0 ? EXIT_FAIL_AUDIO : 0);
-                goto cleanup;
+        if (const char *limit = get_commandline_param("worker-pool-limit")) {
+                task_pool_set_limit(stoi(limit));
         }
 
-        display_flags |= audio_get_display_flags(uv.audio);
+        for (unsigned i = 0; i < sessions.size(); ++i) {
+                ug_options &opt = sessions[i]->opt;
+                sessions[i]->uv.attach(&root.mod, multi_session ? (int) i : -1);
+                opt.common.parent = sessions[i]->uv.parent;
 
-        // Display initialization should be prior to modules that may use graphic card (eg. GLSL) in order
-        // to initalize shared resource (X display) first
-        ret =
-             initialize_video_display(&uv.root_module, opt.requested_display, opt.display_cfg, display_flags, opt.postprocess, &uv.display_device);
-        if (ret < 0) {
-                printf("Unable to open display device: %s\n",
-                       opt.requested_display);
-                exit_uv(EXIT_FAIL_DISPLAY);
-                goto cleanup;
-        } else if(ret > 0) {
-                exit_uv(EXIT_SUCCESS);
-                goto cleanup;
+                opt.common.exporter = export_init(opt.common.parent, opt.export_opts, opt.should_export);
+                if (!opt.common.exporter) {
+                        log_msg(LOG_LEVEL_ERROR, "Export initialization failed.\n");
+                        EXIT(EXIT_FAILURE);
+                }
         }
-        log_msg(LOG_LEVEL_DEBUG, "Display initialized-%s\n", opt.requested_display);
 
-        ret = initialize_video_capture(&uv.root_module, opt.vidcap_params_head, &uv.capture_device);
-        if (ret < 0) {
-                printf("Unable to open capture device: %s\n",
-                                vidcap_params_get_driver(opt.vidcap_params_head));
-                exit_uv(EXIT_FAIL_CAPTURE);
-                goto cleanup;
-        } else if(ret > 0) {
-                exit_uv(EXIT_SUCCESS);
-                goto cleanup;
+        if (control_init(gopt.control_port, gopt.connection_type, &control,
+                         &root.mod, gopt.common.force_ip_version) != 0) {
+                LOG(LOG_LEVEL_FATAL) << "Error: Unable to initialize remote control!\n";
+                EXIT(EXIT_FAIL_CONTROL_SOCK);
+        }
+
+        for (auto &s : sessions) {
+                ret = init_session_devices(s.get(), display_flags);
+                if (ret != 0) {
+                        exit_uv(ret < 0 ? -ret : EXIT_SUCCESS);
+                        goto cleanup;
+                }
         }
-        log_msg(LOG_LEVEL_DEBUG, "Video capture initialized-%s\n", vidcap_params_get_driver(opt.vidcap_params_head));
 
         signal(SIGINT, signal_handler);
         signal(SIGTERM, signal_handler);
@@ -1389,108 +1679,31 @@ int main(int argc, char *argv[])
 #endif /* USE_RT */
 
         try {
-                map<string, param_u> params;
-
-                // common
-                params["compression"].str = opt.requested_compression;
-                params["rxtx_mode"].i = opt.video_rxtx_mode;
-
-                // iHDTV
-                params["capture_device"].ptr = (opt.video_rxtx_mode & MODE_SENDER) != 0U ? uv.capture_device : nullptr;
-                params["display_device"].ptr = (opt.video_rxtx_mode & MODE_RECEIVER) != 0U ? uv.display_device : nullptr;
-
-                //RTP
-                params["common"].cptr = &opt.common;
-                params["receiver"].str = opt.requested_receiver;
-                params["rx_port"].i = opt.video_rx_port;
-                params["tx_port"].i = opt.video_tx_port;
-                params["fec"].str = opt.requested_video_fec;
-                params["bitrate"].ll = opt.bitrate;
-                params["start_time"].ll = start_time;
-
-                // UltraGrid RTP
-                params["decoder_mode"].l = (long) opt.decoder_mode;
-                params["display_device"].ptr = uv.display_device;
-
-                // SAGE + RTSP
-                params["opts"].str = opt.video_protocol_opts;
-
-                if (strcmp(opt.video_protocol, "rtsp") == 0) {
-                        rtsp_types_t avType = rtsp_type_none;
-                        if ((strcmp("none", opt.audio.send_cfg) != 0)) {
-                                avType = (rtsp_types_t) (avType | rtsp_type_audio); // AStream
-                        }
-                        if (strcmp("none", vidcap_params_get_driver(
-                                               opt.vidcap_params_head)) != 0) {
-                                avType = (rtsp_types_t) (avType | rtsp_type_video); // VStream
-                        }
-                        if (avType == rtsp_type_none) {
-                                printf("[RTSP SERVER CHECK] no stream type... check capture devices input...\n");
-                        }
-
-                        params["avType"].l = (long) avType;
-                }
-
-                sdp_set_properties(opt.requested_receiver, opt.video_rxtx_mode & MODE_SENDER && strcasecmp(opt.video_protocol, "sdp") == 0, opt.audio.send_port != 0 && strcasecmp(opt.audio.proto, "sdp") == 0);
-
-                uv.state_video_rxtx = video_rxtx::create(opt.video_protocol, params);
-                if (!uv.state_video_rxtx) {
-                        if (strcmp(opt.video_protocol, "help") != 0) {
-                                throw string("Requested RX/TX cannot be created (missing library?)");
-                        } else {
-                                throw 0;
-                        }
-                }
-
-                if ((opt.video_rxtx_mode & MODE_RECEIVER) != 0U) {
-                        if (!uv.state_video_rxtx->supports_receiving()) {
-                                fprintf(stderr, "Selected RX/TX mode doesn't support receiving.\n");
+                for (auto &s : sessions) {
+                        if (!start_session(s.get(), start_time)) {
                                 exit_uv(EXIT_FAILURE);
                                 goto cleanup;
                         }
-                        // init module here so as it is capable of receiving messages
-                        if (pthread_create
-                                        (&receiver_thread_id, NULL, video_rxtx::receiver_thread,
-                                         (void *) uv.state_video_rxtx) != 0) {
-                                perror("Unable to create display thread!\n");
-                                exit_uv(EXIT_FAILURE);
-                                goto cleanup;
-                        } else {
-                                receiver_thread_started = true;
-                        }
                 }
 
-                if ((opt.video_rxtx_mode & MODE_SENDER) != 0U) {
-                        if (pthread_create
-                                        (&capture_thread_id, NULL, capture_thread,
-                                         (void *) &uv) != 0) {
-                                perror("Unable to create capture thread!\n");
-                                exit_uv(EXIT_FAILURE);
-                                goto cleanup;
-                        } else {
-                                capture_thread_started = true;
-                        }
-                }
-
-                struct additional_audio_data aux = {
-                        { uv.display_device, display_put_audio_frame,
-                         display_reconfigure_audio, display_ctl_property },
-                        uv.state_video_rxtx,
-                };
-                audio_register_aux_data(uv.audio, aux);
-
-                if (opt.requested_capabilities != nullptr) {
-                        print_capabilities(opt.requested_capabilities);
+                if (gopt.requested_capabilities != nullptr) {
+                        print_capabilities(gopt.requested_capabilities);
                         exit_uv(EXIT_SUCCESS);
                         goto cleanup;
                 }
 
-                audio_start(uv.audio);
+                for (auto &s : sessions) {
+                        audio_start(s->uv.audio);
+                }
 
                 control_start(control);
                 kc.start();
 
-                display_run_mainloop(uv.display_device);
+                // only the first session display may use the main thread
+                for (unsigned i = 1; i < sessions.size(); ++i) {
+                        display_run_new_thread(sessions[i]->uv.display_device);
+                }
+                display_run_mainloop(sessions[0]->uv.display_device);
 
         } catch (ug_no_error const &e) {
                 exit_uv(0);
@@ -1511,22 +1724,10 @@ int main(int argc, char *argv[])
         }
 
 cleanup:
-        if (strcmp("none", opt.requested_display) != 0 &&
-                        receiver_thread_started)
-                pthread_join(receiver_thread_id, NULL);
-
-        if ((opt.video_rxtx_mode & MODE_SENDER) != 0U
-                        && capture_thread_started) {
-                pthread_join(capture_thread_id, NULL);
+        for (unsigned i = 0; i < sessions.size(); ++i) {
+                join_session(sessions[i].get(), i > 0);
         }
 
-        /* also wait for audio threads */
-        audio_join(uv.audio);
-        if (uv.state_video_rxtx)
-                uv.state_video_rxtx->join();
-
-        export_destroy(opt.common.exporter);
-
         signal(SIGINT, SIG_DFL);
         signal(SIGTERM, SIG_DFL);
 #ifndef _WIN32
@@ -1535,16 +1736,9 @@ cleanup:
 #endif
         alarm(5); // prevent exit hangs
 
-        if(uv.audio)
-                audio_done(uv.audio);
-        delete uv.state_video_rxtx;
-
-        if (uv.capture_device)
-                vidcap_done(uv.capture_device);
-        if (uv.display_device)
-                display_done(uv.display_device);
-
-        stop_nat_traverse(nat_traverse);
+        for (auto &s : sessions) {
+                destroy_session(s.get());
+        }
 
         kc.stop();
         control_done(control);
@@ -1553,7 +1747,7 @@ cleanup:
 
         printf("Exit\n");
 
-        return get_exit_status(&uv.root_module);
+        return get_exit_status(&root.mod);
 }
 
 /* vim: set expandtab sw=8: */
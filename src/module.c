@@ -173,6 +173,7 @@ static const char *module_class_name_pairs[] = {
         [MODULE_CLASS_DECODER] = "decoder",
         [MODULE_CLASS_EXPORTER] = "exporter",
         [MODULE_CLASS_KEYCONTROL] = "keycontrol",
+        [MODULE_CLASS_SESSION] = "session",
 };
 
 const char *module_class_name(enum module_class cls)
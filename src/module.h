@@ -95,6 +95,7 @@ enum module_class {
         MODULE_CLASS_DECODER,
         MODULE_CLASS_EXPORTER,
         MODULE_CLASS_KEYCONTROL,
+        MODULE_CLASS_SESSION,
 };
 
 struct module;
@@ -0,0 +1,436 @@
+/**
+ * @file   rtp/net_impair.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Delayed packets are kept in a binary min-heap ordered by the release
+ * time. A single worker thread sleeps until the earliest deadline and is
+ * woken up only if a packet becomes a new heap head (which doesn't happen
+ * in a steady state with fixed delay), so that there is no extra syscall per
+ * packet.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "rtp/net_impair.h"
+#include "utils/color_out.h"
+#include "utils/macros.h"
+#include "utils/misc.h"
+#include "utils/thread.h"
+#include "utils/virtual_clock.h"
+
+#define DEFAULT_LIMIT 100000
+#define DEFAULT_REORDER_GAP_MS 1
+#define MOD_NAME "[net_impair] "
+
+struct heap_item {
+        time_ns_t deadline;
+        uint64_t seq; ///< keeps FIFO ordering for equal deadlines
+        void *pkt;
+};
+
+struct net_impair {
+        char name[64];
+
+        // configuration
+        uint64_t seed;
+        double p;         ///< Gilbert-Elliott P(good->bad)
+        double r;         ///< Gilbert-Elliott P(bad->good)
+        double loss_good; ///< loss probability in good state
+        double loss_bad;  ///< loss probability in bad state
+        double reorder;
+        double dup;
+        time_ns_t delay;
+        time_ns_t jitter;
+        time_ns_t reorder_gap;
+        long long rate;   ///< bps, 0 = unlimited
+        int limit;        ///< maximal number of queued packets
+        bool immediate;   ///< no delay-related option set - no heap used
+
+        // runtime state
+        uint64_t rng;
+        bool bad_state;
+        time_ns_t link_free; ///< time when the rate-limited link becomes idle
+        time_ns_t last_deadline;
+        uint64_t seq;
+
+        struct heap_item *heap;
+        int heap_len;
+        int heap_alloc;
+
+        net_impair_deliver_t deliver;
+        void *udata;
+
+        pthread_t thread_id;
+        pthread_mutex_t lock;
+        pthread_cond_t cv;
+        struct virtual_clock_waiters waiters;
+        bool should_exit;
+
+        // stats
+        uint64_t stat_total;
+        uint64_t stat_lost;
+        uint64_t stat_dup;
+        uint64_t stat_reordered;
+        uint64_t stat_overflow;
+};
+
+static void usage(void)
+{
+        color_printf("Network impairment emulator for UDP sockets (use for testing only):\n\n");
+        color_printf("\t" TERM_BOLD "--param udp-impair-{tx,rx}=[seed=<n>][:loss=<%%>][:p=<%%>:r=<%%>[:loss_good=<%%>][:loss_bad=<%%>]]"
+                        "[:reorder=<%%>[:gap=<ms>]][:dup=<%%>][:delay=<ms>][:jitter=<ms>][:rate=<bps>][:limit=<pkts>]\n" TERM_RESET);
+        color_printf("\nwhere\n");
+        color_printf("\t" TERM_BOLD "seed" TERM_RESET "      - seed for the pseudo-random generator (the same seed gives the same results)\n");
+        color_printf("\t" TERM_BOLD "loss" TERM_RESET "      - uniform (Bernoulli) loss probability\n");
+        color_printf("\t" TERM_BOLD "p, r" TERM_RESET "      - Gilbert-Elliott burst loss transition probabilities good->bad and bad->good\n");
+        color_printf("\t" TERM_BOLD "loss_good, loss_bad" TERM_RESET " - loss probabilities in the good (default 0%%) and bad (default 100%%) state\n");
+        color_printf("\t" TERM_BOLD "reorder" TERM_RESET "   - probability that a packet overtakes the delayed ones (needs delay > gap)\n");
+        color_printf("\t" TERM_BOLD "gap" TERM_RESET "       - delay of the reordered packets (default %d ms)\n", DEFAULT_REORDER_GAP_MS);
+        color_printf("\t" TERM_BOLD "dup" TERM_RESET "       - duplication probability\n");
+        color_printf("\t" TERM_BOLD "delay" TERM_RESET "     - fixed delay\n");
+        color_printf("\t" TERM_BOLD "jitter" TERM_RESET "    - uniformly distributed delay variation (+-), packet order is kept\n");
+        color_printf("\t" TERM_BOLD "rate" TERM_RESET "      - rate limit (eg. 100M)\n");
+        color_printf("\t" TERM_BOLD "limit" TERM_RESET "     - maximal number of queued packets, further are dropped (default %d)\n", DEFAULT_LIMIT);
+        color_printf("\nExample:\n\t" TERM_BOLD "--param udp-impair-rx=seed=1:p=1:r=25:delay=20:jitter=5" TERM_RESET "\n\n");
+}
+
+/// splitmix64 - we do not use ug_rand() to get reproducible per-socket sequences
+static uint64_t next_rand(struct net_impair *s)
+{
+        uint64_t z = (s->rng += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27U)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31U);
+}
+
+static double next_drand(struct net_impair *s)
+{
+        return (double) (next_rand(s) >> 11U) * 0x1.0p-53;
+}
+
+static bool chance(struct net_impair *s, double prob)
+{
+        return prob > 0.0 && next_drand(s) < prob;
+}
+
+static bool parse_fmt(struct net_impair *s, char *fmt)
+{
+        char *item = NULL;
+        char *save_ptr = NULL;
+        while ((item = strtok_r(fmt, ":", &save_ptr)) != NULL) {
+                fmt = NULL;
+                char *val = strchr(item, '=');
+                if (val == NULL) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Option %s requires a value!\n", item);
+                        return false;
+                }
+                *val++ = '\0';
+                if (strcmp(item, "seed") == 0) {
+                        s->seed = strtoull(val, NULL, 0);
+                } else if (strcmp(item, "loss") == 0) {
+                        s->loss_good = s->loss_bad = atof(val) / 100.0;
+                } else if (strcmp(item, "p") == 0) {
+                        s->p = atof(val) / 100.0;
+                } else if (strcmp(item, "r") == 0) {
+                        s->r = atof(val) / 100.0;
+                } else if (strcmp(item, "loss_good") == 0) {
+                        s->loss_good = atof(val) / 100.0;
+                } else if (strcmp(item, "loss_bad") == 0) {
+                        s->loss_bad = atof(val) / 100.0;
+                } else if (strcmp(item, "reorder") == 0) {
+                        s->reorder = atof(val) / 100.0;
+                } else if (strcmp(item, "gap") == 0) {
+                        s->reorder_gap = atof(val) * NS_IN_MS_DBL;
+                } else if (strcmp(item, "dup") == 0) {
+                        s->dup = atof(val) / 100.0;
+                } else if (strcmp(item, "delay") == 0) {
+                        s->delay = atof(val) * NS_IN_MS_DBL;
+                } else if (strcmp(item, "jitter") == 0) {
+                        s->jitter = atof(val) * NS_IN_MS_DBL;
+                } else if (strcmp(item, "rate") == 0) {
+                        s->rate = unit_evaluate(val, NULL);
+                        if (s->rate <= 0) {
+                                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong rate: %s\n", val);
+                                return false;
+                        }
+                } else if (strcmp(item, "limit") == 0) {
+                        s->limit = atoi(val);
+                        if (s->limit <= 0) {
+                                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong limit: %s\n", val);
+                                return false;
+                        }
+                } else {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Unknown option: %s\n", item);
+                        return false;
+                }
+        }
+        return true;
+}
+
+static void heap_push(struct net_impair *s, struct heap_item item)
+{
+        if (s->heap_len == s->heap_alloc) {
+                s->heap_alloc = MAX(s->heap_alloc * 2, 64);
+                s->heap = realloc(s->heap, s->heap_alloc * sizeof s->heap[0]);
+        }
+        int i = s->heap_len++;
+        while (i > 0) {
+                int parent = (i - 1) / 2;
+                struct heap_item *p = &s->heap[parent];
+                if (p->deadline < item.deadline || (p->deadline == item.deadline && p->seq < item.seq)) {
+                        break;
+                }
+                s->heap[i] = *p;
+                i = parent;
+        }
+        s->heap[i] = item;
+}
+
+static struct heap_item heap_pop(struct net_impair *s)
+{
+        assert(s->heap_len > 0);
+        struct heap_item ret = s->heap[0];
+        struct heap_item last = s->heap[--s->heap_len];
+        int i = 0;
+        for (;;) {
+                int child = 2 * i + 1;
+                if (child >= s->heap_len) {
+                        break;
+                }
+                struct heap_item *c = &s->heap[child];
+                if (child + 1 < s->heap_len) {
+                        struct heap_item *c2 = &s->heap[child + 1];
+                        if (c2->deadline < c->deadline || (c2->deadline == c->deadline && c2->seq < c->seq)) {
+                                c = c2;
+                                child += 1;
+                        }
+                }
+                if (last.deadline < c->deadline || (last.deadline == c->deadline && last.seq < c->seq)) {
+                        break;
+                }
+                s->heap[i] = *c;
+                i = child;
+        }
+        s->heap[i] = last;
+        return ret;
+}
+
+static void *net_impair_worker(void *arg)
+{
+        set_thread_name(__func__);
+        struct net_impair *s = arg;
+
+        pthread_mutex_lock(&s->lock);
+        while (!s->should_exit) {
+                if (s->heap_len == 0) {
+                        virtual_clock_wait_begin(&s->waiters);
+                        pthread_cond_wait(&s->cv, &s->lock);
+                        virtual_clock_wait_end(&s->waiters);
+                        continue;
+                }
+                time_ns_t now = get_time_in_ns();
+                if (s->heap[0].deadline <= now) {
+                        struct heap_item item = heap_pop(s);
+                        pthread_mutex_unlock(&s->lock);
+                        s->deliver(s->udata, item.pkt);
+                        pthread_mutex_lock(&s->lock);
+                        continue;
+                }
+                if (virtual_clock_enabled) {
+                        virtual_clock_cond_timedwait(&s->cv, &s->lock, &s->waiters, s->heap[0].deadline);
+                        continue;
+                }
+                struct timespec ts = { (time_t) (s->heap[0].deadline / NS_IN_SEC), (long) (s->heap[0].deadline % NS_IN_SEC) };
+                pthread_cond_timedwait(&s->cv, &s->lock, &ts);
+        }
+        pthread_mutex_unlock(&s->lock);
+
+        return NULL;
+}
+
+struct net_impair *net_impair_init(const char *cfg, const char *name, uint64_t seed_off,
+                net_impair_deliver_t deliver, void *udata)
+{
+        if (strcmp(cfg, "help") == 0) {
+                usage();
+                return NULL;
+        }
+
+        struct net_impair *s = calloc(1, sizeof *s);
+        s->loss_bad = 1.0;
+        s->limit = DEFAULT_LIMIT;
+        s->reorder_gap = DEFAULT_REORDER_GAP_MS * NS_IN_MS;
+        snprintf(s->name, sizeof s->name, "%s", name);
+
+        char *fmt = strdup(cfg);
+        bool ret = parse_fmt(s, fmt);
+        free(fmt);
+        if (!ret) {
+                free(s);
+                return NULL;
+        }
+        if (s->p == 0.0 && s->loss_bad != s->loss_good) { // no G-E model, just uniform loss
+                s->loss_bad = s->loss_good;
+        }
+
+        s->rng = s->seed + seed_off;
+        s->deliver = deliver;
+        s->udata = udata;
+        s->immediate = s->delay == 0 && s->jitter == 0 && s->rate == 0 && s->reorder == 0.0;
+
+        pthread_mutex_init(&s->lock, NULL);
+        pthread_cond_init(&s->cv, NULL);
+        if (!s->immediate) {
+                pthread_create(&s->thread_id, NULL, net_impair_worker, s);
+        }
+
+        log_msg(LOG_LEVEL_WARNING, MOD_NAME "%s: impairment enabled (seed %" PRIu64 ", GE p=%.2f%% r=%.2f%% "
+                        "loss %.2f/%.2f%%, reorder %.2f%%, dup %.2f%%, delay %lld+-%lld us, rate %lld bps)\n",
+                        s->name, s->rng, s->p * 100.0, s->r * 100.0, s->loss_good * 100.0, s->loss_bad * 100.0,
+                        s->reorder * 100.0, s->dup * 100.0, s->delay / US_IN_NS, s->jitter / US_IN_NS, s->rate);
+
+        return s;
+}
+
+void net_impair_done(struct net_impair *s)
+{
+        if (s == NULL) {
+                return;
+        }
+        if (!s->immediate) {
+                pthread_mutex_lock(&s->lock);
+                s->should_exit = true;
+                pthread_mutex_unlock(&s->lock);
+                pthread_cond_signal(&s->cv);
+                pthread_join(s->thread_id, NULL);
+        }
+        for (int i = 0; i < s->heap_len; ++i) {
+                free(s->heap[i].pkt);
+        }
+        log_msg(LOG_LEVEL_INFO, MOD_NAME "%s: %" PRIu64 " packets, %" PRIu64 " lost, %" PRIu64 " duplicated, %" PRIu64
+                        " reordered, %" PRIu64 " dropped on queue overflow\n", s->name, s->stat_total, s->stat_lost,
+                        s->stat_dup, s->stat_reordered, s->stat_overflow);
+        free(s->heap);
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->cv);
+        free(s);
+}
+
+int net_impair_schedule(struct net_impair *s, int len, time_ns_t deadlines[NET_IMPAIR_MAX_COPIES])
+{
+        pthread_mutex_lock(&s->lock);
+        s->stat_total += 1;
+
+        // Gilbert-Elliott state transition and loss
+        if (s->bad_state) {
+                s->bad_state = !chance(s, s->r);
+        } else {
+                s->bad_state = chance(s, s->p);
+        }
+        if (chance(s, s->bad_state ? s->loss_bad : s->loss_good)) {
+                s->stat_lost += 1;
+                pthread_mutex_unlock(&s->lock);
+                return 0;
+        }
+        int copies = 1;
+        if (chance(s, s->dup)) {
+                s->stat_dup += 1;
+                copies = 2;
+        }
+
+        if (s->immediate) {
+                pthread_mutex_unlock(&s->lock);
+                deadlines[0] = deadlines[1] = 0;
+                return copies;
+        }
+
+        if (s->heap_len + copies > s->limit) {
+                s->stat_overflow += 1;
+                pthread_mutex_unlock(&s->lock);
+                return 0;
+        }
+
+        time_ns_t now = get_time_in_ns();
+        time_ns_t deadline = now;
+        if (s->rate > 0) {
+                deadline = MAX(now, s->link_free);
+                s->link_free = deadline + (time_ns_t) len * 8 * NS_IN_SEC / s->rate;
+        }
+        if (chance(s, s->reorder)) {
+                s->stat_reordered += 1;
+                deadline += s->reorder_gap;
+        } else {
+                deadline += s->delay;
+                if (s->jitter > 0) {
+                        deadline += (time_ns_t) ((2.0 * next_drand(s) - 1.0) * s->jitter);
+                }
+                deadline = MAX(deadline, s->last_deadline); // jitter doesn't reorder
+                s->last_deadline = deadline;
+        }
+        pthread_mutex_unlock(&s->lock);
+
+        deadlines[0] = deadlines[1] = MAX(deadline, 1);
+        return copies;
+}
+
+void net_impair_push(struct net_impair *s, time_ns_t deadline, void *pkt)
+{
+        pthread_mutex_lock(&s->lock);
+        heap_push(s, (struct heap_item){ deadline, s->seq++, pkt });
+        // wake up the worker only if it sleeps for a later deadline
+        bool new_head = s->heap[0].pkt == pkt;
+        if (new_head) {
+                virtual_clock_wait_notify(&s->waiters);
+        }
+        pthread_mutex_unlock(&s->lock);
+        if (new_head) {
+                pthread_cond_signal(&s->cv);
+        }
+}
+
+/* vim: set expandtab sw=8 tw=120: */
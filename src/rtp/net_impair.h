@@ -0,0 +1,98 @@
+/**
+ * @file   rtp/net_impair.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Deterministic network impairment emulator used by net_udp to simulate
+ * packet loss (Gilbert-Elliott model), reordering, duplication, delay,
+ * jitter and a rate limit without external tools like tc-netem.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NET_IMPAIR_H_5C0E3A7B_1F3D_4E0B_9C8E_6B2A1D7F4E93
+#define NET_IMPAIR_H_5C0E3A7B_1F3D_4E0B_9C8E_6B2A1D7F4E93
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+#include "tv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NET_IMPAIR_MAX_COPIES 2 ///< original + duplicate
+
+struct net_impair;
+
+/**
+ * Callback delivering a delayed packet. Called from the impairment worker
+ * thread. The callback takes the ownership of pkt.
+ */
+typedef void (*net_impair_deliver_t)(void *udata, void *pkt);
+
+/**
+ * @param cfg      configuration string (see "help")
+ * @param name     name used in log messages (eg. "TX 5004")
+ * @param seed_off offset added to the configured seed so that multiple
+ *                 sockets sharing one configuration are not correlated
+ * @param deliver  callback to pass delayed packets to
+ * @returns        state, NULL on error or when help was requested
+ */
+struct net_impair *net_impair_init(const char *cfg, const char *name, uint64_t seed_off,
+                net_impair_deliver_t deliver, void *udata);
+void net_impair_done(struct net_impair *s);
+
+/**
+ * Decides fate of a packet of given length.
+ *
+ * @param[out] deadlines release times of individual copies, 0 means deliver
+ *                       immediately by the caller
+ * @returns    number of copies that should be delivered (0 if packet is lost)
+ */
+int net_impair_schedule(struct net_impair *s, int len, time_ns_t deadlines[NET_IMPAIR_MAX_COPIES]);
+/**
+ * Enqueues a packet to be delivered at deadline. Takes ownership of pkt
+ * (must be allocated by malloc()).
+ */
+void net_impair_push(struct net_impair *s, time_ns_t deadline, void *pkt);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined NET_IMPAIR_H_5C0E3A7B_1F3D_4E0B_9C8E_6B2A1D7F4E93
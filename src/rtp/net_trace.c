@@ -0,0 +1,270 @@
+/**
+ * @file   rtp/net_trace.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Trace file is a standard pcap file with nanosecond timestamps
+ * (magic 0xa1b23c4d) containing raw IPv4 packets. Timestamps are taken from a
+ * monotonic clock, so only their differences are meaningful.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "rtp/net_trace.h"
+#include "utils/macros.h"
+
+#define MOD_NAME "[net_trace] "
+#define PCAP_MAGIC_NSEC 0xa1b23c4dU
+#define LINKTYPE_IPV4 228
+#define IP_UDP_HDR_LEN 28
+#define SNAPLEN 65535
+
+struct pcap_hdr {
+        uint32_t magic_number;
+        uint16_t version_major;
+        uint16_t version_minor;
+        int32_t  thiszone;
+        uint32_t sigfigs;
+        uint32_t snaplen;
+        uint32_t network;
+};
+
+struct pcaprec_hdr {
+        uint32_t ts_sec;
+        uint32_t ts_nsec;
+        uint32_t incl_len;
+        uint32_t orig_len;
+};
+
+struct net_trace_writer {
+        FILE *file;
+        char *filename;
+        int refcount;
+        pthread_mutex_t lock;
+};
+
+struct net_trace_reader {
+        FILE *file;
+};
+
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct net_trace_writer *writer;
+
+time_ns_t net_trace_get_time(void)
+{
+#ifdef CLOCK_MONOTONIC
+        struct timespec ts = { 0, 0 };
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * NS_IN_SEC + ts.tv_nsec;
+#else
+        return get_time_in_ns();
+#endif
+}
+
+struct net_trace_writer *net_trace_writer_acquire(const char *filename)
+{
+        pthread_mutex_lock(&writer_lock);
+        if (writer != NULL) {
+                if (strcmp(writer->filename, filename) != 0) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Trace file %s already opened, cannot open %s!\n",
+                                        writer->filename, filename);
+                        pthread_mutex_unlock(&writer_lock);
+                        return NULL;
+                }
+                writer->refcount += 1;
+                pthread_mutex_unlock(&writer_lock);
+                return writer;
+        }
+        FILE *f = fopen(filename, "wb");
+        if (f == NULL) {
+                log_perror(LOG_LEVEL_ERROR, MOD_NAME "Cannot open trace file");
+                pthread_mutex_unlock(&writer_lock);
+                return NULL;
+        }
+        struct pcap_hdr hdr = { PCAP_MAGIC_NSEC, 2, 4, 0, 0, SNAPLEN, LINKTYPE_IPV4 };
+        if (fwrite(&hdr, sizeof hdr, 1, f) != 1) {
+                log_perror(LOG_LEVEL_ERROR, MOD_NAME "Cannot write trace file");
+                fclose(f);
+                pthread_mutex_unlock(&writer_lock);
+                return NULL;
+        }
+        writer = calloc(1, sizeof *writer);
+        writer->file = f;
+        writer->filename = strdup(filename);
+        writer->refcount = 1;
+        pthread_mutex_init(&writer->lock, NULL);
+        log_msg(LOG_LEVEL_NOTICE, MOD_NAME "Recording received packets to %s\n", filename);
+        struct net_trace_writer *ret = writer;
+        pthread_mutex_unlock(&writer_lock);
+        return ret;
+}
+
+void net_trace_writer_release(struct net_trace_writer *w)
+{
+        if (w == NULL) {
+                return;
+        }
+        pthread_mutex_lock(&writer_lock);
+        assert(w == writer);
+        if (--w->refcount == 0) {
+                fclose(w->file);
+                free(w->filename);
+                pthread_mutex_destroy(&w->lock);
+                free(w);
+                writer = NULL;
+        }
+        pthread_mutex_unlock(&writer_lock);
+}
+
+static uint16_t ip_checksum(const unsigned char *hdr, int len)
+{
+        uint32_t sum = 0;
+        for (int i = 0; i < len; i += 2) {
+                sum += (uint32_t) hdr[i] << 8U | hdr[i + 1];
+        }
+        while (sum >> 16U) {
+                sum = (sum & 0xFFFFU) + (sum >> 16U);
+        }
+        return ~sum;
+}
+
+void net_trace_write(struct net_trace_writer *w, time_ns_t ts, const struct sockaddr *src,
+                uint16_t dst_port, const char *data, int len)
+{
+        uint32_t src_addr = 0; // network order
+        uint16_t src_port = 0;
+        if (src != NULL && src->sa_family == AF_INET) {
+                src_addr = ((const struct sockaddr_in *)(const void *) src)->sin_addr.s_addr;
+                src_port = ((const struct sockaddr_in *)(const void *) src)->sin_port;
+        } else if (src != NULL && src->sa_family == AF_INET6) {
+                const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)(const void *) src;
+                if (IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr)) {
+                        memcpy(&src_addr, &sin6->sin6_addr.s6_addr[12], sizeof src_addr);
+                }
+                src_port = sin6->sin6_port;
+        }
+        len = MIN(len, SNAPLEN - IP_UDP_HDR_LEN);
+
+        unsigned char hdr[IP_UDP_HDR_LEN] = { 0x45, 0 };
+        uint16_t ip_len = htons(len + IP_UDP_HDR_LEN);
+        memcpy(hdr + 2, &ip_len, 2);
+        hdr[8] = 64; // TTL
+        hdr[9] = IPPROTO_UDP;
+        memcpy(hdr + 12, &src_addr, 4);
+        uint32_t dst_addr = htonl(INADDR_LOOPBACK);
+        memcpy(hdr + 16, &dst_addr, 4);
+        uint16_t csum = htons(ip_checksum(hdr, 20));
+        memcpy(hdr + 10, &csum, 2);
+        memcpy(hdr + 20, &src_port, 2);
+        uint16_t port = htons(dst_port);
+        memcpy(hdr + 22, &port, 2);
+        uint16_t udp_len = htons(len + 8);
+        memcpy(hdr + 24, &udp_len, 2); // UDP checksum 0 = none
+
+        struct pcaprec_hdr rec = { ts / NS_IN_SEC, ts % NS_IN_SEC, len + IP_UDP_HDR_LEN, len + IP_UDP_HDR_LEN };
+        pthread_mutex_lock(&w->lock);
+        fwrite(&rec, sizeof rec, 1, w->file);
+        fwrite(hdr, sizeof hdr, 1, w->file);
+        fwrite(data, len, 1, w->file);
+        pthread_mutex_unlock(&w->lock);
+}
+
+struct net_trace_reader *net_trace_reader_init(const char *filename)
+{
+        FILE *f = fopen(filename, "rb");
+        if (f == NULL) {
+                log_perror(LOG_LEVEL_ERROR, MOD_NAME "Cannot open trace file");
+                return NULL;
+        }
+        struct pcap_hdr hdr;
+        if (fread(&hdr, sizeof hdr, 1, f) != 1 || hdr.magic_number != PCAP_MAGIC_NSEC ||
+                        hdr.network != LINKTYPE_IPV4) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "%s is not a trace recorded by UltraGrid!\n", filename);
+                fclose(f);
+                return NULL;
+        }
+        struct net_trace_reader *r = calloc(1, sizeof *r);
+        r->file = f;
+        return r;
+}
+
+void net_trace_reader_done(struct net_trace_reader *r)
+{
+        if (r == NULL) {
+                return;
+        }
+        fclose(r->file);
+        free(r);
+}
+
+int net_trace_read(struct net_trace_reader *r, time_ns_t *ts, struct sockaddr_in *src,
+                uint16_t *dst_port, char *buf, int buflen)
+{
+        struct pcaprec_hdr rec;
+        unsigned char hdr[IP_UDP_HDR_LEN];
+        if (fread(&rec, sizeof rec, 1, r->file) != 1) {
+                return feof(r->file) ? 0 : -1;
+        }
+        if (rec.incl_len < IP_UDP_HDR_LEN || rec.incl_len - IP_UDP_HDR_LEN > (unsigned) buflen
+                        || fread(hdr, sizeof hdr, 1, r->file) != 1) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Malformed trace record!\n");
+                return -1;
+        }
+        int len = rec.incl_len - IP_UDP_HDR_LEN;
+        if (fread(buf, len, 1, r->file) != 1) {
+                return -1;
+        }
+        *ts = rec.ts_sec * NS_IN_SEC + rec.ts_nsec;
+        memset(src, 0, sizeof *src);
+        src->sin_family = AF_INET;
+        memcpy(&src->sin_addr.s_addr, hdr + 12, 4);
+        memcpy(&src->sin_port, hdr + 20, 2);
+        uint16_t port = 0;
+        memcpy(&port, hdr + 22, 2);
+        *dst_port = ntohs(port);
+        return len;
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -0,0 +1,93 @@
+/**
+ * @file   rtp/net_trace.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Recording of received UDP datagrams to a pcap file and reading them back
+ * for an offline replay.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NET_TRACE_H_0B8E52D6_7A4C_4C21_B3F1_2E96A8D0C5F7
+#define NET_TRACE_H_0B8E52D6_7A4C_4C21_B3F1_2E96A8D0C5F7
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif // HAVE_CONFIG_H
+
+#include "tv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct net_trace_writer;
+struct net_trace_reader;
+
+/**
+ * Returns a writer for the file. The writer is shared by all sockets
+ * using the same file (and refcounted), only one file can be open at a time.
+ */
+struct net_trace_writer *net_trace_writer_acquire(const char *filename);
+void net_trace_writer_release(struct net_trace_writer *w);
+/**
+ * Records a datagram. Records are stored as raw IPv4 (LINKTYPE_IPV4) with
+ * synthesized IP/UDP headers so that the file can be examined with Wireshark.
+ *
+ * @param ts       monotonic arrival timestamp (see net_trace_get_time())
+ * @param src      source address (IPv4 or v4-mapped IPv6 is kept, others are
+ *                 recorded as 0.0.0.0)
+ * @param dst_port receiving port
+ */
+void net_trace_write(struct net_trace_writer *w, time_ns_t ts, const struct sockaddr *src,
+                uint16_t dst_port, const char *data, int len);
+
+struct net_trace_reader *net_trace_reader_init(const char *filename);
+void net_trace_reader_done(struct net_trace_reader *r);
+/**
+ * @param[out] src      source address (IPv4)
+ * @param[out] dst_port recorded receiving port
+ * @returns length of the datagram, 0 on EOF, -1 on error
+ */
+int net_trace_read(struct net_trace_reader *r, time_ns_t *ts, struct sockaddr_in *src,
+                uint16_t *dst_port, char *buf, int buflen);
+
+time_ns_t net_trace_get_time(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined NET_TRACE_H_0B8E52D6_7A4C_4C21_B3F1_2E96A8D0C5F7
@@ -50,6 +50,14 @@
 
 #include <pthread.h>
 #include <stdalign.h>
+#include <stdatomic.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#endif
 
 #include "debug.h"
 #include "host.h"
@@ -58,11 +66,15 @@
 #include "compat/vsnprintf.h"
 #include "net_udp.h"
 #include "rtp.h"
+#include "rtp/net_impair.h"
+#include "rtp/net_trace.h"
 #include "utils/list.h"
 #include "utils/macros.h"
 #include "utils/misc.h"
 #include "utils/net.h"
 #include "utils/thread.h"
+#include "tv.h"
+#include "utils/virtual_clock.h"
 #include "utils/windows.h"
 
 #ifdef NEED_ADDRINFO_H
@@ -70,9 +82,11 @@
 #endif
 
 #define DEFAULT_MAX_UDP_READER_QUEUE_LEN (1920/3*8*1080/1152) //< 10-bit FullHD frame divided by 1280 MTU packets (minus headers)
+#define UDP_TS_TX_RING 4096 ///< sent datagrams kept for matching with TX timestamps
 
 static int resolve_address(socket_udp *s, const char *addr, uint16_t tx_port);
 static void *udp_reader(void *arg);
+static void *udp_replay_reader(void *arg);
 
 #define IPv4	4
 #define IPv6	6
@@ -130,6 +144,7 @@ struct item {
     int size;
     struct sockaddr *src_addr;
     socklen_t addrlen;
+    time_ns_t rx_ts; ///< kernel RX timestamp (CLOCK_REALTIME), 0 if not available
 };
 
 #define ALIGNED_SOCKADDR_STORAGE_OFF ((RTP_MAX_PACKET_LEN + alignof(struct sockaddr_storage) - 1) / alignof(struct sockaddr_storage) * alignof(struct sockaddr_storage))
@@ -155,10 +170,39 @@ struct socket_udp_local {
         unsigned int max_packets;
         pthread_mutex_t lock;
         pthread_cond_t boss_cv;
+        struct virtual_clock_waiters boss_waiters;
         pthread_cond_t reader_cv;
 
         bool should_exit;
         fd_t should_exit_fd[2];
+
+        // network impairment emulation (testing only)
+        struct net_impair *impair_tx;
+        struct net_impair *impair_rx;
+
+        // packet trace recording/replay
+        uint16_t rx_port;
+        struct net_trace_writer *trace;
+        struct net_trace_reader *replay;
+        uint16_t replay_port;
+        bool replay_fast;
+        bool replay_exit;
+
+        // kernel packet timestamping (multithreaded sockets only), stats
+        // are updated by udp_reader() which also drains TX timestamps
+        _Atomic int timestamping; ///< enum udp_timestamping
+        struct udp_ts_stats ts_stats; ///< guarded by lock
+        time_ns_t last_rx_ts[UDP_TS_MAX_STREAMS]; ///< indexed as ts_stats.streams
+        time_ns_t last_tx_ts[UDP_TS_MAX_STREAMS];
+        bool ts_streams_exceeded;
+        _Atomic uint32_t tx_ts_id; ///< SOF_TIMESTAMPING_OPT_ID of the next sent datagram
+        struct udp_tx_ts_slot *tx_sent; ///< [UDP_TS_TX_RING] sent datagrams indexed by the ID
+};
+
+/// sent datagram awaiting its TX timestamp
+struct udp_tx_ts_slot {
+        _Atomic time_ns_t intended; ///< intended send time (deadline or send call time)
+        _Atomic long long ssrc; ///< -1 if not an RTP datagram
 };
 
 /*
@@ -171,6 +215,7 @@ struct _socket_udp {
 
         struct socket_udp_local *local;
         bool local_is_slave; // whether is the local
+        time_ns_t tx_deadline; ///< set by udp_set_tx_deadline(), consumed by the next send
 
 #ifdef _WIN32
         WSAOVERLAPPED *overlapped;
@@ -182,7 +227,16 @@ struct _socket_udp {
 #endif
 };
 
+/// packet delayed by TX impairment emulator
+struct impair_tx_pkt {
+        struct sockaddr_storage dst;
+        socklen_t dst_len;
+        int len;
+        char data[];
+};
+
 static void udp_clean_async_state(socket_udp *s);
+static bool udp_reader_enqueue(struct socket_udp_local *l, uint8_t *packet);
 
 #ifdef _WIN32
 /* Want to use both Winsock 1 and 2 socket options, but since
@@ -761,6 +815,112 @@ static bool set_sock_opts_and_bind(fd_t fd, bool ipv6, uint16_t rx_port, int ttl
         return true;
 }
 
+static void udp_impair_tx_deliver(void *udata, void *pkt)
+{
+        struct socket_udp_local *l = udata;
+        struct impair_tx_pkt *p = pkt;
+        sendto(l->tx_fd, p->data, p->len, 0, (struct sockaddr *) &p->dst, p->dst_len);
+        free(p);
+}
+
+static void udp_impair_rx_deliver(void *udata, void *pkt)
+{
+        udp_reader_enqueue(udata, pkt);
+}
+
+ADD_TO_PARAM("udp-impair-rx",
+                "* udp-impair-rx=<cfg>|help\n"
+                "  Emulate network impairments (loss, delay, reordering...) on received packets.\n"
+                "  Delay and duplication is applied only to multithreaded sockets (RTP).\n");
+ADD_TO_PARAM("udp-impair-tx",
+                "* udp-impair-tx=<cfg>|help\n"
+                "  Emulate network impairments (loss, delay, reordering...) on sent packets.\n");
+static bool udp_init_impair(struct socket_udp_local *l, uint16_t rx_port)
+{
+        char name[64];
+        const char *cfg = NULL;
+        if ((cfg = get_commandline_param("udp-impair-rx")) != NULL) {
+                snprintf(name, sizeof name, "RX %d", rx_port);
+                if ((l->impair_rx = net_impair_init(cfg, name, 2 * rx_port, udp_impair_rx_deliver, l)) == NULL) {
+                        return false;
+                }
+        }
+        if ((cfg = get_commandline_param("udp-impair-tx")) != NULL) {
+                snprintf(name, sizeof name, "TX %d", rx_port);
+                if ((l->impair_tx = net_impair_init(cfg, name, 2 * rx_port + 1, udp_impair_tx_deliver, l)) == NULL) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+static int udp_sendto_impaired(struct socket_udp_local *l, const char *buffer, int buflen,
+                const struct sockaddr *dst_addr, socklen_t addrlen)
+{
+        time_ns_t deadlines[NET_IMPAIR_MAX_COPIES];
+        int copies = net_impair_schedule(l->impair_tx, buflen, deadlines);
+        for (int i = 0; i < copies; ++i) {
+                if (deadlines[i] == 0) {
+                        sendto(l->tx_fd, buffer, buflen, 0, dst_addr, addrlen);
+                        continue;
+                }
+                struct impair_tx_pkt *pkt = malloc(sizeof *pkt + buflen);
+                memcpy(&pkt->dst, dst_addr, addrlen);
+                pkt->dst_len = addrlen;
+                pkt->len = buflen;
+                memcpy(pkt->data, buffer, buflen);
+                net_impair_push(l->impair_tx, deadlines[i], pkt);
+        }
+        return buflen;
+}
+
+ADD_TO_PARAM("udp-trace-rx",
+                "* udp-trace-rx=<file>\n"
+                "  Record all received datagrams with arrival timestamps to a pcap file (replay with udp-replay).\n");
+ADD_TO_PARAM("udp-replay",
+                "* udp-replay=<file>[:fast][:port=<p>][:exit]\n"
+                "  Feed packets recorded with udp-trace-rx to multithreaded (RTP) receiving sockets instead\n"
+                "  of network, either with original timing or as fast as possible (fast). Only packets\n"
+                "  recorded for the socket port (or <p>) are replayed, exit - exit when done.\n");
+static bool udp_init_trace(struct socket_udp_local *l)
+{
+        const char *cfg = NULL;
+        if ((cfg = get_commandline_param("udp-trace-rx")) != NULL) {
+                if ((l->trace = net_trace_writer_acquire(cfg)) == NULL) {
+                        return false;
+                }
+        }
+        if ((cfg = get_commandline_param("udp-replay")) == NULL || !l->multithreaded) {
+                return true;
+        }
+        char *tmp = strdupa(cfg);
+        char *item = NULL;
+        char *save_ptr = NULL;
+        const char *filename = NULL;
+        l->replay_port = l->rx_port;
+        while ((item = strtok_r(tmp, ":", &save_ptr)) != NULL) {
+                tmp = NULL;
+                if (filename == NULL) {
+                        filename = item;
+                } else if (strcmp(item, "fast") == 0) {
+                        l->replay_fast = true;
+                } else if (strcmp(item, "exit") == 0) {
+                        l->replay_exit = true;
+                } else if (strstr(item, "port=") == item) {
+                        l->replay_port = atoi(strchr(item, '=') + 1);
+                } else {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Unknown replay option: %s\n", item);
+                        return false;
+                }
+        }
+        if (filename == NULL || (l->replay = net_trace_reader_init(filename)) == NULL) {
+                return false;
+        }
+        log_msg(LOG_LEVEL_NOTICE, MOD_NAME "Replaying packets for port %d from %s%s\n", l->replay_port, filename,
+                        l->replay_fast ? " (as fast as possible)" : "");
+        return true;
+}
+
 ADD_TO_PARAM("udp-queue-len",
                 "* udp-queue-len=<l>\n"
                 "  Use different queue size than default DEFAULT_MAX_UDP_READER_QUEUE_LEN\n");
@@ -887,15 +1047,27 @@ socket_udp *udp_init_if(const char *addr, const char *iface, uint16_t rx_port,
                 abort();
         }
 
+        if (!udp_init_impair(s->local, rx_port)) {
+                goto error;
+        }
+        s->local->rx_port = udp_get_udp_rx_port(s);
         s->local->multithreaded = multithreaded;
+        if (!udp_init_trace(s->local)) {
+                s->local->multithreaded = false;
+                goto error;
+        }
         if (multithreaded) {
                 if (!get_commandline_param("udp-queue-len")) {
                         s->local->max_packets = DEFAULT_MAX_UDP_READER_QUEUE_LEN;
                 } else {
                         s->local->max_packets = atoi(get_commandline_param("udp-queue-len"));
                 }
+                const char *ts_mode = get_commandline_param("udp-timestamping");
+                if (ts_mode != NULL && s->local->replay == NULL) {
+                        udp_set_timestamping(s, strcmp(ts_mode, "hw") == 0 ? UDP_TS_HW : UDP_TS_SW);
+                }
                 platform_pipe_init(s->local->should_exit_fd);
-                pthread_create(&s->local->thread_id, NULL, udp_reader, s);
+                pthread_create(&s->local->thread_id, NULL, s->local->replay ? udp_replay_reader : udp_reader, s);
         }
 
         return s;
@@ -905,6 +1077,136 @@ error:
         return NULL;
 }
 
+/**
+ * Creates a send-only socket with the TTL and send buffer of s, bound to an
+ * ephemeral port (and to the interface iface if given), sending to dst.
+ */
+static socket_udp *udp_init_tx_sibling(socket_udp *s, const struct sockaddr_storage *dst,
+                socklen_t dst_len, int mode, const char *iface)
+{
+        if (s->local->impair_tx != NULL) {
+                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Multi-socket sending cannot be used with TX impairment.\n");
+                return NULL;
+        }
+        int ttl = -1;
+        socklen_t ttl_len = sizeof ttl;
+        if (GETSOCKOPT(s->local->tx_fd, s->local->mode == IPv6 ? IPPROTO_IPV6 : IPPROTO_IP,
+                                s->local->mode == IPv6 ? IPV6_UNICAST_HOPS : IP_TTL,
+                                (sockopt_t) &ttl, &ttl_len) != 0) {
+                ttl = -1;
+        }
+
+        socket_udp *stripe = (socket_udp *) calloc(1, sizeof *stripe);
+        stripe->local = (struct socket_udp_local *) calloc(1, sizeof(*stripe->local));
+        stripe->local->packets = simple_linked_list_init();
+        pthread_mutex_init(&stripe->local->lock, NULL);
+        pthread_cond_init(&stripe->local->boss_cv, NULL);
+        pthread_cond_init(&stripe->local->reader_cv, NULL);
+        stripe->local->mode = mode;
+        memcpy(&stripe->sock, dst, dst_len);
+        stripe->sock_len = dst_len;
+        stripe->ifindex = s->ifindex;
+
+        stripe->local->rx_fd = stripe->local->tx_fd = socket(stripe->sock.ss_family, SOCK_DGRAM, 0);
+        if (stripe->local->tx_fd == INVALID_SOCKET) {
+                socket_error("Unable to initialize socket");
+                goto error;
+        }
+        if (iface != NULL) {
+                if ((stripe->ifindex = if_nametoindex(iface)) == 0) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Unknown interface %s\n", iface);
+                        goto error;
+                }
+#ifdef SO_BINDTODEVICE
+                if (SETSOCKOPT(stripe->local->tx_fd, SOL_SOCKET, SO_BINDTODEVICE, iface, strlen(iface)) != 0) {
+                        socket_error("setsockopt SO_BINDTODEVICE %s", iface);
+                        goto error;
+                }
+#elif defined IP_BOUND_IF
+                if (SETSOCKOPT(stripe->local->tx_fd, mode == IPv6 ? IPPROTO_IPV6 : IPPROTO_IP,
+                                        mode == IPv6 ? IPV6_BOUND_IF : IP_BOUND_IF,
+                                        &stripe->ifindex, sizeof stripe->ifindex) != 0) {
+                        socket_error("setsockopt IP_BOUND_IF %s", iface);
+                        goto error;
+                }
+#else
+                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Binding to interface not supported, using routing table for %s.\n", iface);
+#endif
+        }
+        if (!set_sock_opts_and_bind(stripe->local->tx_fd, stripe->local->mode == IPv6, 0, ttl)) {
+                goto error;
+        }
+        if (stripe->local->mode == IPv4 &&
+                        !udp_join_mcast_grp4(((struct sockaddr_in *)&stripe->sock)->sin_addr.s_addr,
+                                stripe->local->rx_fd, stripe->local->tx_fd, ttl, stripe->ifindex)) {
+                goto error;
+        }
+        if (stripe->local->mode == IPv6 &&
+                        !udp_join_mcast_grp6(((struct sockaddr_in6 *)&stripe->sock)->sin6_addr,
+                                stripe->local->rx_fd, stripe->local->tx_fd, ttl, stripe->ifindex)) {
+                goto error;
+        }
+        int sndbuf = 0;
+        socklen_t sndbuf_len = sizeof sndbuf;
+        if (GETSOCKOPT(s->local->tx_fd, SOL_SOCKET, SO_SNDBUF, (sockopt_t) &sndbuf, &sndbuf_len) == 0) {
+                SETSOCKOPT(stripe->local->tx_fd, SOL_SOCKET, SO_SNDBUF, (char *) &sndbuf, sizeof sndbuf);
+        }
+        return stripe;
+error:
+        udp_exit(stripe);
+        return NULL;
+}
+
+/**
+ * Creates a send-only socket to be used with udp_sendv_stripe() in parallel
+ * with the socket s. The socket has its own file descriptor bound to an
+ * ephemeral port so that the streams from multiple stripes are distinguished
+ * by the source port (and thus may be spread by RSS across NIC queues).
+ *
+ * @returns NULL if the socket cannot be created or s uses TX impairment
+ */
+socket_udp *udp_init_tx_stripe(socket_udp *s)
+{
+        return udp_init_tx_sibling(s, &s->sock, s->sock_len, s->local->mode, NULL);
+}
+
+/**
+ * Creates a send-only socket as udp_init_tx_stripe() but with an own
+ * destination addr (with the same port as s) and optionally bound to the
+ * interface iface. Used for sending one stream over multiple network paths.
+ */
+socket_udp *udp_init_tx_path(socket_udp *s, const char *addr, const char *iface)
+{
+        struct sockaddr_storage dst;
+        socklen_t dst_len = 0;
+        int mode = s->local->mode == IPv4 ? IPv4 : 0;
+        if (resolve_addrinfo(addr, udp_get_tx_port(s), &dst, &dst_len, &mode) != 0) {
+                return NULL;
+        }
+        return udp_init_tx_sibling(s, &dst, dst_len, mode, iface);
+}
+
+/// sends to the destination of s but to another port (eg. RTCP)
+int udp_send_to_port(socket_udp *s, char *buffer, int buflen, uint16_t port)
+{
+        struct sockaddr_storage dst;
+        memcpy(&dst, &s->sock, s->sock_len);
+        if (dst.ss_family == AF_INET) {
+                ((struct sockaddr_in *) &dst)->sin_port = htons(port);
+        } else {
+                ((struct sockaddr_in6 *) &dst)->sin6_port = htons(port);
+        }
+        return sendto(s->local->tx_fd, buffer, buflen, 0, (struct sockaddr *) &dst, s->sock_len);
+}
+
+/// @returns destination port of the socket
+uint16_t udp_get_tx_port(socket_udp *s)
+{
+        return ntohs(s->sock.ss_family == AF_INET ?
+                        ((struct sockaddr_in *) &s->sock)->sin_port :
+                        ((struct sockaddr_in6 *) &s->sock)->sin6_port);
+}
+
 /// @returns true if the socket was initialize with
 ///               IN6_BLACKHOLE_SERVER_MODE_STR
 bool
@@ -964,6 +1266,318 @@ void udp_fd_zero_r(struct udp_fd_r *fd_struct)
         fd_struct->max_fd = 0;
 }
 
+#if defined __linux__ && defined SO_TIMESTAMPING
+static time_ns_t get_realtime_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return ts.tv_sec * NS_IN_SEC + ts.tv_nsec;
+}
+
+/// @returns histogram bucket for the interval, see struct udp_ts_stats
+static int ts_hist_bucket(time_ns_t interval)
+{
+        long long us = interval / NS_IN_US;
+        int bucket = 0;
+        while (us > 0 && bucket < UDP_TS_HIST_BUCKETS - 1) {
+                us >>= 1;
+                bucket += 1;
+        }
+        return bucket;
+}
+
+/// @returns timestamp from SCM_TIMESTAMPING control message (HW if present), 0 if none
+static time_ns_t udp_cmsg_timestamp(struct msghdr *msg)
+{
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm)) {
+                if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_TIMESTAMPING) {
+                        continue;
+                }
+                struct scm_timestamping tss;
+                memcpy(&tss, CMSG_DATA(cm), sizeof tss);
+                const struct timespec *ts = tss.ts[2].tv_sec != 0 || tss.ts[2].tv_nsec != 0 ? &tss.ts[2] : &tss.ts[0];
+                return ts->tv_sec * NS_IN_SEC + ts->tv_nsec;
+        }
+        return 0;
+}
+
+/// @returns SSRC of an RTP datagram, -1 if not RTP (or if RTCP)
+static long long udp_rtp_ssrc(const char *buf, int len)
+{
+        if (len < 12 || ((unsigned char) buf[0] >> 6) != 2) {
+                return -1;
+        }
+        const int pt = buf[1] & 0x7F;
+        if (pt >= 72 && pt <= 76) { // RTCP SR..APP multiplexed on the port (RFC 5761)
+                return -1;
+        }
+        uint32_t ssrc = 0;
+        memcpy(&ssrc, buf + 8, sizeof ssrc);
+        return ntohl(ssrc);
+}
+
+/**
+ * @returns stats of the stream, NULL if the stream count is exceeded
+ * @note to be called with lock held
+ */
+static struct udp_ts_stream_stats *udp_ts_stream(struct socket_udp_local *l, uint32_t ssrc, int *idx)
+{
+        struct udp_ts_stats *st = &l->ts_stats;
+        for (*idx = 0; *idx < st->stream_count; ++*idx) {
+                if (st->streams[*idx].ssrc == ssrc) {
+                        return &st->streams[*idx];
+                }
+        }
+        if (st->stream_count == UDP_TS_MAX_STREAMS) {
+                if (!l->ts_streams_exceeded) {
+                        MSG(WARNING, "More than %d streams on port %d, not timestamping SSRC 0x%08" PRIx32 ".\n",
+                                        UDP_TS_MAX_STREAMS, (int) l->rx_port, ssrc);
+                        l->ts_streams_exceeded = true;
+                }
+                return NULL;
+        }
+        *idx = st->stream_count++;
+        st->streams[*idx].ssrc = ssrc;
+        return &st->streams[*idx];
+}
+
+/**
+ * Processes TX completion timestamps from the socket error queue. The
+ * timestamps are matched to the sent datagrams by SOF_TIMESTAMPING_OPT_ID.
+ */
+static void udp_drain_tx_timestamps(struct socket_udp_local *l)
+{
+        char control[256];
+
+        while (1) {
+                struct msghdr msg = { .msg_control = control, .msg_controllen = sizeof control };
+                if (recvmsg(l->tx_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                        return;
+                }
+                const time_ns_t ts = udp_cmsg_timestamp(&msg);
+                bool have_id = false;
+                uint32_t id = 0;
+                for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+                        if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                                        (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+                                struct sock_extended_err err;
+                                memcpy(&err, CMSG_DATA(cm), sizeof err);
+                                if (err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                                        id = err.ee_data;
+                                        have_id = true;
+                                }
+                        }
+                }
+                if (ts == 0 || !have_id) {
+                        continue;
+                }
+                const struct udp_tx_ts_slot *slot = &l->tx_sent[id % UDP_TS_TX_RING];
+                const long long ssrc = atomic_load(&slot->ssrc);
+                if (ssrc < 0) {
+                        continue;
+                }
+                const time_ns_t lateness = ts - atomic_load(&slot->intended);
+                int idx = 0;
+                pthread_mutex_lock(&l->lock);
+                struct udp_ts_stream_stats *st = udp_ts_stream(l, ssrc, &idx);
+                if (st != NULL) {
+                        st->tx_count += 1;
+                        st->tx_lateness_sum += lateness;
+                        st->tx_lateness_max = st->tx_count == 1 ? lateness : MAX(st->tx_lateness_max, lateness);
+                        if (l->last_tx_ts[idx] != 0) {
+                                st->tx_interdeparture[ts_hist_bucket(ts - l->last_tx_ts[idx])] += 1;
+                        }
+                        l->last_tx_ts[idx] = ts;
+                }
+                pthread_mutex_unlock(&l->lock);
+        }
+}
+
+static void udp_account_rx_timestamp(struct socket_udp_local *l, time_ns_t ts, const char *buf, int len)
+{
+        const long long ssrc = udp_rtp_ssrc(buf, len);
+        if (ssrc < 0) {
+                return;
+        }
+        const time_ns_t delay = get_realtime_ns() - ts;
+        int idx = 0;
+        pthread_mutex_lock(&l->lock);
+        struct udp_ts_stream_stats *st = udp_ts_stream(l, ssrc, &idx);
+        if (st != NULL) {
+                st->rx_count += 1;
+                st->rx_queue_delay_sum += delay;
+                st->rx_queue_delay_max = MAX(st->rx_queue_delay_max, delay);
+                if (l->last_rx_ts[idx] != 0) {
+                        st->rx_interarrival[ts_hist_bucket(ts - l->last_rx_ts[idx])] += 1;
+                }
+                l->last_rx_ts[idx] = ts;
+        }
+        pthread_mutex_unlock(&l->lock);
+}
+
+/**
+ * Records intended send time of the datagram (deadline set by
+ * udp_set_tx_deadline() or the send call time) and its stream to be matched
+ * with the TX timestamp. May be called concurrently with
+ * udp_drain_tx_timestamps() from the reader.
+ *
+ * @param hdr  first buffer of the datagram (containing the RTP header)
+ */
+static inline void udp_tx_ts_account(socket_udp *s, const char *hdr, int hdr_len)
+{
+        const time_ns_t deadline = s->tx_deadline;
+        s->tx_deadline = 0;
+        struct socket_udp_local *l = s->local;
+        if (l->timestamping != UDP_TS_NONE) {
+                const uint32_t id = atomic_fetch_add(&l->tx_ts_id, 1);
+                struct udp_tx_ts_slot *slot = &l->tx_sent[id % UDP_TS_TX_RING];
+                atomic_store(&slot->intended, deadline != 0 ? deadline : get_realtime_ns());
+                atomic_store(&slot->ssrc, udp_rtp_ssrc(hdr, hdr_len));
+        }
+}
+
+/**
+ * Tries to enable HW timestamping on the NIC. Requires the interface to be
+ * known (multicast interface) and CAP_NET_ADMIN, otherwise the NIC needs to be
+ * configured externally (eg. with hwstamp_ctl).
+ */
+static void udp_enable_hw_timestamping(socket_udp *s)
+{
+        char ifname[IF_NAMESIZE];
+        if (s->ifindex == 0 || if_indextoname(s->ifindex, ifname) == NULL) {
+                MSG(WARNING, "Interface not given, HW timestamping must be enabled on the NIC externally.\n");
+                return;
+        }
+        struct hwtstamp_config cfg = { .tx_type = HWTSTAMP_TX_ON, .rx_filter = HWTSTAMP_FILTER_ALL };
+        struct ifreq ifr;
+        memset(&ifr, 0, sizeof ifr);
+        snprintf(ifr.ifr_name, sizeof ifr.ifr_name, "%s", ifname);
+        ifr.ifr_data = (void *) &cfg;
+        if (ioctl(s->local->rx_fd, SIOCSHWTSTAMP, &ifr) != 0) {
+                MSG(WARNING, "Cannot enable HW timestamping on %s: %s\n", ifname, ug_strerror(errno));
+        }
+}
+
+static void udp_print_ts_stats(struct socket_udp_local *l)
+{
+        for (int n = 0; n < l->ts_stats.stream_count; ++n) {
+                const struct udp_ts_stream_stats *st = &l->ts_stats.streams[n];
+                char rx_hist[1024] = "";
+                char tx_hist[1024] = "";
+                for (int i = 0; i < UDP_TS_HIST_BUCKETS; ++i) {
+                        const char *lt = i == 0 ? "<" : i == UDP_TS_HIST_BUCKETS - 1 ? ">=" : "";
+                        const int bound = i == 0 ? 1 : 1 << (i - 1);
+                        if (st->rx_interarrival[i] > 0) {
+                                snprintf(rx_hist + strlen(rx_hist), sizeof rx_hist - strlen(rx_hist), " %s%dus:%llu", lt, bound, st->rx_interarrival[i]);
+                        }
+                        if (st->tx_interdeparture[i] > 0) {
+                                snprintf(tx_hist + strlen(tx_hist), sizeof tx_hist - strlen(tx_hist), " %s%dus:%llu", lt, bound, st->tx_interdeparture[i]);
+                        }
+                }
+                if (st->rx_count > 0) {
+                        MSG(INFO, "Port %d SSRC 0x%08" PRIx32 " RX: %llu packets timestamped, socket queue delay avg %.1f us, max %.1f us\n"
+                                        "\tinter-arrival:%s\n", (int) l->rx_port, st->ssrc, st->rx_count,
+                                        (double) st->rx_queue_delay_sum / st->rx_count / NS_IN_US,
+                                        (double) st->rx_queue_delay_max / NS_IN_US, rx_hist);
+                }
+                if (st->tx_count > 0) {
+                        MSG(INFO, "Port %d SSRC 0x%08" PRIx32 " TX: %llu packets timestamped, sent after intended time avg %.1f us, max %.1f us\n"
+                                        "\tinter-departure:%s\n", (int) l->rx_port, st->ssrc, st->tx_count,
+                                        (double) st->tx_lateness_sum / st->tx_count / NS_IN_US,
+                                        (double) st->tx_lateness_max / NS_IN_US, tx_hist);
+                }
+        }
+}
+#else
+static inline void udp_tx_ts_account(socket_udp *s, const char *hdr, int hdr_len)
+{
+        s->tx_deadline = 0;
+        UNUSED(hdr), UNUSED(hdr_len);
+}
+#endif // defined SO_TIMESTAMPING
+
+/**
+ * Enables kernel timestamping of the packets (SO_TIMESTAMPING). The RX
+ * timestamps are returned by udp_recv_data_ts(). Per-stream statistics of RX
+ * and TX timestamps can be obtained by udp_get_ts_stats() and are printed on
+ * exit.
+ *
+ * @note supported only for multithreaded sockets on Linux
+ */
+bool udp_set_timestamping(socket_udp *s, enum udp_timestamping mode)
+{
+#if defined __linux__ && defined SO_TIMESTAMPING
+        struct socket_udp_local *l = s->local;
+        if (!l->multithreaded) {
+                MSG(WARNING, "Timestamping is supported only for multithreaded sockets.\n");
+                return false;
+        }
+        int flags = 0;
+        if (mode != UDP_TS_NONE) {
+                flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                        SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID |
+                        SOF_TIMESTAMPING_OPT_TSONLY;
+        }
+        if (mode == UDP_TS_HW) {
+                flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE |
+                        SOF_TIMESTAMPING_RAW_HARDWARE;
+                udp_enable_hw_timestamping(s);
+        }
+        if (mode != UDP_TS_NONE && l->tx_sent == NULL) {
+                l->tx_sent = (struct udp_tx_ts_slot *) calloc(UDP_TS_TX_RING, sizeof *l->tx_sent);
+                if (l->tx_sent == NULL) {
+                        MSG(ERROR, "Cannot allocate TX timestamp ring!\n");
+                        return false;
+                }
+        }
+        l->timestamping = UDP_TS_NONE;
+        l->tx_ts_id = 0; // OPT_ID counter is reset when the option is set
+        if (setsockopt(l->rx_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof flags) != 0 ||
+                        (l->tx_fd != l->rx_fd &&
+                         setsockopt(l->tx_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof flags) != 0)) {
+                socket_error("setsockopt SO_TIMESTAMPING");
+                return false;
+        }
+        l->timestamping = mode;
+        return true;
+#else
+        UNUSED(s);
+        if (mode != UDP_TS_NONE) {
+                MSG(WARNING, "Kernel packet timestamping is not supported on this platform.\n");
+                return false;
+        }
+        return true;
+#endif
+}
+
+/// @retval false if timestamping is not enabled
+bool udp_get_ts_stats(socket_udp *s, struct udp_ts_stats *stats)
+{
+        if (s->local->timestamping == UDP_TS_NONE) {
+                return false;
+        }
+        pthread_mutex_lock(&s->local->lock);
+        *stats = s->local->ts_stats;
+        pthread_mutex_unlock(&s->local->lock);
+        return true;
+}
+
+/**
+ * Sets intended send time (pacing deadline, CLOCK_REALTIME) of the next
+ * datagram sent through the socket. Its TX timestamp is then compared with
+ * the deadline instead of the send call time, so that the statistics show
+ * how late the datagram actually left. To be called by the sending thread.
+ */
+void udp_set_tx_deadline(socket_udp *s, long long deadline_ns)
+{
+        s->tx_deadline = deadline_ns;
+}
+
+ADD_TO_PARAM("udp-timestamping", "* udp-timestamping=sw|hw\n"
+                "  Use kernel (sw) or NIC (hw) timestamps of received RTP packets (for jitter computation) and\n"
+                "  print per-stream packet timing statistics (inter-arrival, lateness to the pacing schedule)\n"
+                "  on exit (Linux only).\n");
+
 /**
  * udp_exit:
  * @s: UDP session to be terminated.
@@ -990,20 +1604,35 @@ void udp_exit(socket_udp * s)
                         char c = 0;
                         int ret = PLATFORM_PIPE_WRITE(s->local->should_exit_fd[1], &c, 1);
                         assert (ret == 1);
+                        pthread_mutex_lock(&s->local->lock);
                         s->local->should_exit = true;
-                        pthread_cond_signal(&s->local->reader_cv);
+                        pthread_mutex_unlock(&s->local->lock);
+                        pthread_cond_broadcast(&s->local->reader_cv);
                         pthread_join(s->local->thread_id, NULL);
+                        net_impair_done(s->local->impair_rx);
+                        s->local->impair_rx = NULL;
                         while (simple_linked_list_size(s->local->packets) > 0) {
                                 struct item *item = (struct item *) simple_linked_list_pop(s->local->packets);
                                 free(item->buf);
                         }
                         platform_pipe_close(s->local->should_exit_fd[1]);
+#if defined __linux__ && defined SO_TIMESTAMPING
+                        if (s->local->timestamping != UDP_TS_NONE) {
+                                udp_drain_tx_timestamps(s->local);
+                                udp_print_ts_stats(s->local);
+                        }
+#endif
                 }
+                net_impair_done(s->local->impair_rx);
+                net_impair_done(s->local->impair_tx);
+                net_trace_writer_release(s->local->trace);
+                net_trace_reader_done(s->local->replay);
                 CLOSESOCKET(s->local->rx_fd);
                 if (s->local->tx_fd != s->local->rx_fd) {
                         CLOSESOCKET(s->local->tx_fd);
                 }
                 simple_linked_list_destroy(s->local->packets);
+                free(s->local->tx_sent);
                 pthread_mutex_destroy(&s->local->lock);
                 pthread_cond_destroy(&s->local->boss_cv);
                 pthread_cond_destroy(&s->local->reader_cv);
@@ -1031,12 +1660,20 @@ int udp_send(socket_udp * s, char *buffer, int buflen)
         assert(buffer != NULL);
         assert(buflen > 0);
 
+        if (s->local->impair_tx) {
+                return udp_sendto_impaired(s->local, buffer, buflen, (struct sockaddr *) &s->sock, s->sock_len);
+        }
+        udp_tx_ts_account(s, buffer, buflen);
         return sendto(s->local->tx_fd, buffer, buflen, 0, (struct sockaddr *)&s->sock,
                       s->sock_len);
 }
 
 int udp_sendto(socket_udp * s, char *buffer, int buflen, struct sockaddr *dst_addr, socklen_t addrlen)
 {
+        if (s->local->impair_tx) {
+                return udp_sendto_impaired(s->local, buffer, buflen, dst_addr, addrlen);
+        }
+        udp_tx_ts_account(s, buffer, buflen);
         return sendto(s->local->tx_fd, buffer, buflen, 0, dst_addr, addrlen);
 }
 
@@ -1070,6 +1707,18 @@ int udp_sendv(socket_udp * s, struct iovec *vector, int count, void *d)
 
         assert(s != NULL);
 
+        if (s->local->impair_tx) {
+                char buffer[RTP_MAX_PACKET_LEN];
+                int len = 0;
+                for (int i = 0; i < count; ++i) {
+                        assert(len + vector[i].iov_len <= sizeof buffer);
+                        memcpy(buffer + len, vector[i].iov_base, vector[i].iov_len);
+                        len += vector[i].iov_len;
+                }
+                free(d);
+                return udp_sendto_impaired(s->local, buffer, len, (struct sockaddr *) &s->sock, s->sock_len);
+        }
+
         msg.msg_name = (void *) & s->sock;
         msg.msg_namelen = s->sock_len;
         msg.msg_iov = vector;
@@ -1079,12 +1728,123 @@ int udp_sendv(socket_udp * s, struct iovec *vector, int count, void *d)
         msg.msg_controllen = 0;
         msg.msg_flags = 0;
 
+        udp_tx_ts_account(s, vector[0].iov_base, vector[0].iov_len);
         int ret = sendmsg(s->local->tx_fd, &msg, 0);
         free(d);
         return ret;
 }
 #endif // _WIN32
 
+/**
+ * Sends the datagram through the stripe socket (see udp_init_tx_stripe()) to
+ * the current destination of s. Can be called concurrently for different
+ * stripes.
+ */
+#ifdef _WIN32
+int udp_sendv_stripe(socket_udp *s, socket_udp *stripe, LPWSABUF vector, int count)
+{
+        DWORD bytesSent;
+        int ret = WSASendTo(stripe->local->tx_fd, vector, count, &bytesSent, 0,
+                (struct sockaddr *) &s->sock, s->sock_len, NULL, NULL);
+        return ret == 0 ? (int) bytesSent : ret;
+}
+#else
+int udp_sendv_stripe(socket_udp *s, socket_udp *stripe, struct iovec *vector, int count)
+{
+        struct msghdr msg = { 0 };
+        msg.msg_name = (void *) &s->sock;
+        msg.msg_namelen = s->sock_len;
+        msg.msg_iov = vector;
+        msg.msg_iovlen = count;
+        return sendmsg(stripe->local->tx_fd, &msg, 0);
+}
+#endif // _WIN32
+
+/**
+ * Puts packet received by udp_reader() to the queue. Blocks if the queue is full.
+ *
+ * @param packet packet with filled struct item at ALIGNED_ITEM_OFF
+ * @retval false if the socket is being destroyed (packet is freed)
+ */
+static bool udp_reader_enqueue(struct socket_udp_local *l, uint8_t *packet)
+{
+        pthread_mutex_lock(&l->lock);
+        while (simple_linked_list_size(l->packets) >= (int) l->max_packets && !l->should_exit) {
+                pthread_cond_wait(&l->reader_cv, &l->lock);
+        }
+        if (l->should_exit) {
+                free(packet);
+                pthread_mutex_unlock(&l->lock);
+                return false;
+        }
+
+        simple_linked_list_append(l->packets, packet + ALIGNED_ITEM_OFF);
+        virtual_clock_wait_notify(&l->boss_waiters);
+
+        pthread_mutex_unlock(&l->lock);
+        pthread_cond_signal(&l->boss_cv);
+        return true;
+}
+
+static void udp_reader_impair(struct socket_udp_local *l, uint8_t *packet)
+{
+        struct item *i = (struct item *)(void *)(packet + ALIGNED_ITEM_OFF);
+        time_ns_t deadlines[NET_IMPAIR_MAX_COPIES];
+        int copies = net_impair_schedule(l->impair_rx, i->size, deadlines);
+        if (copies == 0) {
+                free(packet);
+                return;
+        }
+        if (copies > 1) {
+                uint8_t *dup = (uint8_t *) malloc(ALIGNED_ITEM_OFF + sizeof(struct item));
+                memcpy(dup, packet, ALIGNED_ITEM_OFF + sizeof(struct item));
+                struct item *dup_i = (struct item *)(void *)(dup + ALIGNED_ITEM_OFF);
+                dup_i->buf = dup;
+                dup_i->src_addr = (struct sockaddr *)(void *)(dup + ALIGNED_SOCKADDR_STORAGE_OFF);
+                if (deadlines[1] == 0) {
+                        udp_reader_enqueue(l, dup);
+                } else {
+                        net_impair_push(l->impair_rx, deadlines[1], dup);
+                }
+        }
+        if (deadlines[0] == 0) {
+                udp_reader_enqueue(l, packet);
+        } else {
+                net_impair_push(l->impair_rx, deadlines[0], packet);
+        }
+}
+
+/**
+ * Receives a datagram in udp_reader(), with kernel timestamp if enabled.
+ */
+static int udp_reader_recv(struct socket_udp_local *l, char *buffer, int buflen,
+                struct sockaddr *src_addr, socklen_t *addrlen, time_ns_t *rx_ts)
+{
+        *rx_ts = 0;
+#if defined __linux__ && defined SO_TIMESTAMPING
+        if (l->timestamping != UDP_TS_NONE) {
+                // readability may be also caused by pending TX timestamps
+                udp_drain_tx_timestamps(l);
+                char control[256];
+                struct iovec iov = { buffer, buflen };
+                struct msghdr msg = { .msg_name = src_addr, .msg_namelen = *addrlen,
+                        .msg_iov = &iov, .msg_iovlen = 1,
+                        .msg_control = control, .msg_controllen = sizeof control };
+                int size = recvmsg(l->rx_fd, &msg, MSG_DONTWAIT);
+                if (size > 0) {
+                        *addrlen = msg.msg_namelen;
+                        if ((*rx_ts = udp_cmsg_timestamp(&msg)) != 0) {
+                                udp_account_rx_timestamp(l, *rx_ts, buffer, size);
+                        } else { // kernel may start stamping with a delay, keep the same time base
+                                *rx_ts = get_realtime_ns();
+                        }
+                }
+                return size;
+        }
+#endif
+        return recvfrom(l->rx_fd, buffer, buflen, 0, src_addr, addrlen);
+}
+
 /**
  * When receiving data in separate thread, this function fetches data
  * from socket and puts it in queue.
@@ -1100,6 +1860,14 @@ static void *udp_reader(void *arg)
                 FD_SET(s->local->rx_fd, &fds);
                 FD_SET(s->local->should_exit_fd[0], &fds);
                 int nfds = MAX(s->local->rx_fd, s->local->should_exit_fd[0]) + 1;
+#if defined __linux__ && defined SO_TIMESTAMPING
+                // TX timestamps of a separate TX socket make it readable (error queue)
+                const bool tx_ts_fd = s->local->timestamping != UDP_TS_NONE && s->local->tx_fd != s->local->rx_fd;
+                if (tx_ts_fd) {
+                        FD_SET(s->local->tx_fd, &fds);
+                        nfds = MAX(nfds, s->local->tx_fd + 1);
+                }
+#endif
 
                 int rc = select(nfds, &fds, NULL, NULL, NULL);
                 if (rc <= 0) {
@@ -1109,13 +1877,30 @@ static void *udp_reader(void *arg)
                 if (FD_ISSET(s->local->should_exit_fd[0], &fds)) {
                         break;
                 }
+#if defined __linux__ && defined SO_TIMESTAMPING
+                if (tx_ts_fd && FD_ISSET(s->local->tx_fd, &fds) && !FD_ISSET(s->local->rx_fd, &fds)) {
+                        udp_drain_tx_timestamps(s->local);
+                        continue;
+                }
+#endif
                 uint8_t *packet = (uint8_t *) malloc(ALIGNED_ITEM_OFF + sizeof(struct item));
                 uint8_t *buffer = ((uint8_t *) packet) + RTP_PACKET_HEADER_SIZE;
                 struct sockaddr *src_addr = (struct sockaddr *)(void *)(packet + ALIGNED_SOCKADDR_STORAGE_OFF);
                 socklen_t addrlen = sizeof(struct sockaddr_storage);
-                int size = recvfrom(s->local->rx_fd, (char *) buffer,
+                time_ns_t rx_ts = 0;
+                int size = udp_reader_recv(s->local, (char *) buffer,
                                 RTP_MAX_PACKET_LEN - RTP_PACKET_HEADER_SIZE,
-                                0, src_addr, &addrlen);
+                                src_addr, &addrlen, &rx_ts);
+#if defined __linux__ && defined SO_TIMESTAMPING
+                if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { // only TX timestamps were pending
+                        free(packet);
+                        continue;
+                }
+#endif
+                if (s->local->trace && size > 0) {
+                        net_trace_write(s->local->trace, net_trace_get_time(), src_addr, s->local->rx_port,
+                                        (char *) buffer, size);
+                }
 
                 if (size <= 0) {
                         /// @todo
@@ -1127,25 +1912,121 @@ static void *udp_reader(void *arg)
                         continue;
                 }
 
-                pthread_mutex_lock(&s->local->lock);
-                while (simple_linked_list_size(s->local->packets) >= (int) s->local->max_packets && !s->local->should_exit) {
-                        pthread_cond_wait(&s->local->reader_cv, &s->local->lock);
+                struct item *i = (struct item *)(void *)(packet + ALIGNED_ITEM_OFF);
+                *i = (struct item){packet, size, src_addr, addrlen, rx_ts};
+
+                if (s->local->impair_rx) {
+                        udp_reader_impair(s->local, packet);
+                        continue;
+                }
+                if (!udp_reader_enqueue(s->local, packet)) {
+                        break;
                 }
-                if (s->local->should_exit) {
+        }
+
+        platform_pipe_close(s->local->should_exit_fd[0]);
+
+        return NULL;
+}
+
+/**
+ * Waits for a given time or until the socket is destroyed.
+ * @retval true if the socket is being destroyed
+ */
+static bool udp_reader_wait_exit(struct socket_udp_local *l, time_ns_t timeout)
+{
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(l->should_exit_fd[0], &fds);
+        struct timeval tv = { timeout / NS_IN_SEC, (timeout % NS_IN_SEC) / NS_IN_US };
+        return select(l->should_exit_fd[0] + 1, &fds, NULL, NULL, timeout < 0 ? NULL : &tv) > 0;
+}
+
+/**
+ * Replacement of udp_reader() taking the packets from the trace file recorded
+ * with udp-trace-rx instead of the network.
+ */
+static void *udp_replay_reader(void *arg)
+{
+        set_thread_name(__func__);
+        socket_udp *s = (socket_udp *) arg;
+        struct socket_udp_local *l = s->local;
+        time_ns_t first_ts = -1;
+        time_ns_t start = 0;
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+        bool exiting = false;
+
+        while (!exiting) {
+                uint8_t *packet = (uint8_t *) malloc(ALIGNED_ITEM_OFF + sizeof(struct item));
+                uint8_t *buffer = ((uint8_t *) packet) + RTP_PACKET_HEADER_SIZE;
+                struct sockaddr *src_addr = (struct sockaddr *)(void *)(packet + ALIGNED_SOCKADDR_STORAGE_OFF);
+                struct sockaddr_in src;
+                time_ns_t ts = 0;
+                uint16_t dst_port = 0;
+                int size = net_trace_read(l->replay, &ts, &src, &dst_port, (char *) buffer,
+                                RTP_MAX_PACKET_LEN - RTP_PACKET_HEADER_SIZE);
+                if (size <= 0) {
                         free(packet);
-                        pthread_mutex_unlock(&s->local->lock);
                         break;
                 }
+                if (dst_port != l->replay_port) {
+                        free(packet);
+                        continue;
+                }
+                if (first_ts == -1) {
+                        first_ts = ts;
+                        start = net_trace_get_time();
+                }
+                if (!l->replay_fast) {
+                        time_ns_t wait = (ts - first_ts) - (net_trace_get_time() - start);
+                        if (wait > 0 && udp_reader_wait_exit(l, wait)) {
+                                free(packet);
+                                exiting = true;
+                                break;
+                        }
+                }
 
+                socklen_t addrlen = sizeof src;
+                if (l->mode == IPv6) { // present source as v4-mapped
+                        struct sockaddr_in6 *src6 = (struct sockaddr_in6 *)(void *) src_addr;
+                        memset(src6, 0, sizeof *src6);
+                        src6->sin6_family = AF_INET6;
+                        src6->sin6_port = src.sin_port;
+                        src6->sin6_addr.s6_addr[10] = src6->sin6_addr.s6_addr[11] = 0xFF;
+                        memcpy(&src6->sin6_addr.s6_addr[12], &src.sin_addr.s_addr, 4);
+                        addrlen = sizeof *src6;
+                } else {
+                        memcpy(src_addr, &src, sizeof src);
+                }
                 struct item *i = (struct item *)(void *)(packet + ALIGNED_ITEM_OFF);
-                *i = (struct item){packet, size, src_addr, addrlen};
-                simple_linked_list_append(s->local->packets, i);
-
-                pthread_mutex_unlock(&s->local->lock);
-                pthread_cond_signal(&s->local->boss_cv);
+                *i = (struct item){packet, size, src_addr, addrlen, 0};
+                if (l->impair_rx) {
+                        udp_reader_impair(l, packet);
+                } else if (!udp_reader_enqueue(l, packet)) {
+                        exiting = true;
+                }
+                packets += 1;
+                bytes += size;
+        }
+
+        if (!exiting) {
+                double duration = (net_trace_get_time() - start) / NS_IN_SEC_DBL;
+                log_msg(LOG_LEVEL_NOTICE, MOD_NAME "Replay of port %d finished: %" PRIu64 " packets (%" PRIu64
+                                " B) in %.3f s - %.0f pkt/s, %.2f Mbps\n", l->replay_port, packets, bytes, duration,
+                                packets / duration, bytes * 8 / duration / 1E6);
+                if (l->replay_exit) {
+                        pthread_mutex_lock(&l->lock);
+                        while (simple_linked_list_size(l->packets) > 0 && !l->should_exit) {
+                                pthread_cond_wait(&l->reader_cv, &l->lock);
+                        }
+                        pthread_mutex_unlock(&l->lock);
+                        exit_uv(0);
+                }
+                udp_reader_wait_exit(l, -1);
         }
 
-        platform_pipe_close(s->local->should_exit_fd[0]);
+        platform_pipe_close(l->should_exit_fd[0]);
 
         return NULL;
 }
@@ -1163,6 +2044,17 @@ static int udp_do_recv(socket_udp * s, char *buffer, int buflen, int flags, stru
 
         len = recvfrom(s->local->rx_fd, buffer, buflen, flags, src_addr, addrlen);
         if (len > 0) {
+                if (s->local->trace && (flags & MSG_PEEK) == 0) {
+                        net_trace_write(s->local->trace, net_trace_get_time(), src_addr, s->local->rx_port,
+                                        buffer, len);
+                }
+                if (s->local->impair_rx && (flags & MSG_PEEK) == 0) {
+                        // only loss is emulated here (synchronous receive)
+                        time_ns_t deadlines[NET_IMPAIR_MAX_COPIES];
+                        if (net_impair_schedule(s->local->impair_rx, len, deadlines) == 0) {
+                                return 0;
+                        }
+                }
                 return len;
         }
         if (errno != ECONNREFUSED) {
@@ -1199,23 +2091,39 @@ bool udp_not_empty(socket_udp * s, struct timeval *timeout)
         assert(s->local->multithreaded);
 
         pthread_mutex_lock(&s->local->lock);
-        if (timeout) {
-                struct timeval tv;
-                gettimeofday(&tv, NULL);
-                tv.tv_sec += timeout->tv_sec;
-                tv.tv_usec += timeout->tv_usec;
-                if (tv.tv_usec >= 1000000) {
-                        tv.tv_sec += 1;
-                        tv.tv_usec -= 1000000;
-                }
-                struct timespec tmout_ts = { tv.tv_sec, tv.tv_usec * 1000 };
-                int rc = 0;
-                while (rc != ETIMEDOUT && simple_linked_list_size(s->local->packets) == 0) {
-                        rc = pthread_cond_timedwait(&s->local->boss_cv, &s->local->lock, &tmout_ts);
+        if (timeout && virtual_clock_enabled) {
+                const time_ns_t deadline = get_time_in_ns() + timeout->tv_sec * NS_IN_SEC +
+                                           timeout->tv_usec * NS_IN_US;
+                while (simple_linked_list_size(s->local->packets) == 0 &&
+                       !virtual_clock_cond_timedwait(&s->local->boss_cv, &s->local->lock,
+                                                     &s->local->boss_waiters, deadline)) {
                 }
         } else {
-                while (simple_linked_list_size(s->local->packets) == 0) {
-                        pthread_cond_wait(&s->local->boss_cv, &s->local->lock);
+                const bool wait = simple_linked_list_size(s->local->packets) == 0;
+                if (wait) {
+                        virtual_clock_wait_begin(&s->local->boss_waiters);
+                }
+                if (timeout) {
+                        struct timeval tv;
+                        gettimeofday(&tv, NULL);
+                        tv.tv_sec += timeout->tv_sec;
+                        tv.tv_usec += timeout->tv_usec;
+                        if (tv.tv_usec >= 1000000) {
+                                tv.tv_sec += 1;
+                                tv.tv_usec -= 1000000;
+                        }
+                        struct timespec tmout_ts = { tv.tv_sec, tv.tv_usec * 1000 };
+                        int rc = 0;
+                        while (rc != ETIMEDOUT && simple_linked_list_size(s->local->packets) == 0) {
+                                rc = pthread_cond_timedwait(&s->local->boss_cv, &s->local->lock, &tmout_ts);
+                        }
+                } else {
+                        while (simple_linked_list_size(s->local->packets) == 0) {
+                                pthread_cond_wait(&s->local->boss_cv, &s->local->lock);
+                        }
+                }
+                if (wait) {
+                        virtual_clock_wait_end(&s->local->boss_waiters);
                 }
         }
         bool ret = simple_linked_list_size(s->local->packets) > 0;
@@ -1254,8 +2162,8 @@ int udp_recvfrom(socket_udp *s, char *buffer, int buflen, struct sockaddr *src_a
  * @param[out] buffer data received from socket. Must be freed by caller!
  * @returns           length of the received datagram
  */
-int udp_recvfrom_data(socket_udp * s, char **buffer,
-                struct sockaddr *src_addr, socklen_t *addrlen)
+static int udp_recvfrom_data_ts(socket_udp * s, char **buffer,
+                struct sockaddr *src_addr, socklen_t *addrlen, long long *rx_ts)
 {
         assert(s->local->multithreaded);
         int ret;
@@ -1263,6 +2171,9 @@ int udp_recvfrom_data(socket_udp * s, char **buffer,
         pthread_mutex_lock(&s->local->lock);
         struct item *it = (struct item *)(simple_linked_list_pop(s->local->packets));
         *buffer = (char *) it->buf;
+        if (rx_ts) {
+                *rx_ts = it->rx_ts;
+        }
         if(src_addr){
                 if(it->src_addr){
                         memcpy(src_addr, it->src_addr, it->addrlen);
@@ -1278,8 +2189,25 @@ int udp_recvfrom_data(socket_udp * s, char **buffer,
 
         return ret;
 }
+int udp_recvfrom_data(socket_udp * s, char **buffer,
+                struct sockaddr *src_addr, socklen_t *addrlen)
+{
+        return udp_recvfrom_data_ts(s, buffer, src_addr, addrlen, NULL);
+}
+
 int udp_recv_data(socket_udp * s, char **buffer){
-        return udp_recvfrom_data(s, buffer, NULL, NULL);
+        return udp_recvfrom_data_ts(s, buffer, NULL, NULL, NULL);
+}
+
+/**
+ * Same as udp_recv_data() but returns also kernel RX timestamp of the packet.
+ *
+ * @param[out] rx_ts_ns  timestamp in ns (CLOCK_REALTIME), 0 if not available
+ *                       (see udp_set_timestamping())
+ */
+int udp_recv_data_ts(socket_udp *s, char **buffer, long long *rx_ts_ns)
+{
+        return udp_recvfrom_data_ts(s, buffer, NULL, NULL, rx_ts_ns);
 }
 
 #ifndef _WIN32
@@ -1349,12 +2277,18 @@ int udp_fd_isset_r(socket_udp *s, struct udp_fd_r *fd_struct)
  **/
 int udp_select(struct timeval *timeout)
 {
-        return select(max_fd + 1, &rfd, NULL, NULL, timeout);
+        virtual_clock_idle_begin();
+        int ret = select(max_fd + 1, &rfd, NULL, NULL, timeout);
+        virtual_clock_idle_end();
+        return ret;
 }
 
 int udp_select_r(struct timeval *timeout, struct udp_fd_r * fd_struct)
 {
-        return select(fd_struct->max_fd + 1, &fd_struct->rfd, NULL, NULL, timeout);
+        virtual_clock_idle_begin();
+        int ret = select(fd_struct->max_fd + 1, &fd_struct->rfd, NULL, NULL, timeout);
+        virtual_clock_idle_end();
+        return ret;
 }
 
 /**
@@ -83,6 +83,15 @@ int         udp_sendv(socket_udp *s, LPWSABUF vector, int count, void *d);
 #else
 int         udp_sendv(socket_udp *s, struct iovec *vector, int count, void *d);
 #endif
+socket_udp *udp_init_tx_stripe(socket_udp *s);
+socket_udp *udp_init_tx_path(socket_udp *s, const char *addr, const char *iface);
+int         udp_send_to_port(socket_udp *s, char *buffer, int buflen, uint16_t port);
+uint16_t    udp_get_tx_port(socket_udp *s);
+#ifdef _WIN32
+int         udp_sendv_stripe(socket_udp *s, socket_udp *stripe, LPWSABUF vector, int count);
+#else
+int         udp_sendv_stripe(socket_udp *s, socket_udp *stripe, struct iovec *vector, int count);
+#endif
 
 char       *udp_host_addr(socket_udp *s);
 int         udp_fd(socket_udp *s);
@@ -121,6 +130,43 @@ int         udp_send_wsa_async(socket_udp *s, char *buffer, int buflen, LPWSAOVE
 int         udp_sendto_wsa_async(socket_udp *s, char *buffer, int buflen, LPWSAOVERLAPPED_COMPLETION_ROUTINE l, LPWSAOVERLAPPED o, struct sockaddr *addr, socklen_t addrlen);
 #endif
 
+/// kernel packet timestamping (SO_TIMESTAMPING, Linux only)
+enum udp_timestamping {
+        UDP_TS_NONE = 0,
+        UDP_TS_SW,      ///< software timestamps taken by the kernel network stack
+        UDP_TS_HW,      ///< NIC timestamps (falls back to software ones if unavailable)
+};
+
+#define UDP_TS_HIST_BUCKETS 16
+#define UDP_TS_MAX_STREAMS 8 ///< further streams are not accounted
+/**
+ * Statistics of one RTP stream (SSRC) computed from kernel timestamps.
+ * Histogram bucket i counts intervals in range [2^(i-1), 2^i) us (bucket 0
+ * intervals under 1 us), the last bucket is open.
+ */
+struct udp_ts_stream_stats {
+        uint32_t           ssrc;
+        unsigned long long rx_count;            ///< received packets with a timestamp
+        unsigned long long rx_interarrival[UDP_TS_HIST_BUCKETS];
+        long long          rx_queue_delay_sum;  ///< [ns] kernel timestamp -> read from socket
+        long long          rx_queue_delay_max;  ///< [ns]
+        unsigned long long tx_count;            ///< sent packets with a TX completion timestamp
+        unsigned long long tx_interdeparture[UDP_TS_HIST_BUCKETS];
+        long long          tx_lateness_sum;     ///< [ns] intended send time -> kernel TX timestamp
+        long long          tx_lateness_max;     ///< [ns]
+};
+
+/// per-stream statistics of a multithreaded socket, only RTP datagrams are accounted
+struct udp_ts_stats {
+        int stream_count;
+        struct udp_ts_stream_stats streams[UDP_TS_MAX_STREAMS];
+};
+
+bool        udp_set_timestamping(socket_udp *s, enum udp_timestamping mode);
+bool        udp_get_ts_stats(socket_udp *s, struct udp_ts_stats *stats);
+void        udp_set_tx_deadline(socket_udp *s, long long deadline_ns);
+int         udp_recv_data_ts(socket_udp *s, char **buffer, long long *rx_ts_ns);
+
 struct socket_udp_local *udp_get_local(socket_udp *s);
 int udp_get_udp_rx_port(socket_udp *s);
 socket_udp *udp_init_with_local(struct socket_udp_local *l, struct sockaddr *sa, socklen_t len);
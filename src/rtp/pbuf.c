@@ -67,6 +67,7 @@
 #include "tv.h"
 #include "utils/color_out.h"
 #include "utils/macros.h"
+#include "utils/mem_account.h"
 
 #define PBUF_MAGIC	0xcafebabe
 
@@ -111,8 +112,19 @@ struct pbuf {
         int out_of_order_pkts;
         int max_out_of_order_dist;
         int dups; // duplicite packets
+
+        bool mem_cap_dropping;   ///< frame with mem_cap_drop_ts is being dropped due to memory cap
+        uint32_t mem_cap_drop_ts;
 };
 
+#define PKT_ACC_SIZE(pkt) (sizeof(rtp_packet) + (pkt)->data_len)
+
+static void free_pkt(rtp_packet *pkt)
+{
+        mem_account_free(MEM_ACC_PBUF, PKT_ACC_SIZE(pkt));
+        free(pkt);
+}
+
 static void free_cdata(struct coded_data *head);
 static int frame_complete(struct pbuf_node *frame);
 
@@ -241,7 +253,7 @@ static void add_coded_unit(struct pbuf_node *node, rtp_packet * pkt)
         struct coded_data *tmp = (struct coded_data *) malloc(sizeof(struct coded_data));
         if (tmp == NULL) {
                 /* this is bad, out of memory, drop the packet... */
-                free(pkt);
+                free_pkt(pkt);
                 return;
         }
 
@@ -271,7 +283,7 @@ static void add_coded_unit(struct pbuf_node *node, rtp_packet * pkt)
                         curr->prv = tmp;
                 } else {
                         /* this is bad, something went terribly wrong... */
-                        free(pkt);
+                        free_pkt(pkt);
                         free(tmp);
                 }
         }
@@ -296,12 +308,12 @@ static struct pbuf_node *create_new_pnode(rtp_packet * pkt, long long playout_de
                         tmp->cdata->seqno = pkt->seq;
                         tmp->cdata->data = pkt;
                 } else {
-                        free(pkt);
+                        free_pkt(pkt);
                         free(tmp);
                         return NULL;
                 }
         } else {
-                free(pkt);
+                free_pkt(pkt);
         }
         return tmp;
 }
@@ -424,6 +436,22 @@ void pbuf_insert(struct pbuf *playout_buf, rtp_packet * pkt)
         pbuf_validate(playout_buf);
         pbuf_process_stats(playout_buf, pkt);
 
+        if (playout_buf->mem_cap_dropping && playout_buf->mem_cap_drop_ts == pkt->ts) {
+                free(pkt);
+                return;
+        }
+        playout_buf->mem_cap_dropping = false;
+        if ((playout_buf->last == NULL || playout_buf->last->rtp_timestamp != pkt->ts)
+                        && mem_account_over_cap(MEM_ACC_PBUF)) {
+                log_msg_once(LOG_LEVEL_WARNING, to_fourcc('p', 'b', 'm', 'c'), MOD_NAME "Memory cap exceeded, dropping frames!\n");
+                log_msg(LOG_LEVEL_VERBOSE, MOD_NAME "Memory cap exceeded, dropping frame with RTP TS=%u\n", pkt->ts);
+                playout_buf->mem_cap_dropping = true;
+                playout_buf->mem_cap_drop_ts = pkt->ts;
+                free(pkt);
+                return;
+        }
+        mem_account_alloc(MEM_ACC_PBUF, PKT_ACC_SIZE(pkt));
+
         if (playout_buf->frst == NULL && playout_buf->last == NULL) {
                 /* playout buffer is empty - add new frame */
                 playout_buf->frst = create_new_pnode(pkt, playout_buf->playout_delay_us + 1000 * (playout_buf->offset_ms ? *playout_buf->offset_ms : 0));
@@ -476,7 +504,7 @@ void pbuf_insert(struct pbuf *playout_buf, rtp_packet * pkt)
                                         debug_msg
                                                 ("Oops... dropped packet with M bit set\n");
                                 }
-                                free(pkt);
+                                free_pkt(pkt);
                         }
                 }
         }
@@ -488,7 +516,7 @@ static void free_cdata(struct coded_data *head)
         struct coded_data *tmp;
 
         while (head != NULL) {
-                free(head->data);
+                free_pkt(head->data);
                 tmp = head;
                 head = head->nxt;
                 free(tmp);
@@ -78,10 +78,15 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdatomic.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
 
 #include "memory.h"
 #include "debug.h"
+#include "host.h"
 #include "net_udp.h"
 #include "crypto/crypt_des.h"
 #include "crypto/crypt_aes.h"
@@ -92,6 +97,9 @@
 #include "utils/misc.h"
 #include "utils/net.h"
 #include "utils/random.h"
+#include "utils/ring_buffer.h"
+#include "utils/thread.h"
+#include "compat/platform_pipe.h"
 
 #undef max
 #undef min
@@ -120,6 +128,9 @@ static int des_encrypt(struct rtp *session, unsigned char *data,
                        unsigned int size, unsigned char *initVec);
 static void rtp_process_data(struct rtp *session, uint32_t curr_rtp_ts,
                uint8_t *buffer, rtp_packet *packet, int buflen);
+static int validate_rtcp(uint8_t * packet, int len);
+static void rtcp_udp_send_direct(struct rtp *session, int len, char *buffer,
+                                 struct sockaddr_storage *dst, socklen_t dst_len);
 
 #define MAX_DROPOUT    3000
 #define MAX_MISORDER   100
@@ -140,6 +151,7 @@ static void rtp_process_data(struct rtp *session, uint32_t curr_rtp_ts,
 #define RTCP_BYE  203
 #define RTCP_APP  204
 #define RTCP_RX   205
+#define RTCP_PSFB 206 /* payload-specific feedback, RFC 4585 */
 
 typedef struct {
 #ifdef WORDS_BIGENDIAN
@@ -185,6 +197,11 @@ typedef struct {
                         uint8_t name[4];
                         uint8_t data[1];
                 } app;
+                struct {
+                        uint32_t ssrc;          /* source this RTCP packet is coming from */
+                        uint32_t media_ssrc;    /* source the feedback is related to */
+                        uint32_t fci[2];        /* feedback control information (variable length) */
+                } psfb;
         } r;
 } rtcp_t;
 
@@ -221,6 +238,7 @@ typedef struct _source {
         int should_advertise_sdes;      /* TRUE if this source is a CSRC which we need to advertise SDES for */
         int sender;
         int got_bye;            /* TRUE if we've received an RTCP bye from this source */
+        int last_fir_seq;       /* sequence number + 1 of the last FIR from this source, 0 if none */
         uint32_t base_seq;
         uint16_t max_seq;
         uint32_t bad_seq;
@@ -298,7 +316,7 @@ struct rtp {
         time_ns_t last_rtp_send_time;
         time_ns_t last_rtcp_send_time;
         time_ns_t next_rtcp_send_time;
-        double rtcp_interval;
+        _Atomic double rtcp_interval; /* written by RTCP thread while it runs */
         int sdes_count_pri;
         int sdes_count_sec;
         int sdes_count_ter;
@@ -329,11 +347,55 @@ struct rtp {
                 } des;
         } crypto_state;
         rtp_callback callback;
+        _Atomic int keyframe_requests;  /* PLI/FIR requests for our source since last rtp_get_keyframe_requests() */
+        uint8_t fir_seq;        /* sequence number of the next FIR we send */
         struct msghdr *mhdr;
         bool mt_recv; /* whether the receiver uses separate thread for receiving */
+        /* RTCP thread (mt_recv only) - does all RTCP socket I/O and runs the     */
+        /* report and housekeeping timers. The thread owning the source database */
+        /* (calling rtp_recv_r(), rtp_send_ctrl() and rtp_update()) processes    */
+        /* the received packets, formats the reports and performs housekeeping   */
+        /* when the RTCP thread requests it. Neither waits for the other - the   */
+        /* packets are passed through lock-free queues and the membership the    */
+        /* report interval is computed from is published in rtcp_sched. The RTCP */
+        /* thread owns the report timing state (next/last_rtcp_send_time,        */
+        /* initial_rtcp, avg_rtcp_size, ssrc_count_prev, last_update, rtcp_dest) */
+        /* while it runs.                                                        */
+        pthread_t rtcp_thread;
+        bool rtcp_thread_running;
+        _Atomic bool rtcp_thread_should_exit;
+        fd_t rtcp_wake_fd[2]; /* wakes RTCP thread to send queued packets or exit */
+        struct ring_buffer *rtcp_queue; /* received - struct rtcp_queue_hdr followed by packet */
+        pthread_mutex_t rtcp_queue_lock; /* used only for blocking in rtcp_recv_r() */
+        pthread_cond_t rtcp_queue_cv;
+        struct ring_buffer *rtcp_out_queue; /* to be sent by the RTCP thread, same format */
+        pthread_mutex_t rtcp_out_lock; /* serializes producers only (sender and receiver thread) */
+        _Atomic bool rtcp_report_due; /* report should be sent, see rtp_send_ctrl() */
+        _Atomic bool rtcp_update_due; /* housekeeping should be done, see rtp_update() */
+        _Atomic uint64_t rtcp_sched; /* membership snapshot, see rtcp_sched_publish() */
         uint32_t magic;         /* For debugging...  */
 };
 
+#define RTCP_QUEUE_SIZE (1 << 16)
+#define RTCP_THREAD_POLL_US 100000 /* maximal RTCP thread sleep */
+#define RTCP_THREAD_NICE 10
+
+/* header of a queued RTCP packet, addrlen 0 for outgoing packet means the */
+/* session RTCP destination                                                */
+struct rtcp_queue_hdr {
+        int len;
+        socklen_t addrlen;
+        struct sockaddr_storage addr;
+};
+
+/* session membership the RTCP report interval is computed from */
+struct rtcp_membership {
+        int members;
+        int senders;
+        int csrc_count;
+        bool we_sent;
+};
+
 static inline int filter_event(struct rtp *session, uint32_t ssrc)
 {
         return session->opt->filter_my_packets
@@ -730,7 +792,7 @@ static void delete_source(struct rtp *session, uint32_t ssrc)
         /*    which is now earlier.                                               */
         /* o  The value of pmembers is set equal to members.                      */
         session->ssrc_count--;
-        if (session->ssrc_count < session->ssrc_count_prev) {
+        if (!session->rtcp_thread_running && session->ssrc_count < session->ssrc_count_prev) {
                 session->next_rtcp_send_time =
                         session->last_rtcp_send_time = get_time_in_ns();
                 session->next_rtcp_send_time +=
@@ -828,7 +890,7 @@ static int update_seq(source * s, uint16_t seq)
         return 1;
 }
 
-static double rtcp_interval(struct rtp *session)
+static double rtcp_interval_of(struct rtp *session, const struct rtcp_membership *m)
 {
         /* Minimum average time between RTCP packets from this site (in   */
         /* seconds).  This time prevents the reports from `clumping' when */
@@ -866,19 +928,15 @@ static double rtcp_interval(struct rtp *session)
         /* If there were active senders, give them at least a minimum     */
         /* share of the RTCP bandwidth.  Otherwise all participants share */
         /* the RTCP bandwidth equally.                                    */
-        if (session->sending_bye) {
-                n = session->bye_count;
-        } else {
-                n = session->ssrc_count;
-        }
-        if (session->sender_count > 0
-            && session->sender_count < n * RTCP_SENDER_BW_FRACTION) {
-                if (session->we_sent) {
+        n = m->members;
+        if (m->senders > 0
+            && m->senders < n * RTCP_SENDER_BW_FRACTION) {
+                if (m->we_sent) {
                         rtcp_bw *= RTCP_SENDER_BW_FRACTION;
-                        n = session->sender_count;
+                        n = m->senders;
                 } else {
                         rtcp_bw *= RTCP_RCVR_BW_FRACTION;
-                        n -= session->sender_count;
+                        n -= m->senders;
                 }
         }
 
@@ -901,6 +959,17 @@ static double rtcp_interval(struct rtp *session)
         return (t * (ug_drand() + 0.5)) / COMPENSATION;
 }
 
+static double rtcp_interval(struct rtp *session)
+{
+        const struct rtcp_membership m = {
+                .members = session->sending_bye ? session->bye_count : session->ssrc_count,
+                .senders = session->sender_count,
+                .csrc_count = session->csrc_count,
+                .we_sent = session->we_sent,
+        };
+        return rtcp_interval_of(session, &m);
+}
+
 #define MAXCNAMELEN	255
 
 static char *get_cname(socket_udp * s)
@@ -1005,6 +1074,285 @@ struct rtp *rtp_init(const char *addr,
                            callback, userdata, force_ip_version, multithreaded);
 }
 
+/**
+ * Publishes the membership for the RTCP thread scheduling the reports. Called
+ * by the thread owning the source database, packed to be read atomically.
+ */
+static void rtcp_sched_publish(struct rtp *session)
+{
+        const uint64_t packed = (uint64_t) MIN(session->ssrc_count, 0xFFFFFF) |
+                (uint64_t) MIN(session->sender_count, 0xFFFFFF) << 24 |
+                (uint64_t) MIN(session->csrc_count, 0x7FFF) << 48 |
+                (uint64_t) (session->we_sent != 0) << 63;
+        atomic_store_explicit(&session->rtcp_sched, packed, memory_order_relaxed);
+}
+
+static struct rtcp_membership rtcp_sched_read(struct rtp *session)
+{
+        const uint64_t packed = atomic_load_explicit(&session->rtcp_sched, memory_order_relaxed);
+        return (struct rtcp_membership) {
+                .members = packed & 0xFFFFFF,
+                .senders = (packed >> 24) & 0xFFFFFF,
+                .csrc_count = (packed >> 48) & 0x7FFF,
+                .we_sent = packed >> 63,
+        };
+}
+
+/* Updates the average compound RTCP packet size (RTP section 6.3.3) */
+static void rtcp_update_avg_size(struct rtp *session, int buflen)
+{
+        if (session->avg_rtcp_size < 0) {
+                /* This is the first RTCP packet we've received, set our initial estimate */
+                /* of the average  packet size to be the size of this packet.             */
+                session->avg_rtcp_size =
+                    buflen + RTP_LOWER_LAYER_OVERHEAD;
+        } else {
+                /* Update our estimate of the average RTCP packet size. The constants are */
+                /* 1/16 and 15/16 (section 6.3.3 of draft-ietf-avt-rtp-new-02.txt).       */
+                session->avg_rtcp_size =
+                    (0.0625 *
+                     (buflen + RTP_LOWER_LAYER_OVERHEAD)) +
+                    (0.9375 * session->avg_rtcp_size);
+        }
+}
+
+/**
+ * RTCP thread timers - schedules reports as rtp_send_ctrl() does (RTP section
+ * 6.3.6) and housekeeping once per second, both are performed by the thread
+ * owning the source database once it notices the request.
+ */
+static void rtcp_thread_timers(struct rtp *session, time_ns_t curr_time)
+{
+        const struct rtcp_membership m = rtcp_sched_read(session);
+
+        /* Reverse reconsideration when members decrease (RTP sections 6.3.4 and 6.3.5) */
+        if (m.members < session->ssrc_count_prev) {
+                const double ratio = (double) m.members / session->ssrc_count_prev;
+                session->next_rtcp_send_time = curr_time + ratio * (session->next_rtcp_send_time - curr_time);
+                session->last_rtcp_send_time = curr_time - ratio * (curr_time - session->last_rtcp_send_time);
+                session->ssrc_count_prev = m.members;
+        }
+        if (curr_time > session->next_rtcp_send_time) {
+                double new_interval = rtcp_interval_of(session, &m) / (m.csrc_count + 1);
+                time_ns_t new_send_time = session->last_rtcp_send_time + new_interval * NS_IN_SEC;
+                if (curr_time > new_send_time) {
+                        session->rtcp_report_due = true;
+                        session->initial_rtcp = FALSE;
+                        session->last_rtcp_send_time = curr_time;
+                        session->next_rtcp_send_time = curr_time +
+                                rtcp_interval_of(session, &m) / (m.csrc_count + 1) * NS_IN_SEC;
+                } else {
+                        session->next_rtcp_send_time = new_send_time;
+                }
+                session->ssrc_count_prev = m.members;
+        }
+        if (curr_time - session->last_update >= NS_IN_SEC) {
+                session->last_update = curr_time;
+                session->rtcp_update_due = true;
+        }
+}
+
+/* Sends packets queued by rtcp_queue_out() */
+static void rtcp_send_queued(struct rtp *session)
+{
+        struct rtcp_queue_hdr hdr;
+        uint8_t buffer[RTP_MAX_PACKET_LEN + MAX_ENCRYPTION_PAD];
+
+        while (ring_get_current_size(session->rtcp_out_queue) >= (int) sizeof hdr) {
+                ring_buffer_read(session->rtcp_out_queue, (char *) &hdr, sizeof hdr);
+                ring_buffer_read(session->rtcp_out_queue, (char *) buffer, hdr.len);
+                rtcp_udp_send_direct(session, hdr.len, (char *) buffer,
+                                     hdr.addrlen > 0 ? &hdr.addr : NULL, hdr.addrlen);
+                rtcp_update_avg_size(session, hdr.len - (session->encryption_enabled ? 4 : 0));
+        }
+}
+
+/**
+ * Accounts a packet received by the RTCP thread and passes it to the thread
+ * processing RTP. The source becomes the RTCP destination except for path
+ * probes (see rtcp_process_received()).
+ */
+static void rtcp_thread_received(struct rtp *session, struct rtcp_queue_hdr *hdr, uint8_t *buffer)
+{
+        if (!session->encryption_enabled) {
+                uint32_t ssrc = 0;
+                bool echo = false;
+                uint32_t probe_seq = 0;
+                uint64_t send_time = 0;
+                if (!validate_rtcp(buffer, hdr->len)) {
+                        debug_msg("Invalid RTCP packet discarded\n");
+                        return;
+                }
+                if (!rtcp_find_path_probe(buffer, hdr->len, &ssrc, &echo, &probe_seq, &send_time)) {
+                        memcpy(&session->rtcp_dest, &hdr->addr, hdr->addrlen);
+                        session->rtcp_dest_len = hdr->addrlen;
+                }
+                rtcp_update_avg_size(session, hdr->len);
+        } else { // cannot be validated before decryption
+                memcpy(&session->rtcp_dest, &hdr->addr, hdr->addrlen);
+                session->rtcp_dest_len = hdr->addrlen;
+                rtcp_update_avg_size(session, hdr->len - 4);
+        }
+
+        const int total = sizeof *hdr + hdr->len;
+        if (ring_get_available_write_size(session->rtcp_queue) <= total) {
+                debug_msg("RTCP queue full, dropping packet\n");
+                return;
+        }
+        ring_buffer_write(session->rtcp_queue, (const char *) hdr, total);
+        pthread_mutex_lock(&session->rtcp_queue_lock);
+        pthread_cond_signal(&session->rtcp_queue_cv);
+        pthread_mutex_unlock(&session->rtcp_queue_lock);
+}
+
+static void *rtcp_thread(void *arg)
+{
+        struct rtp *session = arg;
+        struct { // header immediately followed by data, written to the queue at once
+                struct rtcp_queue_hdr hdr;
+                uint8_t data[RTP_MAX_PACKET_LEN];
+        } packet;
+        struct rtcp_queue_hdr *hdr = &packet.hdr;
+        uint8_t *buffer = packet.data;
+
+        set_thread_name(__func__);
+#ifdef __linux__
+        /* RTCP is not time critical, on Linux nice value is per-thread */
+        if (setpriority(PRIO_PROCESS, 0, RTCP_THREAD_NICE) != 0) {
+                debug_msg("Unable to lower RTCP thread priority\n");
+        }
+#endif
+        while (!session->rtcp_thread_should_exit) {
+                const time_ns_t curr_time = get_time_in_ns();
+                rtcp_thread_timers(session, curr_time);
+                rtcp_send_queued(session);
+
+                time_ns_t wait = MIN(session->next_rtcp_send_time, session->last_update + NS_IN_SEC) - curr_time;
+                wait = MAX(MIN(wait, RTCP_THREAD_POLL_US * NS_IN_US), 0);
+                struct timeval timeout = { .tv_sec = 0, .tv_usec = wait / NS_IN_US + 1 };
+                struct udp_fd_r fd;
+                udp_fd_zero_r(&fd);
+                udp_fd_set_r(session->rtcp_socket, &fd);
+                FD_SET(session->rtcp_wake_fd[0], &fd.rfd);
+                fd.max_fd = MAX(fd.max_fd, session->rtcp_wake_fd[0]);
+                if (udp_select_r(&timeout, &fd) <= 0) {
+                        continue;
+                }
+                if (FD_ISSET(session->rtcp_wake_fd[0], &fd.rfd)) {
+                        char c[16];
+                        PLATFORM_PIPE_READ(session->rtcp_wake_fd[0], c, sizeof c);
+                }
+                if (!udp_fd_isset_r(session->rtcp_socket, &fd)) {
+                        continue;
+                }
+                hdr->addrlen = sizeof hdr->addr;
+                hdr->len = udp_recvfrom(session->rtcp_socket, (char *) buffer,
+                                        RTP_MAX_PACKET_LEN,
+                                        (struct sockaddr *) &hdr->addr, &hdr->addrlen);
+                if (hdr->len > 0) {
+                        rtcp_thread_received(session, hdr, buffer);
+                }
+        }
+        rtcp_send_queued(session); // eg. keyframe request right before exit
+        return NULL;
+}
+
+/**
+ * Queues a compound RTCP packet to be sent by the RTCP thread.
+ * @param dst  destination, NULL for the session RTCP destination
+ */
+static void rtcp_queue_out(struct rtp *session, const uint8_t *buffer, int len,
+                           const struct sockaddr_storage *dst, socklen_t dst_len)
+{
+        struct { // header immediately followed by data, written to the queue at once
+                struct rtcp_queue_hdr hdr;
+                uint8_t data[RTP_MAX_PACKET_LEN + MAX_ENCRYPTION_PAD];
+        } packet;
+        assert(len <= (int) sizeof packet.data);
+        packet.hdr.len = len;
+        packet.hdr.addrlen = dst != NULL ? dst_len : 0;
+        if (dst != NULL) {
+                memcpy(&packet.hdr.addr, dst, dst_len);
+        }
+        memcpy(packet.data, buffer, len);
+
+        const int total = sizeof packet.hdr + len;
+        pthread_mutex_lock(&session->rtcp_out_lock);
+        if (ring_get_available_write_size(session->rtcp_out_queue) <= total) {
+                pthread_mutex_unlock(&session->rtcp_out_lock);
+                debug_msg("RTCP send queue full, dropping packet\n");
+                return;
+        }
+        ring_buffer_write(session->rtcp_out_queue, (const char *) &packet, total);
+        pthread_mutex_unlock(&session->rtcp_out_lock);
+        const char c = 0;
+        if (PLATFORM_PIPE_WRITE(session->rtcp_wake_fd[1], &c, 1) != 1) {
+                debug_msg("Unable to wake RTCP thread\n");
+        }
+}
+
+static bool rtcp_thread_start(struct rtp *session)
+{
+        if (get_commandline_param("rtcp-thread") != NULL &&
+            strcmp(get_commandline_param("rtcp-thread"), "no") == 0) {
+                return false;
+        }
+        if (platform_pipe_init(session->rtcp_wake_fd) != 0) {
+                log_msg(LOG_LEVEL_WARNING, "[RTP] Unable to create RTCP thread pipe, "
+                        "RTCP will be handled by RTP thread.\n");
+                return false;
+        }
+        session->rtcp_queue = ring_buffer_init(RTCP_QUEUE_SIZE);
+        session->rtcp_out_queue = ring_buffer_init(RTCP_QUEUE_SIZE);
+        pthread_mutex_init(&session->rtcp_queue_lock, NULL);
+        pthread_cond_init(&session->rtcp_queue_cv, NULL);
+        pthread_mutex_init(&session->rtcp_out_lock, NULL);
+        rtcp_sched_publish(session);
+        if (pthread_create(&session->rtcp_thread, NULL, rtcp_thread, session) != 0) {
+                log_msg(LOG_LEVEL_WARNING, "[RTP] Unable to create RTCP thread, "
+                        "RTCP will be handled by RTP thread.\n");
+                ring_buffer_destroy(session->rtcp_queue);
+                ring_buffer_destroy(session->rtcp_out_queue);
+                pthread_mutex_destroy(&session->rtcp_queue_lock);
+                pthread_cond_destroy(&session->rtcp_queue_cv);
+                pthread_mutex_destroy(&session->rtcp_out_lock);
+                platform_pipe_close(session->rtcp_wake_fd[0]);
+                platform_pipe_close(session->rtcp_wake_fd[1]);
+                return false;
+        }
+        session->rtcp_thread_running = true;
+        return true;
+}
+
+/**
+ * Stops the RTCP thread (if running), packets queued for sending are sent.
+ * RTCP is handled by the calling thread afterwards.
+ */
+static void rtcp_thread_stop(struct rtp *session)
+{
+        if (!session->rtcp_thread_running) {
+                return;
+        }
+        session->rtcp_thread_should_exit = true;
+        const char c = 0;
+        if (PLATFORM_PIPE_WRITE(session->rtcp_wake_fd[1], &c, 1) != 1) {
+                debug_msg("Unable to wake RTCP thread\n");
+        }
+        pthread_join(session->rtcp_thread, NULL);
+        session->rtcp_thread_running = false;
+        /* packets received but not yet processed are dropped */
+        ring_buffer_destroy(session->rtcp_queue);
+        ring_buffer_destroy(session->rtcp_out_queue);
+        pthread_mutex_destroy(&session->rtcp_queue_lock);
+        pthread_cond_destroy(&session->rtcp_queue_cv);
+        pthread_mutex_destroy(&session->rtcp_out_lock);
+        platform_pipe_close(session->rtcp_wake_fd[0]);
+        platform_pipe_close(session->rtcp_wake_fd[1]);
+}
+
+ADD_TO_PARAM("rtcp-thread", "* rtcp-thread=no\n"
+                "  Send, receive and schedule RTCP in the RTP receiving thread instead of a dedicated one.\n");
+
 /**
  * rtp_init_if:
  * @addr: IP destination of this session (unicast or multicast),
@@ -1163,6 +1511,10 @@ struct rtp *rtp_init_if(const char *addr, const char *iface,
                      strlen(cname));
         free(cname);            /* cname is copied by rtp_set_sdes()... */
 
+        if (multithreaded) {
+                rtcp_thread_start(session);
+        }
+
         log_msg(LOG_LEVEL_DEBUG, "Created new RTP session with SSRC 0x%08x.\n",
                   session->my_ssrc);
 
@@ -1524,8 +1876,14 @@ static int rtp_recv_data(struct rtp *session, uint32_t curr_rtp_ts)
         uint8_t *buffer = NULL;
 
         if (session->mt_recv) {
-                buflen = udp_recv_data(session->rtp_socket, (char **) &packet);
+                long long rx_ts = 0;
+                buflen = udp_recv_data_ts(session->rtp_socket, (char **) &packet, &rx_ts);
                 buffer = ((uint8_t *) packet) + RTP_PACKET_HEADER_SIZE;
+                if (rx_ts != 0) {
+                        // kernel arrival time instead of the dequeue time for
+                        // jitter computation (mt sessions are video - 90 kHz)
+                        curr_rtp_ts = (uint32_t) (rx_ts / 1000 * 9 / 100);
+                }
         } else {
                 if (!session->opt->reuse_bufs || (packet == NULL)) {
                         packet = (rtp_packet *) malloc(RTP_MAX_PACKET_LEN + (session->opt->record_source ? sizeof(struct sockaddr_storage) : 0));
@@ -2068,6 +2426,44 @@ static void process_rtcp_bye(struct rtp *session, rtcp_t * packet)
         }
 }
 
+/**
+ * Echoes a path probe of a multi-path sender back to the probing socket,
+ * see rtp_tx_path_send_probe(). Only probes of senders already known from
+ * their RTP packets are echoed, so that the receiver cannot be used as
+ * a reflector towards arbitrary addresses.
+ *
+ * @param src  source address of the probe
+ * @retval true if the packet is a path probe (or its echo)
+ */
+static bool echo_path_probe(struct rtp *session, const uint8_t *packet, int len,
+                struct sockaddr_storage *src, socklen_t src_len)
+{
+        uint32_t ssrc = 0;
+        bool echo = false;
+        uint32_t probe_seq = 0;
+        uint64_t send_time = 0;
+        if (session->encryption_enabled ||
+                        !rtcp_find_path_probe(packet, len, &ssrc, &echo, &probe_seq, &send_time)) {
+                return false;
+        }
+        if (!echo) {
+                const source *s = get_source(session, ssrc);
+                if (s == NULL || !s->sender) {
+                        debug_msg("Path probe from unknown sender 0x%08" PRIx32 " ignored.\n", ssrc);
+                        return true;
+                }
+                uint8_t buffer[RTCP_PATH_PROBE_LEN];
+                int buflen = rtcp_format_path_probe(buffer, sizeof buffer, rtp_my_ssrc(session), true, probe_seq,
+                                send_time);
+                if (session->rtcp_thread_running) {
+                        rtcp_queue_out(session, buffer, buflen, src, src_len);
+                } else {
+                        udp_sendto(session->rtcp_socket, (char *) buffer, buflen, (struct sockaddr *) src, src_len);
+                }
+        }
+        return true;
+}
+
 static void process_rtcp_app(struct rtp *session, rtcp_t * packet)
 {
         uint32_t ssrc;
@@ -2076,6 +2472,10 @@ static void process_rtcp_app(struct rtp *session, rtcp_t * packet)
         source *s;
         int data_len;
 
+        if (memcmp(packet->r.app.name, RTCP_APP_PATH_PROBE, 4) == 0) {
+                return; // echoed in rtcp_process_received()
+        }
+
         /* Update the database for this source. */
         ssrc = ntohl(packet->r.app.ssrc);
         create_source(session, ssrc, FALSE);
@@ -2121,6 +2521,54 @@ uint32_t compute_rtt(struct rtp *session, rtcp_rx * rrx)
         return 0;
 }
 
+static void process_rtcp_psfb(struct rtp *session, rtcp_t * packet)
+{
+        /* Keyframe requests - PLI (RFC 4585) and FIR (RFC 5104). Other */
+        /* payload-specific feedback messages are ignored.              */
+        const int len = ntohs(packet->common.length); /* in 32-bit words, w/o header */
+        const uint32_t ssrc = ntohl(packet->r.psfb.ssrc);
+        bool for_us = false;
+
+        if (len < 2) {
+                debug_msg("PSFB packet too short\n");
+                return;
+        }
+        create_source(session, ssrc, FALSE);
+        source *s = get_source(session, ssrc);
+        if (s == NULL) {
+                debug_msg("Source 0x%08x invalid, skipping...\n", ssrc);
+                return;
+        }
+
+        if (packet->common.count == RTCP_PSFB_PLI) {
+                for_us = ntohl(packet->r.psfb.media_ssrc) == rtp_my_ssrc(session);
+        } else if (packet->common.count == RTCP_PSFB_FIR) {
+                /* FCI entries consist of SSRC and 8-bit sequence number,  */
+                /* the FCI is variable length so fci[] may not be indexed  */
+                const uint8_t *fci = (const uint8_t *) packet->r.psfb.fci;
+                for (int i = 0; i + 1 < len - 2; i += 2) {
+                        uint32_t entry[2];
+                        memcpy(entry, fci + i * sizeof(uint32_t), sizeof entry);
+                        if (ntohl(entry[0]) != rtp_my_ssrc(session)) {
+                                continue;
+                        }
+                        const int seq = ntohl(entry[1]) >> 24;
+                        /* retransmitted FIR must not trigger another keyframe */
+                        for_us = s->last_fir_seq != seq + 1;
+                        s->last_fir_seq = seq + 1;
+                        break;
+                }
+        }
+        if (!for_us || filter_event(session, ssrc)) {
+                return;
+        }
+
+        atomic_fetch_add(&session->keyframe_requests, 1);
+        rtcp_psfb psfb = { .fmt = (enum rtcp_psfb_fmt) packet->common.count, .media_ssrc = rtp_my_ssrc(session) };
+        rtp_event event = { .ssrc = ssrc, .type = RX_PSFB, .data = &psfb };
+        session->callback(session, &event);
+}
+
 static void rtp_process_ctrl(struct rtp *session, uint8_t * buffer, int buflen)
 {
         /* This routine processes incoming RTCP packets */
@@ -2239,6 +2687,9 @@ static void rtp_process_ctrl(struct rtp *session, uint8_t * buffer, int buflen)
                                         }
                                         process_rtcp_app(session, packet);
                                         break;
+                                case RTCP_PSFB:
+                                        process_rtcp_psfb(session, packet);
+                                        break;
                                 default:
                                         debug_msg
                                             ("RTCP packet with unknown type (%d) ignored.\n",
@@ -2252,18 +2703,8 @@ static void rtp_process_ctrl(struct rtp *session, uint8_t * buffer, int buflen)
                                                   1)));
                                 first = FALSE;
                         }
-                        if (session->avg_rtcp_size < 0) {
-                                /* This is the first RTCP packet we've received, set our initial estimate */
-                                /* of the average  packet size to be the size of this packet.             */
-                                session->avg_rtcp_size =
-                                    buflen + RTP_LOWER_LAYER_OVERHEAD;
-                        } else {
-                                /* Update our estimate of the average RTCP packet size. The constants are */
-                                /* 1/16 and 15/16 (section 6.3.3 of draft-ietf-avt-rtp-new-02.txt).       */
-                                session->avg_rtcp_size =
-                                    (0.0625 *
-                                     (buflen + RTP_LOWER_LAYER_OVERHEAD)) +
-                                    (0.9375 * session->avg_rtcp_size);
+                        if (!session->rtcp_thread_running) { // otherwise accounted by the thread
+                                rtcp_update_avg_size(session, buflen);
                         }
                         /* Signal that we've finished processing this packet */
                         if (!filter_event(session, packet_ssrc)) {
@@ -2316,6 +2757,43 @@ bool rtp_recv(struct rtp *session, struct timeval *timeout, uint32_t curr_rtp_ts
         return false;
 }
 
+/**
+ * Processes an RTCP packet received from src. The source becomes the RTCP
+ * destination (see send_rtcp_to_origin) except for path probes, which come
+ * from the other paths of a multi-path sender and are echoed back to it.
+ * If the RTCP thread runs, the destination was already set by the thread.
+ */
+static void rtcp_process_received(struct rtp *session, uint8_t *buffer, int buflen,
+                struct sockaddr_storage *src, socklen_t src_len)
+{
+        if (buflen > 0 && !echo_path_probe(session, buffer, buflen, src, src_len) &&
+                        !session->rtcp_thread_running) { // otherwise set by the thread
+                memcpy(&session->rtcp_dest, src, src_len);
+                session->rtcp_dest_len = src_len;
+        }
+        rtp_process_ctrl(session, buffer, buflen);
+}
+
+/**
+ * Processes RTCP packets received by the RTCP thread. Doesn't block.
+ *
+ * @retval true if any packet was processed
+ */
+static bool rtcp_process_queued(struct rtp *session)
+{
+        struct rtcp_queue_hdr hdr;
+        uint8_t buffer[RTP_MAX_PACKET_LEN];
+        bool ret = false;
+
+        while (ring_get_current_size(session->rtcp_queue) >= (int) sizeof hdr) {
+                ring_buffer_read(session->rtcp_queue, (char *) &hdr, sizeof hdr);
+                ring_buffer_read(session->rtcp_queue, (char *) buffer, hdr.len);
+                rtcp_process_received(session, buffer, hdr.len, &hdr.addr, hdr.addrlen);
+                ret = true;
+        }
+        return ret;
+}
+
 /**
  * @brief  Receive RTP packets and dispatch them.
  * 
@@ -2336,26 +2814,31 @@ bool rtp_recv_r(struct rtp *session, struct timeval *timeout, uint32_t curr_rtp_
 {
         struct udp_fd_r fd;
         
-        check_database(session);
+        if (!session->rtcp_thread_running) {
+                check_database(session);
+        }
         if (session->mt_recv) {
                 bool ret = false;
                 if (udp_not_empty(session->rtp_socket, timeout)) {
                         rtp_recv_data(session, curr_rtp_ts);
                         ret = true;
                 }
+                if (session->rtcp_thread_running) { // database checked by rtp_update()
+                        return rtcp_process_queued(session) || ret;
+                }
                 udp_fd_zero_r(&fd);
                 udp_fd_set_r(session->rtcp_socket, &fd);
                 struct timeval no_wait_tv = { .tv_sec = 0, .tv_usec = 0 };
 
                 if (udp_select_r(&no_wait_tv, &fd) > 0) {
                         uint8_t buffer[RTP_MAX_PACKET_LEN];
-                        int buflen;
-                        session->rtcp_dest_len = sizeof(session->rtcp_dest);
-                        buflen =
+                        struct sockaddr_storage src;
+                        socklen_t src_len = sizeof src;
+                        int buflen =
                                 udp_recvfrom(session->rtcp_socket, (char *)buffer,
                                                 RTP_MAX_PACKET_LEN,
-                                                (struct sockaddr *) &session->rtcp_dest, &session->rtcp_dest_len);
-                        rtp_process_ctrl(session, buffer, buflen);
+                                                (struct sockaddr *) &src, &src_len);
+                        rtcp_process_received(session, buffer, buflen, &src, src_len);
                         ret = true;
                 }
                 return ret; // NOLINTNEXTLINE(readability-else-after-return)
@@ -2369,13 +2852,13 @@ bool rtp_recv_r(struct rtp *session, struct timeval *timeout, uint32_t curr_rtp_
                         }
                         if (udp_fd_isset_r(session->rtcp_socket, &fd)) {
                                 uint8_t buffer[RTP_MAX_PACKET_LEN];
-                                int buflen;
-                                session->rtcp_dest_len = sizeof(session->rtcp_dest);
-                                buflen =
+                                struct sockaddr_storage src;
+                                socklen_t src_len = sizeof src;
+                                int buflen =
                                         udp_recvfrom(session->rtcp_socket, (char *)buffer,
                                                         RTP_MAX_PACKET_LEN,
-                                                        (struct sockaddr *) &session->rtcp_dest, &session->rtcp_dest_len);
-                                rtp_process_ctrl(session, buffer, buflen);
+                                                        (struct sockaddr *) &src, &src_len);
+                                rtcp_process_received(session, buffer, buflen, &src, src_len);
                         }
                         check_database(session);
                         return true;
@@ -2397,19 +2880,35 @@ bool rtcp_recv_r(struct rtp *session, struct timeval *timeout, uint32_t curr_rtp
         UNUSED(curr_rtp_ts);
         struct udp_fd_r fd;
 
+        if (session->rtcp_thread_running) { // database checked by rtp_update()
+                if (timeout->tv_sec != 0 || timeout->tv_usec != 0) {
+                        struct timespec deadline;
+                        clock_gettime(CLOCK_REALTIME, &deadline);
+                        long long ns = deadline.tv_nsec + timeout->tv_usec * 1000LL;
+                        deadline.tv_sec += timeout->tv_sec + ns / NS_IN_SEC;
+                        deadline.tv_nsec = ns % NS_IN_SEC;
+                        pthread_mutex_lock(&session->rtcp_queue_lock);
+                        while (ring_get_current_size(session->rtcp_queue) == 0 &&
+                               pthread_cond_timedwait(&session->rtcp_queue_cv,
+                                                      &session->rtcp_queue_lock, &deadline) == 0) {
+                        }
+                        pthread_mutex_unlock(&session->rtcp_queue_lock);
+                }
+                return rtcp_process_queued(session);
+        }
         check_database(session);
         udp_fd_zero_r(&fd);
         udp_fd_set_r(session->rtcp_socket, &fd);
         if (udp_select_r(timeout, &fd) > 0) {
                 if (udp_fd_isset_r(session->rtcp_socket, &fd)) {
                         uint8_t buffer[RTP_MAX_PACKET_LEN];
-                        int buflen;
-                        session->rtcp_dest_len = sizeof(session->rtcp_dest);
-                        buflen =
+                        struct sockaddr_storage src;
+                        socklen_t src_len = sizeof src;
+                        int buflen =
                                 udp_recvfrom(session->rtcp_socket, (char *)buffer,
                                                 RTP_MAX_PACKET_LEN,
-                                                (struct sockaddr *) &session->rtcp_dest, &session->rtcp_dest_len);
-                        rtp_process_ctrl(session, buffer, buflen);
+                                                (struct sockaddr *) &src, &src_len);
+                        rtcp_process_received(session, buffer, buflen, &src, src_len);
                 }
                 check_database(session);
                 return true;
@@ -2929,6 +3428,168 @@ rtp_send_data_hdr(struct rtp *session,
         return rc;
 }
 
+/**
+ * Sets intended send time (traffic shaper deadline) of the next packet sent
+ * by rtp_send_data_hdr(), used by kernel TX timestamp statistics.
+ * @see udp_set_tx_deadline()
+ */
+void rtp_set_tx_deadline(struct rtp *session, time_ns_t deadline)
+{
+        udp_set_tx_deadline(session->rtp_socket, deadline);
+}
+
+struct rtp_tx_stripe {
+        socket_udp *sock;
+        bool own_dest; ///< path with own destination (rtp_tx_path_init())
+};
+
+/**
+ * @returns stripe for sending packets of the session from another thread,
+ *          NULL if the session features do not allow it (TFRC, RTP-level
+ *          encryption) or the socket cannot be created
+ */
+struct rtp_tx_stripe *rtp_tx_stripe_init(struct rtp *session)
+{
+        if (session->tfrc_on || session->encryption_enabled) {
+                log_msg(LOG_LEVEL_WARNING, "[RTP] Striped sending not supported with TFRC or RTP encryption.\n");
+                return NULL;
+        }
+        socket_udp *sock = udp_init_tx_stripe(session->rtp_socket);
+        if (sock == NULL) {
+                return NULL;
+        }
+        struct rtp_tx_stripe *stripe = calloc(1, sizeof *stripe);
+        stripe->sock = sock;
+        return stripe;
+}
+
+/**
+ * Creates a stripe sending to another destination addr (the same port as the
+ * session) and optionally through the interface iface. The receiver merges
+ * packets from all paths of the session, as they have the same SSRC.
+ */
+struct rtp_tx_stripe *rtp_tx_path_init(struct rtp *session, const char *addr, const char *iface)
+{
+        if (session->tfrc_on || session->encryption_enabled) {
+                log_msg(LOG_LEVEL_WARNING, "[RTP] Multi-path sending not supported with TFRC or RTP encryption.\n");
+                return NULL;
+        }
+        socket_udp *sock = udp_init_tx_path(session->rtp_socket, addr, iface);
+        if (sock == NULL) {
+                return NULL;
+        }
+        struct rtp_tx_stripe *path = calloc(1, sizeof *path);
+        path->sock = sock;
+        path->own_dest = true;
+        return path;
+}
+
+/**
+ * Sends a path probe (RTCP APP) through the path to the RTCP port of the
+ * receiver, which echoes it back to the path socket.
+ */
+bool rtp_tx_path_send_probe(struct rtp *session, struct rtp_tx_stripe *path,
+                uint32_t probe_seq, uint64_t send_time)
+{
+        uint8_t buffer[RTCP_PATH_PROBE_LEN];
+        int len = rtcp_format_path_probe(buffer, sizeof buffer, rtp_my_ssrc(session), false, probe_seq, send_time);
+        return udp_send_to_port(path->sock, (char *) buffer, len, udp_get_tx_port(path->sock) + 1) == len;
+}
+
+/**
+ * Receives a probe echo sent to the path socket. Doesn't block.
+ *
+ * @retval true if an echo was received
+ */
+bool rtp_tx_path_recv_echo(struct rtp_tx_stripe *path, uint32_t *probe_seq, uint64_t *send_time)
+{
+        uint8_t buffer[RTP_MAX_PACKET_LEN];
+        struct timeval timeout = { 0, 0 };
+        int len = 0;
+        while ((len = udp_recv_timeout(path->sock, (char *) buffer, sizeof buffer, &timeout)) > 0) {
+                bool echo = false;
+                uint32_t ssrc = 0;
+                if (rtcp_find_path_probe(buffer, len, &ssrc, &echo, probe_seq, send_time) && echo) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+void rtp_tx_stripe_done(struct rtp_tx_stripe *stripe)
+{
+        if (stripe == NULL) {
+                return;
+        }
+        udp_exit(stripe->sock);
+        free(stripe);
+}
+
+/// @returns first of count consecutive sequence numbers for rtp_send_data_hdr_stripe()
+uint16_t rtp_reserve_seq(struct rtp *session, int count)
+{
+        uint16_t first = session->rtp_seq;
+        session->rtp_seq += count;
+        return first;
+}
+
+/**
+ * Thread-safe variant of rtp_send_data_hdr() for sending through a stripe
+ * with a sequence number reserved by rtp_reserve_seq(). Neither CSRCs nor
+ * header extensions are supported, session statistics are not updated (see
+ * rtp_stripe_update_stats()).
+ */
+int rtp_send_data_hdr_stripe(struct rtp *session, struct rtp_tx_stripe *stripe,
+                uint16_t seq, uint32_t rtp_ts, char pt, int m,
+                char *phdr, int phdr_len, char *data, int data_len)
+{
+        union {
+                rtp_packet packet;
+                uint8_t buffer[RTP_PACKET_HEADER_SIZE + 12];
+        } u;
+        rtp_packet *packet = &u.packet;
+        packet->v = 2;
+        packet->p = 0;
+        packet->x = 0;
+        packet->cc = 0;
+        packet->m = m;
+        packet->pt = pt;
+        packet->seq = htons(seq);
+        packet->ts = htonl(rtp_ts);
+        packet->ssrc = htonl(session->my_ssrc);
+
+#ifdef _WIN32
+        WSABUF send_vector[3];
+        send_vector[0].buf = (char *) (u.buffer + RTP_PACKET_HEADER_SIZE);
+        send_vector[0].len = 12;
+        send_vector[1].buf = phdr;
+        send_vector[1].len = phdr_len;
+        send_vector[2].buf = data;
+        send_vector[2].len = data_len;
+#else
+        struct iovec send_vector[3] = {
+                { u.buffer + RTP_PACKET_HEADER_SIZE, 12 },
+                { phdr, phdr_len },
+                { data, data_len },
+        };
+#endif
+        int rc = udp_sendv_stripe(stripe->own_dest ? stripe->sock : session->rtp_socket, stripe->sock, send_vector, 3);
+        if (rc == -1) {
+                log_msg(LOG_LEVEL_WARNING, "sending RTP packet: %s", ug_strerror(errno));
+        }
+        return rc;
+}
+
+/// accounts packets sent by rtp_send_data_hdr_stripe() to the RTCP statistics
+void rtp_stripe_update_stats(struct rtp *session, long packets, long data_bytes)
+{
+        session->we_sent = TRUE;
+        session->rtp_pcount += packets;
+        session->rtp_bcount += 12 * packets;
+        session->rtp_bytes_sent += 12 * packets + data_bytes;
+        session->last_rtp_send_time = get_time_in_ns();
+}
+
 static int format_report_blocks(rtcp_rr * rrp, int remaining_length,
                                 struct rtp *session)
 {
@@ -3256,9 +3917,30 @@ static uint8_t *format_rtcp_app(uint8_t * buffer, int buflen, uint32_t ssrc,
 /**
  * Sends the RTCP packet over UDP to either a configured host (if specified on
  * the command-line) or to the destination from which we are receiving RTCP.
+ * If the RTCP thread runs, the packet is queued to be sent by the thread.
  */
 static void rtcp_udp_send(struct rtp *session, int len, char *buffer)
 {
+        if (session->rtcp_thread_running) {
+                rtcp_queue_out(session, (uint8_t *) buffer, len, NULL, 0);
+                return;
+        }
+        rtcp_udp_send_direct(session, len, buffer, NULL, 0);
+}
+
+/**
+ * @param dst  explicit destination, NULL to use the session one (see rtcp_udp_send())
+ */
+static void rtcp_udp_send_direct(struct rtp *session, int len, char *buffer,
+                                 struct sockaddr_storage *dst, socklen_t dst_len)
+{
+        if (dst != NULL) {
+                if (udp_sendto(session->rtcp_socket, buffer, len, (struct sockaddr *) dst, dst_len) == -1) {
+                        log_msg(LOG_LEVEL_WARNING, "sending RTCP packet: %s\n",
+                                ug_strerror(errno));
+                }
+                return;
+        }
         if (!session->send_rtcp_to_origin) {
                 int rc = udp_send(session->rtcp_socket, buffer, len);
                 if (rc == -1) {
@@ -3278,6 +3960,48 @@ static void rtcp_udp_send(struct rtp *session, int len, char *buffer)
         }
 }
 
+/**
+ * Pads (if needed) and encrypts compound RTCP packet in buffer (ending at ptr),
+ * if encryption is enabled. The buffer must be allocated MAX_ENCRYPTION_PAD
+ * longer to allow the padding.
+ *
+ * @param lpt  last packet in the compound
+ * @returns    new end of the packet
+ */
+static uint8_t *encrypt_rtcp(struct rtp *session, uint8_t *buffer, uint8_t *ptr,
+                             uint8_t *lpt)
+{
+        uint8_t initVec[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+        if (!session->encryption_enabled) {
+                return ptr;
+        }
+        if (((ptr - buffer) % session->encryption_pad_length) != 0) {
+                /* Add padding to the last packet in the compound, if necessary. */
+                /* We don't have to worry about overflowing the buffer, since we */
+                /* intentionally allocated it 8 bytes longer to allow for this.  */
+                int padlen =
+                    session->encryption_pad_length -
+                    ((ptr - buffer) % session->encryption_pad_length);
+                int i;
+
+                for (i = 0; i < padlen - 1; i++) {
+                        *(ptr++) = '\0';
+                }
+                *(ptr++) = (uint8_t) padlen;
+                assert(((ptr -
+                         buffer) % session->encryption_pad_length) ==
+                       0);
+
+                ((rtcp_t *)(void *) lpt)->common.p = TRUE;
+                ((rtcp_t *)(void *) lpt)->common.length =
+                    htons((int16_t) (((ptr - lpt) / 4) - 1));
+        }
+        (session->encrypt_func) (session, buffer, ptr - buffer,
+                                 initVec);
+        return ptr;
+}
+
 static void send_rtcp(struct rtp *session, uint32_t rtp_ts,
                       rtcp_app_callback appcallback)
 {
@@ -3289,7 +4013,6 @@ static void send_rtcp(struct rtp *session, uint32_t rtp_ts,
         uint8_t *old_ptr;
         uint8_t *lpt;           /* the last packet in the compound */
         rtcp_app *app;
-        uint8_t initVec[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
 
         check_database(session);
         /* If encryption is enabled, add a 32 bit random prefix to the packet */
@@ -3356,31 +4079,7 @@ static void send_rtcp(struct rtp *session, uint32_t rtp_ts,
         }
 
         /* And encrypt if desired... */
-        if (session->encryption_enabled) {
-                if (((ptr - buffer) % session->encryption_pad_length) != 0) {
-                        /* Add padding to the last packet in the compound, if necessary. */
-                        /* We don't have to worry about overflowing the buffer, since we */
-                        /* intentionally allocated it 8 bytes longer to allow for this.  */
-                        int padlen =
-                            session->encryption_pad_length -
-                            ((ptr - buffer) % session->encryption_pad_length);
-                        int i;
-
-                        for (i = 0; i < padlen - 1; i++) {
-                                *(ptr++) = '\0';
-                        }
-                        *(ptr++) = (uint8_t) padlen;
-                        assert(((ptr -
-                                 buffer) % session->encryption_pad_length) ==
-                               0);
-
-                        ((rtcp_t *)(void *) lpt)->common.p = TRUE;
-                        ((rtcp_t *)(void *) lpt)->common.length =
-                            htons((int16_t) (((ptr - lpt) / 4) - 1));
-                }
-                (session->encrypt_func) (session, buffer, ptr - buffer,
-                                         initVec);
-        }
+        ptr = encrypt_rtcp(session, buffer, ptr, lpt);
 
         rtcp_udp_send(session, ptr - buffer, (char *)buffer);
         /* Loop the data back to ourselves so local participant can */
@@ -3390,6 +4089,19 @@ static void send_rtcp(struct rtp *session, uint32_t rtp_ts,
         check_database(session);
 }
 
+static void rtcp_reset_senders(struct rtp *session)
+{
+        /* We're starting a new RTCP reporting interval, zero out */
+        /* the per-interval statistics.                           */
+        session->sender_count = 0;
+        for (int h = 0; h < RTP_DB_SIZE; h++) {
+                for (source *s = session->db[h]; s != NULL; s = s->next) {
+                        check_source(s);
+                        s->sender = FALSE;
+                }
+        }
+}
+
 /**
  * rtp_send_ctrl:
  * @session: the session pointer (returned by rtp_init())
@@ -3402,6 +4114,10 @@ static void send_rtcp(struct rtp *session, uint32_t rtp_ts,
  * whether the local participant is a sender.  This function should be
  * called at least once per second, and can be safely called more
  * frequently.  
+ *
+ * If the RTCP thread runs, the timer is evaluated by the thread (using the
+ * membership published here) and this function only sends the report when
+ * the thread flags it as due.
  */
 void rtp_send_ctrl(struct rtp *session, uint32_t rtp_ts,
                    rtcp_app_callback appcallback, time_ns_t curr_time)
@@ -3409,11 +4125,17 @@ void rtp_send_ctrl(struct rtp *session, uint32_t rtp_ts,
         /* Send an RTCP packet, if one is due... */
 
         check_database(session);
+        if (session->rtcp_thread_running) {
+                rtcp_sched_publish(session);
+                if (atomic_exchange(&session->rtcp_report_due, false)) {
+                        send_rtcp(session, rtp_ts, appcallback);
+                        rtcp_reset_senders(session);
+                }
+                return;
+        }
         if (curr_time > session->next_rtcp_send_time) {
                 /* The RTCP transmission timer has expired. The following */
                 /* implements draft-ietf-avt-rtp-new-02.txt section 6.3.6 */
-                int h;
-                source *s;
                 double new_interval =
                     rtcp_interval(session) / (session->csrc_count + 1);
                 time_ns_t new_send_time = session->last_rtcp_send_time + new_interval * NS_IN_SEC;
@@ -3423,15 +4145,7 @@ void rtp_send_ctrl(struct rtp *session, uint32_t rtp_ts,
                         session->last_rtcp_send_time = curr_time;
                         session->next_rtcp_send_time = curr_time + (rtcp_interval(session) / (session->csrc_count +
                                                          1)) * NS_IN_SEC;
-                        /* We're starting a new RTCP reporting interval, zero out */
-                        /* the per-interval statistics.                           */
-                        session->sender_count = 0;
-                        for (h = 0; h < RTP_DB_SIZE; h++) {
-                                for (s = session->db[h]; s != NULL; s = s->next) {
-                                        check_source(s);
-                                        s->sender = FALSE;
-                                }
-                        }
+                        rtcp_reset_senders(session);
                 } else {
                         session->next_rtcp_send_time = new_send_time;
                 }
@@ -3448,7 +4162,8 @@ void rtp_send_ctrl(struct rtp *session, uint32_t rtp_ts,
  * housekeeping.  This function should be called at least once per
  * second.  It uses an internal timer to limit the number of passes
  * through the data structures to once per second, it can be safely
- * called more frequently.
+ * called more frequently. If the RTCP thread runs, the thread keeps
+ * the timer and the housekeeping is done once it is flagged as due.
  */
 void rtp_update(struct rtp *session, time_ns_t curr_time)
 {
@@ -3456,15 +4171,22 @@ void rtp_update(struct rtp *session, time_ns_t curr_time)
         int h;
         source *s, *n;
 
-        if (curr_time - session->last_update < 1 * NS_IN_SEC) {
-                /* We only perform housekeeping once per second... */
-                return;
+        if (session->rtcp_thread_running) {
+                if (!atomic_exchange(&session->rtcp_update_due, false)) {
+                        return;
+                }
+        } else {
+                if (curr_time - session->last_update < 1 * NS_IN_SEC) {
+                        /* We only perform housekeeping once per second... */
+                        return;
+                }
+                session->last_update = curr_time;
         }
-        session->last_update = curr_time;
 
         /* Update we_sent (section 6.3.8 of RTP spec) */
         time_ns_t delay = curr_time - session->last_rtp_send_time;
-        if (delay >= 2 * NS_IN_SEC * rtcp_interval(session)) {
+        if (delay >= 2 * NS_IN_SEC * (session->rtcp_thread_running ?
+                                session->rtcp_interval : rtcp_interval(session))) {
                 session->we_sent = FALSE;
         }
 
@@ -3598,6 +4320,8 @@ void rtp_send_bye(struct rtp *session)
         int buflen;
         double new_interval;
 
+        /* BYE is sent (and possibly reconsidered) by the calling thread */
+        rtcp_thread_stop(session);
         check_database(session);
 
         /* "...a participant which never sent an RTP or RTCP packet MUST NOT send  */
@@ -3675,6 +4399,7 @@ void rtp_done(struct rtp *session)
         int i;
         source *s, *n;
 
+        rtcp_thread_stop(session);
         check_database(session);
         /* In delete_source, check database gets called and this assumes */
         /* first added and last removed is us.                           */
@@ -4016,6 +4741,188 @@ bool rtp_has_receiver(struct rtp *session)
                !udp_is_server_mode_blackhole(session->rtp_socket);
 }
 
+/**
+ * Formats compound RTCP packet with a keyframe request - an empty receiver
+ * report followed by either Picture Loss Indication (RFC 4585) or Full Intra
+ * Request (RFC 5104).
+ *
+ * This function doesn't need a RTP session so that it can be used also by
+ * a reflector forwarding the requests.
+ *
+ * @param ssrc        SSRC of the requester
+ * @param media_ssrc  SSRC of the media sender the request is targeted to
+ * @param fir_seq     FIR command sequence number (ignored for PLI)
+ * @returns           length of the packet or -1 if buffer is too small
+ */
+int rtcp_format_keyframe_request(uint8_t *buffer, int buflen, uint32_t ssrc,
+                                 uint32_t media_ssrc, enum rtcp_psfb_fmt fmt,
+                                 uint8_t fir_seq)
+{
+        const int psfb_len = fmt == RTCP_PSFB_FIR ? 20 : 12;
+        if (buflen < 8 + psfb_len) {
+                return -1;
+        }
+
+        rtcp_t *rr = (rtcp_t *)(void *) buffer;
+        rr->common.version = 2;
+        rr->common.p = 0;
+        rr->common.count = 0;
+        rr->common.pt = RTCP_RR;
+        rr->common.length = htons(1);
+        rr->r.rr.ssrc = htonl(ssrc);
+
+        rtcp_t *psfb = (rtcp_t *)(void *) (buffer + 8);
+        psfb->common.version = 2;
+        psfb->common.p = 0;
+        psfb->common.count = fmt;
+        psfb->common.pt = RTCP_PSFB;
+        psfb->common.length = htons(psfb_len / 4 - 1);
+        psfb->r.psfb.ssrc = htonl(ssrc);
+        if (fmt == RTCP_PSFB_FIR) {
+                /* media source SSRC is unused in FIR, target is in FCI */
+                psfb->r.psfb.media_ssrc = 0;
+                psfb->r.psfb.fci[0] = htonl(media_ssrc);
+                psfb->r.psfb.fci[1] = htonl((uint32_t) fir_seq << 24);
+        } else {
+                psfb->r.psfb.media_ssrc = htonl(media_ssrc);
+        }
+
+        return 8 + psfb_len;
+}
+
+/**
+ * Looks up a keyframe request (PLI or FIR) in a compound RTCP packet.
+ *
+ * @param[out] media_ssrc  SSRC of the source the keyframe is requested from
+ * @returns                true if the packet contains a keyframe request
+ */
+bool rtcp_find_keyframe_request(const uint8_t *buffer, int buflen,
+                                uint32_t *media_ssrc)
+{
+        while (buflen >= 12) {
+                const rtcp_t *pkt = (const rtcp_t *)(const void *) buffer;
+                const int len = (ntohs(pkt->common.length) + 1) * 4;
+                if (pkt->common.version != 2 || len > buflen) {
+                        return false;
+                }
+                if (pkt->common.pt == RTCP_PSFB) {
+                        if (pkt->common.count == RTCP_PSFB_PLI && len >= 12) {
+                                *media_ssrc = ntohl(pkt->r.psfb.media_ssrc);
+                                return true;
+                        }
+                        if (pkt->common.count == RTCP_PSFB_FIR && len >= 20) {
+                                *media_ssrc = ntohl(pkt->r.psfb.fci[0]);
+                                return true;
+                        }
+                }
+                buffer += len;
+                buflen -= len;
+        }
+        return false;
+}
+
+/**
+ * Formats a path probe (or its echo) - compound RTCP packet of an empty RR and
+ * APP packet "UGPP" with subtype 0 (probe) or 1 (echo) carrying the probe
+ * sequence number and the send time of the prober.
+ *
+ * @returns packet length (RTCP_PATH_PROBE_LEN), -1 if buflen is insufficient
+ */
+int rtcp_format_path_probe(uint8_t *buffer, int buflen, uint32_t ssrc, bool echo,
+                           uint32_t probe_seq, uint64_t send_time)
+{
+        if (buflen < RTCP_PATH_PROBE_LEN) {
+                return -1;
+        }
+
+        rtcp_t *rr = (rtcp_t *)(void *) buffer;
+        rr->common.version = 2;
+        rr->common.p = 0;
+        rr->common.count = 0;
+        rr->common.pt = RTCP_RR;
+        rr->common.length = htons(1);
+        rr->r.rr.ssrc = htonl(ssrc);
+
+        rtcp_t *app = (rtcp_t *)(void *) (buffer + 8);
+        app->common.version = 2;
+        app->common.p = 0;
+        app->common.count = echo ? 1 : 0;
+        app->common.pt = RTCP_APP;
+        app->common.length = htons((RTCP_PATH_PROBE_LEN - 8) / 4 - 1);
+        app->r.app.ssrc = htonl(ssrc);
+        memcpy(app->r.app.name, RTCP_APP_PATH_PROBE, 4);
+        uint32_t data[3] = { htonl(probe_seq), htonl(send_time >> 32), htonl(send_time & 0xFFFFFFFFU) };
+        memcpy(app->r.app.data, data, sizeof data);
+
+        return RTCP_PATH_PROBE_LEN;
+}
+
+/**
+ * Looks up a path probe or echo (see rtcp_format_path_probe()) in a compound
+ * RTCP packet.
+ */
+bool rtcp_find_path_probe(const uint8_t *buffer, int buflen, uint32_t *ssrc, bool *echo,
+                          uint32_t *probe_seq, uint64_t *send_time)
+{
+        while (buflen >= 8) {
+                const rtcp_t *pkt = (const rtcp_t *)(const void *) buffer;
+                const int len = (ntohs(pkt->common.length) + 1) * 4;
+                if (pkt->common.version != 2 || len > buflen) {
+                        return false;
+                }
+                if (pkt->common.pt == RTCP_APP && len >= RTCP_PATH_PROBE_LEN - 8 &&
+                                memcmp(pkt->r.app.name, RTCP_APP_PATH_PROBE, 4) == 0) {
+                        uint32_t data[3];
+                        memcpy(data, pkt->r.app.data, sizeof data);
+                        *ssrc = ntohl(pkt->r.app.ssrc);
+                        *echo = pkt->common.count == 1;
+                        *probe_seq = ntohl(data[0]);
+                        *send_time = (uint64_t) ntohl(data[1]) << 32 | ntohl(data[2]);
+                        return true;
+                }
+                buffer += len;
+                buflen -= len;
+        }
+        return false;
+}
+
+/**
+ * Sends a keyframe request to the media sender immediately (not subject to
+ * RTCP transmission interval).
+ *
+ * @param media_ssrc  SSRC of the sender the keyframe is requested from
+ */
+bool rtp_send_keyframe_request(struct rtp *session, uint32_t media_ssrc,
+                               enum rtcp_psfb_fmt fmt)
+{
+        uint8_t buffer[4 + 28 + MAX_ENCRYPTION_PAD];
+        uint8_t *ptr = buffer;
+
+        if (session->encryption_enabled) {
+                *((uint32_t *)(void *) ptr) = ug_rand();
+                ptr += 4;
+        }
+        int len = rtcp_format_keyframe_request(ptr, 28, rtp_my_ssrc(session),
+                                               media_ssrc, fmt,
+                                               session->fir_seq++);
+        if (len < 0) {
+                return false;
+        }
+        uint8_t *lpt = ptr + 8;
+        ptr = encrypt_rtcp(session, buffer, ptr + len, lpt);
+        rtcp_udp_send(session, ptr - buffer, (char *)buffer);
+        return true;
+}
+
+/**
+ * @returns number of keyframe requests (PLI/FIR) targeted to our source
+ *          received since the last call
+ */
+int rtp_get_keyframe_requests(struct rtp *session)
+{
+        return atomic_exchange(&session->keyframe_requests, 0);
+}
+
 bool rtp_is_ipv6(struct rtp *session)
 {
         return udp_is_ipv6(session->rtp_socket);
@@ -191,7 +191,8 @@ typedef enum {
         RX_RTCP_FINISH,	/* Processing a compound RTCP packet finished. The SSRC is not valid in this event.       */
         RR_TIMEOUT,
         RX_APP,
-	PEEK_RTP
+	PEEK_RTP,
+        RX_PSFB,        /* Payload-specific feedback (keyframe request) for our source, data is rtcp_psfb */
 } rtp_event_type;
 
 typedef struct {
@@ -200,6 +201,18 @@ typedef struct {
 	void		*data;
 } rtp_event;
 
+/* Payload-specific feedback message types (RFC 4585, RFC 5104) */
+enum rtcp_psfb_fmt {
+        RTCP_PSFB_PLI = 1, /* Picture Loss Indication */
+        RTCP_PSFB_FIR = 4, /* Full Intra Request      */
+};
+
+/* Data of the RX_PSFB event */
+typedef struct {
+        enum rtcp_psfb_fmt fmt;
+        uint32_t           media_ssrc; /* source the keyframe is requested from (ours) */
+} rtcp_psfb;
+
 /* Callback types */
 typedef void (*rtp_callback)(struct rtp *session, rtp_event *e);
 typedef rtcp_app* (*rtcp_app_callback)(struct rtp *session, uint32_t rtp_ts, int max_size);
@@ -283,8 +296,38 @@ int 		 rtp_send_data_hdr(struct rtp *session,
                                char *phdr, int phdr_len, 
                                char *data, int data_len,
 			       char *extn, uint16_t extn_len, uint16_t extn_type);
+void             rtp_set_tx_deadline(struct rtp *session, time_ns_t deadline);
 void 		 rtp_send_ctrl(struct rtp *session, uint32_t rtp_ts, 
 			       rtcp_app_callback appcallback, time_ns_t curr_time);
+
+/*
+ * Striped sending - packets of one session are sent from multiple threads,
+ * each using its own socket (stripe). Sequence numbers are reserved in advance
+ * by the owning thread, which also updates the statistics afterwards.
+ */
+struct rtp_tx_stripe;
+struct rtp_tx_stripe *rtp_tx_stripe_init(struct rtp *session);
+void             rtp_tx_stripe_done(struct rtp_tx_stripe *stripe);
+uint16_t         rtp_reserve_seq(struct rtp *session, int count);
+int              rtp_send_data_hdr_stripe(struct rtp *session, struct rtp_tx_stripe *stripe,
+                               uint16_t seq, uint32_t rtp_ts, char pt, int m,
+                               char *phdr, int phdr_len, char *data, int data_len);
+void             rtp_stripe_update_stats(struct rtp *session, long packets, long data_bytes);
+
+/*
+ * Multi-path sending - stripes with own destination/interface. Per-path RTT
+ * and loss is measured by RTCP APP probes echoed by the receiver.
+ */
+#define RTCP_APP_PATH_PROBE "UGPP"
+#define RTCP_PATH_PROBE_LEN 32
+struct rtp_tx_stripe *rtp_tx_path_init(struct rtp *session, const char *addr, const char *iface);
+bool             rtp_tx_path_send_probe(struct rtp *session, struct rtp_tx_stripe *path,
+                               uint32_t probe_seq, uint64_t send_time);
+bool             rtp_tx_path_recv_echo(struct rtp_tx_stripe *path, uint32_t *probe_seq, uint64_t *send_time);
+int              rtcp_format_path_probe(uint8_t *buffer, int buflen, uint32_t ssrc, bool echo,
+                                        uint32_t probe_seq, uint64_t send_time);
+bool             rtcp_find_path_probe(const uint8_t *buffer, int buflen, uint32_t *ssrc, bool *echo,
+                                      uint32_t *probe_seq, uint64_t *send_time);
 void 		 rtp_update(struct rtp *session, time_ns_t curr_time);
 
 uint32_t	 rtp_my_ssrc(struct rtp *session);
@@ -316,6 +359,15 @@ int              rtp_compute_fract_lost(struct rtp *session, uint32_t ssrc);
 bool             rtp_is_ipv6(struct rtp *session);
 bool             rtp_has_receiver(struct rtp *session);
 
+/*
+ * Keyframe requests (RTCP PLI/FIR)
+ */
+bool             rtp_send_keyframe_request(struct rtp *session, uint32_t media_ssrc, enum rtcp_psfb_fmt fmt);
+int              rtp_get_keyframe_requests(struct rtp *session);
+int              rtcp_format_keyframe_request(uint8_t *buffer, int buflen, uint32_t ssrc, uint32_t media_ssrc,
+                                              enum rtcp_psfb_fmt fmt, uint8_t fir_seq);
+bool             rtcp_find_keyframe_request(const uint8_t *buffer, int buflen, uint32_t *media_ssrc);
+
 /*
  * Async API - MSW specific
  *
@@ -250,6 +250,11 @@ void rtp_recv_callback(struct rtp *session, rtp_event * e)
                 break;
         case RX_BYE:
                 break;
+        case RX_PSFB:
+                log_msg(LOG_LEVEL_VERBOSE, "Received %s from SSRC 0x%08" PRIx32 "\n",
+                        ((rtcp_psfb *) e->data)->fmt == RTCP_PSFB_FIR ? "FIR" : "PLI",
+                        e->ssrc);
+                break;
         case SOURCE_DELETED:
                 {
                         struct pdb_e *pdb_item = NULL;
@@ -112,6 +112,7 @@
 #include "rtp/rtp_callback.h"
 #include "rtp/pbuf.h"
 #include "rtp/video_decoders.h"
+#include "tv.h"
 #include "utils/color_out.h"
 #include "utils/macros.h"
 #include "utils/misc.h"
@@ -140,6 +141,7 @@
 #endif
 
 #define MOD_NAME "[video dec.] "
+#define KEYFRAME_REQ_MIN_INTERVAL_MS 500
 
 #define FRAMEBUFFER_NOT_READY(decoder) (decoder->frame == NULL && decoder->out_codec != VIDEO_CODEC_END)
 
@@ -215,11 +217,15 @@ struct reported_statistics_cumul {
         chrono::steady_clock::time_point t_last = chrono::steady_clock::now();
         unsigned long int displayed = 0, dropped = 0, corrupted = 0, missing = 0;
         atomic_ulong fec_ok = 0, fec_corrected = 0, fec_nok = 0;
+        atomic_int degradation_level = 0; ///< decompressor quality degradation due to overload
         void print() {
                 ostringstream fec;
                 if (fec_ok + fec_nok + fec_corrected > 0) {
                         fec << " FEC noerr/OK/NOK: " << SBOLD(fec_ok) << "/" << SBOLD(fec_corrected) << "/" << SBOLD(fec_nok);
                 }
+                if (degradation_level > 0) {
+                        fec << " / degradation lvl " << SBOLD(degradation_level);
+                }
                 unsigned long total = displayed + dropped + missing;
                 LOG(LOG_LEVEL_INFO) << SUNDERLINE("Video dec stats") << " (cumulative): "
                         << SBOLD(total) << " total / "
@@ -380,8 +386,22 @@ struct state_video_decoder
         struct openssl_decrypt      *decrypt = NULL; ///< decrypt state
 
         struct reported_statistics_cumul stats = {}; ///< stats to be reported through control socket
+
+        /// keyframe request to be sent to the sender (0 - none, otherwise enum rtcp_psfb_fmt),
+        /// FIR is initially pending because a new receiver needs a keyframe to start decoding
+        atomic_int keyframe_request{RTCP_PSFB_FIR};
+        time_ns_t last_keyframe_request = 0;
 };
 
+/**
+ * Marks that a keyframe is needed (because of a lost or a corrupted frame), PLI is used.
+ * Actual request is sent by the RTP receiver, see video_decoder_get_keyframe_request().
+ */
+static void request_keyframe(struct state_video_decoder *decoder) {
+        int none = 0;
+        decoder->keyframe_request.compare_exchange_strong(none, RTCP_PSFB_PLI);
+}
+
 /**
  * This function blocks until video frame is displayed and decoder::frame
  * can be filled with new data. Until this point, the video frame is not considered
@@ -457,6 +477,7 @@ static void *fec_thread(void *args) {
 
                                 if (ret == false) {
                                         data->is_corrupted = true;
+                                        request_keyframe(decoder);
                                         verbose_msg("[decoder] FEC: unable to reconstruct data.\n");
                                         if (fec_out_len < (int) sizeof(video_payload_hdr_t)) {
                                                 goto cleanup;
@@ -534,6 +555,7 @@ static void *fec_thread(void *args) {
                                                         (unsigned int) sum_map(data->pckt_list[i]),
                                                         decoder->decoder_type == EXTERNAL_DECODER && !decoder->accepts_corrupted_frame ? " dropped.\n" : "");
                                         data->is_corrupted = true;
+                                        request_keyframe(decoder);
                                         if(decoder->decoder_type == EXTERNAL_DECODER && !decoder->accepts_corrupted_frame) {
                                                 goto cleanup;
                                         }
@@ -665,6 +687,18 @@ static void *decompress_thread(void *args) {
                                         wait_task(handle[pos]);
                                 }
                         }
+                        int degradation_level = 0;
+                        size_t len = sizeof degradation_level;
+                        if (decompress_get_property(decoder->decompress_state.at(0), DECOMPRESS_PROPERTY_DEGRADATION_LEVEL,
+                                                &degradation_level, &len)) {
+                                msg->stats.degradation_level = degradation_level;
+                        }
+                        int keyframe_needed = 0;
+                        len = sizeof keyframe_needed;
+                        if (decompress_get_property(decoder->decompress_state.at(0), DECOMPRESS_PROPERTY_KEYFRAME_NEEDED,
+                                                &keyframe_needed, &len) && keyframe_needed) {
+                                request_keyframe(decoder);
+                        }
                         for (int pos = 0; pos < tile_count; ++pos) {
                                 if (data[pos].ret == DECODER_GOT_CODEC) {
                                         LOG(LOG_LEVEL_NOTICE) << MOD_NAME << "Detected compression properties: " << get_pixdesc_desc(data[pos].internal_prop) << "\n";
@@ -1812,11 +1846,40 @@ cleanup:
         }
         pbuf_data->decoded++;
 
+        unsigned long missing_before = decoder->stats.missing;
         decoder->stats.update(buffer_number);
+        if (decoder->stats.missing != missing_before) {
+                request_keyframe(decoder);
+        }
 
         return ret;
 }
 
+/**
+ * Returns a pending keyframe request that should be sent to the sender
+ * (RTCP PLI or FIR). Requests are sent only for inter-frame codecs and
+ * are rate-limited so that a burst of losses produces a single request.
+ *
+ * @returns 0 if no request should be sent now, enum rtcp_psfb_fmt otherwise
+ */
+int video_decoder_get_keyframe_request(struct state_video_decoder *decoder)
+{
+        if (decoder->keyframe_request == 0) {
+                return 0;
+        }
+        const codec_t codec = decoder->received_vid_desc.color_spec;
+        if (codec != VIDEO_CODEC_NONE && !is_codec_interframe(codec)) {
+                decoder->keyframe_request = 0; // every frame is a keyframe
+                return 0;
+        }
+        const time_ns_t now = get_time_in_ns();
+        if (now - decoder->last_keyframe_request < KEYFRAME_REQ_MIN_INTERVAL_MS * NS_IN_MS) {
+                return 0;
+        }
+        decoder->last_keyframe_request = now;
+        return decoder->keyframe_request.exchange(0);
+}
+
 static void decoder_process_message(struct module *m)
 {
         struct state_video_decoder *s = (struct state_video_decoder *) m->priv_data;
@@ -74,6 +74,7 @@ void video_decoder_destroy(struct state_video_decoder *decoder);
 bool video_decoder_register_display(struct state_video_decoder *decoder, struct display *display);
 void video_decoder_remove_display(struct state_video_decoder *decoder);
 bool parse_video_hdr(const uint32_t *hdr, struct video_desc *desc);
+int video_decoder_get_keyframe_request(struct state_video_decoder *decoder);
 
 /** @} */ // end of video_rtp_decoder
 
@@ -58,8 +58,12 @@
 
 #include <algorithm>
 #include <array>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "audio/codec.h"
@@ -80,14 +84,23 @@
 #include "types.h"
 #include "utils/jpeg_reader.h"
 #include "utils/misc.h" // unit_evaluate
+#include "utils/path_sched.h"
 #include "utils/random.h"
+#include "utils/virtual_clock.h"
 #include "video.h"
 #include "video_codec.h"
 
 #define MOD_NAME "[transmit] "
 #define TRANSMIT_MAGIC	0xe80ab15f
 
+ADD_TO_PARAM("tx-paths", "* tx-paths=<host>[%<iface>][*<weight>][+<host2>...]\n"
+                "  Send video packets over multiple network paths (bonding), weights are relative path capacities.\n"
+                "  Receiver merges the paths automatically, its playout delay should cover the RTT difference.\n");
+ADD_TO_PARAM("tx-threads", "* tx-threads=<n>\n"
+                "  Stripe packets of each video frame across <n> sender threads with own sockets (source ports).\n");
+
 #define FEC_MAX_MULT 10
+#define TX_THREADS_MAX 64
 
 #define CONTROL_PORT_BANDWIDTH_REPORT_INTERVAL_NS NS_IN_SEC
 
@@ -106,6 +119,7 @@
 #endif
 
 using std::array;
+using std::string;
 using std::vector;
 
 static void tx_update(struct tx *tx, struct video_frame *frame, int substream);
@@ -128,6 +142,273 @@ struct rate_limit_dyn {
         static constexpr int EXCESS_GAP = 4; ///< minimal gap between excessive frames
 };
 
+/**
+ * Sender threads for striped transmission of video (--param tx-threads=<n>).
+ * Packets of a tile are interleaved among the threads, each sending through
+ * its own socket (source port). Thread k sends packets k, k+n, k+2n... at the
+ * deadlines of the single-threaded schedule, so the aggregate rate stays the
+ * same while every thread has n-times longer inter-packet budget.
+ */
+struct tx_stripes {
+        struct job {
+                struct rtp *session;
+                const vector<struct rtp_tx_stripe *> *stripes;
+                uint32_t *rtp_headers;
+                int rtp_hdr_len;
+                char *data;
+                const vector<int> *packet_sizes;
+                long count;
+                uint16_t first_seq;
+                uint32_t ts;
+                int pt;
+                long packet_rate;
+                time_ns_t start;
+        };
+
+        explicit tx_stripes(int count) {
+                for (int i = 0; i < count; ++i) {
+                        threads.emplace_back(&tx_stripes::worker, this, i);
+                }
+        }
+        ~tx_stripes() {
+                {
+                        std::lock_guard<std::mutex> lk(lock);
+                        should_exit = true;
+                }
+                cv_start.notify_all();
+                for (auto &t : threads) {
+                        t.join();
+                }
+                reset();
+        }
+        /**
+         * Sends packets [0, count) of the tile and waits for completion.
+         * @retval false striping is not usable for the session, packets not sent
+         */
+        bool send(struct rtp *session, uint32_t *rtp_headers, int rtp_hdr_len, char *data,
+                        const vector<int> &packet_sizes, long count, uint32_t ts, int pt, long packet_rate) {
+                if (session != stripes_session) {
+                        if (stripes_session != nullptr) {
+                                log_msg(LOG_LEVEL_NOTICE, MOD_NAME "RTP session changed, recreating stripes.\n");
+                                reset();
+                        }
+                        init(session);
+                }
+                if (stripes.empty()) {
+                        return false;
+                }
+                {
+                        std::lock_guard<std::mutex> lk(lock);
+                        cur = job{ session, &stripes, rtp_headers, rtp_hdr_len, data, &packet_sizes, count,
+                                rtp_reserve_seq(session, count), ts, pt, packet_rate, get_time_in_ns() };
+                        pending = threads.size();
+                        generation += 1;
+                }
+                cv_start.notify_all();
+                std::unique_lock<std::mutex> lk(lock);
+                cv_done.wait(lk, [this] { return pending == 0; });
+                long data_bytes = 0;
+                for (long i = 0; i < count; ++i) {
+                        data_bytes += packet_sizes[i % packet_sizes.size()];
+                }
+                rtp_stripe_update_stats(session, count, data_bytes);
+                return true;
+        }
+
+private:
+        void init(struct rtp *session) {
+                stripes_session = session;
+                for (size_t i = 0; i < threads.size(); ++i) {
+                        struct rtp_tx_stripe *stripe = rtp_tx_stripe_init(session);
+                        if (stripe == nullptr) {
+                                reset();
+                                stripes_session = session; // do not retry for the same session
+                                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Cannot create stripes, sending from single thread.\n");
+                                return;
+                        }
+                        stripes.push_back(stripe);
+                }
+        }
+        /// stripes are independent of the session so they can outlive it
+        void reset() {
+                for (auto *stripe : stripes) {
+                        rtp_tx_stripe_done(stripe);
+                }
+                stripes.clear();
+                stripes_session = nullptr;
+        }
+        static void wait_until(time_ns_t target) {
+                if (virtual_clock_enabled) {
+                        virtual_clock_sleep_until(target);
+                        return;
+                }
+                time_ns_t now = 0;
+                while ((now = get_time_in_ns()) < target) {
+                        if (target - now > 50 * NS_IN_US) {
+                                std::this_thread::yield();
+                        }
+                }
+        }
+        void worker(int idx) {
+                unsigned long seen = 0;
+                while (true) {
+                        job j;
+                        {
+                                std::unique_lock<std::mutex> lk(lock);
+                                cv_start.wait(lk, [&] { return should_exit || generation != seen; });
+                                if (should_exit) {
+                                        return;
+                                }
+                                seen = generation;
+                                j = cur;
+                        }
+                        const long step = threads.size();
+                        for (long i = idx; i < j.count; i += step) {
+                                if (j.packet_rate > 0) {
+                                        wait_until(j.start + i * j.packet_rate);
+                                }
+                                uint32_t *hdr = j.rtp_headers + i * (j.rtp_hdr_len / sizeof(uint32_t));
+                                rtp_send_data_hdr_stripe(j.session, (*j.stripes)[idx], j.first_seq + i, j.ts, j.pt, 0,
+                                                (char *) hdr, j.rtp_hdr_len, j.data + ntohl(hdr[1]),
+                                                (*j.packet_sizes)[i % j.packet_sizes->size()]);
+                        }
+                        std::lock_guard<std::mutex> lk(lock);
+                        if (--pending == 0) {
+                                cv_done.notify_one();
+                        }
+                }
+        }
+
+        vector<std::thread> threads;
+        struct rtp *stripes_session = nullptr; ///< session the stripes were created for
+        vector<struct rtp_tx_stripe *> stripes;
+        std::mutex lock;
+        std::condition_variable cv_start;
+        std::condition_variable cv_done;
+        unsigned long generation = 0;
+        int pending = 0;
+        bool should_exit = false;
+        job cur{};
+};
+
+/**
+ * Multi-path (bonded) sending of video (--param tx-paths=...). Packets are
+ * distributed by the path scheduler (see utils/path_sched.h) fed by probes
+ * echoed by the receiver.
+ */
+struct tx_paths {
+        struct path {
+                string addr;
+                string iface;
+                struct rtp_tx_stripe *stripe = nullptr;
+        };
+
+        /// @param cfg  <host>[%<iface>][*<weight>][+<host2>...]
+        static tx_paths *create(const char *cfg) {
+                auto *ret = new tx_paths;
+                std::istringstream iss(cfg);
+                string item;
+                while (std::getline(iss, item, '+')) {
+                        path p;
+                        double weight = 1.0;
+                        if (size_t pos = item.rfind('*'); pos != string::npos) {
+                                weight = atof(item.substr(pos + 1).c_str());
+                                item.resize(pos);
+                        }
+                        if (size_t pos = item.find('%'); pos != string::npos) {
+                                p.iface = item.substr(pos + 1);
+                                item.resize(pos);
+                        }
+                        p.addr = item;
+                        if (p.addr.empty() || weight <= 0.0) {
+                                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong path specification: %s\n", cfg);
+                                delete ret;
+                                return nullptr;
+                        }
+                        path_sched_add(ret->sched, p.addr.c_str(), weight);
+                        ret->paths.push_back(p);
+                }
+                return ret;
+        }
+        ~tx_paths() {
+                for (auto &p : paths) {
+                        rtp_tx_stripe_done(p.stripe);
+                }
+                path_sched_destroy(sched);
+        }
+        /**
+         * Initializes the paths for the session (if not yet), processes probe
+         * echoes, sends probes and updates the path weights. Called once per tile.
+         * @retval false if the paths cannot be used for the session
+         */
+        bool update(struct rtp *rtp_session) {
+                if (session != rtp_session) {
+                        if (session != nullptr) {
+                                log_msg(LOG_LEVEL_NOTICE, MOD_NAME "RTP session changed, reinitializing paths.\n");
+                                reset();
+                        }
+                        init(rtp_session);
+                }
+                if (usable == 0) {
+                        return false;
+                }
+                const time_ns_t now = get_time_in_ns();
+                for (unsigned i = 0; i < paths.size(); ++i) {
+                        if (paths[i].stripe == nullptr) {
+                                continue;
+                        }
+                        uint32_t seq = 0;
+                        uint64_t sent = 0;
+                        while (rtp_tx_path_recv_echo(paths[i].stripe, &seq, &sent)) {
+                                path_sched_echo(sched, i, seq, (time_ns_t) sent, now);
+                        }
+                        if (path_sched_probe_due(sched, i, now, &seq)) {
+                                rtp_tx_path_send_probe(session, paths[i].stripe, seq, now);
+                        }
+                }
+                path_sched_update(sched, now);
+                return true;
+        }
+        /// sends the packet through the path selected by the scheduler
+        void send(uint32_t ts, int pt, int m, char *phdr, int phdr_len, char *data, int data_len) {
+                const int idx = path_sched_next(sched);
+                assert(idx >= 0);
+                rtp_send_data_hdr_stripe(session, paths[idx].stripe, rtp_reserve_seq(session, 1), ts, pt, m,
+                                phdr, phdr_len, data, data_len);
+                rtp_stripe_update_stats(session, 1, data_len);
+        }
+
+private:
+        void init(struct rtp *rtp_session) {
+                session = rtp_session;
+                const time_ns_t now = get_time_in_ns();
+                for (unsigned i = 0; i < paths.size(); ++i) {
+                        path &p = paths[i];
+                        p.stripe = rtp_tx_path_init(session, p.addr.c_str(), p.iface.empty() ? nullptr : p.iface.c_str());
+                        if (p.stripe == nullptr) {
+                                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Cannot initialize path %s, skipping.\n", p.addr.c_str());
+                                continue;
+                        }
+                        path_sched_enable(sched, i, now);
+                        usable += 1;
+                }
+        }
+        /// releases the paths of the previous session keeping their configuration
+        void reset() {
+                for (auto &p : paths) {
+                        rtp_tx_stripe_done(p.stripe);
+                        p.stripe = nullptr;
+                }
+                path_sched_reset(sched);
+                usable = 0;
+        }
+
+        vector<path> paths;
+        struct path_sched *sched = path_sched_create();
+        struct rtp *session = nullptr; ///< session the paths are bound to
+        int usable = 0;
+};
+
 struct tx {
         struct module mod;
 
@@ -158,6 +439,8 @@ struct tx {
         struct openssl_encrypt *encryption;
         long long int bitrate;
         struct rate_limit_dyn dyn_rate_limit_state;
+        struct tx_stripes *stripes; ///< striped sending, NULL if disabled
+        struct tx_paths *paths;     ///< multi-path sending, NULL if disabled
 		
         char tmp_packet[RTP_MAX_MTU];
 };
@@ -253,6 +536,31 @@ struct tx *tx_init(struct module *parent, unsigned mtu, enum tx_media_type media
 
         tx->bitrate = bitrate;
 
+        if (media_type == TX_MEDIA_VIDEO && get_commandline_param("tx-paths") != nullptr) {
+                if ((tx->paths = tx_paths::create(get_commandline_param("tx-paths"))) == nullptr) {
+                        module_done(&tx->mod);
+                        return NULL;
+                }
+                if (get_commandline_param("tx-threads") != nullptr) {
+                        log_msg(LOG_LEVEL_WARNING, MOD_NAME "tx-threads is ignored when tx-paths is used.\n");
+                }
+        } else if (media_type == TX_MEDIA_VIDEO && get_commandline_param("tx-threads") != nullptr) {
+                const char *threads_str = get_commandline_param("tx-threads");
+                char *endptr = nullptr;
+                const long threads = strtol(threads_str, &endptr, 10);
+                if (endptr == threads_str || *endptr != '\0' || threads < 1 || threads > TX_THREADS_MAX) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong tx-threads value: %s (expected 1-%d)\n", threads_str, TX_THREADS_MAX);
+                        module_done(&tx->mod);
+                        return NULL;
+                }
+                if (threads > (long) std::thread::hardware_concurrency()) {
+                        log_msg(LOG_LEVEL_WARNING, MOD_NAME "%ld sender threads exceed CPU count, expect packet bursts!\n", threads);
+                }
+                if (threads > 1) {
+                        tx->stripes = new tx_stripes(threads);
+                }
+        }
+
         if(parent)
                 tx->control = (struct control_state *) get_module(get_root_module(parent), "control");
 
@@ -396,6 +704,8 @@ static void tx_done(struct module *mod)
 {
         struct tx *tx = (struct tx *) mod->priv_data;
         assert(tx->magic == TRANSMIT_MAGIC);
+        delete tx->stripes;
+        delete tx->paths;
         free(tx);
 }
 
@@ -739,9 +1049,23 @@ tx_send_base(struct tx *tx, struct video_frame *frame, struct rtp *rtp_session,
                 rtp_async_start(rtp_session, mult_pkt_cnt);
         }
 
+        const bool use_paths = tx->paths != nullptr && tx->paths->update(rtp_session);
+
+        // shaper schedule - packet i is intended to be sent at tile_start + i * packet_rate
+        const time_ns_t tile_start = get_time_in_ns();
         rtp_hdr_packet = (uint32_t *) rtp_headers;
-        for (long i = 0; i < mult_pkt_cnt; ++i) {
+        long i = 0;
+        // all but the last (M-bit) packet are striped, so that the receiver
+        // gets the M-bit packet after the rest of the frame
+        if (tx->stripes != nullptr && tx->encryption == nullptr && mult_pkt_cnt > 1 &&
+                        tx->stripes->send(rtp_session, rtp_hdr_packet, rtp_hdr_len, tile->data,
+                                packet_sizes, mult_pkt_cnt - 1, ts, pt, packet_rate)) {
+                i = mult_pkt_cnt - 1;
+                rtp_hdr_packet += i * (rtp_hdr_len / sizeof(uint32_t));
+        }
+        for ( ; i < mult_pkt_cnt; ++i) {
                 GET_STARTTIME;
+                const time_ns_t pkt_start = virtual_clock_enabled ? get_time_in_ns() : 0;
                 const int m        = i == mult_pkt_cnt - 1 ? send_m : 0;
                 char     *data     = tile->data + ntohl(rtp_hdr_packet[1]);
                 int       data_len = packet_sizes.at(i % packet_sizes.size());
@@ -761,13 +1085,24 @@ tx_send_base(struct tx *tx, struct video_frame *frame, struct rtp *rtp_session,
                         data = encrypted_data;
                 }
 
-                rtp_send_data_hdr(rtp_session, ts, pt, m, 0, nullptr,
-                                  (char *) rtp_hdr_packet, rtp_hdr_len, data,
-                                  data_len, nullptr, 0, 0);
+                if (use_paths) {
+                        tx->paths->send(ts, pt, m, (char *) rtp_hdr_packet, rtp_hdr_len, data, data_len);
+                } else {
+                        if (!virtual_clock_enabled) { // kernel timestamps are in real time
+                                rtp_set_tx_deadline(rtp_session, tile_start + i * packet_rate);
+                        }
+                        rtp_send_data_hdr(rtp_session, ts, pt, m, 0, nullptr,
+                                          (char *) rtp_hdr_packet, rtp_hdr_len, data,
+                                          data_len, nullptr, 0, 0);
+                }
                 rtp_hdr_packet += rtp_hdr_len / sizeof(uint32_t);
 
                 // TRAFFIC SHAPER
-                if (m != 1) { // wait for all but last packet
+                if (m != 1 && virtual_clock_enabled) {
+                        const time_ns_t target = pkt_start + packet_rate - overslept;
+                        virtual_clock_sleep_until(target);
+                        overslept = get_time_in_ns() - target;
+                } else if (m != 1) { // wait for all but last packet
                         do {
                                 GET_STOPTIME;
                                 GET_DELTA;
@@ -92,7 +92,13 @@ typedef long long time_ns_t;
 #define NS_IN_SEC_DBL ((double) NS_IN_SEC)
 #define NS_IN_US (NS_IN_SEC/US_IN_SEC)
 #define NS_IN_US_DBL ((double) NS_IN_US)
+extern int virtual_clock_enabled; ///< @see utils/virtual_clock.h
+time_ns_t virtual_clock_now(void);
+
 static inline time_ns_t get_time_in_ns() {
+        if (virtual_clock_enabled) {
+                return virtual_clock_now();
+        }
 #ifdef HAVE_TIMESPEC_GET
         struct timespec ts = { 0, 0 };
         timespec_get(&ts, TIME_UTC);
@@ -105,6 +105,8 @@ typedef enum {
         PRORES_422_PROXY, ///< Apple ProRes 422 (Proxy)
         PRORES_422_LT,    ///< Apple ProRes 422 (LT)
         DRM_PRIME, ///< DRM Prime buffer, data contains struct drm_prime_frame
+        NV12,     ///< semi-planar YCbCr 4:2:0 - Y plane followed by interleaved CbCr plane
+        P010,     ///< semi-planar YCbCr 4:2:0 16-bit little-endian (10 MSB used), layout same as NV12
         VIDEO_CODEC_COUNT, ///< count of known video codecs (including VIDEO_CODEC_NONE)
         VC_COUNT        = VIDEO_CODEC_COUNT,
         VC_END          = VIDEO_CODEC_COUNT,
@@ -223,6 +225,14 @@ enum frame_flags_common {
         TIMESTAMP_VALID = 1 << 0, ///< timestamp set by source (in 90 kHz clock)
 };
 
+/// video frame specific flags (must not collide with @ref frame_flags_common)
+enum video_frame_flags {
+        VF_FORCE_KEYFRAME = 1 << 1, ///< encoder should produce a keyframe (IDR) from this frame
+        /// frame data is owned exclusively by the frame (eg. taken from a pool) and may be modified
+        /// in place - not set for frames wrapping a buffer that the producer keeps using
+        VF_WRITABLE = 1 << 2,
+};
+
 struct video_frame;
 /**
  * @brief Struct containing callbacks of a @ref video_frame
@@ -322,6 +332,7 @@ struct video_frame {
         unsigned int         decoder_overrides_data_len:1;
 
         struct video_frame_callbacks callbacks;
+        size_t               data_alloc_len; ///< total size of data allocated by vf_alloc_desc_data() (for accounting)
 
         // metadata follow
 #define VF_METADATA_START fec_params
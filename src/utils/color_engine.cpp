@@ -0,0 +1,377 @@
+/**
+ * @file   utils/color_engine.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * The matrix is applied in fixed point (Q13 for 8-bit, Q16 for 16-bit
+ * input). 8-bit RGB and UYVY input is processed with SSSE3 (pmaddwd) if
+ * the coefficients fit in 16 bits, the LUT is then applied on a small
+ * block while it is still in the cache. 8-bit LUTs are applied with a
+ * plain table lookup - a 256-entry table is L1-resident and the lookup
+ * turned out faster than pshufb based lookups with SSE4.1/AVX2.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "utils/color_engine.h"
+#include "utils/misc.h"
+#include "utils/worker.h"
+
+#define MIN_CHUNK_LEN (256 * 1024) ///< do not split smaller work for workers
+#define FUSE_BLOCK_PIXELS 1024     ///< matrix output block size the LUT is applied on
+#define Q8 13                      ///< fixed-point precision for 8-bit input
+#define Q16 16                     ///< fixed-point precision for 16-bit input
+
+using std::max;
+using std::min;
+using std::vector;
+
+namespace {
+enum kind {
+        COPY,
+        LUT_8_8,
+        LUT_8_16,
+        LUT_16_8,
+        LUT_16_16,
+        MATRIX_RGB,
+        MATRIX_UYVY,
+        MATRIX_RG48,
+};
+
+struct kind_info {
+        int in_unit;  ///< bytes of input per processing unit
+        int out_unit; ///< bytes of output per processing unit
+};
+
+/// indexed by enum kind
+const struct kind_info kind_info[] = {
+        { 1, 1 }, // COPY
+        { 1, 1 }, // LUT_8_8
+        { 1, 2 }, // LUT_8_16
+        { 2, 1 }, // LUT_16_8
+        { 2, 2 }, // LUT_16_16
+        { 3, 3 }, // MATRIX_RGB
+        { 4, 6 }, // MATRIX_UYVY - one unit is a pixel pair
+        { 6, 6 }, // MATRIX_RG48
+};
+} // end of anonymous namespace
+
+struct color_engine {
+        bool has_matrix;
+        bool has_gamma;
+        bool simd_ok; ///< Q8 coefficients fit to int16_t
+        int32_t m8[9];
+        int64_t m16[9];
+
+        vector<uint8_t> lut8;
+        vector<uint16_t> lut8_16;
+        vector<uint8_t> lut16_8;
+        vector<uint16_t> lut16;
+};
+
+struct color_engine_task {
+        struct color_engine *e;
+        enum kind kind;
+        const unsigned char *in;
+        unsigned char *out;
+        size_t count; ///< number of units
+};
+
+template<typename inT, typename outT>
+static void apply_lut(const outT *lut, const inT *in, outT *out, size_t count)
+{
+        for (size_t i = 0; i < count; ++i) {
+                out[i] = lut[in[i]];
+        }
+}
+
+static inline uint8_t mul_clamp8(const int32_t *m, int a0, int a1, int a2)
+{
+        int32_t val = (m[0] * a0 + m[1] * a1 + m[2] * a2) >> Q8;
+        return min(max(val, 0), 255);
+}
+
+/// @param offs subtracted from the respective components before multiplication
+static void matrix8_scalar(const int32_t *m, const int *offs, const unsigned char *in, unsigned char *out,
+                size_t pixels, bool uyvy)
+{
+        for (size_t i = 0; i < pixels; ++i) {
+                int a0, a1, a2;
+                if (uyvy) { // U Y0 V Y1
+                        const unsigned char *mp = in + (i / 2) * 4;
+                        a0 = mp[1 + 2 * (i % 2)] - offs[0];
+                        a1 = mp[0] - offs[1];
+                        a2 = mp[2] - offs[2];
+                } else {
+                        a0 = in[3 * i];
+                        a1 = in[3 * i + 1];
+                        a2 = in[3 * i + 2];
+                }
+                *out++ = mul_clamp8(m, a0, a1, a2);
+                *out++ = mul_clamp8(m + 3, a0, a1, a2);
+                *out++ = mul_clamp8(m + 6, a0, a1, a2);
+        }
+}
+
+#ifdef __SSSE3__
+/**
+ * Computes 4 RGB pixels (12 bytes) from 4 unpacked pixels in x01 and x23
+ * (16-bit lanes c0 c1 c2 0 of 2 pixels each).
+ */
+static inline void matrix8_sse_4px(__m128i x01, __m128i x23, const __m128i *coef, unsigned char *out)
+{
+        __m128i s[3];
+        for (int r = 0; r < 3; ++r) {
+                s[r] = _mm_srai_epi32(_mm_hadd_epi32(_mm_madd_epi16(x01, coef[r]),
+                                        _mm_madd_epi16(x23, coef[r])), Q8);
+        }
+        // saturation in packs clamps the result to 0-255
+        __m128i px = _mm_packus_epi16(_mm_packs_epi32(s[0], s[1]), _mm_packs_epi32(s[2], s[2]));
+        px = _mm_shuffle_epi8(px, _mm_setr_epi8(0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1));
+        _mm_storel_epi64((__m128i *)(void *) out, px);
+        uint32_t last = _mm_cvtsi128_si32(_mm_srli_si128(px, 8));
+        memcpy(out + 8, &last, sizeof last); // exactly 12 bytes - out may alias in
+}
+
+/// @returns number of processed pixels (the rest is left for the scalar version)
+static size_t matrix8_sse(const int32_t *m, const int *offs, const unsigned char *in, unsigned char *out,
+                size_t pixels, bool uyvy)
+{
+        __m128i coef[3];
+        for (int r = 0; r < 3; ++r) {
+                coef[r] = _mm_setr_epi16(m[3 * r], m[3 * r + 1], m[3 * r + 2], 0,
+                                m[3 * r], m[3 * r + 1], m[3 * r + 2], 0);
+        }
+        const __m128i offset = _mm_setr_epi16(offs[0], offs[1], offs[2], 0, offs[0], offs[1], offs[2], 0);
+        size_t i = 0;
+        if (uyvy) {
+                const __m128i sh01 = _mm_setr_epi8(1, -1, 0, -1, 2, -1, -1, -1, 3, -1, 0, -1, 2, -1, -1, -1);
+                const __m128i sh23 = _mm_setr_epi8(5, -1, 4, -1, 6, -1, -1, -1, 7, -1, 4, -1, 6, -1, -1, -1);
+                for ( ; i + 4 <= pixels; i += 4) {
+                        __m128i v = _mm_loadl_epi64((const __m128i *)(const void *) (in + i * 2));
+                        matrix8_sse_4px(_mm_sub_epi16(_mm_shuffle_epi8(v, sh01), offset),
+                                        _mm_sub_epi16(_mm_shuffle_epi8(v, sh23), offset),
+                                        coef, out + i * 3);
+                }
+        } else {
+                const __m128i sh01 = _mm_setr_epi8(0, -1, 1, -1, 2, -1, -1, -1, 3, -1, 4, -1, 5, -1, -1, -1);
+                const __m128i sh23 = _mm_setr_epi8(6, -1, 7, -1, 8, -1, -1, -1, 9, -1, 10, -1, 11, -1, -1, -1);
+                for ( ; i + 6 <= pixels; i += 4) { // loads 16 bytes
+                        __m128i v = _mm_loadu_si128((const __m128i *)(const void *) (in + i * 3));
+                        matrix8_sse_4px(_mm_shuffle_epi8(v, sh01), _mm_shuffle_epi8(v, sh23),
+                                        coef, out + i * 3);
+                }
+        }
+        return i;
+}
+#endif // defined __SSSE3__
+
+static void matrix8(struct color_engine *e, const unsigned char *in, unsigned char *out, size_t pixels, bool uyvy)
+{
+        static const int no_offs[3] = { 0, 0, 0 };
+        static const int yuv_offs[3] = { 16, 128, 128 };
+        const int *offs = uyvy ? yuv_offs : no_offs;
+        const int in_bpp = uyvy ? 2 : 3;
+        // process in blocks so that LUT is applied on data in the cache
+        for (size_t done = 0; done < pixels; ) {
+                size_t block = min<size_t>(FUSE_BLOCK_PIXELS, pixels - done);
+                const unsigned char *block_in = in + done * in_bpp;
+                unsigned char *block_out = out + done * 3;
+                size_t simd_done = 0;
+#ifdef __SSSE3__
+                if (e->simd_ok) {
+                        simd_done = matrix8_sse(e->m8, offs, block_in, block_out, block, uyvy);
+                }
+#endif
+                matrix8_scalar(e->m8, offs, block_in + simd_done * in_bpp, block_out + simd_done * 3,
+                                block - simd_done, uyvy);
+                if (e->has_gamma) {
+                        apply_lut(e->lut8.data(), block_out, block_out, block * 3);
+                }
+                done += block;
+        }
+}
+
+static void matrix16(struct color_engine *e, const uint16_t *in, uint16_t *out, size_t pixels)
+{
+        for (size_t i = 0; i < pixels; ++i) {
+                int64_t a[3] = { in[0], in[1], in[2] };
+                in += 3;
+                for (int r = 0; r < 3; ++r) {
+                        int64_t val = (e->m16[3 * r] * a[0] + e->m16[3 * r + 1] * a[1] + e->m16[3 * r + 2] * a[2]) >> Q16;
+                        val = min<int64_t>(max<int64_t>(val, 0), UINT16_MAX);
+                        *out++ = e->has_gamma ? e->lut16[val] : val;
+                }
+        }
+}
+
+static void *color_engine_worker(void *arg)
+{
+        auto *t = static_cast<struct color_engine_task *>(arg);
+        struct color_engine *e = t->e;
+        switch (t->kind) {
+        case COPY:
+                if (t->in != t->out) {
+                        memcpy(t->out, t->in, t->count);
+                }
+                break;
+        case LUT_8_8:
+                apply_lut(e->lut8.data(), t->in, t->out, t->count);
+                break;
+        case LUT_8_16:
+                apply_lut(e->lut8_16.data(), t->in, (uint16_t *)(void *) t->out, t->count);
+                break;
+        case LUT_16_8:
+                apply_lut(e->lut16_8.data(), (const uint16_t *)(const void *) t->in, t->out, t->count);
+                break;
+        case LUT_16_16:
+                apply_lut(e->lut16.data(), (const uint16_t *)(const void *) t->in, (uint16_t *)(void *) t->out, t->count);
+                break;
+        case MATRIX_RGB:
+                matrix8(e, t->in, t->out, t->count, false);
+                break;
+        case MATRIX_UYVY:
+                matrix8(e, t->in, t->out, 2 * t->count, true);
+                break;
+        case MATRIX_RG48:
+                matrix16(e, (const uint16_t *)(const void *) t->in, (uint16_t *)(void *) t->out, t->count);
+                break;
+        }
+        return nullptr;
+}
+
+template<typename outT>
+static vector<outT> create_lut(int in_bits, double gamma)
+{
+        const double in_max = (1 << in_bits) - 1;
+        const double out_max = std::numeric_limits<outT>::max();
+        vector<outT> lut(1 << in_bits);
+        for (size_t i = 0; i < lut.size(); ++i) {
+                lut[i] = lround(pow(i / in_max, gamma) * out_max);
+        }
+        return lut;
+}
+
+struct color_engine *color_engine_create(const double *matrix, double gamma)
+{
+        auto *e = new color_engine();
+        e->has_matrix = matrix != nullptr;
+        e->has_gamma = gamma != 1.0;
+        e->simd_ok = true;
+        for (int i = 0; i < 9 && matrix != nullptr; ++i) {
+                e->m8[i] = lround(matrix[i] * (1 << Q8));
+                e->m16[i] = llround(matrix[i] * (1 << Q16));
+                e->simd_ok = e->simd_ok && e->m8[i] >= INT16_MIN && e->m8[i] <= INT16_MAX;
+        }
+        e->lut8 = create_lut<uint8_t>(8, gamma);
+        e->lut8_16 = create_lut<uint16_t>(8, gamma);
+        e->lut16_8 = create_lut<uint8_t>(16, gamma);
+        e->lut16 = create_lut<uint16_t>(16, gamma);
+        return e;
+}
+
+void color_engine_destroy(struct color_engine *e)
+{
+        delete e;
+}
+
+static bool get_kind(struct color_engine *e, codec_t in_codec, codec_t out_codec, enum kind *kind)
+{
+        if (in_codec == UYVY && out_codec == RGB && e->has_matrix) {
+                *kind = MATRIX_UYVY;
+                return true;
+        }
+        if ((in_codec != RGB && in_codec != RG48) || (out_codec != RGB && out_codec != RG48)) {
+                return false;
+        }
+        const bool in16 = in_codec == RG48;
+        const bool out16 = out_codec == RG48;
+        if (e->has_matrix) {
+                if (in16 != out16) {
+                        return false;
+                }
+                *kind = in16 ? MATRIX_RG48 : MATRIX_RGB;
+                return true;
+        }
+        if (in16 == out16 && !e->has_gamma) {
+                *kind = COPY;
+        } else if (in16) {
+                *kind = out16 ? LUT_16_16 : LUT_16_8;
+        } else {
+                *kind = out16 ? LUT_8_16 : LUT_8_8;
+        }
+        return true;
+}
+
+bool color_engine_apply(struct color_engine *e, codec_t in_codec, const char *in,
+                codec_t out_codec, char *out, size_t in_len)
+{
+        enum kind kind = COPY;
+        if (!get_kind(e, in_codec, out_codec, &kind)) {
+                return false;
+        }
+        const struct kind_info &info = kind_info[kind];
+        const size_t units = in_len / info.in_unit;
+        const int workers = max<int>(1, min<size_t>(get_cpu_core_count(), in_len / MIN_CHUNK_LEN));
+
+        vector<struct color_engine_task> tasks(workers);
+        for (int i = 0; i < workers; ++i) {
+                size_t first = i * (units / workers);
+                tasks[i].e = e;
+                tasks[i].kind = kind;
+                tasks[i].in = (const unsigned char *) in + first * info.in_unit;
+                tasks[i].out = (unsigned char *) out + first * info.out_unit;
+                tasks[i].count = i == workers - 1 ? units - first : units / workers;
+        }
+        task_run_parallel(color_engine_worker, workers, tasks.data(), sizeof tasks[0], nullptr);
+        return true;
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -0,0 +1,86 @@
+/**
+ * @file   utils/color_engine.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Per-pixel color processing shared by the gamma and matrix capture filters -
+ * an optional 3x3 matrix followed by a LUT (gamma and/or bit depth change)
+ * applied in a single pass over the data in fixed point, parallelized with
+ * the worker pool (utils/worker.h).
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef COLOR_ENGINE_H_8B4D2E6A_0C71_4F93_A5E8_17D3C9B0F24E
+#define COLOR_ENGINE_H_8B4D2E6A_0C71_4F93_A5E8_17D3C9B0F24E
+
+#ifdef __cplusplus
+#include <cstddef>
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#endif
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct color_engine;
+
+/**
+ * @param matrix 3x3 matrix [a b c; d e f; g h i] in row-major order, NULL for none
+ * @param gamma  exponent of the applied transfer function, 1.0 for none
+ */
+struct color_engine *color_engine_create(const double *matrix, double gamma);
+void color_engine_destroy(struct color_engine *e);
+/**
+ * Supported conversions are RGB or RG48 to RGB or RG48 (matrix only if
+ * the bit depth is kept) and UYVY to RGB (matrix is applied to
+ * Y, Cb and Cr with subtracted offsets 16, 128 and 128).
+ *
+ * Processing may be done in place (in == out) if in_codec == out_codec.
+ *
+ * @param in_len  length of input data in bytes
+ * @retval false  conversion is not supported
+ */
+bool color_engine_apply(struct color_engine *e, codec_t in_codec, const char *in,
+                codec_t out_codec, char *out, size_t in_len);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined COLOR_ENGINE_H_8B4D2E6A_0C71_4F93_A5E8_17D3C9B0F24E
+
@@ -0,0 +1,99 @@
+/**
+ * @file   utils/line_accumulate.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "utils/line_accumulate.h"
+
+void line_accumulate_8(uint16_t *acc, const unsigned char *line, int len)
+{
+        int i = 0;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        for ( ; i + 16 <= len; i += 16) {
+                __m128i in = _mm_loadu_si128((const __m128i *)(const void *) (line + i));
+                __m128i lo = _mm_loadu_si128((__m128i *)(void *) (acc + i));
+                __m128i hi = _mm_loadu_si128((__m128i *)(void *) (acc + i + 8));
+                _mm_storeu_si128((__m128i *)(void *) (acc + i), _mm_add_epi16(lo, _mm_unpacklo_epi8(in, zero)));
+                _mm_storeu_si128((__m128i *)(void *) (acc + i + 8), _mm_add_epi16(hi, _mm_unpackhi_epi8(in, zero)));
+        }
+#endif
+        for ( ; i < len; ++i) {
+                acc[i] += line[i];
+        }
+}
+
+void line_accumulate_v210(uint32_t *acc, const unsigned char *line, int words)
+{
+        uint32_t *acc0 = acc;
+        uint32_t *acc1 = acc + words;
+        uint32_t *acc2 = acc + 2 * words;
+        int i = 0;
+#ifdef __SSE2__
+        const __m128i mask = _mm_set1_epi32(0x3FF);
+        for ( ; i + 4 <= words; i += 4) {
+                __m128i in = _mm_loadu_si128((const __m128i *)(const void *) (line + 4 * i));
+                __m128i a0 = _mm_loadu_si128((__m128i *)(void *) (acc0 + i));
+                __m128i a1 = _mm_loadu_si128((__m128i *)(void *) (acc1 + i));
+                __m128i a2 = _mm_loadu_si128((__m128i *)(void *) (acc2 + i));
+                _mm_storeu_si128((__m128i *)(void *) (acc0 + i), _mm_add_epi32(a0, _mm_and_si128(in, mask)));
+                _mm_storeu_si128((__m128i *)(void *) (acc1 + i), _mm_add_epi32(a1, _mm_and_si128(_mm_srli_epi32(in, 10), mask)));
+                _mm_storeu_si128((__m128i *)(void *) (acc2 + i), _mm_add_epi32(a2, _mm_and_si128(_mm_srli_epi32(in, 20), mask)));
+        }
+#endif
+        for ( ; i < words; ++i) {
+                uint32_t word = 0;
+                memcpy(&word, line + 4 * i, sizeof word);
+                acc0[i] += word & 0x3FFU;
+                acc1[i] += (word >> 10U) & 0x3FFU;
+                acc2[i] += (word >> 20U) & 0x3FFU;
+        }
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -0,0 +1,66 @@
+/**
+ * @file   utils/line_accumulate.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * SIMD accumulation of picture lines used by box (area-average) filters.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef LINE_ACCUMULATE_H_5C2E8A41_9B7D_4F36_A1E0_6D3B9F27C854
+#define LINE_ACCUMULATE_H_5C2E8A41_9B7D_4F36_A1E0_6D3B9F27C854
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// acc[i] += line[i] for i in [0, len)
+void line_accumulate_8(uint16_t *acc, const unsigned char *line, int len);
+/**
+ * Adds v210 line to the accumulator kept as 3 planes (10-bit components
+ * 0-9, 10-19 and 20-29 of each word), each of @ref words items.
+ */
+void line_accumulate_v210(uint32_t *acc, const unsigned char *line, int words);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined LINE_ACCUMULATE_H_5C2E8A41_9B7D_4F36_A1E0_6D3B9F27C854
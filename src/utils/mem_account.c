@@ -0,0 +1,78 @@
+/**
+ * @file   utils/mem_account.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <stdatomic.h>
+
+#include "utils/mem_account.h"
+
+static struct {
+        _Atomic size_t current;
+        _Atomic size_t peak;
+} counters[MEM_ACC_COUNT];
+
+void mem_account_alloc(enum mem_account_module mod, size_t size)
+{
+        size_t cur = atomic_fetch_add_explicit(&counters[mod].current, size, memory_order_relaxed) + size;
+        size_t peak = atomic_load_explicit(&counters[mod].peak, memory_order_relaxed);
+        while (cur > peak && !atomic_compare_exchange_weak_explicit(&counters[mod].peak, &peak, cur,
+                                memory_order_relaxed, memory_order_relaxed)) {
+        }
+}
+
+void mem_account_free(enum mem_account_module mod, size_t size)
+{
+        atomic_fetch_sub_explicit(&counters[mod].current, size, memory_order_relaxed);
+}
+
+size_t mem_account_get_current(enum mem_account_module mod)
+{
+        return atomic_load_explicit(&counters[mod].current, memory_order_relaxed);
+}
+
+size_t mem_account_get_peak(enum mem_account_module mod)
+{
+        return atomic_load_explicit(&counters[mod].peak, memory_order_relaxed);
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -0,0 +1,94 @@
+/**
+ * @file   utils/mem_account.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Lightweight accounting of big buffers allocated by individual subsystems
+ * (current and peak bytes) with optional per-subsystem caps. The report can
+ * be queried over the control socket ("memory" command).
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef MEM_ACCOUNT_H_8E2B4C1A_7D3F_4A6E_B5C9_0F1E2D3C4B5A
+#define MEM_ACCOUNT_H_8E2B4C1A_7D3F_4A6E_B5C9_0F1E2D3C4B5A
+
+#ifdef __cplusplus
+#include <cstddef>
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum mem_account_module {
+        MEM_ACC_VIDEO_FRAME, ///< vf_alloc_desc_data()
+        MEM_ACC_FRAME_POOL,  ///< video_frame_pool
+        MEM_ACC_PBUF,        ///< packets held by playout buffers
+        MEM_ACC_RING_BUFFER, ///< ring_buffer
+        MEM_ACC_AUDIO_FRAME, ///< audio_frame2 channel data
+        MEM_ACC_REPLAY_RING, ///< replay_ring
+        MEM_ACC_COUNT
+};
+
+// counters (mem_account.c) have no dependencies so that they can be linked to tools
+void mem_account_alloc(enum mem_account_module mod, size_t size);
+void mem_account_free(enum mem_account_module mod, size_t size);
+size_t mem_account_get_current(enum mem_account_module mod);
+size_t mem_account_get_peak(enum mem_account_module mod);
+
+// caps (mem_account_cap.c) are configured from the command line
+/**
+ * @returns true if a cap is set for the module and current usage exceeds it,
+ * the caller should drop the frame instead of allocating/enqueueing more data
+ */
+bool mem_account_over_cap(enum mem_account_module mod);
+/**
+ * @param name module name as printed in the report (eg. "pbuf")
+ * @param cap  cap in bytes, 0 to disable
+ * @returns    false if name is not a known module
+ */
+bool mem_account_set_cap(const char *name, size_t cap);
+/**
+ * Writes report "<module>=<cur>/<peak>[/<cap>] ..." (in bytes) to buf.
+ */
+void mem_account_report(char *buf, size_t buflen);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined MEM_ACCOUNT_H_8E2B4C1A_7D3F_4A6E_B5C9_0F1E2D3C4B5A
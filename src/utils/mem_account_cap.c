@@ -0,0 +1,139 @@
+/**
+ * @file   utils/mem_account_cap.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "host.h"
+#include "utils/mem_account.h"
+#include "utils/misc.h"
+
+#define MOD_NAME "[mem_account] "
+
+static const char *const module_names[MEM_ACC_COUNT] = {
+        [MEM_ACC_VIDEO_FRAME] = "video_frame",
+        [MEM_ACC_FRAME_POOL] = "frame_pool",
+        [MEM_ACC_PBUF] = "pbuf",
+        [MEM_ACC_RING_BUFFER] = "ring_buffer",
+        [MEM_ACC_AUDIO_FRAME] = "audio_frame",
+        [MEM_ACC_REPLAY_RING] = "replay_ring",
+};
+
+static _Atomic size_t caps[MEM_ACC_COUNT]; ///< 0 - no cap
+
+static pthread_once_t caps_once = PTHREAD_ONCE_INIT;
+
+static bool set_cap(const char *name, size_t cap)
+{
+        for (int i = 0; i < MEM_ACC_COUNT; ++i) {
+                if (strcmp(module_names[i], name) == 0) {
+                        atomic_store_explicit(&caps[i], cap, memory_order_relaxed);
+                        return true;
+                }
+        }
+        return false;
+}
+
+ADD_TO_PARAM("mem-cap", "* mem-cap=<module>=<bytes>[:<module>=<bytes>...]\n"
+                "  Caps memory used by a subsystem (video_frame, frame_pool, pbuf, ring_buffer, audio_frame,\n"
+                "  replay_ring), frames are dropped when exceeded. Sizes accept k/M/G suffixes.\n");
+static void parse_caps(void)
+{
+        const char *param = get_commandline_param("mem-cap");
+        if (param == NULL) {
+                return;
+        }
+        char *tmp = strdup(param);
+        char *save_ptr = NULL;
+        char *item = NULL;
+        char *str = tmp;
+        while ((item = strtok_r(str, ":", &save_ptr)) != NULL) {
+                str = NULL;
+                char *size = strchr(item, '=');
+                if (size == NULL) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong cap spec: %s\n", item);
+                        continue;
+                }
+                *size++ = '\0';
+                long long cap = unit_evaluate(size, NULL);
+                if (cap <= 0 || !set_cap(item, cap)) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong cap for module %s: %s\n", item, size);
+                }
+        }
+        free(tmp);
+}
+
+bool mem_account_over_cap(enum mem_account_module mod)
+{
+        pthread_once(&caps_once, parse_caps);
+        size_t cap = atomic_load_explicit(&caps[mod], memory_order_relaxed);
+        return cap != 0 && mem_account_get_current(mod) > cap;
+}
+
+bool mem_account_set_cap(const char *name, size_t cap)
+{
+        pthread_once(&caps_once, parse_caps);
+        return set_cap(name, cap);
+}
+
+void mem_account_report(char *buf, size_t buflen)
+{
+        pthread_once(&caps_once, parse_caps);
+        buf[0] = '\0';
+        size_t off = 0;
+        for (int i = 0; i < MEM_ACC_COUNT && off < buflen; ++i) {
+                off += snprintf(buf + off, buflen - off, "%s%s=%zu/%zu", i == 0 ? "" : " ", module_names[i],
+                                mem_account_get_current(i), mem_account_get_peak(i));
+                size_t cap = atomic_load_explicit(&caps[i], memory_order_relaxed);
+                if (cap != 0 && off < buflen) {
+                        off += snprintf(buf + off, buflen - off, "/%zu", cap);
+                }
+        }
+}
+
+/* vim: set expandtab sw=8 tw=120: */
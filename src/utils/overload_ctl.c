@@ -0,0 +1,92 @@
+/**
+ * @file   utils/overload_ctl.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <string.h>
+
+#include "utils/macros.h"
+#include "utils/overload_ctl.h"
+
+#define LOAD_HIGH 0.9    ///< above this level is raised
+#define LOAD_LOW  0.5    ///< below this level is lowered
+#define LOAD_ALPHA 0.05  ///< weight of a new sample in the moving average
+#define RAISE_HOLDOFF_NS (1 * NS_IN_SEC) ///< min time after a change to raise again (the average needs to settle)
+#define LOWER_HOLDOFF_NS (5 * NS_IN_SEC) ///< min time after a change to lower, longer to prevent oscillation
+
+void overload_ctl_init(struct overload_ctl *c, int max_level)
+{
+        memset(c, 0, sizeof *c);
+        c->max_level = max_level;
+}
+
+bool overload_ctl_update(struct overload_ctl *c, time_ns_t start, time_ns_t end, time_ns_t frame_interval)
+{
+        if (c->max_level == 0) {
+                return false;
+        }
+        if (c->last_end == 0) {
+                c->last_end = c->last_change = end;
+                return false;
+        }
+        const double busy = end - start;
+        const double idle = MAX(start - c->last_end, 0);
+        c->last_end = end;
+        double sample = busy / MAX(busy + idle, 1);
+        if (frame_interval > 0) {
+                sample = MAX(sample, busy / frame_interval);
+        }
+        c->load = (1 - LOAD_ALPHA) * c->load + LOAD_ALPHA * MIN(sample, 2.0);
+
+        if (c->load > LOAD_HIGH && c->level < c->max_level && end - c->last_change > RAISE_HOLDOFF_NS) {
+                c->level += 1;
+        } else if (c->load < LOAD_LOW && c->level > 0 && end - c->last_change > LOWER_HOLDOFF_NS) {
+                c->level -= 1;
+        } else {
+                return false;
+        }
+        c->last_change = end;
+        c->load = (LOAD_HIGH + LOAD_LOW) / 2; // measure the new level from scratch
+        return true;
+}
+
+/* vim: set expandtab sw=8 tw=120: */
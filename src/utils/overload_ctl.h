@@ -0,0 +1,79 @@
+/**
+ * @file   utils/overload_ctl.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Controller of quality degradation of a processing stage (decoder) that
+ * cannot keep up with incoming frames.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OVERLOAD_CTL_H_E4B27A90_58C1_4D6F_9A3B_0C7E15F2D864
+#define OVERLOAD_CTL_H_E4B27A90_58C1_4D6F_9A3B_0C7E15F2D864
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+#include "tv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct overload_ctl {
+        int       max_level;
+        int       level;       ///< current level, raised on overload, lowered if underloaded (0 - lowest)
+        double    load;        ///< smoothed utilization, 1.0 - fully busy
+        time_ns_t last_end;    ///< end of the processing of the previous frame
+        time_ns_t last_change; ///< time of the last level change
+};
+
+void overload_ctl_init(struct overload_ctl *c, int max_level);
+/**
+ * Updates the load with processing of one frame. Load is the maximum of the
+ * processing time relative to the frame interval and the busy ratio (the
+ * latter reaches 1.0 if the frames are queued before the stage).
+ *
+ * @param start,end      time when the frame processing started and ended
+ * @param frame_interval nominal interval between frames
+ * @retval true          if c->level was changed
+ */
+bool overload_ctl_update(struct overload_ctl *c, time_ns_t start, time_ns_t end, time_ns_t frame_interval);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined OVERLOAD_CTL_H_E4B27A90_58C1_4D6F_9A3B_0C7E15F2D864
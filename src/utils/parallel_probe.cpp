@@ -0,0 +1,345 @@
+/**
+ * @file   utils/parallel_probe.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+#include <utility>
+
+#ifdef BUILD_LIBRARIES
+#include <dlfcn.h>
+#endif
+
+#include "debug.h"
+#include "host.h"
+#include "utils/fs.h"
+#include "utils/parallel_probe.hpp"
+
+#define CACHE_MAGIC "UG probe cache 1"
+#define MAX_PROBE_THREADS 8
+#define MOD_NAME "[probe] "
+
+using std::map;
+using std::min;
+using std::mutex;
+using std::pair;
+using std::shared_ptr;
+using std::string;
+using std::to_string;
+using std::unique_lock;
+using std::vector;
+using std::chrono::steady_clock;
+
+namespace {
+struct probe_worker_state {
+        std::thread thread;
+        ssize_t task = -1; ///< currently running task, -1 if none
+        std::chrono::steady_clock::time_point start;
+        bool hung = false;  ///< task timed out, the worker is abandoned
+        bool finished = false;
+};
+/// shared with probe threads so that a timed-out probe can safely finish later
+struct probe_results {
+        mutex lock;
+        std::condition_variable cv;
+        vector<std::function<string()>> probes;
+        vector<vector<size_t>> groups; ///< tasks run sequentially by one worker
+        size_t next_group = 0;
+        vector<probe_worker_state> workers;
+        vector<string> out;
+        vector<bool> done;
+        bool should_exit = false;
+};
+using cache_t = map<string, pair<string, string>>; ///< key -> (validator, data)
+} // end of anonymous namespace
+
+static cache_t load_cache(string const &file)
+{
+        cache_t ret;
+        std::ifstream in(file, std::ios::binary);
+        string line;
+        if (!in || !std::getline(in, line) || line != CACHE_MAGIC) {
+                return ret;
+        }
+        string key;
+        string validator;
+        string len_str;
+        while (std::getline(in, key) && std::getline(in, validator) && std::getline(in, len_str)) {
+                size_t len = strtoul(len_str.c_str(), nullptr, 10);
+                string data(len, '\0');
+                if (!in.read(data.data(), len) || in.get() != '\n') {
+                        MSG(WARNING, "Corrupted cache file %s!\n", file.c_str());
+                        return {};
+                }
+                ret[key] = { validator, std::move(data) };
+        }
+        return ret;
+}
+
+static void store_cache(string const &file, cache_t const &cache)
+{
+        string tmp_name = file + ".tmp" + to_string(getpid());
+        {
+                std::ofstream out(tmp_name, std::ios::binary | std::ios::trunc);
+                if (!out) {
+                        MSG(VERBOSE, "Cannot write cache file %s!\n", tmp_name.c_str());
+                        return;
+                }
+                out << CACHE_MAGIC "\n";
+                for (auto const &[key, val] : cache) {
+                        out << key << "\n" << val.first << "\n" << val.second.size() << "\n" << val.second << "\n";
+                }
+        }
+        if (rename(tmp_name.c_str(), file.c_str()) != 0) {
+                MSG(VERBOSE, "Cannot rename cache file: %s\n", strerror(errno));
+                remove(tmp_name.c_str());
+        }
+}
+
+static void probe_worker(shared_ptr<probe_results> res, size_t id)
+{
+        unique_lock<mutex> lk(res->lock);
+        while (!res->should_exit && !res->workers[id].hung && res->next_group < res->groups.size()) {
+                for (size_t task : res->groups[res->next_group++]) {
+                        if (res->should_exit || res->workers[id].hung) {
+                                break;
+                        }
+                        res->workers[id].task = task;
+                        res->workers[id].start = steady_clock::now();
+                        lk.unlock();
+                        string out = res->probes[task]();
+                        lk.lock();
+                        res->out[task] = std::move(out);
+                        res->done[task] = true;
+                        res->workers[id].task = -1;
+                        res->cv.notify_one();
+                }
+        }
+        res->workers[id].task = -1;
+        res->workers[id].finished = true;
+        res->cv.notify_one();
+}
+
+/// @note res->lock must be held
+static void start_probe_worker(shared_ptr<probe_results> const &res)
+{
+        res->workers.emplace_back();
+        res->workers.back().thread = std::thread(probe_worker, res, res->workers.size() - 1);
+}
+
+vector<string> run_probes_parallel(vector<probe_task> const &tasks, std::chrono::milliseconds timeout,
+                string const &cache_file)
+{
+        cache_t cache;
+        if (!cache_file.empty()) {
+                cache = load_cache(cache_file);
+        }
+
+        auto res = std::make_shared<probe_results>();
+        res->out.resize(tasks.size());
+        res->done.resize(tasks.size());
+        res->probes.resize(tasks.size());
+        map<string, size_t> group_idx;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+                auto it = cache.find(tasks[i].key);
+                if (it != cache.end() && it->second.first == tasks[i].validator) {
+                        MSG(DEBUG, "Using cached result for %s\n", tasks[i].key.c_str());
+                        res->out[i] = it->second.second;
+                        res->done[i] = true;
+                        continue;
+                }
+                res->probes[i] = tasks[i].probe;
+                if (tasks[i].group.empty() || group_idx.count(tasks[i].group) == 0) {
+                        group_idx[tasks[i].group] = res->groups.size();
+                        res->groups.emplace_back();
+                }
+                res->groups[group_idx[tasks[i].group]].push_back(i);
+        }
+
+        unique_lock<mutex> lk(res->lock);
+        const size_t max_threads = min<size_t>(MAX_PROBE_THREADS, std::max(2U, std::thread::hardware_concurrency()));
+        for (size_t i = 0; i < min(max_threads, res->groups.size()); ++i) {
+                start_probe_worker(res);
+        }
+        // wait until all workers are finished, abandoning the ones exceeding the timeout
+        while (true) {
+                auto deadline = steady_clock::time_point::max();
+                size_t running = 0;
+                for (auto &w : res->workers) {
+                        if (w.hung || !w.thread.joinable()) {
+                                continue;
+                        }
+                        if (w.finished) {
+                                w.thread.join();
+                                continue;
+                        }
+                        running += 1;
+                        if (w.task != -1 && steady_clock::now() >= w.start + timeout) {
+                                MSG(WARNING, "Probe of %s timed out!\n", tasks[w.task].key.c_str());
+                                w.hung = true;
+                                w.thread.detach(); // cannot be interrupted, finishes (or not) on its own
+                                running -= 1;
+                        } else if (w.task != -1) {
+                                deadline = min(deadline, w.start + timeout);
+                        }
+                }
+                if (running == 0 && res->next_group == res->groups.size()) {
+                        break;
+                }
+                if (running < min(max_threads, res->groups.size() - res->next_group)) {
+                        start_probe_worker(res); // replaces an abandoned worker
+                        continue;
+                }
+                if (deadline == steady_clock::time_point::max()) {
+                        res->cv.wait(lk);
+                } else {
+                        res->cv.wait_until(lk, deadline);
+                }
+        }
+        res->should_exit = true;
+
+        vector<string> ret(tasks.size());
+        bool cache_changed = false;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+                if (!res->done[i]) {
+                        MSG(WARNING, "Probe of %s not finished!\n", tasks[i].key.c_str());
+                        continue;
+                }
+                ret[i] = res->out[i];
+                auto it = cache.find(tasks[i].key);
+                if (it == cache.end() || it->second.first != tasks[i].validator) {
+                        cache[tasks[i].key] = { tasks[i].validator, ret[i] };
+                        cache_changed = true;
+                }
+        }
+        lk.unlock();
+
+        if (!cache_file.empty() && cache_changed) {
+                store_cache(cache_file, cache);
+        }
+        return ret;
+}
+
+string get_probe_cache_file()
+{
+        string dir;
+#ifdef _WIN32
+        if (const char *tmp = get_temp_dir()) {
+                dir = tmp;
+        }
+#else
+        if (const char *xdg = getenv("XDG_CACHE_HOME")) {
+                dir = xdg;
+        } else if (const char *home = getenv("HOME")) {
+                dir = string(home) + "/.cache";
+                mkdir(dir.c_str(), S_IRWXU);
+        }
+#endif
+        if (dir.empty()) {
+                return {};
+        }
+        dir += "/ultragrid";
+        if (mkdir(dir.c_str(), S_IRWXU) != 0 && errno != EEXIST) {
+                MSG(VERBOSE, "Cannot create cache directory %s: %s\n", dir.c_str(), strerror(errno));
+                return {};
+        }
+        return dir + "/capabilities.cache";
+}
+
+static string get_mtime(const char *path)
+{
+        struct stat st {};
+        if (stat(path, &st) != 0) {
+                return "-";
+        }
+#ifdef __linux__
+        return to_string(st.st_mtim.tv_sec) + "." + to_string(st.st_mtim.tv_nsec);
+#else
+        return to_string(st.st_mtime);
+#endif
+}
+
+string get_probe_validator(const void *module_info, bool device_hint)
+{
+        string ret;
+#ifdef BUILD_LIBRARIES
+        Dl_info info{};
+        if (module_info != nullptr && dladdr(module_info, &info) != 0 && info.dli_fname != nullptr) {
+                ret = get_mtime(info.dli_fname);
+        }
+#else
+        (void) module_info;
+#endif
+        if (ret.empty()) { // module compiled in the executable
+                char exec_path[MAX_PATH_SIZE];
+                if (get_exec_path(exec_path)) {
+                        ret = get_mtime(exec_path);
+                }
+        }
+        if (device_hint) {
+                // device nodes are (dis)appearing on hotplug, changing directory mtime
+#ifdef __linux__
+                for (const char *dir : { "/dev", "/dev/snd", "/dev/dri" }) {
+                        ret += string(" ") + get_mtime(dir);
+                }
+#endif
+                if (const char *hint = get_commandline_param("capabilities-hint")) {
+                        ret += string(" ") + hint;
+                }
+        }
+        return ret;
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -0,0 +1,80 @@
+/**
+ * @file   utils/parallel_probe.hpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Runs module probes (used by --capabilities) concurrently with a timeout
+ * and caches the results on disk.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef UTILS_PARALLEL_PROBE_HPP_3A9F5E21_6C4B_4D8E_A1F7_2B0C9D8E7F61
+#define UTILS_PARALLEL_PROBE_HPP_3A9F5E21_6C4B_4D8E_A1F7_2B0C9D8E7F61
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct probe_task {
+        std::string key;       ///< unique cache key, eg. "capture:v4l2"
+        std::string validator; ///< cached result is used only if the validator matches
+        std::function<std::string()> probe; ///< returns probe output
+        /// probes of the same non-empty group (eg. using the same library) are never run concurrently
+        std::string group;
+};
+
+/**
+ * Runs the probes in a bounded pool of threads, probes of one group run
+ * sequentially in the order of tasks. A probe not finished within timeout
+ * (measured since its start) is abandoned - its result and the results of the
+ * rest of its group are returned empty and are not cached.
+ *
+ * @param cache_file file to load cached results from and store new ones to,
+ *                   empty to disable caching
+ * @returns outputs of the probes in the order of tasks
+ */
+std::vector<std::string> run_probes_parallel(std::vector<probe_task> const &tasks,
+                std::chrono::milliseconds timeout, std::string const &cache_file);
+
+/// @returns default cache file location, empty if it cannot be determined
+std::string get_probe_cache_file();
+/**
+ * @returns string identifying the file containing the module (modification time),
+ *          followed by a device-change hint so that device probes get invalidated
+ *          when devices are (dis)connected
+ */
+std::string get_probe_validator(const void *module_info, bool device_hint);
+
+#endif // ! defined UTILS_PARALLEL_PROBE_HPP_3A9F5E21_6C4B_4D8E_A1F7_2B0C9D8E7F61
@@ -0,0 +1,236 @@
+/**
+ * @file   utils/path_sched.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2026 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+#include "debug.h"
+#include "utils/path_sched.h"
+
+#define MOD_NAME "[path_sched] "
+#define PROBE_WINDOW 32
+#define STATS_INTERVAL (10 * NS_IN_SEC)
+
+using std::string;
+using std::vector;
+
+namespace {
+struct path {
+        string name;
+        double weight = 1.0;
+        bool enabled = false;
+
+        double eff_weight = 0.0;
+        double current = 0.0;   ///< SWRR state
+        uint32_t probe_seq = 0;
+        time_ns_t last_probe = 0;
+        time_ns_t last_echo = 0;
+        time_ns_t srtt = 0;
+        std::array<time_ns_t, PROBE_WINDOW> probe_sent{};
+        std::array<bool, PROBE_WINDOW> probe_echoed{};
+        double loss = 0.0;
+        bool failed = false;
+        unsigned long long packets = 0;
+};
+} // end of anonymous namespace
+
+struct path_sched {
+        vector<path> paths;
+        bool echo_supported = false; ///< receiver echoes probes
+        time_ns_t last_stats = 0;
+};
+
+struct path_sched *path_sched_create()
+{
+        return new path_sched();
+}
+
+void path_sched_destroy(struct path_sched *s)
+{
+        delete s;
+}
+
+int path_sched_add(struct path_sched *s, const char *name, double weight)
+{
+        path p;
+        p.name = name;
+        p.weight = weight;
+        s->paths.push_back(p);
+        return (int) s->paths.size() - 1;
+}
+
+void path_sched_reset(struct path_sched *s)
+{
+        for (auto &p : s->paths) {
+                p = path{ p.name, p.weight };
+        }
+        s->echo_supported = false;
+        s->last_stats = 0;
+}
+
+void path_sched_enable(struct path_sched *s, int path, time_ns_t now)
+{
+        s->paths.at(path).enabled = true;
+        s->paths.at(path).last_echo = now;
+        if (s->last_stats == 0) {
+                s->last_stats = now;
+        }
+}
+
+bool path_sched_probe_due(struct path_sched *s, int path, time_ns_t now, uint32_t *probe_seq)
+{
+        struct path &p = s->paths.at(path);
+        if (!p.enabled || now - p.last_probe < PATH_SCHED_PROBE_INTERVAL) {
+                return false;
+        }
+        p.probe_sent[p.probe_seq % PROBE_WINDOW] = now;
+        p.probe_echoed[p.probe_seq % PROBE_WINDOW] = false;
+        p.last_probe = now;
+        *probe_seq = p.probe_seq++;
+        return true;
+}
+
+void path_sched_echo(struct path_sched *s, int path, uint32_t probe_seq, time_ns_t send_time, time_ns_t now)
+{
+        struct path &p = s->paths.at(path);
+        if (p.probe_sent[probe_seq % PROBE_WINDOW] != send_time || p.probe_echoed[probe_seq % PROBE_WINDOW]) {
+                return; // too old or duplicate
+        }
+        p.probe_echoed[probe_seq % PROBE_WINDOW] = true;
+        const time_ns_t rtt = now - send_time;
+        p.srtt = p.srtt == 0 ? rtt : (7 * p.srtt + rtt) / 8;
+        p.last_echo = now;
+        s->echo_supported = true;
+}
+
+void path_sched_update(struct path_sched *s, time_ns_t now)
+{
+        time_ns_t min_srtt = 0;
+        for (auto &p : s->paths) {
+                if (!p.enabled) {
+                        continue;
+                }
+                // probes older than the expected echo time are eligible for loss computation
+                const time_ns_t echo_deadline = std::max<time_ns_t>(3 * p.srtt, 200 * NS_IN_MS);
+                int eligible = 0;
+                int lost = 0;
+                for (int i = 0; i < PROBE_WINDOW; ++i) {
+                        if (p.probe_sent[i] != 0 && now - p.probe_sent[i] > echo_deadline) {
+                                eligible += 1;
+                                lost += !p.probe_echoed[i];
+                        }
+                }
+                p.loss = eligible > 0 ? (double) lost / eligible : 0.0;
+                const bool failed = s->echo_supported && now - p.last_echo > PATH_SCHED_FAIL_TIMEOUT;
+                if (failed != p.failed) {
+                        log_msg(failed ? LOG_LEVEL_WARNING : LOG_LEVEL_NOTICE, MOD_NAME "Path %s %s.\n",
+                                        p.name.c_str(), failed ? "failed" : "recovered");
+                        p.failed = failed;
+                }
+                if (!p.failed && p.srtt > 0 && (min_srtt == 0 || p.srtt < min_srtt)) {
+                        min_srtt = p.srtt;
+                }
+        }
+
+        double total = 0.0;
+        for (auto &p : s->paths) {
+                p.eff_weight = 0.0;
+                if (!p.enabled || p.failed) {
+                        continue;
+                }
+                p.eff_weight = p.weight;
+                if (s->echo_supported) {
+                        p.eff_weight *= (1.0 - p.loss) * (1.0 - p.loss);
+                        if (p.srtt > 0) {
+                                p.eff_weight *= std::clamp((double) (min_srtt + PATH_SCHED_DELAY_SLACK) / p.srtt, 0.1, 1.0);
+                        }
+                }
+                total += p.eff_weight;
+        }
+        if (total <= 0.0) { // all paths down (or not measured) - use configured weights
+                for (auto &p : s->paths) {
+                        p.eff_weight = p.enabled ? p.weight : 0.0;
+                }
+        }
+
+        if (now - s->last_stats > STATS_INTERVAL) {
+                for (auto &p : s->paths) {
+                        if (p.enabled) {
+                                log_msg(LOG_LEVEL_VERBOSE, MOD_NAME "Path %s: RTT %.2f ms, probe loss %.1f %%, weight %.2f, %llu packets\n",
+                                                p.name.c_str(), (double) p.srtt / NS_IN_MS, p.loss * 100.0, p.eff_weight, p.packets);
+                        }
+                }
+                s->last_stats = now;
+        }
+}
+
+int path_sched_next(struct path_sched *s)
+{
+        struct path *best = nullptr;
+        double total = 0.0;
+        for (auto &p : s->paths) {
+                if (p.eff_weight <= 0.0) {
+                        continue;
+                }
+                p.current += p.eff_weight;
+                total += p.eff_weight;
+                if (best == nullptr || p.current > best->current) {
+                        best = &p;
+                }
+        }
+        if (best == nullptr) {
+                return -1;
+        }
+        best->current -= total;
+        best->packets += 1;
+        return (int) (best - s->paths.data());
+}
+
+void path_sched_get_stats(const struct path_sched *s, int path, struct path_sched_stats *stats)
+{
+        const struct path &p = s->paths.at(path);
+        *stats = { p.eff_weight, p.loss, p.srtt, p.failed, p.packets };
+}
@@ -0,0 +1,110 @@
+/**
+ * @file   utils/path_sched.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Packet scheduler of multi-path (bonded) sending. Packets are assigned to
+ * the paths by smooth weighted round-robin. The configured weights are scaled
+ * by the path health measured by probes echoed by the receiver - loss
+ * decreases the share and paths with RTT excessively higher than the best one
+ * get less traffic so that the cross-path reordering stays within the
+ * receiver playout delay. A path without echo for PATH_SCHED_FAIL_TIMEOUT is
+ * excluded (but further probed), so only its share is lost until then.
+ *
+ * The scheduler doesn't send anything itself, probes and their echoes are
+ * passed by the caller.
+ */
+/*
+ * Copyright (c) 2026 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PATH_SCHED_H_B4E1C7A2_0F38_4D6B_9C25_E87A13F5D640
+#define PATH_SCHED_H_B4E1C7A2_0F38_4D6B_9C25_E87A13F5D640
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+#include "tv.h"
+
+#define PATH_SCHED_PROBE_INTERVAL (100 * NS_IN_MS)
+#define PATH_SCHED_FAIL_TIMEOUT NS_IN_SEC
+#define PATH_SCHED_DELAY_SLACK (20 * NS_IN_MS) ///< RTT difference tolerated without penalty
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct path_sched;
+
+struct path_sched_stats {
+        double    weight;  ///< effective weight
+        double    loss;    ///< probe loss ratio
+        time_ns_t srtt;    ///< smoothed RTT (0 - not measured yet)
+        bool      failed;
+        unsigned long long packets;
+};
+
+struct path_sched *path_sched_create(void);
+void path_sched_destroy(struct path_sched *s);
+/**
+ * @param name  used in log messages
+ * @returns index of the added path, initially disabled
+ */
+int path_sched_add(struct path_sched *s, const char *name, double weight);
+/// forgets all measurements and disables all paths (keeps names and weights)
+void path_sched_reset(struct path_sched *s);
+/// path is usable for sending (its socket was initialized)
+void path_sched_enable(struct path_sched *s, int path, time_ns_t now);
+/**
+ * Checks if a probe should be sent through the path. If so, the probe is
+ * recorded as sent at now.
+ *
+ * @param[out] probe_seq sequence number of the probe to be sent
+ */
+bool path_sched_probe_due(struct path_sched *s, int path, time_ns_t now, uint32_t *probe_seq);
+/// processes echo of a probe sent at send_time, received at now
+void path_sched_echo(struct path_sched *s, int path, uint32_t probe_seq, time_ns_t send_time, time_ns_t now);
+/// recomputes the effective weights, should be called regularly (eg. once per frame)
+void path_sched_update(struct path_sched *s, time_ns_t now);
+/// @returns path the next packet should be sent through, -1 if there is no enabled path
+int path_sched_next(struct path_sched *s);
+void path_sched_get_stats(const struct path_sched *s, int path, struct path_sched_stats *stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined PATH_SCHED_H_B4E1C7A2_0F38_4D6B_9C25_E87A13F5D640
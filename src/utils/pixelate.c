@@ -0,0 +1,320 @@
+/**
+ * @file   utils/pixelate.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Lines of one block row are summed first (SIMD over the whole region
+ * width), the sums are then reduced per block and component and the
+ * resulting row is copied back to all lines of the block row. Luma and
+ * chroma samples are thus averaged separately regardless of the packing.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/line_accumulate.h"
+#include "utils/macros.h"
+#include "utils/pixelate.h"
+#include "video_codec.h"
+
+/// layout of codecs with 8-bit components
+struct byte_layout {
+        int group_bytes;          ///< bytes of the smallest repeating pixel group
+        int group_pixels;
+        unsigned char comp[4];    ///< component index of each byte of the group
+        unsigned char comp_count[4]; ///< occurrences of each component in the group
+        unsigned char black[4];
+};
+
+static const struct byte_layout layout_rgb = { 3, 1, { 0, 1, 2 }, { 1, 1, 1 }, { 0, 0, 0 } };
+static const struct byte_layout layout_rgba = { 4, 1, { 0, 1, 2, 3 }, { 1, 1, 1, 1 }, { 0, 0, 0, 255 } };
+static const struct byte_layout layout_uyvy = { 4, 2, { 0, 1, 2, 1 }, { 1, 2, 1 }, { 128, 16, 128, 16 } };
+static const struct byte_layout layout_yuyv = { 4, 2, { 0, 1, 0, 2 }, { 2, 1, 1 }, { 16, 128, 16, 128 } };
+static const struct byte_layout layout_luma = { 1, 1, { 0 }, { 1 }, { 16 } };
+static const struct byte_layout layout_chroma = { 1, 1, { 0 }, { 1 }, { 128 } };
+
+/// component (0 - Y, 1 - Cb, 2 - Cr) of the 12 10-bit fields of a v210 group
+static const unsigned char v210_comp[12] = { 1, 0, 2, 0, 1, 0, 2, 0, 1, 0, 2, 0 };
+static const int v210_comp_count[3] = { 6, 3, 3 };
+static const uint32_t v210_black[3] = { 64, 512, 512 };
+
+struct pixelator {
+        uint16_t *acc;
+        size_t acc_len;
+        uint32_t *acc10;
+        size_t acc10_len;
+        unsigned char *row;
+        size_t row_len;
+};
+
+struct pixelator *pixelator_create(void)
+{
+        return calloc(1, sizeof(struct pixelator));
+}
+
+void pixelator_destroy(struct pixelator *p)
+{
+        if (p == NULL) {
+                return;
+        }
+        free(p->acc);
+        free(p->acc10);
+        free(p->row);
+        free(p);
+}
+
+/// grows the buffer to hold at least count items of size
+static void *ensure_size(void *buf, size_t *len, size_t count, size_t size)
+{
+        if (*len >= count) {
+                return buf;
+        }
+        free(buf);
+        *len = count;
+        return malloc(count * size);
+}
+
+#define SUM_POSITIONS(gb) \
+        for (int i = 0; i < groups * (gb); i += (gb)) { \
+                for (int j = 0; j < (gb); ++j) { \
+                        pos_sum[j] += acc[i + j]; \
+                } \
+        }
+
+/// sums accumulated values per byte position of the pixel group
+static void sum_positions(uint32_t *pos_sum, const uint16_t *acc, int groups, int gb)
+{
+        // constant group sizes let the compiler unroll and vectorize the loop
+        switch (gb) {
+        case 1: SUM_POSITIONS(1) break;
+        case 3: SUM_POSITIONS(3) break;
+        case 4: SUM_POSITIONS(4) break;
+        default: SUM_POSITIONS(gb)
+        }
+}
+
+/**
+ * @param start       first byte of the region
+ * @param groups      region width in pixel groups
+ * @param block_w     block width in pixel groups, 0 to blank
+ */
+static void pixelate_bytes(struct pixelator *p, unsigned char *start, int linesize, const struct byte_layout *l,
+                int groups, int lines, int block_w, int block_h)
+{
+        const int gb = l->group_bytes;
+        const int len = groups * gb;
+        unsigned char *row = p->row = ensure_size(p->row, &p->row_len, len, 1);
+
+        if (block_w == 0) {
+                for (int i = 0; i < len; i += gb) {
+                        memcpy(row + i, l->black, gb);
+                }
+                for (int i = 0; i < lines; ++i) {
+                        memcpy(start + (size_t) i * linesize, row, len);
+                }
+                return;
+        }
+
+        uint16_t *acc = p->acc = ensure_size(p->acc, &p->acc_len, len, sizeof *acc);
+        for (int by = 0; by < lines; by += block_h) {
+                const int block_lines = MIN(block_h, lines - by);
+                unsigned char *block_start = start + (size_t) by * linesize;
+                memset(acc, 0, len * sizeof *acc);
+                for (int i = 0; i < block_lines; ++i) {
+                        line_accumulate_8(acc, block_start + (size_t) i * linesize, len);
+                }
+                for (int bx = 0; bx < groups; bx += block_w) {
+                        const int block_groups = MIN(block_w, groups - bx);
+                        uint32_t pos_sum[4] = { 0 };
+                        sum_positions(pos_sum, acc + bx * gb, block_groups, gb);
+                        uint32_t sum[4] = { 0 };
+                        for (int j = 0; j < gb; ++j) {
+                                sum[l->comp[j]] += pos_sum[j];
+                        }
+                        unsigned char val[4];
+                        for (int j = 0; j < gb; ++j) {
+                                const uint32_t samples = (uint32_t) block_groups * block_lines * l->comp_count[l->comp[j]];
+                                val[j] = (sum[l->comp[j]] + samples / 2) / samples;
+                        }
+                        unsigned char *out = row + bx * gb;
+                        for (int i = 0; i < block_groups; ++i) {
+                                memcpy(out + i * gb, val, gb);
+                        }
+                }
+                for (int i = 0; i < block_lines; ++i) {
+                        memcpy(block_start + (size_t) i * linesize, row, len);
+                }
+        }
+}
+
+/// v210 counterpart of pixelate_bytes(), a group is 6 pixels (4 words)
+static void pixelate_v210(struct pixelator *p, unsigned char *start, int linesize,
+                int groups, int lines, int block_w, int block_h)
+{
+        const int words = groups * 4;
+        const int len = words * 4;
+        unsigned char *row = p->row = ensure_size(p->row, &p->row_len, len, 1);
+
+        if (block_w == 0) {
+                for (int i = 0; i < words; ++i) {
+                        uint32_t word = 0;
+                        for (int j = 0; j < 3; ++j) {
+                                word |= v210_black[v210_comp[(i % 4) * 3 + j]] << (10 * j);
+                        }
+                        memcpy(row + 4 * i, &word, sizeof word);
+                }
+                for (int i = 0; i < lines; ++i) {
+                        memcpy(start + (size_t) i * linesize, row, len);
+                }
+                return;
+        }
+
+        uint32_t *acc = p->acc10 = ensure_size(p->acc10, &p->acc10_len, 3 * words, sizeof *acc);
+        for (int by = 0; by < lines; by += block_h) {
+                const int block_lines = MIN(block_h, lines - by);
+                unsigned char *block_start = start + (size_t) by * linesize;
+                memset(acc, 0, 3 * words * sizeof *acc);
+                for (int i = 0; i < block_lines; ++i) {
+                        line_accumulate_v210(acc, block_start + (size_t) i * linesize, words);
+                }
+                for (int bx = 0; bx < groups; bx += block_w) {
+                        const int block_groups = MIN(block_w, groups - bx);
+                        uint32_t sum[3] = { 0 };
+                        for (int i = bx * 4; i < (bx + block_groups) * 4; ++i) {
+                                for (int j = 0; j < 3; ++j) {
+                                        sum[v210_comp[(i % 4) * 3 + j]] += acc[j * words + i];
+                                }
+                        }
+                        uint32_t val[3];
+                        for (int c = 0; c < 3; ++c) {
+                                const uint32_t samples = (uint32_t) block_groups * block_lines * v210_comp_count[c];
+                                val[c] = (sum[c] + samples / 2) / samples;
+                        }
+                        for (int i = bx * 4; i < (bx + block_groups) * 4; ++i) {
+                                uint32_t word = 0;
+                                for (int j = 0; j < 3; ++j) {
+                                        word |= val[v210_comp[(i % 4) * 3 + j]] << (10 * j);
+                                }
+                                memcpy(row + 4 * i, &word, sizeof word);
+                        }
+                }
+                for (int i = 0; i < block_lines; ++i) {
+                        memcpy(block_start + (size_t) i * linesize, row, len);
+                }
+        }
+}
+
+static const struct byte_layout *get_byte_layout(codec_t codec)
+{
+        switch (codec) {
+        case RGB:
+        case BGR:
+                return &layout_rgb;
+        case RGBA:
+                return &layout_rgba;
+        case UYVY:
+                return &layout_uyvy;
+        case YUYV:
+                return &layout_yuyv;
+        default:
+                return NULL;
+        }
+}
+
+bool pixelator_supports(codec_t codec)
+{
+        return get_byte_layout(codec) != NULL || codec == v210 || codec == I420;
+}
+
+bool pixelator_apply(struct pixelator *p, char *data, codec_t codec, int width, int height,
+                int x, int y, int w, int h, int block)
+{
+        if (!pixelator_supports(codec)) {
+                return false;
+        }
+        const struct byte_layout *l = get_byte_layout(codec);
+        const int align = codec == v210 ? 6 : codec == I420 ? 2 : l->group_pixels;
+        const int align_y = codec == I420 ? 2 : 1;
+
+        // v210 lines are padded to whole groups
+        const int max_x = codec == v210 ? (width + 5) / 6 * 6 : width / align * align;
+        const int max_y = height / align_y * align_y;
+        const int x_end = MIN((MAX(x, 0) + MAX(w, 0) + align - 1) / align * align, max_x);
+        const int y_end = MIN((MAX(y, 0) + MAX(h, 0) + align_y - 1) / align_y * align_y, max_y);
+        x = MAX(x, 0) / align * align;
+        y = MAX(y, 0) / align_y * align_y;
+        if (x_end <= x || y_end <= y) {
+                return true;
+        }
+
+        int block_w = 0;
+        int block_h = 0;
+        if (block > 0) {
+                block = CLAMP(block, 1, PIXELATE_MAX_BLOCK);
+                block_w = (block + align - 1) / align * align;
+                block_h = (block + align_y - 1) / align_y * align_y;
+        }
+
+        unsigned char *buf = (unsigned char *) data;
+        if (codec == v210) {
+                const int linesize = vc_get_linesize(width, v210);
+                pixelate_v210(p, buf + (size_t) y * linesize + x / 6 * 16, linesize,
+                                (x_end - x) / 6, y_end - y, block_w / 6, block_h);
+        } else if (codec == I420) {
+                const int c_width = (width + 1) / 2;
+                const int c_height = (height + 1) / 2;
+                unsigned char *u = buf + (size_t) width * height;
+                unsigned char *v = u + (size_t) c_width * c_height;
+                pixelate_bytes(p, buf + (size_t) y * width + x, width, &layout_luma,
+                                x_end - x, y_end - y, block_w, block_h);
+                for (int i = 0; i < 2; ++i) {
+                        unsigned char *plane = i == 0 ? u : v;
+                        pixelate_bytes(p, plane + (size_t) y / 2 * c_width + x / 2, c_width, &layout_chroma,
+                                        (x_end - x) / 2, (y_end - y) / 2, block_w / 2, block_h / 2);
+                }
+        } else {
+                const int linesize = vc_get_linesize(width, codec);
+                pixelate_bytes(p, buf + (size_t) y * linesize + x / l->group_pixels * l->group_bytes, linesize, l,
+                                (x_end - x) / l->group_pixels, y_end - y, block_w / l->group_pixels, block_h);
+        }
+        return true;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file   utils/pixelate.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * In-place blanking and pixelation (block averaging) of rectangular regions
+ * of a frame without converting the frame to another pixel format.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PIXELATE_H_8C1E5A47_2B9D_4F63_A0D8_51C7E2B93F04
+#define PIXELATE_H_8C1E5A47_2B9D_4F63_A0D8_51C7E2B93F04
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIXELATE_MAX_BLOCK 256 ///< block lines are summed in 16 bits
+
+struct pixelator;
+
+struct pixelator *pixelator_create(void);
+void pixelator_destroy(struct pixelator *p);
+/**
+ * @retval true  if pixelator_apply() can process the codec (RGB, BGR, RGBA,
+ *               UYVY, YUYV, v210 or I420)
+ */
+bool pixelator_supports(codec_t codec);
+/**
+ * Blanks or pixelates the rectangle x, y, w, h of the frame data in place.
+ * Only the lines covered by the rectangle are touched.
+ *
+ * The rectangle is clipped to the frame and aligned to whole pixel blocks
+ * of the codec (2 pixels for UYVY and I420, 6 pixels for v210).
+ *
+ * @param block  size of the averaged squares in pixels (clamped to
+ *               [1, @ref PIXELATE_MAX_BLOCK]), 0 to fill with black
+ * @retval false codec not supported
+ */
+bool pixelator_apply(struct pixelator *p, char *data, codec_t codec, int width, int height,
+                int x, int y, int w, int h, int block);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined PIXELATE_H_8C1E5A47_2B9D_4F63_A0D8_51C7E2B93F04
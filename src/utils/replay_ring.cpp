@@ -0,0 +1,324 @@
+/**
+ * @file   utils/replay_ring.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio/types.h"
+#include "audio/utils.h"
+#include "audio/wav_writer.h"
+#include "debug.h"
+#include "tv.h"
+#include "types.h"
+#include "utils/mem_account.h"
+#include "utils/misc.h"
+#include "utils/replay_ring.h"
+#include "utils/thread.h"
+#include "video_export.h"
+#include "video_frame.h"
+
+#define MOD_NAME "[replay] "
+
+using std::atomic;
+using std::deque;
+using std::lock_guard;
+using std::mutex;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::vector;
+
+namespace {
+struct video_entry {
+        shared_ptr<video_frame> frame;
+        bool key;
+        time_ns_t time;
+        size_t len;
+};
+
+struct audio_entry {
+        audio_desc desc;
+        shared_ptr<vector<char>> data;
+        time_ns_t time;
+};
+} // end of anonymous namespace
+
+struct replay_ring {
+        replay_ring(double seconds, size_t max_bytes) :
+                window((time_ns_t) (seconds * NS_IN_SEC_DBL)), max_bytes(max_bytes) {}
+        ~replay_ring();
+
+        void evict();
+        bool over_cap() const {
+                return (max_bytes > 0 && bytes > max_bytes) ||
+                        mem_account_over_cap(MEM_ACC_REPLAY_RING);
+        }
+        void account_free(size_t len) {
+                bytes -= len;
+                mem_account_free(MEM_ACC_REPLAY_RING, len);
+        }
+
+        const time_ns_t window;
+        const size_t max_bytes;
+
+        mutex lock;
+        deque<video_entry> video;
+        deque<audio_entry> audio;
+        size_t bytes = 0;
+        bool waiting_for_key = true;
+
+        thread dump_thread;
+        atomic<bool> dumping{false};
+};
+
+replay_ring::~replay_ring()
+{
+        if (dump_thread.joinable()) {
+                dump_thread.join();
+        }
+        for (auto const &e : video) {
+                account_free(e.len);
+        }
+        for (auto const &e : audio) {
+                account_free(e.data->size());
+        }
+}
+
+/**
+ * Video is evicted by whole GOPs so that the ring always starts with a
+ * keyframe. The last GOP is kept even if longer than the window, unless it
+ * exceeds the size cap - the ring is then emptied and waits for a keyframe.
+ */
+void replay_ring::evict()
+{
+        while (!video.empty()) {
+                size_t next_key = 1;
+                while (next_key < video.size() && !video[next_key].key) {
+                        next_key += 1;
+                }
+                if (next_key == video.size()) {
+                        if (over_cap()) {
+                                MSG(WARNING, "Single GOP exceeds the size "
+                                             "cap, dropping video!\n");
+                                for (auto const &e : video) {
+                                        account_free(e.len);
+                                }
+                                video.clear();
+                                waiting_for_key = true;
+                        }
+                        break;
+                }
+                if (!over_cap() && video.back().time - video[next_key].time < window) {
+                        break;
+                }
+                for (size_t i = 0; i < next_key; ++i) {
+                        account_free(video.front().len);
+                        video.pop_front();
+                }
+        }
+
+        const time_ns_t oldest = video.empty()
+                ? (audio.empty() ? 0 : audio.back().time - window)
+                : video.front().time;
+        while (!audio.empty() && (audio.front().time < oldest || over_cap())) {
+                account_free(audio.front().data->size());
+                audio.pop_front();
+        }
+}
+
+struct replay_ring *replay_ring_init(double seconds, size_t max_bytes)
+{
+        if (seconds <= 0) {
+                MSG(ERROR, "Wrong ring length: %f s!\n", seconds);
+                return nullptr;
+        }
+        return new replay_ring(seconds, max_bytes);
+}
+
+void replay_ring_destroy(struct replay_ring *s)
+{
+        delete s;
+}
+
+void replay_ring_add_video(struct replay_ring *s, const struct video_frame *frame)
+{
+        const bool key = frame->frame_type == INTRA;
+        lock_guard<mutex> lk(s->lock);
+        if (!key && s->waiting_for_key) {
+                return;
+        }
+        s->waiting_for_key = false;
+
+        video_entry e{};
+        e.frame = shared_ptr<video_frame>(
+            vf_get_copy(const_cast<video_frame *>(frame)), vf_free);
+        e.key = key;
+        e.time = get_time_in_ns();
+        for (unsigned i = 0; i < frame->tile_count; ++i) {
+                e.len += frame->tiles[i].data_len;
+        }
+        s->bytes += e.len;
+        mem_account_alloc(MEM_ACC_REPLAY_RING, e.len);
+        s->video.push_back(std::move(e));
+        s->evict();
+}
+
+void replay_ring_add_audio(struct replay_ring *s, const struct audio_frame *frame)
+{
+        if (frame->data_len <= 0) {
+                return;
+        }
+        audio_entry e{};
+        e.desc = audio_desc_from_frame(frame);
+        e.data = std::make_shared<vector<char>>(frame->data,
+                                                frame->data + frame->data_len);
+        e.time = get_time_in_ns();
+
+        lock_guard<mutex> lk(s->lock);
+        s->bytes += frame->data_len;
+        mem_account_alloc(MEM_ACC_REPLAY_RING, frame->data_len);
+        s->audio.push_back(std::move(e));
+        s->evict();
+}
+
+static void dump_audio(const string &dir, const vector<audio_entry> &audio)
+{
+        if (audio.empty()) {
+                return;
+        }
+        const audio_desc desc = audio.front().desc;
+        string name = dir + "/sound.wav";
+        struct wav_writer_file *wav = wav_writer_create(name.c_str(), desc);
+        if (wav == nullptr) {
+                MSG(ERROR, "Cannot create %s!\n", name.c_str());
+                return;
+        }
+        for (auto const &e : audio) {
+                if (!audio_desc_eq(e.desc, desc)) {
+                        MSG(WARNING, "Audio format change, not exporting rest of audio.\n");
+                        break;
+                }
+                int rc = wav_writer_write(wav, e.data->size() / (desc.bps * desc.ch_count),
+                                          e.data->data());
+                if (rc != 0) {
+                        MSG(ERROR, "Problem writing audio samples: %s\n", ug_strerror(-rc));
+                        break;
+                }
+        }
+        wav_writer_close(wav);
+}
+
+static void dump_video(const string &dir, const vector<video_entry> &video)
+{
+        if (video.empty()) {
+                return;
+        }
+        struct video_export *exp = video_export_init(dir.c_str());
+        if (exp == nullptr) {
+                return;
+        }
+        video_export_set_blocking(exp, true);
+        for (auto const &e : video) {
+                video_export(exp, e.frame.get());
+        }
+        video_export_destroy(exp);
+}
+
+bool replay_ring_dump(struct replay_ring *s, const char *dir, bool video, bool audio)
+{
+        if (s->dumping) {
+                return false;
+        }
+        if (s->dump_thread.joinable()) {
+                s->dump_thread.join();
+        }
+
+        vector<video_entry> video_snapshot;
+        vector<audio_entry> audio_snapshot;
+        {
+                lock_guard<mutex> lk(s->lock);
+                if (video) {
+                        video_snapshot.assign(s->video.begin(), s->video.end());
+                }
+                if (audio) {
+                        audio_snapshot.assign(s->audio.begin(), s->audio.end());
+                }
+        }
+
+        s->dumping = true;
+        s->dump_thread = thread([s, path = string(dir),
+                                 video_snapshot = std::move(video_snapshot),
+                                 audio_snapshot = std::move(audio_snapshot)] {
+                set_thread_name("replay_dump");
+                dump_video(path, video_snapshot);
+                dump_audio(path, audio_snapshot);
+                MSG(NOTICE, "Replay dumped to %s (%zu video frames, %zu audio frames).\n",
+                    path.c_str(), video_snapshot.size(), audio_snapshot.size());
+                s->dumping = false;
+        });
+
+        return true;
+}
+
+void replay_ring_get_stats(struct replay_ring *s, struct replay_ring_stats *stats)
+{
+        lock_guard<mutex> lk(s->lock);
+        stats->video_frames = s->video.size();
+        stats->audio_frames = s->audio.size();
+        stats->bytes = s->bytes;
+        stats->duration = 0;
+        if (!s->video.empty()) {
+                stats->duration = (s->video.back().time - s->video.front().time) / NS_IN_SEC_DBL;
+        } else if (!s->audio.empty()) {
+                stats->duration = (s->audio.back().time - s->audio.front().time) / NS_IN_SEC_DBL;
+        }
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -0,0 +1,92 @@
+/**
+ * @file   utils/replay_ring.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * In-memory ring of the last N seconds of compressed video and audio that
+ * can be dumped on demand in the export layout (see export.c) so that it can
+ * be replayed with --playback. The ring always begins with a keyframe and
+ * whole GOPs are evicted at once.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef REPLAY_RING_H_3F7A9C21_84D2_4B6E_A0C5_2E91D7B4F608
+#define REPLAY_RING_H_3F7A9C21_84D2_4B6E_A0C5_2E91D7B4F608
+
+#ifdef __cplusplus
+#include <cstddef>
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct audio_frame;
+struct replay_ring;
+struct video_frame;
+
+struct replay_ring_stats {
+        int video_frames;
+        int audio_frames;
+        size_t bytes;
+        double duration; ///< span of stored video (audio if no video) in seconds
+};
+
+/**
+ * @param seconds   length of the kept history
+ * @param max_bytes cap of the stored data (0 - unlimited)
+ */
+struct replay_ring *replay_ring_init(double seconds, size_t max_bytes);
+/// waits for a pending dump to complete
+void replay_ring_destroy(struct replay_ring *s);
+void replay_ring_add_video(struct replay_ring *s, const struct video_frame *frame);
+void replay_ring_add_audio(struct replay_ring *s, const struct audio_frame *frame);
+/**
+ * Writes current ring contents to (already existing) directory dir in a
+ * separate thread. The ring is not altered.
+ *
+ * @retval false if another dump is still running
+ */
+bool replay_ring_dump(struct replay_ring *s, const char *dir, bool video, bool audio);
+void replay_ring_get_stats(struct replay_ring *s, struct replay_ring_stats *stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined REPLAY_RING_H_3F7A9C21_84D2_4B6E_A0C5_2E91D7B4F608
+
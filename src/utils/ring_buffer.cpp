@@ -36,6 +36,7 @@
  * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "utils/mem_account.h"
 #include "utils/ring_buffer.h"
 #include <assert.h>
 #include <stdio.h>
@@ -71,11 +72,13 @@ struct ring_buffer *ring_buffer_init(int size) {
         ring->len = size;
         ring->start = 0;
         ring->end = 0;
+        mem_account_alloc(MEM_ACC_RING_BUFFER, size);
         return ring;
 }
 
 void ring_buffer_destroy(struct ring_buffer *ring) {
         if(ring) {
+                mem_account_free(MEM_ACC_RING_BUFFER, ring->len);
                 delete ring;
         }
 }
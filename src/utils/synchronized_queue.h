@@ -43,6 +43,8 @@
 #include <queue>
 #include <utility>
 
+#include "utils/virtual_clock.h"
+
 struct msg {
         virtual ~msg() {}
 };
@@ -70,10 +72,13 @@ public:
         void push(T const & message)
         {
                 std::unique_lock<std::mutex> l(m_lock);
-                if (max_len != -1) {
+                if (max_len != -1 && m_queue.size() >= (unsigned int) max_len) {
+                        virtual_clock_wait_begin(&m_push_waiters);
                         m_queue_decremented.wait(l, [this]{return m_queue.size() < (unsigned int) max_len;});
+                        virtual_clock_wait_end(&m_push_waiters);
                 }
                 m_queue.push(message);
+                virtual_clock_wait_notify(&m_pop_waiters);
                 l.unlock();
                 m_queue_incremented.notify_one();
         }
@@ -81,10 +86,13 @@ public:
         void push(T && message)
         {
                 std::unique_lock<std::mutex> l(m_lock);
-                if (max_len != -1) {
+                if (max_len != -1 && m_queue.size() >= (unsigned int) max_len) {
+                        virtual_clock_wait_begin(&m_push_waiters);
                         m_queue_decremented.wait(l, [this]{return m_queue.size() < (unsigned int) max_len;});
+                        virtual_clock_wait_end(&m_push_waiters);
                 }
                 m_queue.push(std::move(message));
+                virtual_clock_wait_notify(&m_pop_waiters);
                 l.unlock();
                 m_queue_incremented.notify_one();
         }
@@ -96,9 +104,14 @@ public:
                         return T();
                 }
 
-                m_queue_incremented.wait(l, [this]{return m_queue.size() > 0;});
+                if (m_queue.size() == 0) {
+                        virtual_clock_wait_begin(&m_pop_waiters);
+                        m_queue_incremented.wait(l, [this]{return m_queue.size() > 0;});
+                        virtual_clock_wait_end(&m_pop_waiters);
+                }
                 T ret = std::move(m_queue.front());
                 m_queue.pop();
+                virtual_clock_wait_notify(&m_push_waiters);
 
                 l.unlock();
                 m_queue_decremented.notify_one();
@@ -109,11 +122,15 @@ public:
         bool timed_pop(T& result, std::chrono::duration<Rep, Period> const& timeout)
         {
                 std::unique_lock<std::mutex> l(m_lock);
-                if (!m_queue_incremented.wait_for(l, timeout, [this]{return m_queue.size() > 0;})) {
+                virtual_clock_wait_begin(&m_pop_waiters);
+                const bool ready = m_queue_incremented.wait_for(l, timeout, [this]{return m_queue.size() > 0;});
+                virtual_clock_wait_end(&m_pop_waiters);
+                if (!ready) {
                         return false;
                 }
                 result = std::move(m_queue.front());
                 m_queue.pop();
+                virtual_clock_wait_notify(&m_push_waiters);
                 l.unlock();
                 m_queue_decremented.notify_one();
                 return true;
@@ -124,6 +141,8 @@ private:
         std::mutex              m_lock;
         std::condition_variable m_queue_decremented;
         std::condition_variable m_queue_incremented;
+        virtual_clock_waiters   m_push_waiters{};
+        virtual_clock_waiters   m_pop_waiters{};
 };
 
 #ifndef NO_EXTERN_MSGQ_MSG
@@ -0,0 +1,247 @@
+/**
+ * @file   utils/uyvy_scale.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * The scaling is separable - the two source lines contributing to an output
+ * line are blended first (SIMD over the whole source line), the result is
+ * then resampled horizontally with precomputed per-byte offsets and weights
+ * (luma and chroma samples thus need no special handling in the inner loop).
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "utils/uyvy_scale.h"
+
+#define WEIGHT_BITS 8
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+
+struct uyvy_scaler {
+        int in_w, in_h, out_w, out_h;
+
+        // horizontal - for every output byte
+        int32_t *h_off;    ///< first source sample
+        int32_t *h_off2;   ///< second source sample
+        uint16_t *h_weight; ///< weight of the second sample
+
+        // vertical - for every output line
+        int32_t *v_line;
+        uint16_t *v_weight;
+};
+
+/// computes first source sample index and the weight of the next one
+static void get_pos(int out_idx, int in_len, int out_len, int *idx, int *weight)
+{
+        double pos = (out_idx + 0.5) * in_len / out_len - 0.5;
+        if (pos < 0) {
+                pos = 0;
+        }
+        *idx = (int) pos;
+        *weight = (int) ((pos - *idx) * WEIGHT_ONE + 0.5);
+        if (*idx >= in_len - 1) {
+                *idx = in_len - 1;
+                *weight = 0;
+        }
+        if (*weight == WEIGHT_ONE) {
+                *idx += 1;
+                *weight = 0;
+        }
+}
+
+struct uyvy_scaler *uyvy_scaler_create(int in_w, int in_h, int out_w, int out_h)
+{
+        assert(in_w % 2 == 0 && out_w % 2 == 0);
+        if (in_w <= 0 || in_h <= 0 || out_w <= 0 || out_h <= 0) {
+                return NULL;
+        }
+        struct uyvy_scaler *s = calloc(1, sizeof *s);
+        s->in_w = in_w;
+        s->in_h = in_h;
+        s->out_w = out_w;
+        s->out_h = out_h;
+
+        const int out_bytes = out_w * 2;
+        s->h_off = malloc(out_bytes * sizeof s->h_off[0]);
+        s->h_off2 = malloc(out_bytes * sizeof s->h_off2[0]);
+        s->h_weight = malloc(out_bytes * sizeof s->h_weight[0]);
+        for (int i = 0; i < out_bytes; ++i) {
+                int idx = 0;
+                int weight = 0;
+                if (i % 2 == 1) { // Y
+                        get_pos(i / 2, in_w, out_w, &idx, &weight);
+                        s->h_off[i] = idx * 2 + 1;
+                        s->h_off2[i] = (idx + (idx < in_w - 1)) * 2 + 1;
+                } else { // U or V
+                        get_pos(i / 4, in_w / 2, out_w / 2, &idx, &weight);
+                        s->h_off[i] = idx * 4 + i % 4;
+                        s->h_off2[i] = (idx + (idx < in_w / 2 - 1)) * 4 + i % 4;
+                }
+                s->h_weight[i] = weight;
+        }
+
+        s->v_line = malloc(out_h * sizeof s->v_line[0]);
+        s->v_weight = malloc(out_h * sizeof s->v_weight[0]);
+        for (int i = 0; i < out_h; ++i) {
+                int idx = 0;
+                int weight = 0;
+                get_pos(i, in_h, out_h, &idx, &weight);
+                s->v_line[i] = idx;
+                s->v_weight[i] = weight;
+        }
+        return s;
+}
+
+void uyvy_scaler_destroy(struct uyvy_scaler *s)
+{
+        if (s == NULL) {
+                return;
+        }
+        free(s->h_off);
+        free(s->h_off2);
+        free(s->h_weight);
+        free(s->v_line);
+        free(s->v_weight);
+        free(s);
+}
+
+/// out = (a * (WEIGHT_ONE - w) + b * w) / WEIGHT_ONE
+static void blend_lines(const unsigned char *a, const unsigned char *b, unsigned char *out, int len, int w)
+{
+        int i = 0;
+#ifdef __SSE2__
+        const __m128i wa = _mm_set1_epi16(WEIGHT_ONE - w);
+        const __m128i wb = _mm_set1_epi16(w);
+        const __m128i round = _mm_set1_epi16(WEIGHT_ONE / 2);
+        const __m128i zero = _mm_setzero_si128();
+        if (w == WEIGHT_ONE / 2) { // (a + b + 1) / 2 - equal to the below
+                for ( ; i + 16 <= len; i += 16) {
+                        __m128i va = _mm_loadu_si128((const __m128i *)(const void *) (a + i));
+                        __m128i vb = _mm_loadu_si128((const __m128i *)(const void *) (b + i));
+                        _mm_storeu_si128((__m128i *)(void *) (out + i), _mm_avg_epu8(va, vb));
+                }
+        }
+        for ( ; i + 16 <= len; i += 16) {
+                __m128i va = _mm_loadu_si128((const __m128i *)(const void *) (a + i));
+                __m128i vb = _mm_loadu_si128((const __m128i *)(const void *) (b + i));
+                __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+                __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+                lo = _mm_srli_epi16(_mm_add_epi16(lo, round), WEIGHT_BITS);
+                hi = _mm_srli_epi16(_mm_add_epi16(hi, round), WEIGHT_BITS);
+                _mm_storeu_si128((__m128i *)(void *) (out + i), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for ( ; i < len; ++i) {
+                out[i] = (a[i] * (WEIGHT_ONE - w) + b[i] * w + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+        }
+}
+
+/**
+ * Horizontal 2:1 downscale - bilinear weights are then exactly 1/2 so
+ * U Ya V Yb U' Yc V' Yd -> avg(U,U') avg(Ya,Yb) avg(V,V') avg(Yc,Yd)
+ */
+static void halve_line(const unsigned char *in, unsigned char *out, int out_len)
+{
+        int i = 0;
+#ifdef __SSSE3__
+        const __m128i shuf_a = _mm_setr_epi8(0, 1, 2, 5, 8, 9, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i shuf_b = _mm_setr_epi8(4, 3, 6, 7, 12, 11, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+        for ( ; i + 8 <= out_len; i += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(const void *) (in + 2 * i));
+                __m128i res = _mm_avg_epu8(_mm_shuffle_epi8(v, shuf_a), _mm_shuffle_epi8(v, shuf_b));
+                _mm_storel_epi64((__m128i *)(void *) (out + i), res);
+        }
+#endif
+        for ( ; i < out_len; i += 4) {
+                const unsigned char *src = in + 2 * i;
+                out[i] = (src[0] + src[4] + 1) >> 1;
+                out[i + 1] = (src[1] + src[3] + 1) >> 1;
+                out[i + 2] = (src[2] + src[6] + 1) >> 1;
+                out[i + 3] = (src[5] + src[7] + 1) >> 1;
+        }
+}
+
+void uyvy_scaler_scale(const struct uyvy_scaler *s, const char *in, int in_pitch, char *out, int out_pitch,
+                int out_y_begin, int out_y_end)
+{
+        const int in_bytes = s->in_w * 2;
+        const int out_bytes = s->out_w * 2;
+        unsigned char *tmp = malloc(in_bytes);
+        for (int y = out_y_begin; y < out_y_end; ++y) {
+                const int line = s->v_line[y];
+                const int next_line = line + (line < s->in_h - 1);
+                const unsigned char *src = (const unsigned char *) in + (size_t) line * in_pitch;
+                unsigned char *dst = (unsigned char *) out + (size_t) y * out_pitch;
+                const bool same_width = s->in_w == s->out_w;
+                if (s->v_weight[y] != 0) {
+                        blend_lines(src, (const unsigned char *) in + (size_t) next_line * in_pitch,
+                                        same_width ? dst : tmp, in_bytes, s->v_weight[y]);
+                        src = tmp;
+                } else if (same_width) {
+                        memcpy(dst, src, out_bytes);
+                }
+                if (same_width) {
+                        continue;
+                }
+                if (s->in_w == 2 * s->out_w) {
+                        halve_line(src, dst, out_bytes);
+                        continue;
+                }
+                for (int i = 0; i < out_bytes; ++i) {
+                        const int w = s->h_weight[i];
+                        dst[i] = (src[s->h_off[i]] * (WEIGHT_ONE - w) + src[s->h_off2[i]] * w + WEIGHT_ONE / 2)
+                                >> WEIGHT_BITS;
+                }
+        }
+        free(tmp);
+}
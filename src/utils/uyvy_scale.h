@@ -0,0 +1,68 @@
+/**
+ * @file   utils/uyvy_scale.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Bilinear scaler of UYVY images working directly in the YCbCr domain.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef UYVY_SCALE_H_3F6A9C21_7D4B_4E8A_B5C0_92E1D8F47A36
+#define UYVY_SCALE_H_3F6A9C21_7D4B_4E8A_B5C0_92E1D8F47A36
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct uyvy_scaler;
+
+/**
+ * @param in_w,out_w  widths in pixels, must be even
+ */
+struct uyvy_scaler *uyvy_scaler_create(int in_w, int in_h, int out_w, int out_h);
+void uyvy_scaler_destroy(struct uyvy_scaler *s);
+/**
+ * Scales output lines [out_y_begin, out_y_end). May be called concurrently
+ * for disjoint line ranges.
+ *
+ * @param in_pitch,out_pitch line lengths in bytes
+ */
+void uyvy_scaler_scale(const struct uyvy_scaler *s, const char *in, int in_pitch, char *out, int out_pitch,
+                int out_y_begin, int out_y_end);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined UYVY_SCALE_H_3F6A9C21_7D4B_4E8A_B5C0_92E1D8F47A36
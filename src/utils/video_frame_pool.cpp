@@ -38,13 +38,19 @@
 #include "config_msvc.h"
 
 #include <cassert>
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <stdexcept>
 #include <utility>
 
+#include "debug.h"
+#include "utils/macros.h"
+#include "utils/mem_account.h"
 #include "video_frame_pool.h"
 
+#define MEM_CAP_WAIT_TIMEOUT std::chrono::milliseconds(500)
+
 void *default_data_allocator::allocate(size_t size) {
         return malloc(size);
 }
@@ -67,9 +73,9 @@ video_frame_pool::~video_frame_pool() {
 
 void video_frame_pool::reconfigure(struct video_desc new_desc, size_t new_size) {
         std::unique_lock<std::mutex> lk(m_lock);
+        remove_free_frames(); // must be done before m_max_data_len change (accounting)
         m_desc = new_desc;
         m_max_data_len = new_size != SIZE_MAX ? new_size : new_desc.height * vc_get_linesize(new_desc.width, new_desc.color_spec);
-        remove_free_frames();
         m_generation++;
 }
 
@@ -85,25 +91,26 @@ std::shared_ptr<video_frame> video_frame_pool::get_frame() {
                 assert(!m_free_frames.empty());
                 ret = m_free_frames.front();
                 m_free_frames.pop();
-        } else {
-                try {
-                        ret = vf_alloc_desc(m_desc);
-                        for (unsigned int i = 0; i < m_desc.tile_count; ++i) {
-                                ret->tiles[i].data = (char *)
-                                        m_allocator->allocate(m_max_data_len);
-                                if (ret->tiles[i].data == NULL) {
-                                        throw std::runtime_error("Cannot allocate data");
-                                }
-                                ret->tiles[i].data_len = m_max_data_len;
+        } else if (m_unreturned_frames > 0 && mem_account_over_cap(MEM_ACC_FRAME_POOL)) {
+                // over the memory cap - wait for a frame to be returned instead of allocating a new one
+                // (the cap is global so the memory may be held by other pools - do not wait forever)
+                m_frame_returned.wait_for(lk, MEM_CAP_WAIT_TIMEOUT, [this] {return !m_free_frames.empty()
+                                || m_unreturned_frames == 0 || !mem_account_over_cap(MEM_ACC_FRAME_POOL);});
+                if (!m_free_frames.empty()) {
+                        ret = m_free_frames.front();
+                        m_free_frames.pop();
+                } else {
+                        if (mem_account_over_cap(MEM_ACC_FRAME_POOL)) {
+                                log_msg_once(LOG_LEVEL_WARNING, to_fourcc('v', 'f', 'p', 'c'), "[video_frame_pool] No frame returned "
+                                                "while over the memory cap, allocating anyway!\n");
                         }
-                } catch (std::exception &e) {
-                        std::cerr << e.what() << std::endl;
-                        deallocate_frame(ret);
-                        throw e;
+                        ret = allocate_frame();
                 }
+        } else {
+                ret = allocate_frame();
         }
         m_unreturned_frames += 1;
-        return std::shared_ptr<video_frame>(ret, std::bind([this](struct video_frame *frame, int generation) {
+        return std::shared_ptr<video_frame>(ret, std::bind([this](struct video_frame *frame, int generation, size_t data_len) {
                                 std::unique_lock<std::mutex> lk(m_lock);
 
                                 assert(m_unreturned_frames > 0);
@@ -111,11 +118,33 @@ std::shared_ptr<video_frame> video_frame_pool::get_frame() {
                                 m_frame_returned.notify_one();
 
                                 if (this->m_generation != generation) {
-                                this->deallocate_frame(frame);
+                                this->deallocate_frame(frame, data_len);
                                 } else {
                                 m_free_frames.push(frame);
                                 }
-                                }, std::placeholders::_1, m_generation));
+                                }, std::placeholders::_1, m_generation, m_max_data_len));
+}
+
+/// @note m_lock must be held
+struct video_frame *video_frame_pool::allocate_frame() {
+        struct video_frame *ret = NULL;
+        try {
+                ret = vf_alloc_desc(m_desc);
+                for (unsigned int i = 0; i < m_desc.tile_count; ++i) {
+                        ret->tiles[i].data = (char *)
+                                m_allocator->allocate(m_max_data_len);
+                        if (ret->tiles[i].data == NULL) {
+                                throw std::runtime_error("Cannot allocate data");
+                        }
+                        ret->tiles[i].data_len = m_max_data_len;
+                }
+        } catch (std::exception &e) {
+                std::cerr << e.what() << std::endl;
+                deallocate_frame(ret, 0);
+                throw e;
+        }
+        mem_account_alloc(MEM_ACC_FRAME_POOL, m_desc.tile_count * m_max_data_len);
+        return ret;
 }
 
 struct video_frame *video_frame_pool::get_disposable_frame() {
@@ -125,6 +154,7 @@ struct video_frame *video_frame_pool::get_disposable_frame() {
             new std::shared_ptr<video_frame>(std::move(frame));
         static auto dispose = [](video_frame *f) { delete static_cast<std::shared_ptr<video_frame> *>(f->callbacks.dispose_udata); };
         out->callbacks.dispose = dispose;
+        out->flags |= VF_WRITABLE;
         return out;
 }
 
@@ -138,6 +168,7 @@ struct video_frame *video_frame_pool::get_pod_frame() {
             new std::shared_ptr<video_frame>(std::move(frame));
         static auto deleter = [](video_frame *f) { delete static_cast<std::shared_ptr<video_frame> *>(f->callbacks.dispose_udata); };
         out->callbacks.data_deleter = deleter;
+        out->flags |= VF_WRITABLE;
         return out;
 }
 
@@ -149,16 +180,20 @@ void video_frame_pool::remove_free_frames() {
         while (!m_free_frames.empty()) {
                 struct video_frame *frame = m_free_frames.front();
                 m_free_frames.pop();
-                deallocate_frame(frame);
+                deallocate_frame(frame, m_max_data_len);
         }
 }
 
-void video_frame_pool::deallocate_frame(struct video_frame *frame) {
+/**
+ * @param data_len allocated length of a tile data (0 if the frame wasn't accounted)
+ */
+void video_frame_pool::deallocate_frame(struct video_frame *frame, size_t data_len) {
         if (frame == NULL)
                 return;
         for (unsigned int i = 0; i < frame->tile_count; ++i) {
                 m_allocator->deallocate(frame->tiles[i].data);
         }
+        mem_account_free(MEM_ACC_FRAME_POOL, frame->tile_count * data_len);
         vf_free(frame);
 }
 
@@ -173,6 +208,11 @@ struct video_frame *video_frame_pool_get_disposable_frame(void *state) {
         return s->get_disposable_frame();
 }
 
+void video_frame_pool_reconfigure(void *state, struct video_desc desc) {
+        auto *s = static_cast<video_frame_pool* >(state);
+        s->reconfigure(desc);
+}
+
 void video_frame_pool_destroy(void *state) {
         auto *s = static_cast<video_frame_pool* >(state);
         delete s;
@@ -98,7 +98,8 @@ struct video_frame_pool {
 
         private:
                 void remove_free_frames();
-                void deallocate_frame(struct video_frame *frame);
+                struct video_frame *allocate_frame();
+                void deallocate_frame(struct video_frame *frame, size_t data_len);
 
                 std::unique_ptr<video_frame_pool_allocator> m_allocator;
                 std::queue<struct video_frame *> m_free_frames;
@@ -114,6 +115,7 @@ struct video_frame_pool {
 
 EXTERN_C void *video_frame_pool_init(struct video_desc desc, int len);
 EXTERN_C struct video_frame *video_frame_pool_get_disposable_frame(void *);
+EXTERN_C void video_frame_pool_reconfigure(void *, struct video_desc desc);
 EXTERN_C void video_frame_pool_destroy(void *);
 
 #endif // VIDEO_FRAME_POOL_H_
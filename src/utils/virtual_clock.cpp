@@ -0,0 +1,306 @@
+/**
+ * @file   utils/virtual_clock.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * The virtual time advances to the earliest sleep deadline when no
+ * participating thread runs and no wakeup of an idle participant is pending.
+ * Since not every blocking call in the code base is instrumented, a stall
+ * watchdog advances the clock anyway if nothing happens for
+ * STALL_TIMEOUT of real time, so that the pipeline cannot deadlock.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+#include <set>
+
+#include "debug.h"
+#include "utils/virtual_clock.h"
+
+#define MOD_NAME "[vclock] "
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+using std::condition_variable;
+using std::multiset;
+using std::mutex;
+using std::unique_lock;
+
+int virtual_clock_enabled = 0;
+
+namespace {
+constexpr milliseconds STALL_TIMEOUT{ 20 };
+
+struct virtual_clock {
+        mutex              lock;
+        condition_variable cv;
+        std::atomic<time_ns_t> now{ 0 }; ///< written with lock held
+        int                running = 0; ///< participants neither sleeping nor idle
+        int                idle = 0;    ///< participants in untimed waits
+        int                pending = 0; ///< wakeups promised to idle participants
+        steady_clock::time_point last_event;
+        multiset<time_ns_t> deadlines;
+        multiset<pthread_cond_t *> timed_waiters; ///< woken on every advance
+        long long          stalls = 0;
+
+        void event() { last_event = steady_clock::now(); }
+        void try_advance(bool stalled);
+};
+
+virtual_clock clk;
+
+/// per-thread participation, unregistered on thread exit
+struct participant {
+        bool registered = false;
+        bool is_idle = false;
+        void ensure_registered() {
+                if (!registered) {
+                        registered = true;
+                        clk.running += 1;
+                }
+        }
+        ~participant() {
+                if (!registered) {
+                        return;
+                }
+                unique_lock<mutex> lk(clk.lock);
+                if (is_idle) {
+                        clk.idle -= 1;
+                } else {
+                        clk.running -= 1;
+                }
+                clk.try_advance(false);
+        }
+};
+thread_local participant self;
+
+time_ns_t real_time_ns() {
+        struct timespec ts = { 0, 0 };
+        timespec_get(&ts, TIME_UTC);
+        return ts.tv_sec * NS_IN_SEC + ts.tv_nsec;
+}
+
+/// must be called with lock held
+void virtual_clock::try_advance(bool stalled)
+{
+        if (deadlines.empty()) {
+                return;
+        }
+        if (!stalled && (running > 0 || pending > 0)) {
+                return;
+        }
+        if (stalled && (running > 0 || pending > 0)) {
+                stalls += 1;
+                MSG(DEBUG, "Stall detected (running %d, pending %d), advancing anyway.\n",
+                    running, pending);
+        }
+        pending = 0;
+        now = std::max(now.load(), *deadlines.begin());
+        event();
+        cv.notify_all();
+        for (auto *waiter_cv : timed_waiters) {
+                pthread_cond_broadcast(waiter_cv);
+        }
+}
+} // end anonymous namespace
+
+void virtual_clock_set_enabled(bool enabled)
+{
+        unique_lock<mutex> lk(clk.lock);
+        if (enabled && !virtual_clock_enabled) {
+                clk.now = real_time_ns();
+                clk.event();
+        }
+        if (!enabled && virtual_clock_enabled && clk.stalls > 0) {
+                MSG(VERBOSE, "%lld stalls resolved by timeout.\n", clk.stalls);
+        }
+        virtual_clock_enabled = enabled;
+}
+
+time_ns_t virtual_clock_now(void)
+{
+        return clk.now;
+}
+
+void virtual_clock_sleep_until(time_ns_t deadline)
+{
+        unique_lock<mutex> lk(clk.lock);
+        self.ensure_registered();
+        if (clk.now >= deadline) {
+                return;
+        }
+        auto it = clk.deadlines.insert(deadline);
+        clk.running -= 1;
+        clk.try_advance(false);
+        while (clk.now < deadline) {
+                if (clk.cv.wait_for(lk, STALL_TIMEOUT) == std::cv_status::timeout &&
+                    steady_clock::now() - clk.last_event >= STALL_TIMEOUT) {
+                        clk.try_advance(true);
+                }
+        }
+        clk.deadlines.erase(it);
+        clk.running += 1;
+        clk.event();
+}
+
+bool virtual_clock_cond_timedwait(pthread_cond_t *cv, pthread_mutex_t *cv_lock,
+                                  struct virtual_clock_waiters *w, time_ns_t deadline)
+{
+        unique_lock<mutex> lk(clk.lock);
+        self.ensure_registered();
+        if (clk.now >= deadline) {
+                return true;
+        }
+        auto dl_it = clk.deadlines.insert(deadline);
+        auto cv_it = clk.timed_waiters.insert(cv);
+        w->idle += 1;
+        self.is_idle = true;
+        clk.running -= 1;
+        clk.idle += 1;
+        clk.try_advance(false);
+        bool timedout = false;
+        if (clk.now < deadline) { // otherwise advanced by ourselves
+                lk.unlock();
+                // the real-time timeout bounds a broadcast lost before the wait is entered
+                struct timespec ts = { 0, 0 };
+                timespec_get(&ts, TIME_UTC);
+                ts.tv_nsec += std::chrono::nanoseconds(STALL_TIMEOUT).count();
+                ts.tv_sec += ts.tv_nsec / NS_IN_SEC;
+                ts.tv_nsec %= NS_IN_SEC;
+                timedout = pthread_cond_timedwait(cv, cv_lock, &ts) == ETIMEDOUT;
+                lk.lock();
+        }
+        if (timedout && steady_clock::now() - clk.last_event >= STALL_TIMEOUT) {
+                clk.try_advance(true);
+        }
+        clk.deadlines.erase(dl_it);
+        clk.timed_waiters.erase(cv_it);
+        self.is_idle = false;
+        clk.idle -= 1;
+        clk.running += 1;
+        w->idle -= 1;
+        if (w->woken > 0) {
+                w->woken -= 1;
+                if (clk.pending > 0) {
+                        clk.pending -= 1;
+                }
+                clk.event();
+        }
+        return clk.now >= deadline;
+}
+
+void virtual_clock_idle_begin(void)
+{
+        if (!virtual_clock_enabled) {
+                return;
+        }
+        unique_lock<mutex> lk(clk.lock);
+        self.ensure_registered();
+        self.is_idle = true;
+        clk.running -= 1;
+        clk.idle += 1;
+        clk.try_advance(false);
+}
+
+void virtual_clock_idle_end(void)
+{
+        if (!virtual_clock_enabled || !self.is_idle) {
+                return;
+        }
+        unique_lock<mutex> lk(clk.lock);
+        self.is_idle = false;
+        clk.idle -= 1;
+        clk.running += 1;
+        if (clk.pending > 0) {
+                clk.pending -= 1;
+        }
+        clk.event();
+}
+
+void virtual_clock_notify(void)
+{
+        if (!virtual_clock_enabled) {
+                return;
+        }
+        unique_lock<mutex> lk(clk.lock);
+        if (clk.idle > clk.pending) {
+                clk.pending += 1;
+                clk.event();
+        }
+}
+
+void virtual_clock_wait_begin(struct virtual_clock_waiters *w)
+{
+        w->idle += 1;
+        virtual_clock_idle_begin();
+}
+
+void virtual_clock_wait_end(struct virtual_clock_waiters *w)
+{
+        w->idle -= 1;
+        if (w->woken == 0) { // not woken by a notify (eg. timeout) - no pending wakeup to consume
+                if (virtual_clock_enabled && self.is_idle) {
+                        unique_lock<mutex> lk(clk.lock);
+                        self.is_idle = false;
+                        clk.idle -= 1;
+                        clk.running += 1;
+                        clk.event();
+                }
+                return;
+        }
+        w->woken -= 1;
+        virtual_clock_idle_end();
+}
+
+void virtual_clock_wait_notify(struct virtual_clock_waiters *w)
+{
+        if (w->woken < w->idle) {
+                w->woken += 1;
+                virtual_clock_notify();
+        }
+}
+
+/* vim: set expandtab sw=8 tw=120: */
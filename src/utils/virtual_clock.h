@@ -0,0 +1,110 @@
+/**
+ * @file   utils/virtual_clock.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Virtual (fast-forward) clock. When enabled, get_time_in_ns() returns
+ * virtual time that jumps to the nearest sleep deadline as soon as all
+ * participating threads are blocked, so that loopback pipelines run as fast
+ * as the CPU allows with the same timing semantics.
+ *
+ * A thread participates once it blocks in virtual_clock_sleep_until() or in
+ * an instrumented wait (virtual_clock_idle_begin() - virtual_clock_idle_end(),
+ * used by synchronized_queue, wait_obj and the worker pool). While it runs,
+ * the clock stands still.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef UTILS_VIRTUAL_CLOCK_H_2E6B9C1A_7D4F_4B8E_A3C5_91F0D6E2B7A4
+#define UTILS_VIRTUAL_CLOCK_H_2E6B9C1A_7D4F_4B8E_A3C5_91F0D6E2B7A4
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#include <pthread.h>
+
+#include "tv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// enabled from main() if requested by "--param virtual-clock"
+void virtual_clock_set_enabled(bool enabled);
+
+/**
+ * Blocks until the virtual time reaches the deadline (in get_time_in_ns()
+ * units). Must be called only if virtual_clock_enabled is set.
+ */
+void virtual_clock_sleep_until(time_ns_t deadline);
+
+/// marks the calling thread as blocked in an untimed wait
+void virtual_clock_idle_begin(void);
+void virtual_clock_idle_end(void);
+/**
+ * Should be called when waking a waiter (which may be an idle participant)
+ * so that the clock doesn't advance before the waiter resumes.
+ */
+void virtual_clock_notify(void);
+
+/**
+ * Idle waiters of a single condition variable, guarded by its mutex. A wakeup
+ * is announced to the clock only if there is a waiter not yet woken, otherwise
+ * the unconsumed announcement would hold the clock back until a stall timeout.
+ */
+struct virtual_clock_waiters {
+        int idle;
+        int woken;
+};
+/// wraps an untimed wait on the condition variable, must be called with its mutex held
+void virtual_clock_wait_begin(struct virtual_clock_waiters *w);
+void virtual_clock_wait_end(struct virtual_clock_waiters *w);
+/// should be called with the mutex held before signaling the condition variable
+void virtual_clock_wait_notify(struct virtual_clock_waiters *w);
+/**
+ * Timed wait on cv with the deadline in virtual time, the caller is treated as
+ * idle until either the clock reaches the deadline or it is woken (after
+ * virtual_clock_wait_notify()). As with pthread_cond_timedwait(), cv_lock must
+ * be held and spurious wakeups are possible. Must be called only if
+ * virtual_clock_enabled is set.
+ * @retval true  deadline was reached
+ */
+bool virtual_clock_cond_timedwait(pthread_cond_t *cv, pthread_mutex_t *cv_lock,
+                                  struct virtual_clock_waiters *w, time_ns_t deadline);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined UTILS_VIRTUAL_CLOCK_H_2E6B9C1A_7D4F_4B8E_A3C5_91F0D6E2B7A4
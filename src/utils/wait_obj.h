@@ -42,13 +42,20 @@
 #include <condition_variable>
 #include <mutex>
 
+#include "utils/virtual_clock.h"
+
 struct wait_obj {
         public:
                 wait_obj() : m_val(false) {
                 }
                 void wait() {
                         std::unique_lock<std::mutex> lk(m_lock);
+                        if (m_val) {
+                                return;
+                        }
+                        virtual_clock_wait_begin(&m_waiters);
                         m_cv.wait(lk, [this] { return m_val; });
+                        virtual_clock_wait_end(&m_waiters);
                 }
                 void reset() {
                         std::lock_guard<std::mutex> lk(m_lock);
@@ -57,6 +64,7 @@ struct wait_obj {
                 void notify() {
                         std::unique_lock<std::mutex> lk(m_lock);
                         m_val = true;
+                        virtual_clock_wait_notify(&m_waiters);
                         lk.unlock();
                         m_cv.notify_one();
                 }
@@ -64,6 +72,7 @@ struct wait_obj {
                 std::mutex m_lock;
                 std::condition_variable m_cv;
                 bool m_val;
+                virtual_clock_waiters m_waiters{};
 };
 #endif // __cplusplus
 
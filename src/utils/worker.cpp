@@ -45,6 +45,7 @@
 #include "utils/macros.h" // for MAX_CPU_CORES
 #include "utils/misc.h"   // get_cpu_core_count
 #include "utils/thread.h"
+#include "utils/virtual_clock.h"
 #include "utils/worker.h"
 
 using std::min;
@@ -56,7 +57,7 @@ struct wp_worker;
 
 struct worker_state_observer {
         virtual ~worker_state_observer() {}
-        virtual void notify(wp_worker *) = 0;
+        virtual void notify(wp_worker *, bool detached) = 0;
 };
 
 /**
@@ -110,6 +111,8 @@ struct wp_worker {
         pthread_mutex_t   m_lock;
         pthread_cond_t    m_task_ready_cv;
         pthread_cond_t    m_task_completed_cv;
+        virtual_clock_waiters m_ready_waiters{};
+        virtual_clock_waiters m_completed_waiters{};
         pthread_t         m_thread_id;
 
         worker_state_observer &m_state_observer;
@@ -127,8 +130,12 @@ void wp_worker::run() {
         while(1) {
                 struct wp_task_data *data;
                 pthread_mutex_lock(&m_lock);
-                while(m_data.empty()) {
-                        pthread_cond_wait(&m_task_ready_cv, &m_lock);
+                if (m_data.empty()) {
+                        virtual_clock_wait_begin(&m_ready_waiters);
+                        while (m_data.empty()) {
+                                pthread_cond_wait(&m_task_ready_cv, &m_lock);
+                        }
+                        virtual_clock_wait_end(&m_ready_waiters);
                 }
                 data = m_data.front();
                 m_data.pop();
@@ -145,11 +152,13 @@ void wp_worker::run() {
                 pthread_mutex_lock(&m_lock);
                 data->m_result = res;
                 data->m_returned = true;
+                virtual_clock_wait_notify(&m_completed_waiters);
                 pthread_cond_signal(&m_task_completed_cv);
-                m_state_observer.notify(this);
-                if (data->m_detached) {
+                const bool detached = data->m_detached;
+                if (detached) {
                         delete data;
                 }
+                m_state_observer.notify(this, detached);
                 pthread_mutex_unlock(&m_lock);
         }
 }
@@ -158,6 +167,7 @@ void wp_worker::push(wp_task_data *data) {
         pthread_mutex_lock(&m_lock);
         assert(m_data.size() == 0);
         m_data.push(data);
+        virtual_clock_wait_notify(&m_ready_waiters);
         pthread_mutex_unlock(&m_lock);
         pthread_cond_signal(&m_task_ready_cv);
 }
@@ -166,8 +176,12 @@ void *wp_worker::pop(wp_task_data *d) {
         void *res = NULL;
 
         pthread_mutex_lock(&m_lock);
-        while(!d->m_returned) {
-                pthread_cond_wait(&m_task_completed_cv, &m_lock);
+        if (!d->m_returned) {
+                virtual_clock_wait_begin(&m_completed_waiters);
+                while (!d->m_returned) {
+                        pthread_cond_wait(&m_task_completed_cv, &m_lock);
+                }
+                virtual_clock_wait_end(&m_completed_waiters);
         }
         res = d->m_result;
         delete d;
@@ -201,8 +215,11 @@ class worker_pool : public worker_state_observer
                         pthread_mutex_destroy(&m_lock);
                 }
 
-                void notify(wp_worker *w) {
+                void notify(wp_worker *w, bool detached) {
                         pthread_mutex_lock(&m_lock);
+                        if (!detached) {
+                                m_busy_attached -= 1;
+                        }
                         m_occupied_workers.erase(w);
                         m_empty_workers.insert(w);
                         pthread_mutex_unlock(&m_lock);
@@ -211,18 +228,38 @@ class worker_pool : public worker_state_observer
 
                 task_result_handle_t run_async(runnable_t task, void *data, bool detached);
                 void *wait_task(task_result_handle_t handle);
+                void set_limit(int max_workers) {
+                        pthread_mutex_lock(&m_lock);
+                        m_max_attached = max_workers;
+                        pthread_mutex_unlock(&m_lock);
+                }
 
         private:
                 set<wp_worker*>    m_empty_workers;
                 set<wp_worker*>    m_occupied_workers;
                 pthread_mutex_t m_lock;
                 pthread_cond_t     m_worker_finished;
+                int                m_max_attached = 0; ///< 0 - unlimited
+                int                m_busy_attached = 0;
 };
 
 task_result_handle_t worker_pool::run_async(runnable_t task, void *data, bool detached)
 {
         wp_worker *w;
         pthread_mutex_lock(&m_lock);
+        if (!detached && m_max_attached > 0 &&
+            m_busy_attached >= m_max_attached) {
+                // pool saturated - run the task by the caller instead of
+                // spawning another thread (see task_pool_set_limit())
+                pthread_mutex_unlock(&m_lock);
+                wp_task_data *d = new wp_task_data(task, data, nullptr, false);
+                d->m_result   = task(data);
+                d->m_returned = true;
+                return d;
+        }
+        if (!detached) {
+                m_busy_attached += 1;
+        }
         if(m_empty_workers.empty()) {
                 m_empty_workers.insert(new wp_worker(*this));
         }
@@ -244,6 +281,11 @@ void *worker_pool::wait_task(task_result_handle_t handle)
 {
         wp_task_data *d = (wp_task_data *) handle;
         wp_worker *w = d->m_w;
+        if (w == nullptr) { // run by the caller
+                void *res = d->m_result;
+                delete d;
+                return res;
+        }
         return w->pop(d);
 }
 
@@ -282,6 +324,22 @@ void *wait_task(task_result_handle_t handle)
         return instance.wait_task(handle);
 }
 
+/**
+ * @brief Limits number of concurrently running (non-detached) tasks
+ *
+ * When the limit is reached, task_run_async() runs the task synchronously in
+ * the caller's thread, so the number of busy workers doesn't exceed the
+ * limit even if multiple independent pipelines (eg. sessions) call
+ * task_run_parallel() with the CPU core count at once. Detached tasks are
+ * not affected.
+ *
+ * @param max_workers maximal number of busy workers, 0 for unlimited (default)
+ */
+void task_pool_set_limit(int max_workers)
+{
+        instance.set_limit(max_workers);
+}
+
 /**
  * This combines task_run_async() + wait_task()
  *
@@ -54,6 +54,7 @@ task_result_handle_t task_run_async(runnable_t task, void *data);
 void task_run_async_detached(runnable_t task, void *data);
 void *wait_task(task_result_handle_t handle);
 void task_run_parallel(runnable_t task, int worker_count, void *data, size_t data_size, void **res);
+void task_pool_set_limit(int max_workers);
 
 /**
  * @param data_len   in/out processed block length in bytes (multpile of respawn_parallel's size param)
@@ -70,6 +70,10 @@ static struct {
         {V4L2_PIX_FMT_YUYV, YUYV},
         {V4L2_PIX_FMT_UYVY, UYVY},
         {V4L2_PIX_FMT_YUV420, I420},
+        {V4L2_PIX_FMT_NV12, NV12},
+#ifdef V4L2_PIX_FMT_P010
+        {V4L2_PIX_FMT_P010, P010},
+#endif
 #ifdef V4L2_PIX_FMT_YUVA32
         {V4L2_PIX_FMT_YUVA32, Y416},
 #endif
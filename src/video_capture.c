@@ -65,6 +65,7 @@
 #include "utils/macros.h"
 #include "video_capture.h"
 #include "video_capture_params.h"
+#include "video_frame.h"
 
 #define VIDCAP_MAGIC	0x76ae98f0
 
@@ -218,11 +219,51 @@ void vidcap_done(struct vidcap *state)
 struct video_frame *vidcap_grab(struct vidcap *state, struct audio_frame **audio)
 {
         assert(state->magic == VIDCAP_MAGIC);
-        struct video_frame *frame;
-        frame = state->funcs->grab(state->state, audio);
-        if (frame != NULL)
-                frame = capture_filter(state->capture_filter, frame);
-        return frame;
+        struct video_frame *frame = NULL;
+        if (capture_filter_drop_next(state->capture_filter)) {
+                if (vidcap_skip(state, audio)) {
+                        capture_filter_dropped(state->capture_filter);
+                }
+        } else {
+                frame = state->funcs->grab(state->state, audio);
+        }
+        // passed also without a frame to collect ones finished by a pipelined filter
+        return capture_filter(state->capture_filter, frame);
+}
+
+/** @brief Returns frames still being processed by pipelined capture filters.
+ * Should be called repeatedly after the last vidcap_grab() not to lose the
+ * last grabbed frames.
+ *
+ * @param[in]  state vidcap state
+ * @returns video frame, NULL if there are no more frames
+ */
+struct video_frame *vidcap_drain(struct vidcap *state)
+{
+        assert(state->magic == VIDCAP_MAGIC);
+        return capture_filter_drain(state->capture_filter);
+}
+
+/** @brief Consumes the next frame without returning it.
+ * Used if the frame would be discarded by capture filters so that the driver
+ * can skip its processing (see video_capture_info::skip).
+ *
+ * @param[in]  state vidcap state
+ * @param[out] audio contains audio frame if driver is grabbing audio
+ * @returns whether a frame was consumed
+ */
+bool vidcap_skip(struct vidcap *state, struct audio_frame **audio)
+{
+        assert(state->magic == VIDCAP_MAGIC);
+        if (state->funcs->skip != NULL) {
+                return state->funcs->skip(state->state, audio);
+        }
+        struct video_frame *frame = state->funcs->grab(state->state, audio);
+        if (frame == NULL) {
+                return false;
+        }
+        VIDEO_FRAME_DISPOSE(frame);
+        return true;
 }
 
 /**
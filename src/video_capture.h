@@ -106,7 +106,7 @@
 #include "types.h"
 #include "video_capture_params.h"
 
-#define VIDEO_CAPTURE_ABI_VERSION 13
+#define VIDEO_CAPTURE_ABI_VERSION 14
 
 #ifdef __cplusplus
 extern "C" {
@@ -141,6 +141,16 @@ struct video_capture_info {
         struct video_frame    *(*grab) (void *state, struct audio_frame **audio);
         const char             *generic_fps_indicator_prefix; ///< display name, eg. "[gl] ",
                                                               ///< pass NULL to use own
+        /**
+         * Optional - called instead of grab() if the next frame is going to
+         * be discarded by capture filters (eg. ratelimit, every). The driver
+         * should consume the frame keeping the timing of grab() but may skip
+         * its processing (decoding, conversion). Audio is returned as usual.
+         * If NULL, the frame is grabbed and discarded.
+         * @retval true  a frame was consumed
+         * @retval false no frame available (grab() would return NULL)
+         */
+        bool                   (*skip) (void *state, struct audio_frame **audio);
 };
 
 struct module;
@@ -152,6 +162,8 @@ int initialize_video_capture(struct module *parent,
                 struct vidcap **state);
 void			 vidcap_done(struct vidcap *state);
 struct video_frame	*vidcap_grab(struct vidcap *state, struct audio_frame **audio);
+bool                     vidcap_skip(struct vidcap *state, struct audio_frame **audio);
+struct video_frame      *vidcap_drain(struct vidcap *state);
 const char              *vidcap_get_fps_print_prefix(struct vidcap *state);
 
 #ifdef __cplusplus
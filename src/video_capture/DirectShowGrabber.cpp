@@ -1431,6 +1431,7 @@ extern "C" const struct video_capture_info vidcap_dshow_info = {
         vidcap_dshow_done,
         vidcap_dshow_grab,
         MOD_NAME,
+        nullptr,
 };
 
 REGISTER_MODULE(dshow, &vidcap_dshow_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
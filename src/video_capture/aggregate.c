@@ -3,6 +3,10 @@
  * @author Martin Pulec <pulec@cesnet.cz>
  *
  * @brief Aggregate video capture driver
+ *
+ * Each sub-device is captured by its own thread to a short queue, the
+ * resulting tiles are then assembled according to capture timestamps
+ * (device #1 is the reference).
  */
 /*
  * Copyright (c) 2012-2023 CESNET z.s.p.o.
@@ -49,34 +53,110 @@
 #include "tv.h"
 
 #include "audio/types.h"
+#include "utils/color_out.h"
+#include "utils/video_frame_pool.h"
+#include "video_capture/input_worker_common.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-/* prototypes of functions defined in this module */
-static void show_help(void);
+#define MOD_NAME "[aggregate] "
+#define QUEUE_LEN 4                 ///< per-device queue length
+#define GRAB_TIMEOUT_MS 100         ///< max wait for the reference device frame
 
-static void show_help()
-{
-        printf("Aggregate capture\n");
-        printf("Usage\n");
-        printf("\t-t aggregate -t <dev1_config> -t <dev2_config> ....]\n");
-        printf("\t\twhere devn_config is a complete configuration string of device involved in an aggregate device\n");
+enum missing_tile_policy {
+        MISSING_REPEAT, ///< repeat last tile of the device
+        MISSING_DROP,   ///< drop whole tile set
+};
 
-}
+struct queued_frame {
+        struct video_frame *frame;
+        time_ns_t           ts; ///< capture time (after vidcap_grab returned)
+};
+
+struct aggregate_device {
+        struct vidcap_aggregate_state *parent;
+        int                 idx;
+        struct vidcap      *dev;
+        pthread_t           thread;
+        bool                thread_started;
+
+        void               *pool; ///< for frames not owned by us (without dispose callback)
+        struct video_desc   pool_desc;
+
+        // following members are protected by parent->lock
+        struct queued_frame queue[QUEUE_LEN];
+        int                 q_head;
+        int                 q_count;
+        unsigned long       overflows;
+
+        struct video_frame *current; ///< tile used in the last assembled frame
+};
 
 struct vidcap_aggregate_state {
-        struct vidcap     **devices;
-        int                 devices_cnt;
+        struct aggregate_device *devices;
+        int                      devices_cnt;
+
+        pthread_mutex_t lock;
+        pthread_cond_t  frame_ready_cv;
+        bool            should_exit;
 
-        struct video_frame      **captured_frames;
-        struct video_frame       *frame; 
+        time_ns_t                tolerance; ///< 0 - half of the reference frame interval
+        enum missing_tile_policy missing;
+
+        struct video_frame *frame;
         int frames;
+        unsigned long dropped_sets;
+        unsigned long repeated_tiles;
         struct       timeval t, t0;
 
-        int          audio_source_index;
+        struct input_audio_acc audio; ///< protected by lock
 };
 
+static void vidcap_aggregate_done(void *state);
+
+static void show_help()
+{
+        printf("Aggregate capture\n");
+        printf("Usage\n");
+        color_printf("\t" TERM_BOLD "-t aggregate[:tolerance=<ms>][:missing=repeat|drop] -t <dev1_config> -t <dev2_config> ....]\n" TERM_RESET);
+        printf("\t\twhere devn_config is a complete configuration string of device involved in an aggregate device\n");
+        printf("\n");
+        printf("Devices are captured concurrently, tiles are matched by capture time with the first device.\n");
+        color_printf("\t" TERM_BOLD "tolerance" TERM_RESET " - max difference of tile capture times (default half of the first device frame interval)\n");
+        color_printf("\t" TERM_BOLD "missing" TERM_RESET "   - what to do if tile is missing - repeat previous (default) or drop the whole frame\n");
+}
+
+static int parse_fmt(struct vidcap_aggregate_state *s, char *cfg)
+{
+        char *save_ptr = NULL;
+        char *item = NULL;
+        while ((item = strtok_r(cfg, ":", &save_ptr))) {
+                if (strcmp(item, "help") == 0) {
+                        show_help();
+                        return VIDCAP_INIT_NOERR;
+                }
+                if (strstr(item, "tolerance=") == item) {
+                        double val = atof(item + strlen("tolerance="));
+                        if (val <= 0) {
+                                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Wrong tolerance: %s\n", item);
+                                return VIDCAP_INIT_FAIL;
+                        }
+                        s->tolerance = val * NS_IN_MS_DBL;
+                } else if (strcmp(item, "missing=repeat") == 0) {
+                        s->missing = MISSING_REPEAT;
+                } else if (strcmp(item, "missing=drop") == 0) {
+                        s->missing = MISSING_DROP;
+                } else {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Unknown option: %s\n", item);
+                        show_help();
+                        return VIDCAP_INIT_FAIL;
+                }
+                cfg = NULL;
+        }
+        return 0;
+}
 
 static void vidcap_aggregate_probe(struct device_info **cards, int *count, void (**deleter)(void *))
 {
@@ -85,6 +165,67 @@ static void vidcap_aggregate_probe(struct device_info **cards, int *count, void
         *deleter = free;
 }
 
+/**
+ * Returns a frame that remains valid after the next vidcap_grab() - if the
+ * device doesn't pass the ownership (no dispose callback), copy is made.
+ */
+static struct video_frame *get_owned_frame(struct aggregate_device *d, struct video_frame *f)
+{
+        if (f->callbacks.dispose != NULL) {
+                return f;
+        }
+        if (is_codec_opaque(f->color_spec)) { // size not known in advance
+                struct video_frame *out = vf_get_copy(f);
+                vf_copy_metadata(out, f);
+                out->callbacks.dispose = vf_free;
+                return out;
+        }
+        struct video_desc desc = video_desc_from_frame(f);
+        if (d->pool == NULL) {
+                d->pool = video_frame_pool_init(desc, 0);
+                d->pool_desc = desc;
+        } else if (!video_desc_eq(desc, d->pool_desc)) {
+                video_frame_pool_reconfigure(d->pool, desc);
+                d->pool_desc = desc;
+        }
+        struct video_frame *out = video_frame_pool_get_disposable_frame(d->pool);
+        for (unsigned int i = 0; i < f->tile_count; ++i) {
+                memcpy(out->tiles[i].data, f->tiles[i].data, f->tiles[i].data_len);
+                out->tiles[i].data_len = f->tiles[i].data_len;
+        }
+        vf_copy_metadata(out, f);
+        return out;
+}
+
+static void enqueue_frame(void *udata, struct video_frame *frame, time_ns_t ts)
+{
+        struct aggregate_device *d = udata;
+        struct vidcap_aggregate_state *s = d->parent;
+        frame = get_owned_frame(d, frame);
+
+        pthread_mutex_lock(&s->lock);
+        if (d->q_count == QUEUE_LEN) { // consumer too slow - drop the oldest
+                VIDEO_FRAME_DISPOSE(d->queue[d->q_head].frame);
+                d->q_head = (d->q_head + 1) % QUEUE_LEN;
+                d->q_count -= 1;
+                d->overflows += 1;
+        }
+        d->queue[(d->q_head + d->q_count) % QUEUE_LEN] = (struct queued_frame) { frame, ts };
+        d->q_count += 1;
+        pthread_cond_broadcast(&s->frame_ready_cv);
+        pthread_mutex_unlock(&s->lock);
+}
+
+static void *aggregate_worker(void *arg)
+{
+        struct aggregate_device *d = arg;
+        struct vidcap_aggregate_state *s = d->parent;
+        const struct input_worker w = { "aggregate", d->idx, d->dev, &s->lock, &s->should_exit, &s->audio,
+                enqueue_frame, d };
+        input_worker_run(&w);
+        return NULL;
+}
+
 static int
 vidcap_aggregate_init(struct vidcap_params *params, void **state)
 {
@@ -99,14 +240,19 @@ vidcap_aggregate_init(struct vidcap_params *params, void **state)
 		return VIDCAP_INIT_FAIL;
 	}
 
-        s->audio_source_index = -1;
+        input_audio_acc_init(&s->audio);
+        s->missing = MISSING_REPEAT;
         s->frames = 0;
         gettimeofday(&s->t0, NULL);
 
         if(vidcap_params_get_fmt(params) && strcmp(vidcap_params_get_fmt(params), "") != 0) {
-                show_help();
-                free(s);
-                return VIDCAP_INIT_NOERR;
+                char *cfg = strdup(vidcap_params_get_fmt(params));
+                int rc = parse_fmt(s, cfg);
+                free(cfg);
+                if (rc != 0) {
+                        free(s);
+                        return rc;
+                }
         }
 
 
@@ -118,8 +264,14 @@ vidcap_aggregate_init(struct vidcap_params *params, void **state)
                 else
                         break;
         }
+        if (s->devices_cnt == 0) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "No device given!\n");
+                show_help();
+                free(s);
+                return VIDCAP_INIT_FAIL;
+        }
 
-        s->devices = calloc(s->devices_cnt, sizeof(struct vidcap *));
+        s->devices = calloc(s->devices_cnt, sizeof(struct aggregate_device));
         tmp = params;
         for (int i = 0; i < s->devices_cnt; ++i) {
                 tmp = vidcap_params_get_next(tmp);
@@ -128,18 +280,30 @@ vidcap_aggregate_init(struct vidcap_params *params, void **state)
                         vidcap_params_set_flags(tmp, vidcap_params_get_flags(params));
                 }
 
-                int ret = initialize_video_capture(vidcap_params_get_parent(params), (struct vidcap_params *) tmp, &s->devices[i]);
+                int ret = initialize_video_capture(vidcap_params_get_parent(params), (struct vidcap_params *) tmp, &s->devices[i].dev);
                 if(ret != 0) {
                         fprintf(stderr, "[aggregate] Unable to initialize device %d (%s:%s).\n",
                                         i, vidcap_params_get_driver(tmp),
                                         vidcap_params_get_fmt(tmp));
                         goto error;
                 }
+                s->devices[i].parent = s;
+                s->devices[i].idx = i;
         }
 
-        s->captured_frames = calloc(s->devices_cnt, sizeof(struct video_frame *));
-
         s->frame = vf_alloc(s->devices_cnt);
+
+        pthread_mutex_init(&s->lock, NULL);
+        pthread_cond_init(&s->frame_ready_cv, NULL);
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                if (pthread_create(&s->devices[i].thread, NULL, aggregate_worker, &s->devices[i]) != 0) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Unable to create capture thread!\n");
+                        *state = s;
+                        vidcap_aggregate_done(s);
+                        return VIDCAP_INIT_FAIL;
+                }
+                s->devices[i].thread_started = true;
+        }
         
         *state = s;
 	return VIDCAP_INIT_OK;
@@ -148,11 +312,12 @@ error:
         if(s->devices) {
                 int i;
                 for (i = 0u; i < s->devices_cnt; ++i) {
-                        if(s->devices[i]) {
-                                 vidcap_done(s->devices[i]);
+                        if(s->devices[i].dev) {
+                                 vidcap_done(s->devices[i].dev);
                         }
                 }
         }
+        free(s->devices);
         free(s);
         return VIDCAP_INIT_FAIL;
 }
@@ -164,58 +329,175 @@ vidcap_aggregate_done(void *state)
 
 	assert(s != NULL);
 
-	if (s != NULL) {
-                int i;
-		for (i = 0; i < s->devices_cnt; ++i) {
-                         vidcap_done(s->devices[i]);
-		}
-	}
-        
+        pthread_mutex_lock(&s->lock);
+        s->should_exit = true;
+        pthread_mutex_unlock(&s->lock);
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                if (s->devices[i].thread_started) {
+                        pthread_join(s->devices[i].thread, NULL);
+                }
+        }
+
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                struct aggregate_device *d = &s->devices[i];
+                vidcap_done(d->dev);
+                for (int j = 0; j < d->q_count; ++j) {
+                        VIDEO_FRAME_DISPOSE(d->queue[(d->q_head + j) % QUEUE_LEN].frame);
+                }
+                VIDEO_FRAME_DISPOSE(d->current);
+                if (d->pool != NULL) {
+                        video_frame_pool_destroy(d->pool);
+                }
+        }
+
+        pthread_cond_destroy(&s->frame_ready_cv);
+        pthread_mutex_destroy(&s->lock);
+        input_audio_acc_done(&s->audio);
+        free(s->devices);
         vf_free(s->frame);
         free(s);
 }
 
+/**
+ * Waits until device queue is non-empty or deadline passes.
+ * @note s->lock must be held
+ */
+static bool wait_for_frame(struct vidcap_aggregate_state *s, struct aggregate_device *d, time_ns_t deadline)
+{
+        while (d->q_count == 0 && !s->should_exit) {
+                const time_ns_t now = get_time_in_ns();
+                if (now >= deadline) {
+                        return false;
+                }
+                struct timespec ts;
+                timespec_get(&ts, TIME_UTC);
+                const time_ns_t abs_ns = ts.tv_sec * NS_IN_SEC + ts.tv_nsec + (deadline - now);
+                ts.tv_sec = abs_ns / NS_IN_SEC;
+                ts.tv_nsec = abs_ns % NS_IN_SEC;
+                pthread_cond_timedwait(&s->frame_ready_cv, &s->lock, &ts);
+        }
+        return d->q_count > 0;
+}
+
+/// @note s->lock must be held
+static struct queued_frame queue_pop(struct aggregate_device *d)
+{
+        assert(d->q_count > 0);
+        struct queued_frame ret = d->queue[d->q_head];
+        d->q_head = (d->q_head + 1) % QUEUE_LEN;
+        d->q_count -= 1;
+        return ret;
+}
+
+static void set_current(struct aggregate_device *d, struct video_frame *frame)
+{
+        VIDEO_FRAME_DISPOSE(d->current);
+        d->current = frame;
+}
+
+/**
+ * Selects a tile for the device captured within tolerance from the reference
+ * time. Older frames are skipped (the last of them is kept as a current tile).
+ * @note s->lock must be held
+ * @retval false no matching tile
+ */
+static bool select_tile(struct vidcap_aggregate_state *s, struct aggregate_device *d, time_ns_t ref_ts,
+                time_ns_t tolerance)
+{
+        do {
+                while (d->q_count > 0 && d->queue[d->q_head].ts < ref_ts - tolerance) {
+                        set_current(d, queue_pop(d).frame);
+                }
+                if (d->q_count > 0) {
+                        if (d->queue[d->q_head].ts > ref_ts + tolerance) {
+                                return false;
+                        }
+                        set_current(d, queue_pop(d).frame);
+                        return true;
+                }
+        } while (wait_for_frame(s, d, ref_ts + tolerance));
+        return false;
+}
+
+static void print_stats(struct vidcap_aggregate_state *s)
+{
+        gettimeofday(&s->t, NULL);
+        double seconds = tv_diff(s->t, s->t0);    
+        if (seconds < 5) {
+                return;
+        }
+        float fps  = s->frames / seconds;
+        char overflows[STR_LEN] = "";
+        pthread_mutex_lock(&s->lock);
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                snprintf(overflows + strlen(overflows), sizeof overflows - strlen(overflows), "%s%lu",
+                                i == 0 ? "" : "/", s->devices[i].overflows);
+        }
+        pthread_mutex_unlock(&s->lock);
+        log_msg(LOG_LEVEL_INFO, "[aggregate cap.] %d frames in %g seconds = %g FPS (%lu dropped, %lu tiles repeated, "
+                        "queue overflows %s)\n", s->frames, seconds, fps, s->dropped_sets, s->repeated_tiles, overflows);
+        s->t0 = s->t;
+        s->frames = 0;
+        s->dropped_sets = s->repeated_tiles = 0;
+}
+
 static struct video_frame *
 vidcap_aggregate_grab(void *state, struct audio_frame **audio)
 {
 	struct vidcap_aggregate_state *s = (struct vidcap_aggregate_state *) state;
-        struct audio_frame *audio_frame = NULL;
-        struct video_frame *frame = NULL;
 
-        for (int i = 0; i < s->devices_cnt; ++i) {
-                VIDEO_FRAME_DISPOSE(s->captured_frames[i]);
+        *audio = NULL;
+
+        pthread_mutex_lock(&s->lock);
+        struct aggregate_device *ref = &s->devices[0];
+        if (!wait_for_frame(s, ref, get_time_in_ns() + GRAB_TIMEOUT_MS * NS_IN_MS)) {
+                input_audio_acc_take(&s->audio, audio);
+                pthread_mutex_unlock(&s->lock);
+                return NULL;
+        }
+        struct queued_frame ref_frame = queue_pop(ref);
+        set_current(ref, ref_frame.frame);
+        time_ns_t tolerance = s->tolerance;
+        if (tolerance == 0) {
+                tolerance = ref_frame.frame->fps > 0 ? NS_IN_SEC_DBL / ref_frame.frame->fps / 2 : 20 * NS_IN_MS;
         }
 
-        *audio = NULL;
+        bool complete = true;
+        for (int i = 1; i < s->devices_cnt; ++i) {
+                struct aggregate_device *d = &s->devices[i];
+                if (select_tile(s, d, ref_frame.ts, tolerance)) {
+                        continue;
+                }
+                if (s->missing == MISSING_DROP || d->current == NULL) {
+                        complete = false;
+                } else {
+                        s->repeated_tiles += 1;
+                }
+        }
+        input_audio_acc_take(&s->audio, audio);
+        pthread_mutex_unlock(&s->lock);
+
+        if (!complete) {
+                s->dropped_sets += 1;
+                print_stats(s);
+                return NULL;
+        }
 
         for (int i = 0; i < s->devices_cnt; ++i) {
-                frame = NULL;
-                while(!frame) {
-                        frame = vidcap_grab(s->devices[i], &audio_frame);
-                }
+                struct video_frame *frame = s->devices[i].current;
                 if (i == 0) {
                         s->frame->color_spec = frame->color_spec;
                         s->frame->interlacing = frame->interlacing;
                         s->frame->fps = frame->fps;
                 }
-                if (s->audio_source_index == -1 && audio_frame != NULL) {
-                        fprintf(stderr, "[aggregate] Locking device #%d as an audio source.\n",
-                                        i);
-                        s->audio_source_index = i;
-                }
-                if (s->audio_source_index == i) {
-                        *audio = audio_frame;
-                }
+                // FPS may differ - the output has the rate of the reference device
                 if (frame->color_spec != s->frame->color_spec ||
-                                frame->fps != s->frame->fps ||
                                 frame->interlacing != s->frame->interlacing) {
                         fprintf(stderr, "[aggregate] Different format detected: ");
                         if(frame->color_spec != s->frame->color_spec)
                                 fprintf(stderr, "codec");
                         if(frame->interlacing != s->frame->interlacing)
                                 fprintf(stderr, "interlacing");
-                        if(frame->fps != s->frame->fps)
-                                fprintf(stderr, "FPS (%.2f and %.2f)", frame->fps, s->frame->fps);
                         fprintf(stderr, "\n");
                         
                         return NULL;
@@ -224,17 +506,10 @@ vidcap_aggregate_grab(void *state, struct audio_frame **audio)
                 vf_get_tile(s->frame, i)->height = vf_get_tile(frame, 0)->height;
                 vf_get_tile(s->frame, i)->data_len = vf_get_tile(frame, 0)->data_len;
                 vf_get_tile(s->frame, i)->data = vf_get_tile(frame, 0)->data;
-                s->captured_frames[i] = frame;
         }
+        s->frame->timestamp = s->devices[0].current->timestamp;
         s->frames++;
-        gettimeofday(&s->t, NULL);
-        double seconds = tv_diff(s->t, s->t0);    
-        if (seconds >= 5) {
-            float fps  = s->frames / seconds;
-            log_msg(LOG_LEVEL_INFO, "[aggregate cap.] %d frames in %g seconds = %g FPS\n", s->frames, seconds, fps);
-            s->t0 = s->t;
-            s->frames = 0;
-        }  
+        print_stats(s);
 
 	return s->frame;
 }
@@ -245,7 +520,7 @@ static const struct video_capture_info vidcap_aggregate_info = {
         vidcap_aggregate_done,
         vidcap_aggregate_grab,
         VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        NULL,
 };
 
 REGISTER_MODULE(aggregate, &vidcap_aggregate_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
-
@@ -1177,6 +1177,7 @@ static const struct video_capture_info vidcap_aja_info = {
         vidcap_aja_done,
         vidcap_aja_grab,
         VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        nullptr,
 };
 
 REGISTER_MODULE(aja, &vidcap_aja_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
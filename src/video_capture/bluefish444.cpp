@@ -1089,6 +1089,7 @@ static const struct video_capture_info vidcap_bluefish444_info = {
         vidcap_bluefish444_done,
         vidcap_bluefish444_grab,
         VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        nullptr,
 };
 
 REGISTER_MODULE(bluefish444, &vidcap_bluefish444_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -1864,6 +1864,7 @@ static const struct video_capture_info vidcap_decklink_info = {
         vidcap_decklink_done,
         vidcap_decklink_grab,
         MOD_NAME,
+        nullptr,
 };
 
 REGISTER_MODULE(decklink, &vidcap_decklink_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
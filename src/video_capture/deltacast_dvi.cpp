@@ -799,6 +799,7 @@ static const struct video_capture_info vidcap_deltacast_dvi_info = {
         vidcap_deltacast_dvi_done,
         vidcap_deltacast_dvi_grab,
         VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        nullptr,
 };
 
 REGISTER_MODULE(deltacast-dv, &vidcap_deltacast_dvi_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -680,6 +680,7 @@ static const struct video_capture_info vidcap_dvs_info = {
         vidcap_dvs_done,
         vidcap_dvs_grab,
         VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        NULL,
 };
 
 REGISTER_MODULE(dvs, &vidcap_dvs_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -1042,6 +1042,7 @@ static const struct video_capture_info vidcap_file_info = {
         vidcap_file_done,
         vidcap_file_grab,
         MOD_NAME,
+        NULL,
 };
 
 REGISTER_MODULE(file, &vidcap_file_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -1071,10 +1071,11 @@ static unsigned long long get_req_bytes(struct vidcap_import_state *s) {
         return requested_samples * s->audio_frame.bps * s->audio_frame.ch_count;
 }
 
+/// @param skipped  if not NULL, the frame is going to be discarded - it is released instead
+///                 of returned and *skipped is set to whether there was a frame
 static struct video_frame *
-vidcap_import_grab(void *state, struct audio_frame **audio)
+import_grab(struct vidcap_import_state *s, struct audio_frame **audio, bool *skipped)
 {
-	struct vidcap_import_state 	*s = (struct vidcap_import_state *) state;
         struct timeval cur_time;
         struct video_frame *ret = NULL;
         
@@ -1112,13 +1113,18 @@ vidcap_import_grab(void *state, struct audio_frame **audio)
                 pthread_mutex_unlock(&s->lock);
                 pthread_cond_signal(&s->worker_cv);
 
-                ret = vf_alloc_desc(s->video_desc);
-                ret->callbacks.dispose = vidcap_import_dispose_video_frame;
-                ret->callbacks.dispose_udata = current;
-                for (unsigned int i = 0; i < s->video_desc.tile_count; ++i) {
-                        ret->tiles[i].data_len =
-                                current->tiles[i].data_len;
-                        ret->tiles[i].data = current->tiles[i].data;
+                if (skipped != NULL) {
+                        free_entry(current);
+                        *skipped = true;
+                } else {
+                        ret = vf_alloc_desc(s->video_desc);
+                        ret->callbacks.dispose = vidcap_import_dispose_video_frame;
+                        ret->callbacks.dispose_udata = current;
+                        for (unsigned int i = 0; i < s->video_desc.tile_count; ++i) {
+                                ret->tiles[i].data_len =
+                                        current->tiles[i].data_len;
+                                ret->tiles[i].data = current->tiles[i].data;
+                        }
                 }
         }
 
@@ -1152,12 +1158,27 @@ vidcap_import_grab(void *state, struct audio_frame **audio)
 	return ret;
 }
 
+static struct video_frame *
+vidcap_import_grab(void *state, struct audio_frame **audio)
+{
+        return import_grab((struct vidcap_import_state *) state, audio, NULL);
+}
+
+static bool
+vidcap_import_skip(void *state, struct audio_frame **audio)
+{
+        bool skipped = false;
+        import_grab((struct vidcap_import_state *) state, audio, &skipped);
+        return skipped;
+}
+
 static const struct video_capture_info vidcap_import_info = {
         vidcap_import_probe,
         vidcap_import_init,
         vidcap_import_done,
         vidcap_import_grab,
         MOD_NAME,
+        vidcap_import_skip,
 };
 
 REGISTER_MODULE(import, &vidcap_import_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -0,0 +1,155 @@
+/**
+ * @file   video_capture/input_worker_common.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "utils/thread.h"
+#include "video.h"
+#include "video_capture.h"
+#include "video_capture/input_worker_common.h"
+
+#define NULL_GRABS_BEFORE_SLEEP 10  ///< back-off for devices not blocking in grab
+#define MAX_AUDIO_SEC 1             ///< max accumulated audio
+
+void input_audio_acc_init(struct input_audio_acc *a)
+{
+        memset(a, 0, sizeof *a);
+        a->source_index = -1;
+}
+
+void input_audio_acc_done(struct input_audio_acc *a)
+{
+        free(a->acc.data);
+        free(a->out.data);
+}
+
+/// @note capturer lock must be held
+static void accumulate_audio(struct input_audio_acc *a, const struct audio_frame *f, const char *name)
+{
+        struct audio_frame *acc = &a->acc;
+        if (acc->bps != f->bps || acc->sample_rate != f->sample_rate || acc->ch_count != f->ch_count) {
+                acc->data_len = 0;
+        }
+        acc->bps = f->bps;
+        acc->sample_rate = f->sample_rate;
+        acc->ch_count = f->ch_count;
+        acc->timestamp = f->timestamp;
+        acc->flags = f->flags;
+        if (acc->data_len + f->data_len > MAX_AUDIO_SEC * f->sample_rate * f->bps * f->ch_count) {
+                log_msg(LOG_LEVEL_WARNING, "[%s] Audio not consumed, dropping %d B.\n", name, acc->data_len);
+                acc->data_len = 0;
+        }
+        if (acc->data_len + f->data_len > acc->max_size) {
+                acc->max_size = 2 * (acc->data_len + f->data_len);
+                acc->data = realloc(acc->data, acc->max_size);
+        }
+        memcpy(acc->data + acc->data_len, f->data, f->data_len);
+        acc->data_len += f->data_len;
+}
+
+void input_audio_acc_take(struct input_audio_acc *a, struct audio_frame **audio)
+{
+        if (a->acc.data_len == 0) {
+                return;
+        }
+        char *data = a->out.data;
+        int max_size = a->out.max_size;
+        if (max_size < a->acc.data_len) {
+                max_size = a->acc.max_size;
+                data = realloc(data, max_size);
+        }
+        a->out = a->acc;
+        a->out.data = data;
+        a->out.max_size = max_size;
+        a->out.dispose = NULL;
+        memcpy(a->out.data, a->acc.data, a->acc.data_len);
+        a->acc.data_len = 0;
+        *audio = &a->out;
+}
+
+void input_worker_run(const struct input_worker *w)
+{
+        char name[16];
+        snprintf(name, sizeof name, "%s%d", w->name, w->idx);
+        set_thread_name(name);
+        int null_grabs = 0;
+
+        while (true) {
+                pthread_mutex_lock(w->lock);
+                bool should_exit = *w->should_exit;
+                pthread_mutex_unlock(w->lock);
+                if (should_exit) {
+                        break;
+                }
+
+                struct audio_frame *audio = NULL;
+                struct video_frame *frame = vidcap_grab(w->dev, &audio);
+                const time_ns_t ts = get_time_in_ns();
+                if (audio != NULL) {
+                        pthread_mutex_lock(w->lock);
+                        if (w->audio->source_index == -1) {
+                                log_msg(LOG_LEVEL_NOTICE, "[%s] Locking device #%d as an audio source.\n",
+                                                w->name, w->idx);
+                                w->audio->source_index = w->idx;
+                        }
+                        if (w->audio->source_index == w->idx) {
+                                accumulate_audio(w->audio, audio, w->name);
+                        }
+                        pthread_mutex_unlock(w->lock);
+                        AUDIO_FRAME_DISPOSE(audio);
+                }
+                if (frame == NULL) {
+                        if (++null_grabs >= NULL_GRABS_BEFORE_SLEEP) {
+                                usleep(1000);
+                        }
+                        continue;
+                }
+                null_grabs = 0;
+                w->frame_cb(w->udata, frame, ts);
+        }
+}
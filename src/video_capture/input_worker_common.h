@@ -0,0 +1,100 @@
+/**
+ * @file   video_capture/input_worker_common.h
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Capture worker loop and audio accumulation shared by capturers
+ * grabbing several devices concurrently (aggregate, swmix_cpu).
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef INPUT_WORKER_COMMON_H_3F8B1C26_2D74_4E59_9A0B_7C61E5D2F4A8
+#define INPUT_WORKER_COMMON_H_3F8B1C26_2D74_4E59_9A0B_7C61E5D2F4A8
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+#include <pthread.h>
+
+#include "audio/types.h"
+#include "tv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct video_frame;
+struct vidcap;
+
+/**
+ * Audio of the first device that delivered some is accumulated until
+ * taken by the grab. The structure is protected by the capturer lock.
+ */
+struct input_audio_acc {
+        int                source_index; ///< device used as an audio source (-1 - not yet selected)
+        struct audio_frame acc;          ///< accumulated by the workers
+        struct audio_frame out;          ///< returned by grab
+};
+
+void input_audio_acc_init(struct input_audio_acc *a);
+void input_audio_acc_done(struct input_audio_acc *a);
+/// moves accumulated audio to a->out and sets *audio to it (untouched if nothing was accumulated)
+void input_audio_acc_take(struct input_audio_acc *a, struct audio_frame **audio);
+
+/**
+ * Called from the worker with every captured frame (ownership is passed)
+ * and its capture time, the capturer lock is not held.
+ */
+typedef void (*input_worker_frame_cb)(void *udata, struct video_frame *frame, time_ns_t ts);
+
+struct input_worker {
+        const char             *name;        ///< thread name prefix and module name for logs
+        int                     idx;         ///< device index
+        struct vidcap          *dev;
+        pthread_mutex_t        *lock;        ///< protects should_exit and audio
+        const bool             *should_exit;
+        struct input_audio_acc *audio;
+        input_worker_frame_cb   frame_cb;
+        void                   *udata;
+};
+
+/// runs the grab loop until *w->should_exit is set
+void input_worker_run(const struct input_worker *w);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ! defined INPUT_WORKER_COMMON_H_3F8B1C26_2D74_4E59_9A0B_7C61E5D2F4A8
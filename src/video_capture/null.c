@@ -94,6 +94,7 @@ static const struct video_capture_info vidcap_null_info = {
         vidcap_null_done,
         vidcap_null_grab,
         VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        NULL,
 };
 
 REGISTER_HIDDEN_MODULE(none, &vidcap_null_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -636,6 +636,7 @@ static const struct video_capture_info vidcap_screen_pw_info = {
         vidcap_screen_pw_done,
         vidcap_screen_pw_grab,
         MOD_NAME,
+        nullptr,
 };
 
 REGISTER_MODULE(screen_pw, &vidcap_screen_pw_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -1282,6 +1282,7 @@ static const struct video_capture_info vidcap_rtsp_info = {
         vidcap_rtsp_done,
         vidcap_rtsp_grab,
         MOD_NAME,
+        NULL,
 };
 
 REGISTER_MODULE(rtsp, &vidcap_rtsp_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -112,12 +112,19 @@ vidcap_screen_linux_grab(void *state, struct audio_frame **audio)
         return vidcap_grab((struct vidcap *) state, audio);
 }
 
+static bool
+vidcap_screen_linux_skip(void *state, struct audio_frame **audio)
+{
+        return vidcap_skip((struct vidcap *) state, audio);
+}
+
 static const struct video_capture_info vidcap_screen_linux_info = {
         vidcap_screen_linux_probe,
         vidcap_screen_linux_init,
         vidcap_screen_linux_done,
         vidcap_screen_linux_grab,
         "[screen] ",
+        vidcap_screen_linux_skip,
 };
 
 REGISTER_MODULE(screen, &vidcap_screen_linux_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -303,6 +303,7 @@ static const struct video_capture_info vidcap_screen_osx_info = {
         vidcap_screen_osx_done,
         vidcap_screen_osx_grab,
         VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        NULL,
 };
 
 REGISTER_MODULE(screen, &vidcap_screen_osx_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
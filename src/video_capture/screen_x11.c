@@ -407,10 +407,10 @@ static void vidcap_screen_x11_done(void *state)
         free(s);
 }
 
-static struct video_frame * vidcap_screen_x11_grab(void *state, struct audio_frame **audio)
+/// @param convert  false if the frame is going to be skipped
+static struct video_frame *screen_x11_grab(struct vidcap_screen_x11_state *s, struct audio_frame **audio,
+                bool convert)
 {
-        struct vidcap_screen_x11_state *s = (struct vidcap_screen_x11_state *) state;
-
         if (!s->initialized) {
                 s->initialized = initialize(s);
                 if (!s->initialized) {
@@ -448,11 +448,13 @@ static struct video_frame * vidcap_screen_x11_grab(void *state, struct audio_fra
          * some configurations, but seems to work currently. To be corrected if there is an
          * opposite case.
          */
-        parallel_pix_conv(s->tile->height, s->tile->data,
-                          vc_get_linesize(s->tile->width, RGB),
-                          &item->data->data[0],
-                          vc_get_linesize(s->tile->width, RGBA),
-                          vc_copylineBGRAtoRGB, s->cpu_count);
+        if (convert) {
+                parallel_pix_conv(s->tile->height, s->tile->data,
+                                  vc_get_linesize(s->tile->width, RGB),
+                                  &item->data->data[0],
+                                  vc_get_linesize(s->tile->width, RGBA),
+                                  vc_copylineBGRAtoRGB, s->cpu_count);
+        }
 
         XDestroyImage(item->data);
         free(item);
@@ -470,12 +472,23 @@ static struct video_frame * vidcap_screen_x11_grab(void *state, struct audio_fra
         return s->frame;
 }
 
+static struct video_frame * vidcap_screen_x11_grab(void *state, struct audio_frame **audio)
+{
+        return screen_x11_grab((struct vidcap_screen_x11_state *) state, audio, true);
+}
+
+static bool vidcap_screen_x11_skip(void *state, struct audio_frame **audio)
+{
+        return screen_x11_grab((struct vidcap_screen_x11_state *) state, audio, false) != NULL;
+}
+
 static const struct video_capture_info vidcap_screen_x11_info = {
         vidcap_screen_x11_probe,
         vidcap_screen_x11_init,
         vidcap_screen_x11_done,
         vidcap_screen_x11_grab,
         MOD_NAME,
+        vidcap_screen_x11_skip,
 };
 
 REGISTER_MODULE(screen_x11, &vidcap_screen_x11_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -349,6 +349,7 @@ static const struct video_capture_info vidcap_switcher_info = {
         vidcap_switcher_done,
         vidcap_switcher_grab,
         MOD_NAME,
+        NULL,
 };
 
 REGISTER_MODULE(switcher, &vidcap_switcher_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -1354,6 +1354,7 @@ static const struct video_capture_info vidcap_swmix_info = {
         vidcap_swmix_done,
         vidcap_swmix_grab,
         VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        NULL,
 };
 
 REGISTER_MODULE(swmix, &vidcap_swmix_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
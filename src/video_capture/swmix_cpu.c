@@ -0,0 +1,709 @@
+/**
+ * @file   video_capture/swmix_cpu.c
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ *
+ * @brief CPU-only variant of the SW mix (no OpenGL required)
+ *
+ * Inputs are converted to UYVY in their capture threads, scaled and
+ * composed by parallel tasks into a private canvas that is copied to pooled
+ * output frames. The canvas remembers which input frames it contains so
+ * only inputs with a new frame are recomposed (the output frames cannot be
+ * used for that because capture filters may modify them in place).
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "audio/types.h"
+#include "debug.h"
+#include "host.h"
+#include "lib_common.h"
+#include "pixfmt_conv.h"
+#include "tv.h"
+#include "utils/color_out.h"
+#include "utils/fs.h"
+#include "utils/macros.h"
+#include "utils/misc.h"
+#include "utils/uyvy_scale.h"
+#include "utils/video_frame_pool.h"
+#include "utils/worker.h"
+#include "video.h"
+#include "video_capture.h"
+#include "video_capture/input_worker_common.h"
+
+#define MOD_NAME "[swmix_cpu] "
+#define MIN_LINES_PER_TASK 32
+
+struct swmix_cpu_input {
+        struct vidcap_swmix_cpu_state *parent;
+        int                 idx;
+        struct vidcap      *dev;
+        pthread_t           thread;
+        bool                thread_started;
+        void               *pool;       ///< UYVY copies of captured frames
+        struct video_desc   pool_desc;
+        bool                unsupported_reported;
+
+        struct video_frame *captured;   ///< protected by parent->lock
+
+        // following is accessed only from the grab thread
+        struct video_frame *current;
+        unsigned            generation; ///< incremented on every new frame (0 - no frame yet)
+        double              x, y, width, height; ///< cell in 1x1 unit space
+        struct video_desc   scaler_desc;
+        struct uyvy_scaler *scaler;
+        int                 dst_x, dst_y, dst_w, dst_h; ///< placement in the output (pixels)
+};
+
+struct vidcap_swmix_cpu_state {
+        struct swmix_cpu_input *inputs;
+        int                     devices_cnt;
+        struct video_desc       desc;
+        int                     grid_x, grid_y;
+
+        pthread_mutex_t lock;
+        bool            should_exit;
+
+        void     *pool;
+        char     *canvas;                   ///< composed image, accessed only from the grab thread
+        size_t    canvas_len;
+        unsigned  canvas_layout_generation; ///< layout the canvas was composed with (0 - none)
+        unsigned *canvas_input_generation;  ///< input frames contained in the canvas
+        unsigned  layout_generation;
+
+        time_ns_t next_frame_time;
+
+        struct input_audio_acc audio; ///< protected by lock
+
+        int       frames;
+        int       recomposed;
+        time_ns_t compose_time;
+        time_ns_t t0;
+};
+
+struct scale_task {
+        const struct uyvy_scaler *scaler;
+        const char *in;
+        int in_pitch;
+        char *out;
+        int out_pitch;
+        int y_begin, y_end;
+};
+
+static void vidcap_swmix_cpu_done(void *state);
+
+static char *get_config_name()
+{
+        const char *rc_suffix = "/.ug-swmix.rc";
+        static char buf[MAX_PATH_SIZE];
+        if(!getenv("HOME")) {
+                return NULL;
+        }
+
+        snprintf(buf, sizeof buf, "%s%s", getenv("HOME"), rc_suffix);
+        return buf;
+}
+
+static void show_help()
+{
+        printf("SW Mix capture (CPU)\n");
+        printf("Usage\n");
+        color_printf("\t" TERM_BOLD "-t swmix_cpu:<width>:<height>:<fps>[:UYVY][:layout=<X>x<Y>] "
+                        "-t <dev1_config> -t <dev2_config>\n" TERM_RESET);
+        printf("\tor\n");
+        color_printf("\t" TERM_BOLD "-t swmix_cpu:file[=<file_path>] -t <dev1_config> -t <dev2_config> ...\n" TERM_RESET);
+        printf("\t\twhere <devn_config> is a configuration string of device as usual -\n"
+                        "\t\t\tdevice config string or alias from UG config file.\n");
+        printf("\t\t<width> width of resulting video\n");
+        printf("\t\t<height> height of resulting video\n");
+        printf("\t\t<fps> FPS of resulting video, may be eg. 25 or 50i\n");
+        printf("\n");
+        printf("\t\tLayout and the config file (%s) have the same semantics as with \"swmix\".\n",
+                        get_config_name());
+        printf("\t\tInputs are scaled bilinearly, output codec is UYVY.\n");
+}
+
+static bool get_input_param_from_file(FILE* config_file, const char *name, int *x, int *y,
+                                        int *width, int *height)
+{
+        char line[1024];
+        fseek(config_file, 0, SEEK_SET); // rewind
+        if (!fgets(line, sizeof(line), config_file)) { // skip first line
+                return false;
+        }
+        while (fgets(line, sizeof(line), config_file)) {
+                char item_name[129];
+                int x_, y_, width_, height_;
+                if(sscanf(line, "%128s %d %d %d %d", item_name, &x_, &y_, &width_, &height_) != 5)
+                        continue;
+                if(strcasecmp(item_name, name) == 0) {
+                        *x = x_;
+                        *y = y_;
+                        *width = width_;
+                        *height = height_;
+                        return true;
+                }
+        }
+        return false;
+}
+
+#define PARSE_OK 0
+#define PARSE_ERROR 1
+#define PARSE_FILE 2
+static int parse_config_string(struct vidcap_swmix_cpu_state *s, const char *fmt, char **filepath)
+{
+        char *parse_string = strdup(fmt);
+        char *tmp = parse_string;
+        char *save_ptr = NULL;
+        char *item = NULL;
+        int token_nr = 0;
+        int ret = PARSE_OK;
+
+        s->desc.interlacing = PROGRESSIVE;
+        while ((item = strtok_r(tmp, ":", &save_ptr)) && ret == PARSE_OK) {
+                tmp = NULL;
+                switch (token_nr++) {
+                case 0:
+                        if (strncasecmp(item, "file", strlen("file")) == 0) {
+                                char *eq = strchr(item, '=');
+                                if (filepath && eq) {
+                                        *filepath = strdup(eq + 1);
+                                }
+                                ret = PARSE_FILE;
+                                continue;
+                        }
+                        s->desc.width = atoi(item);
+                        break;
+                case 1:
+                        s->desc.height = atoi(item);
+                        break;
+                case 2: {
+                        char *endptr = NULL;
+                        s->desc.fps = strtod(item, &endptr);
+                        if (tolower(*endptr) == 'i') {
+                                s->desc.fps /= 2;
+                                s->desc.interlacing = INTERLACED_MERGED;
+                        }
+                        break;
+                }
+                default:
+                        if (token_nr == 4 && get_codec_from_name(item) != VIDEO_CODEC_NONE) {
+                                if (get_codec_from_name(item) != UYVY) {
+                                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Only UYVY output is supported!\n");
+                                        ret = PARSE_ERROR;
+                                }
+                        } else if (strncasecmp(item, "interpolation=", strlen("interpolation=")) == 0) {
+                                log_msg(LOG_LEVEL_WARNING, MOD_NAME "Only bilinear interpolation is supported.\n");
+                        } else if (strncasecmp(item, "layout=", strlen("layout=")) == 0) {
+                                const char *l = item + strlen("layout=");
+                                if (!strchr(l, 'x') || (s->grid_x = atoi(l)) <= 0
+                                                || (s->grid_y = atoi(strchr(l, 'x') + 1)) <= 0) {
+                                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Error parsing layout!\n");
+                                        ret = PARSE_ERROR;
+                                }
+                        } else {
+                                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Unknown option: %s\n", item);
+                                ret = PARSE_ERROR;
+                        }
+                }
+        }
+        free(parse_string);
+
+        if (ret == PARSE_OK && (token_nr < 3 || s->desc.width < 2 || s->desc.height < 1 || s->desc.fps <= 0)) {
+                ret = PARSE_ERROR;
+        }
+        return ret;
+}
+
+/// @returns config file if used (caller must close it) or NULL; *ok is set to false on error
+static FILE *parse(struct vidcap_swmix_cpu_state *s, const char *fmt, bool *ok)
+{
+        char *config_path = NULL;
+        *ok = false;
+        int ret = parse_config_string(s, fmt, &config_path);
+        if (ret == PARSE_ERROR) {
+                show_help();
+                return NULL;
+        }
+        if (ret == PARSE_OK) {
+                *ok = true;
+                return NULL;
+        }
+
+        if (!config_path) {
+                config_path = strdup(get_config_name());
+        }
+        FILE *config_file = fopen(config_path, "r");
+        if (!config_file) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Params not set and config file %s not found.\n", config_path);
+                free(config_path);
+                return NULL;
+        }
+        free(config_path);
+
+        char line[1024];
+        if (!fgets(line, sizeof(line), config_file)) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Input file is empty!\n");
+                fclose(config_file);
+                return NULL;
+        }
+        for(int i = strlen(line); i > 0 && isspace(line[i - 1]); i--) line[i - 1] = '\0'; // trim trailing spaces
+        if (parse_config_string(s, line, NULL) != PARSE_OK) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Malformed input file! First line should contain config "
+                                "string same as for cmdline use.\n");
+                show_help();
+                fclose(config_file);
+                return NULL;
+        }
+        *ok = true;
+        return config_file;
+}
+
+static bool set_layout(struct vidcap_swmix_cpu_state *s, FILE *config_file, struct vidcap_params *params)
+{
+        int m = s->grid_x;
+        int n = s->grid_y;
+        if (m == 0) {
+                // we want to have least MxN, where N <= M + 1
+                m = ceil((-1.0 + sqrt(1.0 + 4.0 * s->devices_cnt)) / 2.0);
+                n = (s->devices_cnt + m - 1) / m;
+        } else if (s->devices_cnt > m * n) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "Invalid layout! More devices given than layout size.\n");
+                return false;
+        }
+
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                struct swmix_cpu_input *in = &s->inputs[i];
+                params = vidcap_params_get_next(params);
+                if (config_file == NULL) {
+                        in->width = 1.0 / m;
+                        in->height = 1.0 / n;
+                        in->x = (i % m) * in->width;
+                        in->y = (i / m) * in->height;
+                        continue;
+                }
+                int x, y, width, height;
+                if (!get_input_param_from_file(config_file, vidcap_params_get_name(params), &x, &y, &width, &height)) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Cannot find config for device \"%s\"\n",
+                                        vidcap_params_get_name(params));
+                        return false;
+                }
+                in->width = (double) width / s->desc.width;
+                in->height = (double) height / s->desc.height;
+                in->x = (double) x / s->desc.width;
+                in->y = (double) y / s->desc.height;
+        }
+        return true;
+}
+
+static void vidcap_swmix_cpu_probe(struct device_info **available_cards, int *count, void (**deleter)(void *))
+{
+        *deleter = free;
+        *available_cards = NULL;
+        *count = 0;
+}
+
+/**
+ * Converts the captured frame to owned UYVY frame (if it is not one already).
+ * @returns NULL if the codec cannot be converted
+ */
+static struct video_frame *get_uyvy_frame(struct swmix_cpu_input *in, struct video_frame *f)
+{
+        if (f->color_spec == UYVY && f->callbacks.dispose != NULL) {
+                return f;
+        }
+        decoder_t dec = NULL;
+        if (f->color_spec != UYVY && (dec = get_decoder_from_to(f->color_spec, UYVY)) == NULL) {
+                if (!in->unsupported_reported) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Cannot convert %s to UYVY (input #%d)!\n",
+                                        get_codec_name(f->color_spec), in->idx);
+                        in->unsupported_reported = true;
+                }
+                VIDEO_FRAME_DISPOSE(f);
+                return NULL;
+        }
+        struct video_desc desc = video_desc_from_frame(f);
+        desc.color_spec = UYVY;
+        desc.tile_count = 1;
+        if (in->pool == NULL) {
+                in->pool = video_frame_pool_init(desc, 0);
+                in->pool_desc = desc;
+        } else if (!video_desc_eq(desc, in->pool_desc)) {
+                video_frame_pool_reconfigure(in->pool, desc);
+                in->pool_desc = desc;
+        }
+        struct video_frame *out = video_frame_pool_get_disposable_frame(in->pool);
+        if (dec == NULL) {
+                memcpy(out->tiles[0].data, f->tiles[0].data, out->tiles[0].data_len);
+        } else {
+                const int src_linesize = vc_get_linesize(desc.width, f->color_spec);
+                const int dst_linesize = vc_get_linesize(desc.width, UYVY);
+                for (unsigned int y = 0; y < desc.height; ++y) {
+                        dec((unsigned char *) out->tiles[0].data + y * dst_linesize,
+                                        (const unsigned char *) f->tiles[0].data + y * src_linesize, dst_linesize,
+                                        DEFAULT_R_SHIFT, DEFAULT_G_SHIFT, DEFAULT_B_SHIFT);
+                }
+        }
+        vf_copy_metadata(out, f);
+        out->color_spec = UYVY;
+        VIDEO_FRAME_DISPOSE(f);
+        return out;
+}
+
+static void replace_captured(void *udata, struct video_frame *frame, time_ns_t ts)
+{
+        UNUSED(ts);
+        struct swmix_cpu_input *in = udata;
+        struct vidcap_swmix_cpu_state *s = in->parent;
+        if ((frame = get_uyvy_frame(in, frame)) == NULL) {
+                return;
+        }
+        if (frame->interlacing == INTERLACED_MERGED) {
+                vc_deinterlace((unsigned char *) frame->tiles[0].data,
+                                vc_get_linesize(frame->tiles[0].width, UYVY), frame->tiles[0].height);
+        }
+
+        pthread_mutex_lock(&s->lock);
+        // frame was not processed, simply replace it
+        VIDEO_FRAME_DISPOSE(in->captured);
+        in->captured = frame;
+        pthread_mutex_unlock(&s->lock);
+}
+
+static void *input_worker(void *arg)
+{
+        struct swmix_cpu_input *in = arg;
+        struct vidcap_swmix_cpu_state *s = in->parent;
+        const struct input_worker w = { "swmix_cpu", in->idx, in->dev, &s->lock, &s->should_exit, &s->audio,
+                replace_captured, in };
+        input_worker_run(&w);
+        return NULL;
+}
+
+static int
+vidcap_swmix_cpu_init(struct vidcap_params *params, void **state)
+{
+        const char *fmt = vidcap_params_get_fmt(params);
+        if (fmt == NULL || strlen(fmt) == 0 || strcmp(fmt, "help") == 0) {
+                show_help();
+                return VIDCAP_INIT_NOERR;
+        }
+
+        struct vidcap_swmix_cpu_state *s = calloc(1, sizeof *s);
+        input_audio_acc_init(&s->audio);
+        s->desc.color_spec = UYVY;
+        s->desc.tile_count = 1;
+        pthread_mutex_init(&s->lock, NULL);
+
+        bool ok = false;
+        FILE *config_file = parse(s, fmt, &ok);
+        if (!ok) {
+                vidcap_swmix_cpu_done(s);
+                return VIDCAP_INIT_FAIL;
+        }
+        s->desc.width &= ~1;
+
+        struct vidcap_params *tmp = params;
+        while ((tmp = vidcap_params_get_next(tmp)) && vidcap_params_get_driver(tmp) != NULL) {
+                s->devices_cnt++;
+        }
+        if (s->devices_cnt == 0) {
+                log_msg(LOG_LEVEL_ERROR, MOD_NAME "No input device given!\n");
+                show_help();
+                vidcap_swmix_cpu_done(s);
+                return VIDCAP_INIT_FAIL;
+        }
+        s->inputs = calloc(s->devices_cnt, sizeof s->inputs[0]);
+        s->canvas_input_generation = calloc(s->devices_cnt, sizeof(unsigned));
+        s->layout_generation = 1;
+        bool layout_ok = set_layout(s, config_file, params);
+        if (config_file) {
+                fclose(config_file);
+        }
+        if (!layout_ok) {
+                vidcap_swmix_cpu_done(s);
+                return VIDCAP_INIT_FAIL;
+        }
+
+        tmp = params;
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                tmp = vidcap_params_get_next(tmp);
+                s->inputs[i].parent = s;
+                s->inputs[i].idx = i;
+                if (vidcap_params_get_flags(tmp) == 0 && vidcap_params_get_flags(params) != 0) {
+                        vidcap_params_set_flags(tmp, vidcap_params_get_flags(params));
+                }
+                if (initialize_video_capture(vidcap_params_get_parent(params), tmp, &s->inputs[i].dev) != 0) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Unable to initialize device %d (%s:%s).\n",
+                                        i, vidcap_params_get_driver(tmp), vidcap_params_get_fmt(tmp));
+                        vidcap_swmix_cpu_done(s);
+                        return VIDCAP_INIT_FAIL;
+                }
+        }
+
+        s->pool = video_frame_pool_init(s->desc, 0);
+        s->t0 = s->next_frame_time = get_time_in_ns();
+
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                if (pthread_create(&s->inputs[i].thread, NULL, input_worker, &s->inputs[i]) != 0) {
+                        log_msg(LOG_LEVEL_ERROR, MOD_NAME "Unable to create capture thread!\n");
+                        vidcap_swmix_cpu_done(s);
+                        return VIDCAP_INIT_FAIL;
+                }
+                s->inputs[i].thread_started = true;
+        }
+
+        *state = s;
+        return VIDCAP_INIT_OK;
+}
+
+static void
+vidcap_swmix_cpu_done(void *state)
+{
+        struct vidcap_swmix_cpu_state *s = state;
+
+        pthread_mutex_lock(&s->lock);
+        s->should_exit = true;
+        pthread_mutex_unlock(&s->lock);
+
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                struct swmix_cpu_input *in = &s->inputs[i];
+                if (in->thread_started) {
+                        pthread_join(in->thread, NULL);
+                }
+                if (in->dev) {
+                        vidcap_done(in->dev);
+                }
+                VIDEO_FRAME_DISPOSE(in->captured);
+                VIDEO_FRAME_DISPOSE(in->current);
+                if (in->pool) {
+                        video_frame_pool_destroy(in->pool);
+                }
+                uyvy_scaler_destroy(in->scaler);
+        }
+        if (s->pool) {
+                video_frame_pool_destroy(s->pool);
+        }
+        free(s->canvas);
+        free(s->canvas_input_generation);
+        pthread_mutex_destroy(&s->lock);
+        input_audio_acc_done(&s->audio);
+        free(s->inputs);
+        free(s);
+}
+
+/// computes aspect-preserving placement of the input in its cell
+static void reconfigure_input(struct vidcap_swmix_cpu_state *s, struct swmix_cpu_input *in, struct video_desc desc)
+{
+        uyvy_scaler_destroy(in->scaler);
+        in->scaler = NULL;
+        in->scaler_desc = desc;
+
+        const double video_aspect = (double) desc.width / desc.height;
+        double width = in->width * s->desc.width;
+        double height = in->height * s->desc.height;
+        double x = in->x * s->desc.width;
+        double y = in->y * s->desc.height;
+        if (video_aspect > width / height) {
+                double new_height = width / video_aspect;
+                y += (height - new_height) / 2;
+                height = new_height;
+        } else {
+                double new_width = height * video_aspect;
+                x += (width - new_width) / 2;
+                width = new_width;
+        }
+        // clip to the output, x and width need to be even (UYVY)
+        const int rx = lround(x);
+        const int ry = lround(y);
+        const int rwidth = lround(width);
+        const int rheight = lround(height);
+        in->dst_x = MAX(0, rx) & ~1;
+        in->dst_y = MAX(0, ry);
+        in->dst_w = MIN(rwidth, (int) s->desc.width - in->dst_x) & ~1;
+        in->dst_h = MIN(rheight, (int) s->desc.height - in->dst_y);
+        if (desc.width % 2 == 0 && in->dst_w > 0 && in->dst_h > 0) {
+                in->scaler = uyvy_scaler_create(desc.width, desc.height, in->dst_w, in->dst_h);
+        }
+        s->layout_generation++;
+        log_msg(LOG_LEVEL_VERBOSE, MOD_NAME "Input #%d: %ux%u placed to %dx%d+%d+%d\n", in->idx, desc.width,
+                        desc.height, in->dst_w, in->dst_h, in->dst_x, in->dst_y);
+}
+
+static void fill_black(char *data, size_t len)
+{
+        const uint32_t black = 0x10801080; // little-endian U Y V Y = 128 16 128 16
+        for (size_t i = 0; i + 4 <= len; i += 4) {
+                memcpy(data + i, &black, 4);
+        }
+}
+
+static void *scale_task(void *arg)
+{
+        struct scale_task *t = arg;
+        uyvy_scaler_scale(t->scaler, t->in, t->in_pitch, t->out, t->out_pitch, t->y_begin, t->y_end);
+        return NULL;
+}
+
+/// composes inputs with a frame not yet contained in the canvas and copies the canvas to out
+static void compose(struct vidcap_swmix_cpu_state *s, struct video_frame *out)
+{
+        if (s->canvas_len != out->tiles[0].data_len) {
+                free(s->canvas);
+                s->canvas_len = out->tiles[0].data_len;
+                s->canvas = malloc(s->canvas_len);
+                s->canvas_layout_generation = 0;
+        }
+        if (s->canvas_layout_generation != s->layout_generation) {
+                fill_black(s->canvas, s->canvas_len);
+                memset(s->canvas_input_generation, 0, s->devices_cnt * sizeof(unsigned));
+                s->canvas_layout_generation = s->layout_generation;
+        }
+
+        const int out_pitch = vc_get_linesize(s->desc.width, UYVY);
+        const int workers = get_cpu_core_count();
+        struct scale_task *tasks = alloca(s->devices_cnt * workers * sizeof(struct scale_task));
+        int task_count = 0;
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                struct swmix_cpu_input *in = &s->inputs[i];
+                if (in->current == NULL || in->scaler == NULL || s->canvas_input_generation[i] == in->generation) {
+                        continue;
+                }
+                s->canvas_input_generation[i] = in->generation;
+                s->recomposed += 1;
+                const int chunks = MAX(1, MIN(workers, in->dst_h / MIN_LINES_PER_TASK));
+                for (int j = 0; j < chunks; ++j) {
+                        tasks[task_count++] = (struct scale_task) {
+                                .scaler = in->scaler,
+                                .in = in->current->tiles[0].data,
+                                .in_pitch = vc_get_linesize(in->current->tiles[0].width, UYVY),
+                                .out = s->canvas + in->dst_y * out_pitch + in->dst_x * 2,
+                                .out_pitch = out_pitch,
+                                .y_begin = j * in->dst_h / chunks,
+                                .y_end = (j + 1) * in->dst_h / chunks,
+                        };
+                }
+        }
+        if (task_count == 1) {
+                scale_task(&tasks[0]);
+        } else if (task_count > 1) {
+                task_run_parallel(scale_task, task_count, tasks, sizeof tasks[0], NULL);
+        }
+        memcpy(out->tiles[0].data, s->canvas, s->canvas_len);
+}
+
+static struct video_frame *
+vidcap_swmix_cpu_grab(void *state, struct audio_frame **audio)
+{
+        struct vidcap_swmix_cpu_state *s = state;
+        *audio = NULL;
+
+        // wait until next frame time is due
+        const time_ns_t frame_interval = NS_IN_SEC_DBL / s->desc.fps;
+        time_ns_t now = get_time_in_ns();
+        if (now < s->next_frame_time) {
+                usleep((s->next_frame_time - now) / NS_IN_US);
+        } else if (now - s->next_frame_time > frame_interval) { // too late, do not try to catch up
+                s->next_frame_time = now;
+        }
+        s->next_frame_time += frame_interval;
+
+        const time_ns_t t_start = get_time_in_ns();
+        pthread_mutex_lock(&s->lock);
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                struct swmix_cpu_input *in = &s->inputs[i];
+                if (in->captured != NULL) {
+                        VIDEO_FRAME_DISPOSE(in->current);
+                        in->current = in->captured;
+                        in->captured = NULL;
+                        in->generation += 1;
+                }
+        }
+        input_audio_acc_take(&s->audio, audio);
+        pthread_mutex_unlock(&s->lock);
+
+        for (int i = 0; i < s->devices_cnt; ++i) {
+                struct swmix_cpu_input *in = &s->inputs[i];
+                if (in->current != NULL && !video_desc_eq(video_desc_from_frame(in->current), in->scaler_desc)) {
+                        reconfigure_input(s, in, video_desc_from_frame(in->current));
+                }
+        }
+
+        struct video_frame *out = video_frame_pool_get_disposable_frame(s->pool);
+        out->fps = s->desc.fps;
+        out->interlacing = s->desc.interlacing;
+        compose(s, out);
+
+        const time_ns_t t_end = get_time_in_ns();
+        s->compose_time += t_end - t_start;
+        s->frames++;
+        if (t_end - s->t0 >= 5 * NS_IN_SEC) {
+                const double seconds = (double) (t_end - s->t0) / NS_IN_SEC;
+                log_msg(LOG_LEVEL_INFO, "[swmix_cpu cap.] %d frames in %g seconds = %g FPS (avg. %.2f ms compose, "
+                                "%.2f inputs recomposed per frame)\n", s->frames, seconds, s->frames / seconds,
+                                (double) s->compose_time / s->frames / NS_IN_MS, (double) s->recomposed / s->frames);
+                s->t0 = t_end;
+                s->frames = s->recomposed = 0;
+                s->compose_time = 0;
+        }
+
+        return out;
+}
+
+static const struct video_capture_info vidcap_swmix_cpu_info = {
+        vidcap_swmix_cpu_probe,
+        vidcap_swmix_cpu_init,
+        vidcap_swmix_cpu_done,
+        vidcap_swmix_cpu_grab,
+        VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        NULL,
+};
+
+REGISTER_MODULE(swmix_cpu, &vidcap_swmix_cpu_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
+
+/* vim: set expandtab sw=8 tw=120: */
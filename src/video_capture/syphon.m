@@ -568,6 +568,7 @@ static const struct video_capture_info vidcap_syphon_info = {
         vidcap_syphon_done,
         vidcap_syphon_grab,
         MOD_NAME,
+        NULL,
 };
 
 REGISTER_MODULE(syphon, &vidcap_syphon_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
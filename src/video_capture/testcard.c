@@ -64,6 +64,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>                         // for usleep
 
 #include "audio/types.h"
 #include "audio/utils.h"
@@ -80,6 +81,7 @@
 #include "utils/string.h"
 #include "utils/vf_split.h"
 #include "utils/video_pattern_generator.h"
+#include "utils/virtual_clock.h"
 #include "utils/y4m.h"
 #include "video.h"
 #include "video_capture.h"
@@ -703,6 +705,29 @@ static audio_frame *vidcap_testcard_get_audio(struct testcard_state *s)
         return &s->audio;
 }
 
+/**
+ * Waits for the next frame time and returns the current time. Busy waiting is
+ * used for precise timing, a skipped frame (not passed anywhere) can sleep.
+ */
+static time_ns_t wait_frame_time(struct testcard_state *state, bool precise)
+{
+        const time_ns_t deadline = state->last_frame_time +
+                                   (time_ns_t) (NS_IN_SEC_DBL / state->frame->fps);
+        if (virtual_clock_enabled) {
+                virtual_clock_sleep_until(deadline);
+                return get_time_in_ns();
+        }
+        time_ns_t curr_time = get_time_in_ns();
+        if (!precise && curr_time < deadline) {
+                usleep((deadline - curr_time) / NS_IN_US);
+                return get_time_in_ns();
+        }
+        while (curr_time < deadline) {
+                curr_time = get_time_in_ns();
+        }
+        return curr_time;
+}
+
 static struct video_frame *vidcap_testcard_grab(void *arg, struct audio_frame **audio)
 {
         struct testcard_state *state = arg;
@@ -710,12 +735,7 @@ static struct video_frame *vidcap_testcard_grab(void *arg, struct audio_frame **
         if (state->video_frames + 1 == state->capture_frames) {
                 return NULL;
         }
-        time_ns_t curr_time = 0;
-        do {
-                curr_time = get_time_in_ns();
-        } while ((double) (curr_time - state->last_frame_time) / NS_IN_SEC <
-                 1.0 / state->frame->fps);
-        state->last_frame_time = curr_time;
+        state->last_frame_time = wait_frame_time(state, true);
         state->frame->timestamp =
             (state->video_frames * state->fps_den * 90000 + state->fps_num - 1) /
             state->fps_num;
@@ -749,6 +769,22 @@ static struct video_frame *vidcap_testcard_grab(void *arg, struct audio_frame **
         return state->frame;
 }
 
+/// keeps the frame timing (and audio) but doesn't busy wait nor update the frame
+static bool vidcap_testcard_skip(void *arg, struct audio_frame **audio)
+{
+        struct testcard_state *state = arg;
+
+        if (state->video_frames + 1 == state->capture_frames) {
+                return false;
+        }
+        state->last_frame_time = wait_frame_time(state, false);
+        *audio = vidcap_testcard_get_audio(state);
+        if (!state->tiled) {
+                state->video_frames += 1;
+        }
+        return true;
+}
+
 static void vidcap_testcard_probe(struct device_info **available_devices, int *count, void (**deleter)(void *))
 {
         *deleter = free;
@@ -809,6 +845,7 @@ static const struct video_capture_info vidcap_testcard_info = {
         vidcap_testcard_done,
         vidcap_testcard_grab,
         MOD_NAME,
+        vidcap_testcard_skip,
 };
 
 REGISTER_MODULE(testcard, &vidcap_testcard_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
@@ -115,7 +115,14 @@ static void toI420(unsigned char *out, const unsigned char *input, int width, in
 void testcard_convert_buffer(codec_t in_c, codec_t out_c, unsigned char *out, unsigned const char *in, int width, int height)
 {
         unsigned char *tmp_buffer = NULL;
-        if (out_c == I420 || out_c == YUYV || (in_c == RGBA && out_c == v210)) {
+        if (out_c == P010) {
+                tmp_buffer = malloc(vc_get_datalen(width, height, v210));
+                testcard_convert_buffer(in_c, v210, tmp_buffer, in, width, height);
+                v210_to_p010(width, height, tmp_buffer, out);
+                free(tmp_buffer);
+                return;
+        }
+        if (out_c == I420 || out_c == NV12 || out_c == YUYV || (in_c == RGBA && out_c == v210)) {
                 decoder_t decoder = get_decoder_from_to(in_c, UYVY);
                 tmp_buffer =  malloc(2L * ((width + 1U) ^ 1U) * height);
                 long in_linesize = vc_get_size(width, in_c);
@@ -131,6 +138,11 @@ void testcard_convert_buffer(codec_t in_c, codec_t out_c, unsigned char *out, un
                 free(tmp_buffer);
                 return;
         }
+        if (out_c == NV12) {
+                uyvy_to_nv12(width, height, in, out);
+                free(tmp_buffer);
+                return;
+        }
         decoder_t decoder = get_decoder_from_to(in_c, out_c);
         assert(decoder != NULL);
         long out_linesize = vc_get_linesize(width, out_c);
@@ -143,7 +155,7 @@ void testcard_convert_buffer(codec_t in_c, codec_t out_c, unsigned char *out, un
 
 static bool testcard_conv_handled_internally(codec_t c)
 {
-        return c == I420 || c == YUYV || c == v210;
+        return c == I420 || c == NV12 || c == P010 || c == YUYV || c == v210;
 }
 
 void testcard_show_codec_help(const char *name, bool src_8b_only)
@@ -157,7 +169,7 @@ void testcard_show_codec_help(const char *name, bool src_8b_only)
                                         && !testcard_conv_handled_internally(c))) {
                         continue;
                 }
-                if (c == I420 && !print_i420) {
+                if (codec_is_planar(c) && !print_i420) {
                         continue;
                 }
                 color_printf(TERM_BOLD "\t\t%-4s" TERM_RESET " - %s\n", get_codec_name(c), get_codec_name_long(c));
@@ -168,8 +180,11 @@ void testcard_show_codec_help(const char *name, bool src_8b_only)
                 if (is_codec_opaque(c) || get_bits_per_component(c) == 8) {
                         continue;
                 }
+                if (codec_is_planar(c) && src_8b_only) {
+                        continue;
+                }
                 if (get_decoder_from_to(RGBA, c) == VIDEO_CODEC_NONE &&
-                                ((src_8b_only && c != v210) || get_decoder_from_to(RG48, c) == VIDEO_CODEC_NONE)) {
+                                ((src_8b_only && c != v210) || (get_decoder_from_to(RG48, c) == VIDEO_CODEC_NONE && c != P010))) {
                         continue;
                 }
                 color_printf(TERM_BOLD "\t\t%-4s" TERM_RESET " - %s\n", get_codec_name(c), get_codec_name_long(c));
@@ -374,7 +374,8 @@ static void write_mode(struct mode *m,
         write_fcc(codec, pixelformat);
 
         codec_t ug_codec = get_v4l2_to_ug(pixelformat);
-        bool force_rgb = is_codec_opaque(ug_codec) || codec_is_planar(ug_codec) || ug_codec == VIDEO_CODEC_NONE;
+        bool force_rgb = is_codec_opaque(ug_codec) || (codec_is_planar(ug_codec) && ug_codec != NV12 && ug_codec != P010) ||
+                ug_codec == VIDEO_CODEC_NONE;
 
         snprintf(m->name, sizeof(m->name), "%dx%d %.2f fps %4s",
                         width, height, fps, codec);
@@ -813,11 +814,9 @@ static void vidcap_v4l2_dispose_video_frame(struct video_frame *frame) {
         vf_free(frame);
 }
 
-static struct video_frame * vidcap_v4l2_grab(void *state, struct audio_frame **audio)
+/// waits for a free buffer slot and dequeues a captured buffer
+static bool dequeue_buffer(struct vidcap_v4l2_state *s, struct v4l2_buffer *buf)
 {
-        struct vidcap_v4l2_state *s = (struct vidcap_v4l2_state *) state;
-        struct video_frame *out;
-
         pthread_mutex_lock(&s->lock);
         enqueue_all_finished_frames(s);
         while (s->dequeued_buffers == s->buffer_count) { // we cannot dequeue any buffer
@@ -826,19 +825,30 @@ static struct video_frame * vidcap_v4l2_grab(void *state, struct audio_frame **a
         }
         pthread_mutex_unlock(&s->lock);
 
-        *audio = NULL;
-
-        struct v4l2_buffer buf;
-        memset(&buf, 0, sizeof(buf));
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
+        memset(buf, 0, sizeof *buf);
+        buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf->memory = V4L2_MEMORY_MMAP;
 
-        if(ioctl(s->fd, VIDIOC_DQBUF, &buf) != 0) {
+        if(ioctl(s->fd, VIDIOC_DQBUF, buf) != 0) {
                 log_perror(LOG_LEVEL_ERROR, MOD_NAME "Unable to dequeue buffer");
-                return NULL;
-        };
+                return false;
+        }
 
         s->dequeued_buffers += 1;
+        return true;
+}
+
+static struct video_frame * vidcap_v4l2_grab(void *state, struct audio_frame **audio)
+{
+        struct vidcap_v4l2_state *s = (struct vidcap_v4l2_state *) state;
+        struct video_frame *out;
+
+        *audio = NULL;
+
+        struct v4l2_buffer buf;
+        if (!dequeue_buffer(s, &buf)) {
+                return NULL;
+        }
 
         out = vf_alloc_desc(s->desc);
         out->callbacks.dispose = vidcap_v4l2_dispose_video_frame;
@@ -898,12 +908,33 @@ static struct video_frame * vidcap_v4l2_grab(void *state, struct audio_frame **a
         return out;
 }
 
+/// returns the buffer to the driver right away, without conversion
+static bool vidcap_v4l2_skip(void *state, struct audio_frame **audio)
+{
+        struct vidcap_v4l2_state *s = (struct vidcap_v4l2_state *) state;
+
+        *audio = NULL;
+
+        struct v4l2_buffer buf;
+        if (!dequeue_buffer(s, &buf)) {
+                return false;
+        }
+        if (ioctl(s->fd, VIDIOC_QBUF, &buf) != 0) {
+                log_perror(LOG_LEVEL_ERROR, MOD_NAME "Unable to enqueue buffer");
+        } else {
+                s->dequeued_buffers -= 1;
+        }
+        s->frames++;
+        return true;
+}
+
 static const struct video_capture_info vidcap_v4l2_info = {
         vidcap_v4l2_probe,
         vidcap_v4l2_init,
         vidcap_v4l2_done,
         vidcap_v4l2_grab,
         VIDCAP_NO_GENERIC_FPS_INDICATOR,
+        vidcap_v4l2_skip,
 };
 
 REGISTER_MODULE(v4l2, &vidcap_v4l2_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
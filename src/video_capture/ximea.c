@@ -336,6 +336,7 @@ static const struct video_capture_info vidcap_ximea_info = {
         vidcap_ximea_done,
         vidcap_ximea_grab,
         MOD_NAME,
+        NULL,
 };
 
 REGISTER_MODULE(ximea, &vidcap_ximea_info, LIBRARY_CLASS_VIDEO_CAPTURE, VIDEO_CAPTURE_ABI_VERSION);
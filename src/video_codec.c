@@ -75,6 +75,8 @@
 
 #ifdef __SSSE3__
 #include "tmmintrin.h"
+#elif defined __SSE2__
+#include <emmintrin.h>
 #endif
 
 char pixfmt_conv_pref[] = "dsc"; ///< bitdepth, subsampling, color space
@@ -197,15 +199,26 @@ static const struct codec_info_t codec_info[] = {
                 to_fourcc('a','p','c','s'), 1, 1, 0, 8, FALSE, TRUE, FALSE, FALSE, 0, "apcs"},
         [DRM_PRIME] = {"DRM_PRIME", "DRM Prime buffer",
                 to_fourcc('D', 'R', 'M', 'P'), sizeof(struct drm_prime_frame), 1, 0, 8, FALSE, TRUE, FALSE, TRUE, 0, "drm_prime"},
+        [NV12] =  {"NV12", "semi-planar YUV 4:2:0",
+                to_fourcc('N','V','1','2'), 3, 2, 2, 8, FALSE, FALSE, FALSE, FALSE, 4200, "nv12"},
+        [P010] =  {"P010", "semi-planar 10-bit YUV 4:2:0 (16-bit little-endian)",
+                to_fourcc('P','0','1','0'), 6, 2, 2, 10, FALSE, FALSE, FALSE, FALSE, 4200, "p010"},
 };
 
-/// for planar pixel formats
+/**
+ * for planar pixel formats
+ *
+ * Interleaved CbCr plane of semi-planar formats (NV12, P010) is described as
+ * a single plane not subsampled horizontally (2 samples per chroma pixel).
+ */
 struct pixfmt_plane_info_t {
         int plane_info[8];              ///< [1st comp H subsamp, 1st comp V subs., 2nd comp H....]
 };
 
 static const struct pixfmt_plane_info_t pixfmt_plane_info[] = {
         [I420] = {{1, 1, 2, 2, 2, 2, 0, 0}},
+        [NV12] = {{1, 1, 1, 2, 0, 0, 0, 0}},
+        [P010] = {{1, 1, 1, 2, 0, 0, 0, 0}},
         [VIDEO_CODEC_END] = {{0}}, // end must be present to all codecs to have the metadata defined
 };
 
@@ -537,7 +550,6 @@ size_t vc_get_datalen(unsigned int width, unsigned int height, codec_t codec)
                 return vc_get_linesize(width, codec) * height;
         }
 
-        assert(get_bits_per_component(codec) == 8);
         size_t ret = 0;
         int sub[8];
         codec_get_planes_subsampling(codec, sub);
@@ -549,7 +561,7 @@ size_t vc_get_datalen(unsigned int width, unsigned int height, codec_t codec)
                         * ((height + sub[i * 2 + 1] - 1) / sub[i * 2 + 1]);
         }
 
-        return ret;
+        return ret * codec_planar_sample_size(codec);
 }
 
 /// @brief returns @ref codec_info_t::block_size_bytes
@@ -927,6 +939,14 @@ void codec_get_planes_subsampling(codec_t pix_fmt, int *sub) {
         }
 }
 
+/**
+ * @returns size of one sample (in bytes) of a planar pixel format
+ */
+int codec_planar_sample_size(codec_t codec)
+{
+        return get_bits_per_component(codec) > 8 ? 2 : 1;
+}
+
 bool codec_is_420(codec_t pix_fmt)
 {
         return pixfmt_plane_info[pix_fmt].plane_info[0] == 1 &&
@@ -1122,6 +1142,194 @@ i444_8_to_uyvy(int width, int height, const unsigned char *in,
         }
 }
 
+/**
+ * Converts UYVY to NV12, chroma of each line pair is averaged.
+ * @note odd width is not supported (last column is omitted)
+ */
+void
+uyvy_to_nv12(int width, int height, const unsigned char *in,
+             unsigned char *out)
+{
+        const ptrdiff_t      uyvy_linesize = vc_get_linesize(width, UYVY);
+        unsigned char *const out_cbcr      = out + (ptrdiff_t) width * height;
+        for (ptrdiff_t y = 0; y < height; y += 2) {
+                const unsigned char *src0 = in + y * uyvy_linesize;
+                const unsigned char *src1 = y + 1 < height ? src0 + uyvy_linesize : src0;
+                unsigned char *dst_y0   = out + y * width;
+                unsigned char *dst_y1   = y + 1 < height ? dst_y0 + width : dst_y0;
+                unsigned char *dst_cbcr = out_cbcr + (y / 2) * width;
+                int x = 0;
+#ifdef __SSE2__
+                const __m128i lo_mask = _mm_set1_epi16(0xFF);
+                for (; x + 16 <= width; x += 16) {
+                        const __m128i a0 = _mm_loadu_si128((const __m128i *)(const void *) (src0 + 2 * x));
+                        const __m128i b0 = _mm_loadu_si128((const __m128i *)(const void *) (src0 + 2 * x + 16));
+                        const __m128i a1 = _mm_loadu_si128((const __m128i *)(const void *) (src1 + 2 * x));
+                        const __m128i b1 = _mm_loadu_si128((const __m128i *)(const void *) (src1 + 2 * x + 16));
+                        _mm_storeu_si128((__m128i *)(void *) (dst_y0 + x),
+                                         _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(b0, 8)));
+                        _mm_storeu_si128((__m128i *)(void *) (dst_y1 + x),
+                                         _mm_packus_epi16(_mm_srli_epi16(a1, 8), _mm_srli_epi16(b1, 8)));
+                        const __m128i c0 = _mm_packus_epi16(_mm_and_si128(a0, lo_mask), _mm_and_si128(b0, lo_mask));
+                        const __m128i c1 = _mm_packus_epi16(_mm_and_si128(a1, lo_mask), _mm_and_si128(b1, lo_mask));
+                        _mm_storeu_si128((__m128i *)(void *) (dst_cbcr + x), _mm_avg_epu8(c0, c1));
+                }
+#endif
+                for (; x + 1 < width; x += 2) {
+                        dst_y0[x]       = src0[2 * x + 1];
+                        dst_y0[x + 1]   = src0[2 * x + 3];
+                        dst_y1[x]       = src1[2 * x + 1];
+                        dst_y1[x + 1]   = src1[2 * x + 3];
+                        dst_cbcr[x]     = (src0[2 * x] + src1[2 * x] + 1) / 2;
+                        dst_cbcr[x + 1] = (src0[2 * x + 2] + src1[2 * x + 2] + 1) / 2;
+                }
+        }
+}
+
+/// @note odd width is not supported (last column is omitted)
+void
+nv12_to_uyvy(int width, int height, const unsigned char *in,
+             unsigned char *out)
+{
+        const ptrdiff_t            uyvy_linesize = vc_get_linesize(width, UYVY);
+        const unsigned char *const in_cbcr       = in + (ptrdiff_t) width * height;
+        for (ptrdiff_t y = 0; y < height; ++y) {
+                const unsigned char *src_y    = in + y * width;
+                const unsigned char *src_cbcr = in_cbcr + (y / 2) * width;
+                unsigned char       *dst      = out + y * uyvy_linesize;
+                int x = 0;
+#ifdef __SSE2__
+                for (; x + 16 <= width; x += 16) {
+                        const __m128i luma = _mm_loadu_si128((const __m128i *)(const void *) (src_y + x));
+                        const __m128i chroma = _mm_loadu_si128((const __m128i *)(const void *) (src_cbcr + x));
+                        _mm_storeu_si128((__m128i *)(void *) (dst + 2 * x), _mm_unpacklo_epi8(chroma, luma));
+                        _mm_storeu_si128((__m128i *)(void *) (dst + 2 * x + 16), _mm_unpackhi_epi8(chroma, luma));
+                }
+#endif
+                for (; x + 1 < width; x += 2) {
+                        dst[2 * x]     = src_cbcr[x];
+                        dst[2 * x + 1] = src_y[x];
+                        dst[2 * x + 2] = src_cbcr[x + 1];
+                        dst[2 * x + 3] = src_y[x + 1];
+                }
+        }
+}
+
+/// unpacks one v210 block (6 pixels) to luma and interleaved chroma (Cb0 Cr0 Cb1 Cr1 Cb2 Cr2)
+static inline void
+v210_unpack_block(const uint32_t *in, uint16_t *luma, uint16_t *cbcr)
+{
+        cbcr[0] = in[0] & 0x3FFU;
+        luma[0] = in[0] >> 10U & 0x3FFU;
+        cbcr[1] = in[0] >> 20U & 0x3FFU;
+        luma[1] = in[1] & 0x3FFU;
+        cbcr[2] = in[1] >> 10U & 0x3FFU;
+        luma[2] = in[1] >> 20U & 0x3FFU;
+        cbcr[3] = in[2] & 0x3FFU;
+        luma[3] = in[2] >> 10U & 0x3FFU;
+        cbcr[4] = in[2] >> 20U & 0x3FFU;
+        luma[4] = in[3] & 0x3FFU;
+        cbcr[5] = in[3] >> 10U & 0x3FFU;
+        luma[5] = in[3] >> 20U & 0x3FFU;
+}
+
+/// average of 10-bit v210 components at position shift of 2 words, scaled to P010
+#define V210_AVG(a, b, shift) \
+        (uint16_t) ((((a) >> (shift) & 0x3FFU) + ((b) >> (shift) & 0x3FFU) + 1) / 2 << 6U)
+
+/**
+ * Converts v210 to P010, chroma of each line pair is averaged.
+ * @note odd width is not supported (last chroma column is omitted)
+ */
+void
+v210_to_p010(int width, int height, const unsigned char *in,
+             unsigned char *out)
+{
+        const ptrdiff_t v210_linesize = vc_get_linesize(width, v210);
+        uint16_t *const out_y         = (uint16_t *)(void *) out;
+        uint16_t *const out_cbcr      = out_y + (ptrdiff_t) width * height;
+        for (ptrdiff_t y = 0; y < height; y += 2) {
+                const uint32_t *src0 = (const uint32_t *)(const void *) (in + y * v210_linesize);
+                const uint32_t *src1 = y + 1 < height ? src0 + v210_linesize / 4 : src0;
+                uint16_t *dst_y0   = out_y + y * width;
+                uint16_t *dst_y1   = y + 1 < height ? dst_y0 + width : dst_y0;
+                uint16_t *dst_cbcr = out_cbcr + (y / 2) * width;
+                int x = 0;
+                for (; x + 6 <= width; x += 6) { // full blocks
+                        *dst_y0++ = src0[0] >> 4U & 0xFFC0U;
+                        *dst_y0++ = src0[1] << 6U & 0xFFC0U;
+                        *dst_y0++ = src0[1] >> 14U & 0xFFC0U;
+                        *dst_y0++ = src0[2] >> 4U & 0xFFC0U;
+                        *dst_y0++ = src0[3] << 6U & 0xFFC0U;
+                        *dst_y0++ = src0[3] >> 14U & 0xFFC0U;
+                        *dst_y1++ = src1[0] >> 4U & 0xFFC0U;
+                        *dst_y1++ = src1[1] << 6U & 0xFFC0U;
+                        *dst_y1++ = src1[1] >> 14U & 0xFFC0U;
+                        *dst_y1++ = src1[2] >> 4U & 0xFFC0U;
+                        *dst_y1++ = src1[3] << 6U & 0xFFC0U;
+                        *dst_y1++ = src1[3] >> 14U & 0xFFC0U;
+                        *dst_cbcr++ = V210_AVG(src0[0], src1[0], 0U);
+                        *dst_cbcr++ = V210_AVG(src0[0], src1[0], 20U);
+                        *dst_cbcr++ = V210_AVG(src0[1], src1[1], 10U);
+                        *dst_cbcr++ = V210_AVG(src0[2], src1[2], 0U);
+                        *dst_cbcr++ = V210_AVG(src0[2], src1[2], 20U);
+                        *dst_cbcr++ = V210_AVG(src0[3], src1[3], 10U);
+                        src0 += 4;
+                        src1 += 4;
+                }
+                if (x < width) { // incomplete last block
+                        uint16_t luma0[6], luma1[6], cbcr0[6], cbcr1[6];
+                        v210_unpack_block(src0, luma0, cbcr0);
+                        v210_unpack_block(src1, luma1, cbcr1);
+                        const int count = width - x;
+                        for (int i = 0; i < count; ++i) {
+                                *dst_y0++ = luma0[i] << 6U;
+                                *dst_y1++ = luma1[i] << 6U;
+                        }
+                        for (int i = 0; i < (count & ~1); ++i) {
+                                *dst_cbcr++ = (cbcr0[i] + cbcr1[i] + 1) / 2 << 6U;
+                        }
+                }
+        }
+}
+
+/// @note width must be at least 2, odd width is not supported
+void
+p010_to_v210(int width, int height, const unsigned char *in,
+             unsigned char *out)
+{
+        const ptrdiff_t       v210_linesize = vc_get_linesize(width, v210);
+        const uint16_t *const in_y          = (const uint16_t *)(const void *) in;
+        const uint16_t *const in_cbcr       = in_y + (ptrdiff_t) width * height;
+        const int             chroma_width  = width & ~1;
+        for (ptrdiff_t y = 0; y < height; ++y) {
+                const uint16_t *src_y    = in_y + y * width;
+                const uint16_t *src_cbcr = in_cbcr + (y / 2) * width;
+                uint32_t       *dst      = (uint32_t *)(void *) (out + y * v210_linesize);
+                int x = 0;
+                for (; x + 6 <= width; x += 6) { // full blocks
+                        *dst++ = src_cbcr[0] >> 6U | (uint32_t) (src_y[0] >> 6U) << 10U | (uint32_t) (src_cbcr[1] >> 6U) << 20U;
+                        *dst++ = src_y[1] >> 6U | (uint32_t) (src_cbcr[2] >> 6U) << 10U | (uint32_t) (src_y[2] >> 6U) << 20U;
+                        *dst++ = src_cbcr[3] >> 6U | (uint32_t) (src_y[3] >> 6U) << 10U | (uint32_t) (src_cbcr[4] >> 6U) << 20U;
+                        *dst++ = src_y[4] >> 6U | (uint32_t) (src_cbcr[5] >> 6U) << 10U | (uint32_t) (src_y[5] >> 6U) << 20U;
+                        src_y += 6;
+                        src_cbcr += 6;
+                }
+                if (x < width) { // incomplete last block is padded with the last pixel
+                        uint32_t luma[6];
+                        uint32_t cbcr[6];
+                        for (int i = 0; i < 6; ++i) {
+                                luma[i] = src_y[MIN(i, width - x - 1)] >> 6U;
+                                cbcr[i] = src_cbcr[x + i < chroma_width ? i : chroma_width - x - 2 + (i & 1)] >> 6U;
+                        }
+                        *dst++ = cbcr[0] | luma[0] << 10U | cbcr[1] << 20U;
+                        *dst++ = luma[1] | cbcr[2] << 10U | luma[2] << 20U;
+                        *dst++ = cbcr[3] | luma[3] << 10U | cbcr[4] << 20U;
+                        *dst++ = luma[4] | cbcr[5] << 10U | luma[5] << 20U;
+                }
+        }
+}
+
 struct pixfmt_desc get_pixfmt_desc(codec_t pixfmt)
 {
         assert(pixfmt >= VIDEO_CODEC_FIRST && pixfmt < VIDEO_CODEC_END);
@@ -100,6 +100,7 @@ bool codec_is_in_set(codec_t codec, const codec_t *set) __attribute__((pure));
 bool codec_is_const_size(codec_t codec) __attribute__((const));
 bool codec_is_hw_accelerated(codec_t codec) __attribute__((const));
 bool codec_is_planar(codec_t codec) __attribute__((const));
+int codec_planar_sample_size(codec_t codec) __attribute__((const));
 
 void vc_deinterlace(unsigned char *src, long src_linesize, int lines);
 bool vc_deinterlace_ex(codec_t codec, unsigned char *src, size_t src_linesize, unsigned char *dst, size_t dst_pitch, size_t lines);
@@ -123,6 +124,14 @@ void i422_8_to_uyvy(int width, int height, const unsigned char *in,
                     unsigned char *out);
 void i444_8_to_uyvy(int width, int height, const unsigned char *in,
                     unsigned char *out);
+void uyvy_to_nv12(int width, int height, const unsigned char *in,
+                  unsigned char *out);
+void nv12_to_uyvy(int width, int height, const unsigned char *in,
+                  unsigned char *out);
+void v210_to_p010(int width, int height, const unsigned char *in,
+                  unsigned char *out);
+void p010_to_v210(int width, int height, const unsigned char *in,
+                  unsigned char *out);
 
 #ifdef __cplusplus
 }
@@ -37,6 +37,7 @@
 
 #define __STDC_CONSTANT_MACROS
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cinttypes>
@@ -69,6 +70,7 @@
 #include "utils/color_out.h"
 #include "utils/macros.h"
 #include "utils/misc.h"
+#include "utils/overload_ctl.h"
 #include "utils/string.h" // replace_all
 #include "utils/text.h"
 #include "video.h"
@@ -122,6 +124,8 @@ enum {
 
 constexpr const codec_t DEFAULT_CODEC       = MJPG;
 constexpr const int     DEFAULT_GOP_SIZE    = 20;
+constexpr const int     GOP_INFINITE        = 1 << 30; ///< keyframes only on receivers' requests
+constexpr const time_ns_t MIN_COMPLEXITY_SWITCH_INTERVAL = 2 * NS_IN_SEC; ///< reopening blocks the encoding
 constexpr int           DEFAULT_SLICE_COUNT = 32;
 
 constexpr const char *DEFAULT_AMF_RC        = "cqp";
@@ -186,7 +190,9 @@ static void print_codec_aux_usage(string const &name);
 static bool show_coder_help(string const &name, bool encoder = true);
 static void print_codec_supp_pix_fmts(const enum AVPixelFormat *first);
 void usage(bool full);
-static void cleanup(struct state_video_compress_libav *s);
+static void cleanup(struct state_video_compress_libav *s, bool keep_packets = false);
+static bool configure_with(struct state_video_compress_libav *s, struct video_desc desc);
+static void set_complexity(struct state_video_compress_libav *s);
 
 static map<codec_t, codec_params_t> codec_params = {
         { H264, codec_params_t{
@@ -253,6 +259,19 @@ static map<codec_t, codec_params_t> codec_params = {
         }},
 };
 
+/// encoder speed settings ordered from the slowest (best quality) to the fastest
+struct complexity_ladder {
+        const char *encoder_prefix;
+        const char *opt;
+        std::vector<const char *> steps;
+};
+static const complexity_ladder complexity_ladders[] = {
+        { "libx26", "preset", { "medium", "fast", "faster", "veryfast", "superfast", "ultrafast" } },
+        { "libsvtav1", "preset", { "6", "7", "8", "9", "10", "11", "12" } },
+        { "libaom-av1", "cpu-used", { "4", "5", "6", "7", "8" } },
+        { "libvpx", "cpu-used", { "4", "5", "6", "7", "8" } },
+};
+
 struct aux_header {
         char   buf[1024]{};
         size_t buf_len = 0;
@@ -309,6 +328,17 @@ struct state_video_compress_libav {
         time_ns_t duration_warn_last_print = 0;
         int64_t   max_pts_diff_reported    = 0;
 
+        struct {
+                bool enabled = false;
+                bool switching = false; ///< encoder is being reopened with a new step
+                const complexity_ladder *ladder = nullptr; ///< nullptr if adaptation not active
+                int applied = 0; ///< ladder step the encoder currently runs with
+                int switches = 0;
+                time_ns_t last_switch = 0;
+                struct overload_ctl ctl{}; ///< ctl.level is the requested ladder step
+        } complexity;
+        list<shared_ptr<video_frame>> drained; ///< output of the encoder closed by a complexity switch
+
         map<int64_t, char[VF_METADATA_SIZE]> metadata_storage;
 };
 
@@ -397,9 +427,9 @@ void usage(bool full) {
                                ":bitrate=<bits_per_sec>|:bpp=<bits_per_pixel>|:"
                                "crf=<crf>|:cqp=<cqp>]\n\t\t[:subsampling=<"
                                "subsampling>][:depth=<depth>"
-                               "][:rgb|:yuv][:gop=<gop>]\n\t\t"
+                               "][:rgb|:yuv][:gop=<gop>|inf]\n\t\t"
                                "[:[disable_]intra_refresh][:threads=<threads>]["
-                               ":slices=<slices>][safe]\n\t\t[:<lavc_opt>=<val>]*")
+                               ":slices=<slices>][safe][:adapt]\n\t\t[:<lavc_opt>=<val>]*")
               << "\n\t" << SBOLD(SRED("-c libavcodec") << ":[full]help") << "\n";
         col() << "\nwhere\n";
         col() << "\t" << SBOLD("<encoder>") << " specifies encoder (eg. nvenc or libx264 for H.264)\n";
@@ -420,9 +450,10 @@ void usage(bool full) {
         col() << "\t" << SBOLD("<threads>") << " can be \"no\", or \"<number>[F][S][n]\" where 'F'/'S' indicate if frame/slice thr. should be used, both can be used (default slice), 'n' means none;\n";
         col() << "\t" <<       "         "  << " use a comma to add also number of conversion threads (eg. \"0S,8\"), default: number of logical cores\n";
         col() << "\t" << SBOLD("<slices>") << " number of slices to use (default: " << DEFAULT_SLICE_COUNT << ")\n";
-        col() << "\t" << SBOLD("<gop>") << " specifies GOP size\n";
+        col() << "\t" << SBOLD("<gop>") << " specifies GOP size, \"inf\" for no periodic keyframes (sent only when requested by receivers with RTCP PLI/FIR)\n";
         col() << "\t" << SBOLD("<lavc_opt>") << " arbitrary option to be passed directly to libavcodec (eg. preset=veryfast), eventual colons must be backslash-escaped (eg. for x264opts)\n";
         col() << "\t" << SBOLD("safe") << " use opts for (HW) decode compatibility - 420, no intra refresh and interlacing\n";
+        col() << "\t" << SBOLD("adapt") << " adapt encoder speed preset to the frame deadline (x264/x265, SVT-AV1, AOM AV1, libvpx), switched at GOP boundaries\n";
         if (full) {
                 col() << "\t" << SBOLD("header_inserter[=no]")
                       << " repeat H.264/HEVC VPS/SPS/PPS hdrs (fixes problems "
@@ -590,7 +621,9 @@ parse_fmt(struct state_video_compress_libav *s, char *fmt) noexcept(false)
                         s->params.slices = stoi(slices);
                 } else if(strncasecmp("gop=", item, strlen("gop=")) == 0) {
                         char *gop = item + strlen("gop=");
-                        s->requested_gop = atoi(gop);
+                        s->requested_gop = strcasecmp(gop, "inf") == 0 ? GOP_INFINITE : atoi(gop);
+                } else if (strcmp(item, "adapt") == 0) {
+                        s->complexity.enabled = true;
                 } else if (strstr(item, "header_inserter") == item) {
                         s->params.header_inserter_req =
                             strstr(item, "=no") == nullptr ? 1 : 0;
@@ -812,6 +845,16 @@ static inline bool check_av_opt_set(void *priv_data, const char *key, T val, con
         return true;
 }
 
+/**
+ * Keyframes forced on receiver request (PLI/FIR) must be IDR, otherwise the
+ * receiver cannot start decoding from them.
+ * @param opt_name encoder private option name ("forced-idr" or "forced_idr")
+ */
+static void set_forced_idr(AVCodecContext *codec_ctx, const char *opt_name)
+{
+        check_av_opt_set<int>(codec_ctx->priv_data, opt_name, 1);
+}
+
 /// @param requested_cqp requested CQP value if >= 0, autoselect if -1
 static void set_cqp(struct AVCodecContext *codec_ctx, int requested_cqp) {
         int cqp = requested_cqp;
@@ -913,6 +956,7 @@ bool set_codec_ctx_params(struct state_video_compress_libav *s, AVPixelFormat pi
                         return false;
                 }
         }
+        set_complexity(s);
 
         return true;
 }
@@ -968,6 +1012,72 @@ void apply_blacklist([[maybe_unused]] list<enum AVPixelFormat> &formats, [[maybe
 #endif
 }
 
+/**
+ * If reopening because of complexity change, sets the requested ladder step.
+ * Otherwise (re)initializes the adaptation starting from the step selected by
+ * setparam or the user.
+ */
+static void set_complexity(struct state_video_compress_libav *s)
+{
+        auto &c = s->complexity;
+        if (!c.enabled) {
+                return;
+        }
+        if (c.switching) {
+                check_av_opt_set<const char *>(s->codec_ctx->priv_data, c.ladder->opt, c.ladder->steps[c.ctl.level]);
+                return;
+        }
+        c.ladder = nullptr;
+        const char *name = s->codec_ctx->codec->name;
+        const complexity_ladder *ladder = nullptr;
+        for (auto const &l : complexity_ladders) {
+                if (strstr(name, l.encoder_prefix) == name) {
+                        ladder = &l;
+                }
+        }
+        if (ladder == nullptr) {
+                MSG(WARNING, "Complexity adaptation not supported for encoder %s!\n", name);
+                return;
+        }
+        uint8_t *val = nullptr;
+        if (av_opt_get(s->codec_ctx->priv_data, ladder->opt, 0, &val) < 0) {
+                MSG(WARNING, "Cannot get %s of %s, not adapting complexity!\n", ladder->opt, name);
+                return;
+        }
+        auto it = std::find_if(ladder->steps.begin(), ladder->steps.end(),
+                          [&](const char *step) { return strcmp(step, (char *) val) == 0; });
+        if (it == ladder->steps.end()) {
+                MSG(WARNING, "%s=%s is not in the adaptation ladder, not adapting complexity!\n", ladder->opt, (char *) val);
+                av_free(val);
+                return;
+        }
+        av_free(val);
+        c.ladder = ladder;
+        overload_ctl_init(&c.ctl, (int) ladder->steps.size() - 1);
+        c.ctl.level = c.applied = (int) (it - ladder->steps.begin());
+}
+
+/// reopens the encoder with the requested complexity step (done at GOP boundary)
+static bool switch_complexity(struct state_video_compress_libav *s, struct video_desc desc)
+{
+        auto &c = s->complexity;
+        const int old_step = c.applied;
+        c.switching = true;
+        cleanup(s, true);
+        const bool ret = configure_with(s, desc);
+        c.switching = false;
+        c.last_switch = get_time_in_ns();
+        if (!ret) {
+                return false;
+        }
+        c.applied = c.ctl.level;
+        c.switches += 1;
+        MSG(NOTICE, "Complexity adaptation: %s %s -> %s at frame %" PRId64 " (load %.0f%%, switch #%d)\n",
+            c.ladder->opt, c.ladder->steps[old_step], c.ladder->steps[c.applied], s->cur_pts, 100.0 * c.ctl.load,
+            c.switches);
+        return true;
+}
+
 static bool try_open_codec(struct state_video_compress_libav *s,
                            AVPixelFormat &pix_fmt,
                            struct video_desc desc,
@@ -1409,6 +1519,7 @@ auto out_vf_from_pkt(state_video_compress_libav *s, AVPacket *pkt) {
         }
 
         restore_metadata(s, out.get(), pkt->pts);
+        out->frame_type = (pkt->flags & AV_PKT_FLAG_KEY) != 0 ? INTRA : OTHER;
         out->tiles[0].data_len = s->aux_header.buf_len + pkt->size;
         out->tiles[0].data     = (char *) malloc(out->tiles[0].data_len);
         memcpy(out->tiles[0].data, s->aux_header.buf, s->aux_header.buf_len);
@@ -1426,6 +1537,11 @@ auto out_vf_from_pkt(state_video_compress_libav *s, AVPacket *pkt) {
 shared_ptr<video_frame>
 receive_packet(state_video_compress_libav *s)
 {
+        if (!s->drained.empty()) { // precede the output of the current encoder
+                shared_ptr<video_frame> out = s->drained.front();
+                s->drained.pop_front();
+                return out;
+        }
         const int ret = avcodec_receive_packet(s->codec_ctx, s->pkt);
         if (ret != 0) {
                 if (ret == AVERROR(EAGAIN)) {
@@ -1468,6 +1584,16 @@ static shared_ptr<video_frame> libavcodec_compress_tile(struct module *mod, shar
                 return receive_packet(s);
         }
 
+        // switch at GOP boundaries only (at most every DEFAULT_GOP_SIZE frames if the encoder decides)
+        const int switch_interval = s->requested_gop > 0 ? s->requested_gop : DEFAULT_GOP_SIZE;
+        if (s->complexity.ladder != nullptr && s->complexity.ctl.level != s->complexity.applied &&
+            get_time_in_ns() - s->complexity.last_switch >= MIN_COMPLEXITY_SWITCH_INTERVAL &&
+            (s->cur_pts % switch_interval == 0 || (tx->flags & VF_FORCE_KEYFRAME) != 0)) {
+                if (!switch_complexity(s, video_desc_from_frame(tx.get()))) {
+                        return {};
+                }
+        }
+
         time_ns_t t0 = get_time_in_ns();
         struct AVFrame *frame = to_lavc_vid_conv(s->pixfmt_conversion, tx->tiles[0].data);
         if (!frame) {
@@ -1499,6 +1625,7 @@ static shared_ptr<video_frame> libavcodec_compress_tile(struct module *mod, shar
 
         /* encode the image */
         frame->pts = s->cur_pts++;
+        frame->pict_type = (tx->flags & VF_FORCE_KEYFRAME) != 0 ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
         store_metadata(s, tx.get(), frame->pts);
         if (int ret = avcodec_send_frame(s->codec_ctx, frame)) {
                 print_libav_error(LOG_LEVEL_WARNING, "[lavc] Error encoding frame", ret);
@@ -1512,6 +1639,11 @@ static shared_ptr<video_frame> libavcodec_compress_tile(struct module *mod, shar
                 " s, dump+swscale " << (t2 - t1) / (double) NS_IN_SEC <<
                 " s, compression " << (t3 - t2) / (double) NS_IN_SEC << " s\n";
         check_duration(s, t1 - t0, t3 - t0);
+        if (s->complexity.ladder != nullptr &&
+            overload_ctl_update(&s->complexity.ctl, t0, t3, (time_ns_t) (NS_IN_SEC_DBL / s->compressed_desc.fps))) {
+                MSG(VERBOSE, "Encoding load %.0f%%, switching to %s=%s at next GOP.\n", 100.0 * s->complexity.ctl.load,
+                    s->complexity.ladder->opt, s->complexity.ladder->steps[s->complexity.ctl.level]);
+        }
 
         if (!out) {
                 return {};
@@ -1524,7 +1656,12 @@ static shared_ptr<video_frame> libavcodec_compress_tile(struct module *mod, shar
         return out;
 }
 
-static void cleanup(struct state_video_compress_libav *s)
+/**
+ * @param keep_packets keep the frames still buffered in the encoder in
+ *                     s->drained to be returned by receive_packet()
+ *                     (otherwise they are discarded)
+ */
+static void cleanup(struct state_video_compress_libav *s, bool keep_packets)
 {
         if(s->codec_ctx) {
 		int ret = avcodec_send_frame(s->codec_ctx, NULL);
@@ -1533,10 +1670,14 @@ static void cleanup(struct state_video_compress_libav *s)
 					ret);
 		}
 		do {
-			AVPacket *pkt = av_packet_alloc();
-			ret = avcodec_receive_packet(s->codec_ctx, pkt);
-			av_packet_unref(pkt);
-			av_packet_free(&pkt);
+			ret = avcodec_receive_packet(s->codec_ctx, s->pkt);
+			if (ret == 0 && keep_packets) {
+				shared_ptr<video_frame> out = out_vf_from_pkt(s, s->pkt);
+				if (out) {
+					s->drained.push_back(std::move(out));
+				}
+			}
+			av_packet_unref(s->pkt);
 			if (ret != 0 && ret != AVERROR_EOF) {
 				log_msg(LOG_LEVEL_WARNING, "[lavc] Unexpected return value %d\n",
 						ret);
@@ -1559,6 +1700,10 @@ static void libavcodec_compress_done(struct module *mod)
 {
         struct state_video_compress_libav *s = (struct state_video_compress_libav *) mod->priv_data;
 
+        if (s->complexity.ladder != nullptr) {
+                MSG(INFO, "Complexity adaptation: %d switches, last %s=%s.\n", s->complexity.switches,
+                    s->complexity.ladder->opt, s->complexity.ladder->steps[s->complexity.applied]);
+        }
         cleanup(s);
 
         delete s;
@@ -1690,6 +1835,9 @@ static void configure_amf([[maybe_unused]] AVCodecContext *codec_ctx, [[maybe_un
                                       ? DEFAULT_AMF_USAGE_AV1
                                       : DEFAULT_AMF_USAGE;
         check_av_opt_set(codec_ctx->priv_data, "usage", usage);
+        if (codec_ctx->codec->id != AV_CODEC_ID_AV1) {
+                set_forced_idr(codec_ctx, "forced_idr");
+        }
         if (codec_ctx->codec->id == AV_CODEC_ID_AV1 ||
             codec_ctx->codec->id == AV_CODEC_ID_HEVC) {
                 check_av_opt_set<const char *>(codec_ctx->priv_data, "header_insertion_mode", "gop", "header_insertion_mode for AMF");
@@ -1780,6 +1928,7 @@ configure_x264_x265(AVCodecContext *codec_ctx, struct setparam_param *param)
 
         const char *tune = codec_ctx->codec->id == AV_CODEC_ID_H264 ? "zerolatency,fastdecode" : "zerolatency"; // x265 supports only single tune parameter
         check_av_opt_set<const char *>(codec_ctx->priv_data, "tune", tune);
+        set_forced_idr(codec_ctx, "forced-idr");
 
         // try to keep frame sizes as even as possible
         codec_ctx->rc_max_rate = codec_ctx->bit_rate;
@@ -1841,6 +1990,7 @@ static void configure_qsv_h264_hevc(AVCodecContext *codec_ctx, struct setparam_p
                                        DEFAULT_QSV_PRESET);
         check_av_opt_set<const char *>(codec_ctx->priv_data, "scenario", "livestreaming");
         check_av_opt_set<int>(codec_ctx->priv_data, "async_depth", 1);
+        set_forced_idr(codec_ctx, "forced_idr");
 
         if (param->periodic_intra != 0) {
                 incomp_feature_warn(INCOMP_INTRA_REFRESH, param->periodic_intra);
@@ -1913,7 +2063,7 @@ static void configure_nvenc(AVCodecContext *codec_ctx, struct setparam_param *pa
                 }
         }
 
-        check_av_opt_set(codec_ctx->priv_data, "forced-idr", 1);
+        set_forced_idr(codec_ctx, "forced-idr");
 #ifdef PATCHED_FF_NVENC_NO_INFINITE_GOP
         const bool patched_ff = true;
 #else
@@ -61,6 +61,16 @@ struct state_decompress;
  * can be passed to decompressor. Otherwise, broken frame is discarded.
  */
 #define DECOMPRESS_PROPERTY_ACCEPTS_CORRUPTED_FRAME  1          /* int */
+/**
+ * Current quality degradation level the decompressor applies to keep up
+ * with the incoming frame rate (0 - none).
+ */
+#define DECOMPRESS_PROPERTY_DEGRADATION_LEVEL        2          /* int */
+/**
+ * Decompressor lost its reference (decode error, missing parameter sets) and
+ * needs a keyframe to recover. The property is reset when read.
+ */
+#define DECOMPRESS_PROPERTY_KEYFRAME_NEEDED          3          /* int */
 
 /**
  * initializes decompression and returns internal state
@@ -4,7 +4,8 @@
  *
  * implementation of I420->UYVY "decompression", because for the planar
  * format there is no line decoder and when the display iw unable to display
- * I420 directly, it is not possible to present it.
+ * I420 directly, it is not possible to present it. Semi-planar NV12 and P010
+ * are handled the same way (to UYVY and v210 respectively).
  *
  * As this is implementation is quite short, it can also hold as a decompress
  * module template.
@@ -67,8 +68,8 @@ i420_decompress_reconfigure(void *state, struct video_desc desc, int rshift,
                             codec_t out_codec)
 {
         (void) rshift, (void) gshift, (void) bshift;
-        assert(out_codec == UYVY);
-        assert(pitch == (int) desc.width * 2); // implement other ir needed
+        assert(out_codec == (desc.color_spec == P010 ? v210 : UYVY));
+        assert(pitch == vc_get_linesize(desc.width, out_codec)); // implement other ir needed
         struct i420_decompress_state *s = state;
         s->desc                         = desc;
         return true;
@@ -83,7 +84,16 @@ i420_decompress(void *state, unsigned char *dst, unsigned char *buffer,
         (void) src_len, (void) frame_seq, (void) callbacks,
             (void) internal_prop;
         struct i420_decompress_state *s = state;
-        i420_8_to_uyvy((int) s->desc.width, (int) s->desc.height, buffer, dst);
+        switch (s->desc.color_spec) {
+        case NV12:
+                nv12_to_uyvy((int) s->desc.width, (int) s->desc.height, buffer, dst);
+                break;
+        case P010:
+                p010_to_v210((int) s->desc.width, (int) s->desc.height, buffer, dst);
+                break;
+        default:
+                i420_8_to_uyvy((int) s->desc.width, (int) s->desc.height, buffer, dst);
+        }
         return DECODER_GOT_FRAME;
 }
 
@@ -117,7 +127,10 @@ i420_decompress_get_priority(codec_t compression, struct pixfmt_desc internal,
                 PRIO_NORMAL = 500,
         };
         // probing (ugc==VC_NONE) is skipped (optional, not necessary)
-        return compression == I420 && ugc == UYVY ? PRIO_NORMAL : PRIO_NA;
+        return ((compression == I420 || compression == NV12) && ugc == UYVY) ||
+                       (compression == P010 && ugc == v210)
+                   ? PRIO_NORMAL
+                   : PRIO_NA;
 }
 
 static const struct video_decompress_info i420_info = {
@@ -58,6 +58,7 @@
 #include "rtp/rtpenc_h264.h"
 #include "tv.h"
 #include "utils/macros.h"
+#include "utils/overload_ctl.h"
 #include "video.h"
 #include "video_codec.h"
 #include "video_decompress.h"
@@ -97,10 +98,13 @@ struct state_libavcodec_decompress {
         struct hw_accel_state hwaccel;
 
         _Bool sps_vps_found; ///< to avoid initial error flood, start decoding after SPS (H.264) or VPS (HEVC) was received
+        _Bool keyframe_needed; ///< reference lost, reported (and reset) by DECOMPRESS_PROPERTY_KEYFRAME_NEEDED
 
         double    mov_avg_comp_duration;
         long long mov_avg_frames;
         time_ns_t duration_warn_last_print;
+
+        struct overload_ctl overload; ///< drives skipping of non-ref frames when the decoder cannot keep up
 };
 
 static enum AVPixelFormat get_format_callback(struct AVCodecContext *s, const enum AVPixelFormat *fmt);
@@ -333,6 +337,45 @@ ADD_TO_PARAM("use-hw-accel", "* use-hw-accel[=<api>|help]\n"
         "  Try to use hardware accelerated decoding with lavd "
         "(NVDEC/VAAPI/VDPAU/VideoToolbox).\n"
         "  Optionally with enforced API option.\n");
+
+#define DEFAULT_MAX_DEGRADATION 3
+static const struct {
+        enum AVDiscard skip_loop_filter;
+        enum AVDiscard skip_frame;
+        const char *desc;
+} degradation_levels[] = {
+        { AVDISCARD_DEFAULT, AVDISCARD_DEFAULT, "full quality" },
+        { AVDISCARD_NONREF, AVDISCARD_DEFAULT, "no deblocking of non-ref frames" },
+        { AVDISCARD_NONREF, AVDISCARD_NONREF, "skipping non-ref frames" },
+        { AVDISCARD_ALL, AVDISCARD_NONREF, "skipping non-ref frames, no deblocking" },
+};
+
+ADD_TO_PARAM("lavd-max-degradation", "* lavd-max-degradation=<level>\n"
+                "  Max quality degradation level (0-3, default " TOSTRING(DEFAULT_MAX_DEGRADATION) ") used when decoder cannot keep up:\n"
+                "  1 - no deblocking of non-ref frames, 2 - skip non-ref frames, 3 - no deblocking at all; 0 disables\n");
+static void apply_degradation(struct state_libavcodec_decompress *s)
+{
+        if (s->codec_ctx == NULL) {
+                return;
+        }
+        s->codec_ctx->skip_loop_filter = degradation_levels[s->overload.level].skip_loop_filter;
+        s->codec_ctx->skip_frame = degradation_levels[s->overload.level].skip_frame;
+}
+
+static void update_degradation(struct state_libavcodec_decompress *s, time_ns_t start, time_ns_t end)
+{
+        const time_ns_t frame_interval = s->desc.fps > 0 ? (time_ns_t) (NS_IN_SEC_DBL / s->desc.fps) : 0;
+        const int old_level = s->overload.level;
+        if (!overload_ctl_update(&s->overload, start, end, frame_interval)) {
+                return;
+        }
+        apply_degradation(s);
+        log_msg(s->overload.level > old_level ? LOG_LEVEL_WARNING : LOG_LEVEL_NOTICE,
+            MOD_NAME "Decoder load %.0f%%, %s degradation level to %d (%s).\n", 100.0 * s->overload.load,
+            s->overload.level > old_level ? "raising" : "lowering", s->overload.level,
+            degradation_levels[s->overload.level].desc);
+}
+
 static bool configure_with(struct state_libavcodec_decompress *s,
                 struct video_desc desc, void *extradata, int extradata_size)
 {
@@ -409,6 +452,7 @@ static bool configure_with(struct state_libavcodec_decompress *s,
         }
 
         s->pkt = av_packet_alloc();
+        apply_degradation(s);
 
         return true;
 }
@@ -476,6 +520,10 @@ static int libavcodec_decompress_reconfigure(void *state, struct video_desc desc
         }
         s->out_codec = out_codec;
         s->desc = desc;
+        const char *max_degradation = get_commandline_param("lavd-max-degradation");
+        overload_ctl_init(&s->overload, max_degradation != NULL
+                        ? CLAMP(atoi(max_degradation), 0, (int) (sizeof degradation_levels / sizeof degradation_levels[0]) - 1)
+                        : DEFAULT_MAX_DEGRADATION);
 
         deconfigure(s);
         if (libav_codec_has_extradata(desc.color_spec)) {
@@ -955,6 +1003,9 @@ handle_lavd_error(const char *prefix, struct state_libavcodec_decompress *s,
                   int ret)
 {
         print_decoder_error(prefix, ret);
+        if (ret != AVERROR(EAGAIN)) {
+                s->keyframe_needed = true;
+        }
         if(ret == AVERROR(EIO)){
                 s->consecutive_failed_decodes++;
                 if(s->consecutive_failed_decodes > 70 && !s->block_accel[s->hwaccel.type]){
@@ -1040,6 +1091,7 @@ static decompress_status libavcodec_decompress(void *state, unsigned char *dst,
                         return DECODER_GOT_CODEC;
                 }
                 if (!check_first_sps_vps(s, src, src_len)) {
+                        s->keyframe_needed = true;
                         return DECODER_NO_FRAME;
                 }
         }
@@ -1059,10 +1111,14 @@ static decompress_status libavcodec_decompress(void *state, unsigned char *dst,
         time_ns_t t0 = get_time_in_ns();
 
         if (!decode_frame(s, src, src_len)) {
+                update_degradation(s, t0, get_time_in_ns());
                 log_msg(LOG_LEVEL_DEBUG, MOD_NAME "No frame was decoded!\n");
                 return DECODER_NO_FRAME;
         }
         s->consecutive_failed_decodes = 0;
+        if (s->frame->decode_error_flags != 0) {
+                s->keyframe_needed = true;
+        }
 
         time_ns_t t1 = get_time_in_ns();
 
@@ -1084,6 +1140,7 @@ static decompress_status libavcodec_decompress(void *state, unsigned char *dst,
         log_msg(LOG_LEVEL_DEBUG, MOD_NAME "Decompressing %c frame took %f ms, pixfmt change %f ms.\n", av_get_picture_type_char(s->frame->pict_type),
                 (t1 - t0) / NS_IN_MS_DBL, (t2 - t1) / NS_IN_MS_DBL);
         check_duration(s, (t2 - t0) / NS_IN_SEC_DBL, (t2 - t1) / NS_IN_MS_DBL);
+        update_degradation(s, t0, t2);
 
         if (s->out_codec == VIDEO_CODEC_NONE) {
                 log_msg(LOG_LEVEL_VERBOSE,
@@ -1124,6 +1181,23 @@ static int libavcodec_decompress_get_property(void *state, int property, void *v
                                         strcmp(get_commandline_param("lavd-accept-corrupted"), "no") != 0;
                         }
 
+                        *len = sizeof(int);
+                        ret = true;
+                        break;
+                case DECOMPRESS_PROPERTY_DEGRADATION_LEVEL:
+                        if (*len < sizeof(int)) {
+                                return false;
+                        }
+                        *(int *) val = s->overload.level;
+                        *len = sizeof(int);
+                        ret = true;
+                        break;
+                case DECOMPRESS_PROPERTY_KEYFRAME_NEEDED:
+                        if (*len < sizeof(int)) {
+                                return false;
+                        }
+                        *(int *) val = s->keyframe_needed;
+                        s->keyframe_needed = false;
                         *len = sizeof(int);
                         ret = true;
                         break;
@@ -58,7 +58,7 @@
 #define DEFAULT_DUMP_LEN 32
 #define MOD_NAME "[dummy] "
 
-static const codec_t default_codecs[] = {I420, UYVY, YUYV, v210, R10k, R12L, RGBA, RGB, BGR, RG48};
+static const codec_t default_codecs[] = {I420, NV12, P010, UYVY, YUYV, v210, R10k, R12L, RGBA, RGB, BGR, RG48};
 
 static const codec_t codecs_decklink[] = { R12L, R10k, v210, RGBA, UYVY };
 static const codec_t codecs_gl[] = { UYVY, v210, R10k, RGBA, RGB, RG48, Y416, DXT1, DXT1_YUV, DXT5 };
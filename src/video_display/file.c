@@ -279,7 +279,27 @@ display_file_getf(void *state)
         frame->format  = get_ug_to_av_pixfmt(s->video_desc.color_spec);
         frame->width  = (int) s->video_desc.width;
         frame->height = (int) s->video_desc.height;
-        int ret       = av_frame_get_buffer(frame, 0);
+        int ret       = 0;
+        if (codec_is_planar(s->video_desc.color_spec)) {
+                // UG planar frames (eg. NV12, P010) are contiguous - the
+                // AVFrame planes point to a single buffer
+                frame->buf[0] = av_buffer_alloc(
+                    (int) vc_get_datalen(s->video_desc.width,
+                                         s->video_desc.height,
+                                         s->video_desc.color_spec));
+                ret = frame->buf[0] == NULL ? AVERROR(ENOMEM) : 0;
+                if (ret == 0) {
+                        buf_get_planes(frame->width, frame->height,
+                                       s->video_desc.color_spec,
+                                       (char *) frame->buf[0]->data,
+                                       (char **) frame->data);
+                        buf_get_linesizes(frame->width,
+                                          s->video_desc.color_spec,
+                                          frame->linesize);
+                }
+        } else {
+                ret = av_frame_get_buffer(frame, 0);
+        }
         if (ret < 0) {
                 error_msg(MOD_NAME "Could not allocate frame data: %s.\n",
                           av_err2str(ret));
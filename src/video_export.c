@@ -75,6 +75,8 @@ struct video_export {
                             * volatile tail;
         volatile int queue_len;
         sem_t semaphore;
+        pthread_cond_t queue_cv; ///< signalized when an entry is dequeued
+        bool blocking;
 
         struct video_desc saved_desc;
 
@@ -96,6 +98,7 @@ static void *video_export_thread(void *arg)
                         s->queue_len -= 1;
                 }
                 pthread_mutex_unlock(&s->lock);
+                pthread_cond_signal(&s->queue_cv);
 
                 assert((current->data == NULL && current->data_len == 0) ||
                                 (current->data != NULL && current->data_len != 0));
@@ -129,6 +132,7 @@ struct video_export * video_export_init(const char *path)
 
         platform_sem_init(&s->semaphore, 0, 0);
         pthread_mutex_init(&s->lock, NULL);
+        pthread_cond_init(&s->queue_cv, NULL);
         s->total = s->queue_len = 0;
         assert(path != NULL);
         s->path = strdup(path);
@@ -188,6 +192,7 @@ void video_export_destroy(struct video_export *s)
                 platform_sem_post(&s->semaphore);
 
                 pthread_join(s->thread_id, NULL);
+                pthread_cond_destroy(&s->queue_cv);
                 pthread_mutex_destroy(&s->lock);
 
                 // write summary
@@ -242,6 +247,9 @@ void video_export(struct video_export *s, struct video_frame *frame)
 
                 pthread_mutex_lock(&s->lock);
                 {
+                        while (s->blocking && s->queue_len >= MAX_QUEUE_SIZE) {
+                                pthread_cond_wait(&s->queue_cv, &s->lock);
+                        }
                         // check if we do not occupy too much memory
                         if(s->queue_len >= MAX_QUEUE_SIZE) {
                                 fprintf(stderr, "[Video export] Maximal queue size (%d) exceeded, not saving frame %d.\n",
@@ -267,3 +275,9 @@ void video_export(struct video_export *s, struct video_frame *frame)
         }
 }
 
+void video_export_set_blocking(struct video_export *s, bool blocking)
+{
+        pthread_mutex_lock(&s->lock);
+        s->blocking = blocking;
+        pthread_mutex_unlock(&s->lock);
+}
@@ -38,6 +38,10 @@
 #ifndef _VIDEO_EXPORT_H_
 #define _VIDEO_EXPORT_H_
 
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
 #define VIDEO_EXPORT_SUMMARY_VERSION 1
 
 #ifdef __cplusplus
@@ -50,6 +54,11 @@ struct video_frame;
 struct video_export * video_export_init(const char *path);
 void video_export_destroy(struct video_export *state);
 void video_export(struct video_export *state, struct video_frame *frame);
+/**
+ * If set, video_export() waits for the writer instead of dropping frames
+ * when the queue is full. Intended for exporting already buffered data.
+ */
+void video_export_set_blocking(struct video_export *state, bool blocking);
 
 #ifdef __cplusplus
 }
@@ -64,6 +64,7 @@
 #include "config_win32.h"
 #include "debug.h"
 #include "pixfmt_conv.h"
+#include "utils/mem_account.h"
 #include "utils/pam.h"
 #include "utils/y4m.h"
 #include "video_codec.h"
@@ -114,6 +115,7 @@ static void vf_aligned_data_deleter(struct video_frame *buf)
         for (unsigned int i = 0u; i < buf->tile_count; ++i) {
                 aligned_free(buf->tiles[i].data);
         }
+        mem_account_free(MEM_ACC_VIDEO_FRAME, buf->data_alloc_len);
 }
 
 /**
@@ -142,6 +144,7 @@ struct video_frame * vf_alloc_desc_data(struct video_desc desc)
                 }
                 buf->tiles[i].data = (char *) aligned_malloc(buf->tiles[i].data_len + MAX_PADDING, 1U<<21U /* 2 MiB */);
                 assert(buf->tiles[i].data != NULL);
+                buf->data_alloc_len += buf->tiles[i].data_len + MAX_PADDING;
 #ifdef __linux__
                 madvise(buf->tiles[0].data, buf->tiles[0].data_len, MADV_HUGEPAGE);
 #endif
@@ -149,6 +152,7 @@ struct video_frame * vf_alloc_desc_data(struct video_desc desc)
 
         buf->callbacks.data_deleter = vf_aligned_data_deleter;
         buf->callbacks.recycle = NULL;
+        mem_account_alloc(MEM_ACC_VIDEO_FRAME, buf->data_alloc_len);
 
         return buf;
 }
@@ -634,7 +638,8 @@ void buf_get_planes(int width, int height, codec_t color_spec, char *data, char
                 }
                 planes[i] = tmp;
                 tmp += ((width + sub[i * 2] - 1) / sub[i * 2])
-                        * ((height + sub[i * 2 + 1] - 1) / sub[i * 2 + 1]);
+                        * ((height + sub[i * 2 + 1] - 1) / sub[i * 2 + 1])
+                        * codec_planar_sample_size(color_spec);
         }
 }
 
@@ -646,7 +651,7 @@ void buf_get_linesizes(int width, codec_t color_spec, int *linesize)
                 if (sub[2 * i] == 0) {
                         break;
                 }
-                linesize[i] = (width + sub[2 * i] - 1) / sub[2 * i];
+                linesize[i] = (width + sub[2 * i] - 1) / sub[2 * i] * codec_planar_sample_size(color_spec);
         }
 }
 
@@ -53,6 +53,8 @@
 #include "tfrc.h"
 #include "transmit.h"
 #include "tv.h"
+#include "utils/macros.h"
+#include "utils/mem_account.h"
 #include "utils/thread.h"
 #include "utils/vf_split.h"
 #include "video.h"
@@ -62,6 +64,7 @@
 #include "video_rxtx.hpp"
 
 #define MOD_NAME "[vrxtx] "
+#define DEFAULT_KEYFRAME_REQ_MIN_INTERVAL_MS 500
 
 using std::map;
 using std::shared_ptr;
@@ -72,6 +75,9 @@ video_rxtx::video_rxtx(map<string, param_u> const &params): m_port_id("default")
                 m_frames_sent(0ull),
                 m_common(*static_cast<struct common_opts const *>(params.at("common").cptr)),
                 m_thread_id(), m_poisoned(false), m_joined(true) {
+        const char *min_interval = get_commandline_param("keyframe-req-min-interval");
+        m_keyframe_min_interval = (min_interval != nullptr ? atoll(min_interval)
+                        : DEFAULT_KEYFRAME_REQ_MIN_INTERVAL_MS) * 1000 * 1000;
 
         module_init_default(&m_sender_mod);
         m_sender_mod.cls = MODULE_CLASS_SENDER;
@@ -156,12 +162,39 @@ void video_rxtx::send(shared_ptr<video_frame> frame) {
         if (!frame && m_poisoned) {
                 return;
         }
+        if (frame && mem_account_over_cap(MEM_ACC_VIDEO_FRAME)) {
+                log_msg_once(LOG_LEVEL_WARNING, to_fourcc('v', 'f', 'm', 'c'), MOD_NAME "Video frame memory cap exceeded, dropping frames!\n");
+                log_msg(LOG_LEVEL_VERBOSE, MOD_NAME "Video frame memory cap exceeded, frame dropped.\n");
+                return;
+        }
+        if (frame) {
+                // capturers may reuse the frame so clear the flag from the last time
+                frame->flags &= ~VF_FORCE_KEYFRAME;
+        }
+        if (frame && m_keyframe_requested) {
+                // requests coming more often are coalesced to one keyframe
+                long long now = get_time_in_ns();
+                if (now - m_last_forced_keyframe >= m_keyframe_min_interval) {
+                        m_keyframe_requested = false;
+                        m_last_forced_keyframe = now;
+                        frame->flags |= VF_FORCE_KEYFRAME;
+                        log_msg(LOG_LEVEL_VERBOSE, MOD_NAME "Forcing keyframe.\n");
+                }
+        }
         compress_frame(m_compression, frame);
         if (!frame) {
                 m_poisoned = true;
         }
 }
 
+void video_rxtx::request_keyframe() {
+        m_keyframe_requested = true;
+}
+
+ADD_TO_PARAM("keyframe-req-min-interval", "* keyframe-req-min-interval=<ms>\n"
+                "  Minimal interval between keyframes forced by receivers' requests (RTCP PLI/FIR, default "
+                TOSTRING(DEFAULT_KEYFRAME_REQ_MIN_INTERVAL_MS) " ms).\n");
+
 void *video_rxtx::sender_thread(void *args) {
         return static_cast<video_rxtx *>(args)->sender_loop();
 }
@@ -38,6 +38,7 @@
 #ifndef VIDEO_RXTX_H_
 #define VIDEO_RXTX_H_
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -99,6 +100,8 @@ public:
 protected:
         video_rxtx(std::map<std::string, param_u> const &);
         void check_sender_messages();
+        /// requests keyframe from the encoder, eg. upon receiving RTCP PLI/FIR
+        void request_keyframe();
         struct module m_sender_mod;
         struct module m_receiver_mod;
         int m_rxtx_mode;
@@ -120,6 +123,10 @@ private:
         struct compress_state *m_compression = nullptr;
         pthread_mutex_t m_lock;
 
+        std::atomic_bool m_keyframe_requested{false};
+        long long m_last_forced_keyframe = 0; ///< time [ns]
+        long long m_keyframe_min_interval;    ///< [ns]
+
         pthread_t m_thread_id;
         bool m_poisoned, m_joined;
 };
@@ -165,6 +165,9 @@ void ultragrid_rtp_video_rxtx::send_frame_async(shared_ptr<video_frame> tx_frame
                         struct timeval timeout { 0, 0 };
                         ret = rtcp_recv_r(m_network_device, &timeout, ts);
                 } while (!m_should_exit && ret);
+                if (rtp_get_keyframe_requests(m_network_device) > 0) {
+                        request_keyframe();
+                }
         }
 
         m_async_sending_lock.lock();
@@ -330,6 +333,10 @@ void *ultragrid_rtp_video_rxtx::receiver_loop()
                 } else {
                         last_not_timeout = curr_time;
                 }
+                // RTCP for our sender is processed here in bidirectional mode
+                if (rtp_get_keyframe_requests(m_network_device) > 0) {
+                        request_keyframe();
+                }
 
                 /* Decode and render for each participant in the conference... */
                 pdb_iter_t it;
@@ -386,6 +393,14 @@ void *ultragrid_rtp_video_rxtx::receiver_loop()
                                 fr = 1;
                         }
 
+                        if (vdecoder_state) {
+                                if (int fmt = video_decoder_get_keyframe_request(vdecoder_state->decoder)) {
+                                        log_msg(LOG_LEVEL_VERBOSE, "Requesting keyframe (%s) from 0x%08" PRIx32 ".\n",
+                                                        fmt == RTCP_PSFB_FIR ? "FIR" : "PLI", cp->ssrc);
+                                        rtp_send_keyframe_request(m_network_device, cp->ssrc, (enum rtcp_psfb_fmt) fmt);
+                                }
+                        }
+
                         if(vdecoder_state && vdecoder_state->decoded % 100 == 99) {
                                 int new_size = vdecoder_state->max_frame_size * 110ull / 100;
                                 if(new_size > last_buf_size) {
@@ -0,0 +1,149 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "capture_filter.h"
+#include "lib_common.h"
+#include "unit_common.h"
+#include "video_frame.h"
+
+extern "C" {
+        int capture_filter_test_drop_next();
+}
+
+/*
+ * Test filter "test_keep:<n>" passing the first of every n frames (like
+ * every:1/n) and its variant "test_pass" that cannot tell in advance.
+ */
+struct test_keep_state {
+        int n;
+        int counter;
+};
+
+static int test_keep_init(struct module *, const char *cfg, void **state)
+{
+        auto *s = (struct test_keep_state *) calloc(1, sizeof(struct test_keep_state));
+        s->n = std::max(1, atoi(cfg));
+        s->counter = -1;
+        *state = s;
+        return 0;
+}
+
+static void test_keep_done(void *state)
+{
+        free(state);
+}
+
+static struct video_frame *test_keep_filter(void *state, struct video_frame *f)
+{
+        auto *s = (struct test_keep_state *) state;
+        s->counter = (s->counter + 1) % s->n;
+        if (s->counter != 0) {
+                VIDEO_FRAME_DISPOSE(f);
+                return nullptr;
+        }
+        return f;
+}
+
+static bool test_keep_drop_next(void *state)
+{
+        auto *s = (struct test_keep_state *) state;
+        return (s->counter + 1) % s->n != 0;
+}
+
+static void test_keep_dropped(void *state)
+{
+        auto *s = (struct test_keep_state *) state;
+        s->counter = (s->counter + 1) % s->n;
+}
+
+static const struct capture_filter_info capture_filter_test_keep = {
+        test_keep_init,
+        test_keep_done,
+        test_keep_filter,
+        test_keep_drop_next,
+        test_keep_dropped,
+};
+
+static const struct capture_filter_info capture_filter_test_pass = {
+        test_keep_init,
+        test_keep_done,
+        test_keep_filter,
+        nullptr,
+        nullptr,
+};
+
+REGISTER_HIDDEN_MODULE(test_keep, &capture_filter_test_keep, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
+REGISTER_HIDDEN_MODULE(test_pass, &capture_filter_test_pass, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
+
+/// @param fail_skip  every fail_skip-th skip doesn't consume any frame (0 - never)
+static int run_chain(const char *cfg, int frames, int *skipped, int *passed, int fail_skip = 0)
+{
+        struct capture_filter *cf = nullptr;
+        ASSERT_MESSAGE("Cannot initialize capture filter", capture_filter_init(nullptr, cfg, &cf) == 0);
+        struct video_frame *in = vf_alloc_desc_data(video_desc{64, 16, UYVY, 30, PROGRESSIVE, 1});
+        *skipped = *passed = 0;
+        int skip_attempts = 0;
+        for (int i = 0; i <= frames; ++i) {
+                struct video_frame *out = nullptr;
+                if (i < frames) {
+                        if (capture_filter_drop_next(cf)) {
+                                if (fail_skip > 0 && ++skip_attempts % fail_skip == 0) {
+                                        i -= 1; // no frame was available
+                                        continue;
+                                }
+                                capture_filter_dropped(cf);
+                                *skipped += 1;
+                                continue;
+                        }
+                        out = capture_filter(cf, in);
+                } else { // flush the pipeline
+                        while ((out = capture_filter_drain(cf)) != nullptr) {
+                                *passed += 1;
+                                VIDEO_FRAME_DISPOSE(out);
+                        }
+                }
+                if (out != nullptr) {
+                        *passed += 1;
+                        if (out != in) { // pipeline works with its own copies
+                                VIDEO_FRAME_DISPOSE(out);
+                        }
+                }
+        }
+        capture_filter_destroy(cf);
+        vf_free(in);
+        return 0;
+}
+
+/**
+ * Frames announced to be dropped must not be captured at all while the chain
+ * output must stay the same. The drop is committed only if the capture
+ * consumed the frame. In a pipeline, drop_next() may run before the
+ * deciding stage processes the preceding frames so the filter itself drops
+ * the rest.
+ */
+int capture_filter_test_drop_next()
+{
+        int skipped = 0;
+        int passed = 0;
+        // the first filter with drop_next decides, the preceding ones are skipped
+        ASSERT_EQUAL(0, run_chain("test_pass:1,test_keep:3", 9, &skipped, &passed));
+        ASSERT_EQUAL(6, skipped);
+        ASSERT_EQUAL(3, passed);
+        ASSERT_EQUAL(0, run_chain("test_keep:3|test_pass:1", 9, &skipped, &passed));
+        ASSERT_EQUAL(3, passed);
+        // skip that doesn't consume a frame must not count as a dropped one
+        ASSERT_EQUAL(0, run_chain("test_keep:3", 9, &skipped, &passed, 2));
+        ASSERT_EQUAL(6, skipped);
+        ASSERT_EQUAL(3, passed);
+        // no filter can tell in advance
+        ASSERT_EQUAL(0, run_chain("test_pass:3", 9, &skipped, &passed));
+        ASSERT_EQUAL(0, skipped);
+        ASSERT_EQUAL(3, passed);
+        return 0;
+}
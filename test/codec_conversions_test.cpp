@@ -9,6 +9,7 @@
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "unit_common.h"
 #include "video_codec.h"
@@ -20,8 +21,10 @@ using std::pair;
 using std::string;
 using std::to_string;
 using std::ostringstream;
+using std::vector;
 
 extern "C" int codec_conversion_test_testcard_uyvy_to_i420(void);
+extern "C" int codec_conversion_test_semiplanar_roundtrip(void);
 
 int codec_conversion_test_testcard_uyvy_to_i420(void)
 {
@@ -77,3 +80,58 @@ int codec_conversion_test_testcard_uyvy_to_i420(void)
         return 0;
 }
 
+/**
+ * UYVY->NV12->UYVY and v210->P010->v210 must be lossless if chroma of
+ * line pairs is equal (it is averaged when subsampling vertically)
+ */
+int codec_conversion_test_semiplanar_roundtrip(void)
+{
+        list<pair<int, int>> sizes = { { 6, 1 }, { 10, 2 }, { 18, 3 }, { 48, 16 }, { 1926, 5 } };
+        for (auto &size : sizes) {
+                const int width = size.first;
+                const int height = size.second;
+                auto chroma = [](int x, int y) { return (x * 37 + (y / 2) * 11) & 0x3FF; };
+                auto luma = [](int x, int y) { return (x * 13 + y * 101 + 7) & 0x3FF; };
+
+                vector<unsigned char> uyvy(vc_get_datalen(width, height, UYVY));
+                for (int y = 0; y < height; ++y) {
+                        unsigned char *line = uyvy.data() + y * vc_get_linesize(width, UYVY);
+                        for (int x = 0; x < width; ++x) {
+                                line[2 * x] = chroma(x, y) >> 2;
+                                line[2 * x + 1] = luma(x, y) >> 2;
+                        }
+                }
+                vector<unsigned char> nv12(vc_get_datalen(width, height, NV12));
+                vector<unsigned char> uyvy_out(uyvy.size());
+                uyvy_to_nv12(width, height, uyvy.data(), nv12.data());
+                nv12_to_uyvy(width, height, nv12.data(), uyvy_out.data());
+                ASSERT_MESSAGE("UYVY->NV12->UYVY " + to_string(width) + "x" + to_string(height), uyvy == uyvy_out);
+
+                vector<unsigned char> v210_in(vc_get_datalen(width, height, v210));
+                for (int y = 0; y < height; ++y) {
+                        auto *out = (uint32_t *)(void *) (v210_in.data() + y * vc_get_linesize(width, v210));
+                        for (int x = 0; x < width; x += 6) {
+                                *out++ = chroma(x, y) | luma(x, y) << 10 | chroma(x + 1, y) << 20;
+                                *out++ = luma(x + 1, y) | chroma(x + 2, y) << 10 | luma(x + 2, y) << 20;
+                                *out++ = chroma(x + 3, y) | luma(x + 3, y) << 10 | chroma(x + 4, y) << 20;
+                                *out++ = luma(x + 4, y) | chroma(x + 5, y) << 10 | luma(x + 5, y) << 20;
+                        }
+                }
+                vector<unsigned char> p010(vc_get_datalen(width, height, P010));
+                vector<unsigned char> v210_out(v210_in.size());
+                v210_to_p010(width, height, v210_in.data(), p010.data());
+                const auto *p010_y = (const uint16_t *)(const void *) p010.data();
+                for (int y = 0; y < height; ++y) {
+                        for (int x = 0; x < width; ++x) {
+                                ASSERT_EQUAL(luma(x, y) << 6, (int) p010_y[y * width + x]);
+                                ASSERT_EQUAL(chroma(x, y) << 6, (int) p010_y[width * height + (y / 2) * width + x]);
+                        }
+                }
+                if (width % 6 != 0) { // v210 padding of the last block isn't preserved
+                        continue;
+                }
+                p010_to_v210(width, height, p010.data(), v210_out.data());
+                ASSERT_MESSAGE("v210->P010->v210 " + to_string(width) + "x" + to_string(height), v210_in == v210_out);
+        }
+        return 0;
+}
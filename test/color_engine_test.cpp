@@ -0,0 +1,171 @@
+/**
+ * @file   color_engine_test.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "types.h"
+#include "utils/color_engine.h"
+#include "unit_common.h"
+
+extern "C" {
+        int color_engine_test_matrix_lut();
+        int color_engine_test_rg48_lut_only();
+}
+
+static int apply_gamma(double val, double gamma, double max = 255.0)
+{
+        val = std::clamp(val, 0.0, max);
+        return (int) lround(pow(val / max, gamma) * max);
+}
+
+/// fixed-point matrix result may differ by 1 before gamma is applied
+static bool check_component(const double *m, int row, const double *px, double gamma, int result,
+                double max = 255.0)
+{
+        double val = m[row * 3] * px[0] + m[row * 3 + 1] * px[1] + m[row * 3 + 2] * px[2];
+        return result >= apply_gamma(val - 1.0, gamma, max) - 1 && result <= apply_gamma(val + 1.0, gamma, max) + 1;
+}
+
+/**
+ * compares (SIMD/fixed-point) engine output with a double reference,
+ * both for RGB (in place) and UYVY->RGB
+ */
+int color_engine_test_matrix_lut()
+{
+        const double m[9] = { 0.9, 0.2, -0.1, -0.3, 1.1, 0.25, 0.05, -0.05, 1.4 };
+        constexpr int pixels = 1001; // not divisible by SIMD step - tests the tail
+        std::vector<unsigned char> rgb(pixels * 3);
+        srand(1);
+        for (auto &c : rgb) {
+                c = rand() % 256;
+        }
+        for (double gamma : { 1.0, 0.7 }) {
+                struct color_engine *e = color_engine_create(m, gamma);
+                ASSERT(e != nullptr);
+                std::vector<unsigned char> out = rgb;
+                ASSERT(color_engine_apply(e, RGB, (char *) out.data(), RGB, (char *) out.data(), out.size()));
+                for (int i = 0; i < pixels; ++i) {
+                        double px[3] = { (double) rgb[3 * i], (double) rgb[3 * i + 1], (double) rgb[3 * i + 2] };
+                        for (int c = 0; c < 3; ++c) {
+                                ASSERT_MESSAGE("RGB matrix mismatch",
+                                               check_component(m, c, px, gamma, out[3 * i + c]));
+                        }
+                }
+
+                // reuse random RGB data as UYVY (2 px per 4 B)
+                const int uyvy_pixels = pixels / 2 * 2;
+                std::vector<unsigned char> rgb_out(uyvy_pixels * 3);
+                ASSERT(color_engine_apply(e, UYVY, (char *) rgb.data(), RGB, (char *) rgb_out.data(),
+                                          uyvy_pixels * 2));
+                for (int i = 0; i < uyvy_pixels; ++i) {
+                        const unsigned char *uyvy = &rgb[i / 2 * 4];
+                        double px[3] = { uyvy[1 + 2 * (i % 2)] - 16.0, uyvy[0] - 128.0, uyvy[2] - 128.0 };
+                        for (int c = 0; c < 3; ++c) {
+                                ASSERT_MESSAGE("UYVY matrix mismatch",
+                                               check_component(m, c, px, gamma, rgb_out[3 * i + c]));
+                        }
+                }
+                color_engine_destroy(e);
+        }
+        return 0;
+}
+
+/**
+ * 16-bit (RG48) matrix path and gamma LUTs without a matrix, including bit
+ * depth changes
+ */
+int color_engine_test_rg48_lut_only()
+{
+        const double m[9] = { 0.9, 0.2, -0.1, -0.3, 1.1, 0.25, 0.05, -0.05, 1.4 };
+        constexpr int pixels = 1001;
+        std::vector<uint16_t> rg48(pixels * 3);
+        std::vector<unsigned char> rgb(pixels * 3);
+        srand(2);
+        for (int i = 0; i < pixels * 3; ++i) {
+                rg48[i] = rand() % 65536;
+                rgb[i] = rand() % 256;
+        }
+
+        for (double gamma : { 1.0, 0.7 }) {
+                struct color_engine *e = color_engine_create(m, gamma);
+                ASSERT(e != nullptr);
+                std::vector<uint16_t> out = rg48;
+                ASSERT(color_engine_apply(e, RG48, (char *) out.data(), RG48, (char *) out.data(), out.size() * 2));
+                for (int i = 0; i < pixels; ++i) {
+                        double px[3] = { (double) rg48[3 * i], (double) rg48[3 * i + 1], (double) rg48[3 * i + 2] };
+                        for (int c = 0; c < 3; ++c) {
+                                ASSERT_MESSAGE("RG48 matrix mismatch",
+                                               check_component(m, c, px, gamma, out[3 * i + c], 65535.0));
+                        }
+                }
+                // matrix does not change the bit depth
+                ASSERT(!color_engine_apply(e, RG48, (char *) rg48.data(), RGB, (char *) rgb.data(), rg48.size() * 2));
+                color_engine_destroy(e);
+        }
+
+        const double gamma = 0.7;
+        struct color_engine *e = color_engine_create(nullptr, gamma);
+        ASSERT(e != nullptr);
+        std::vector<unsigned char> rgb_out(pixels * 3);
+        std::vector<uint16_t> rg48_out(pixels * 3);
+        ASSERT(color_engine_apply(e, RGB, (char *) rgb.data(), RGB, (char *) rgb_out.data(), rgb.size()));
+        ASSERT(color_engine_apply(e, RGB, (char *) rgb.data(), RG48, (char *) rg48_out.data(), rgb.size()));
+        for (int i = 0; i < pixels * 3; ++i) {
+                ASSERT_EQUAL(apply_gamma(rgb[i], gamma), rgb_out[i]);
+                ASSERT_EQUAL(lround(pow(rgb[i] / 255.0, gamma) * 65535.0), rg48_out[i]);
+        }
+        ASSERT(color_engine_apply(e, RG48, (char *) rg48.data(), RG48, (char *) rg48_out.data(), rg48.size() * 2));
+        ASSERT(color_engine_apply(e, RG48, (char *) rg48.data(), RGB, (char *) rgb_out.data(), rg48.size() * 2));
+        for (int i = 0; i < pixels * 3; ++i) {
+                ASSERT_EQUAL(apply_gamma(rg48[i], gamma, 65535.0), rg48_out[i]);
+                ASSERT_EQUAL(lround(pow(rg48[i] / 65535.0, gamma) * 255.0), rgb_out[i]);
+        }
+        color_engine_destroy(e);
+        return 0;
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -0,0 +1,149 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "audio/echo_ring.hpp"
+#include "audio/types.h"
+#include "unit_common.h"
+#include "utils/ring_buffer.h"
+
+extern "C" {
+        int echo_ring_test_format_change();
+        int echo_ring_test_read_frame();
+        int echo_ring_test_wrap_around();
+}
+
+using std::vector;
+
+static bool push(struct ring_buffer *ring, int sample_rate, int bps, int ch_count, const void *data, int len)
+{
+        struct echo_chunk_hdr hdr = { sample_rate, bps, ch_count, len };
+        return echo_ring_push(ring, &hdr, static_cast<const char *>(data));
+}
+
+/**
+ * Samples are converted to 16 bits, a format change drops samples of the
+ * previous format, prefill pads with silence.
+ */
+int echo_ring_test_format_change()
+{
+        ring_buffer_uniq ring(ring_buffer_init(4096));
+        echo_input in;
+
+        const int16_t a[] = { 1000, -1000, 2000, -2000 };
+        const int8_t b[] = { 1, -2 }; // same format, only bps differs
+        ASSERT(push(ring.get(), 48000, 2, 1, a, sizeof a));
+        ASSERT(push(ring.get(), 48000, 1, 1, b, sizeof b));
+        bool fmt_changed = false;
+        ASSERT_EQUAL(2, in.drain(ring.get(), 0, &fmt_changed));
+        ASSERT(fmt_changed);
+        ASSERT_EQUAL(48000, in.sample_rate);
+        ASSERT_EQUAL(1, in.ch_count);
+        ASSERT(in.samples == vector<int16_t>({ 1000, -1000, 2000, -2000, 256, -512 }));
+
+        fmt_changed = false;
+        ASSERT_EQUAL(0, in.drain(ring.get(), 0, &fmt_changed));
+        const int16_t c[] = { 5, 6 };
+        ASSERT(push(ring.get(), 48000, 2, 1, c, sizeof c));
+        ASSERT_EQUAL(1, in.drain(ring.get(), 8, &fmt_changed));
+        ASSERT(!fmt_changed);
+        ASSERT(in.samples == vector<int16_t>({ 1000, -1000, 2000, -2000, 256, -512, 0, 0, 5, 6 }));
+
+        const int16_t stereo[] = { 7, 8, 9, 10 };
+        ASSERT(push(ring.get(), 48000, 2, 1, c, sizeof c));
+        ASSERT(push(ring.get(), 48000, 2, 2, stereo, sizeof stereo));
+        ASSERT_EQUAL(2, in.drain(ring.get(), 0, &fmt_changed));
+        ASSERT(fmt_changed);
+        ASSERT_EQUAL(2, in.ch_count);
+        ASSERT(in.samples == vector<int16_t>({ 7, 8, 9, 10 }));
+
+        fmt_changed = false;
+        ASSERT(push(ring.get(), 44100, 2, 2, stereo, sizeof stereo));
+        ASSERT_EQUAL(1, in.drain(ring.get(), 0, &fmt_changed));
+        ASSERT(fmt_changed);
+        ASSERT_EQUAL(44100, in.sample_rate);
+
+        ASSERT(push(ring.get(), 44100, 2, 2, stereo, sizeof stereo));
+        in.drain(ring.get(), 0, &fmt_changed);
+        ASSERT(!in.trim(8));
+        ASSERT(in.trim(6));
+        ASSERT(in.samples == vector<int16_t>({ 9, 10, 7, 8, 9, 10 }));
+        in.drop_frames(2); // 2 samples per channel
+        ASSERT(in.samples == vector<int16_t>({ 9, 10 }));
+        return 0;
+}
+
+/// output frame collects following chunks of the same format fitting in max_size
+int echo_ring_test_read_frame()
+{
+        ring_buffer_uniq ring(ring_buffer_init(4096));
+        vector<char> buf(10);
+        struct audio_frame frame{};
+        frame.data = buf.data();
+        frame.max_size = buf.size();
+
+        ASSERT(!echo_ring_read_frame(ring.get(), &frame));
+
+        const int16_t stereo[] = { 1, 2, 3, 4 };
+        const int16_t mono[] = { 5, 6, 7 };
+        ASSERT(push(ring.get(), 48000, 2, 2, stereo, 4));
+        ASSERT(push(ring.get(), 48000, 2, 2, stereo + 2, 4));
+        ASSERT(push(ring.get(), 48000, 2, 1, mono, sizeof mono));
+        ASSERT(push(ring.get(), 48000, 2, 1, mono, sizeof mono));
+
+        ASSERT(echo_ring_read_frame(ring.get(), &frame));
+        ASSERT_EQUAL(2, frame.ch_count);
+        ASSERT_EQUAL(2, frame.bps);
+        ASSERT_EQUAL(48000, frame.sample_rate);
+        ASSERT_EQUAL((int) sizeof stereo, frame.data_len);
+        ASSERT(memcmp(frame.data, stereo, sizeof stereo) == 0);
+
+        // second mono chunk doesn't fit in max_size
+        ASSERT(echo_ring_read_frame(ring.get(), &frame));
+        ASSERT_EQUAL(1, frame.ch_count);
+        ASSERT_EQUAL((int) sizeof mono, frame.data_len);
+        ASSERT(echo_ring_read_frame(ring.get(), &frame));
+        ASSERT_EQUAL((int) sizeof mono, frame.data_len);
+        ASSERT(memcmp(frame.data, mono, sizeof mono) == 0);
+
+        ASSERT(!echo_ring_read_frame(ring.get(), &frame));
+        ASSERT_EQUAL(0, frame.data_len);
+        return 0;
+}
+
+/// chunks split by the ring end are read intact, a chunk not fitting is not written at all
+int echo_ring_test_wrap_around()
+{
+        const int chunk_samples = 9;
+        const int chunk_len = (int) sizeof(struct echo_chunk_hdr) + chunk_samples * 2;
+        ring_buffer_uniq ring(ring_buffer_init(2 * chunk_len + 7));
+        echo_input in;
+        int16_t val = 0;
+        for (int i = 0; i < 20; ++i) {
+                int16_t data[chunk_samples];
+                for (auto &s : data) {
+                        s = val++;
+                }
+                ASSERT(push(ring.get(), 48000, 2, 1, data, sizeof data));
+                if (i % 2 == 0) {
+                        ASSERT(push(ring.get(), 48000, 2, 1, data, sizeof data));
+                        ASSERT(!push(ring.get(), 48000, 2, 1, data, sizeof data));
+                }
+                bool fmt_changed = false;
+                ASSERT_EQUAL(i % 2 == 0 ? 2 : 1, in.drain(ring.get(), 0, &fmt_changed));
+                ASSERT_EQUAL(0, ring_get_current_size(ring.get()));
+                const size_t expected = i % 2 == 0 ? 2 * chunk_samples : chunk_samples;
+                ASSERT_EQUAL(expected, in.samples.size());
+                for (size_t j = 0; j < in.samples.size(); ++j) {
+                        ASSERT_EQUAL(data[j % chunk_samples], in.samples[j]);
+                }
+                in.samples.clear();
+        }
+        return 0;
+}
@@ -0,0 +1,169 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "audio/audio_capture.h"
+#include "audio/echo.h"
+#include "audio/types.h"
+#include "audio/wav_writer.h"
+#include "host.h"
+#include "unit_common.h"
+#include "utils/fs.h"
+#include "utils/virtual_clock.h"
+
+extern "C" {
+        int echo_test_wav_fixtures();
+}
+
+#define SAMPLE_RATE 48000
+#define CHANNELS 2 ///< both played and captured
+#define DURATION_SEC 4
+#define FILTER_LENGTH "1024"
+#define MAX_WAIT_MS "1000" ///< wait for every frame to be processed
+#define MIN_ERLE_DB 10.0 ///< required echo attenuation in the last second
+
+using std::string;
+using std::vector;
+
+#ifdef HAVE_SPEEXDSP
+static string write_wav(const vector<int16_t> &samples)
+{
+        const char *name = nullptr;
+        FILE *f = get_temp_file(&name);
+        if (f == nullptr) {
+                return {};
+        }
+        fclose(f);
+        string filename = name;
+        struct wav_writer_file *wav = wav_writer_create(filename.c_str(), audio_desc{ 2, SAMPLE_RATE, CHANNELS, AC_PCM });
+        if (wav == nullptr) {
+                return {};
+        }
+        wav_writer_write(wav, samples.size() / CHANNELS, reinterpret_cast<const char *>(samples.data()));
+        wav_writer_close(wav);
+        return filename;
+}
+
+/**
+ * Far end is an uncorrelated noise in each played channel, the near end
+ * contains only its echo - every captured channel is a sum of delayed and
+ * attenuated played channels (direct path and one reflection).
+ */
+static void generate_fixtures(vector<int16_t> &far, vector<int16_t> &near)
+{
+        const int len = DURATION_SEC * SAMPLE_RATE;
+        far.resize(len * CHANNELS);
+        for (auto &s : far) {
+                s = rand() % 16001 - 8000;
+        }
+        const int delay[CHANNELS][CHANNELS] = { { 120, 310 }, { 270, 95 } };
+        const double gain[CHANNELS][CHANNELS] = { { 0.5, 0.25 }, { 0.2, 0.45 } };
+        near.assign(len * CHANNELS, 0);
+        for (int i = 0; i < len; ++i) {
+                for (int mic = 0; mic < CHANNELS; ++mic) {
+                        double val = 0;
+                        for (int spk = 0; spk < CHANNELS; ++spk) {
+                                const int d = i - delay[mic][spk];
+                                if (d >= 0) {
+                                        val += gain[mic][spk] * far[d * CHANNELS + spk];
+                                }
+                                if (d - 37 >= 0) {
+                                        val -= 0.3 * gain[mic][spk] * far[(d - 37) * CHANNELS + spk];
+                                }
+                        }
+                        near[i * CHANNELS + mic] = (int16_t) val;
+                }
+        }
+}
+
+static double energy(const vector<int16_t> &samples, int ch, int begin, int end)
+{
+        double sum = 0;
+        for (int i = begin; i < end; ++i) {
+                sum += (double) samples[i * CHANNELS + ch] * samples[i * CHANNELS + ch];
+        }
+        return sum;
+}
+
+static int run_fixtures(const string &far_file, const string &near_file, const vector<int16_t> &near)
+{
+        struct state_audio_capture *far_cap = nullptr;
+        struct state_audio_capture *near_cap = nullptr;
+        ASSERT_EQUAL(0, audio_capture_init(nullptr, "testcard", ("file=" + far_file).c_str(), &far_cap));
+        ASSERT_EQUAL(0, audio_capture_init(nullptr, "testcard", ("file=" + near_file).c_str(), &near_cap));
+        struct echo_cancellation *ec = echo_cancellation_init();
+
+        vector<int16_t> out;
+        const size_t total = near.size() * sizeof near[0];
+        size_t captured = 0;
+        while (captured < total) {
+                echo_play(ec, audio_capture_read(far_cap));
+                struct audio_frame *near_frame = audio_capture_read(near_cap);
+                captured += near_frame->data_len;
+                struct audio_frame *res = echo_cancel(ec, near_frame);
+                if (res == nullptr) {
+                        continue;
+                }
+                ASSERT_EQUAL(CHANNELS, res->ch_count);
+                ASSERT_EQUAL(SAMPLE_RATE, res->sample_rate);
+                ASSERT_EQUAL(2, res->bps);
+                const int16_t *data = reinterpret_cast<const int16_t *>(res->data);
+                out.insert(out.end(), data, data + res->data_len / 2);
+        }
+        echo_cancellation_destroy(ec);
+        audio_capture_done(far_cap);
+        audio_capture_done(near_cap);
+
+        // output is delayed by unprocessed remainder only
+        ASSERT(out.size() / CHANNELS > (DURATION_SEC - 1) * SAMPLE_RATE);
+        const int end = std::min(out.size(), near.size()) / CHANNELS;
+        const int begin = end - SAMPLE_RATE;
+        for (int ch = 0; ch < CHANNELS; ++ch) {
+                const double erle = 10 * log10(energy(near, ch, begin, end) / std::max(energy(out, ch, begin, end), 1.0));
+                ASSERT_MESSAGE("Echo not cancelled", erle >= MIN_ERLE_DB);
+        }
+        return 0;
+}
+#endif // defined HAVE_SPEEXDSP
+
+/**
+ * Far and near end fixtures (stereo speakers picked by 2 microphones) are
+ * played by audio testcard captures and passed through the canceller, the
+ * echo must be attenuated once the filter converges.
+ */
+int echo_test_wav_fixtures()
+{
+#ifdef HAVE_SPEEXDSP
+        srand(1);
+        vector<int16_t> far;
+        vector<int16_t> near;
+        generate_fixtures(far, near);
+        const string far_file = write_wav(far);
+        const string near_file = write_wav(near);
+        ASSERT_MESSAGE("Cannot write WAV fixtures", !far_file.empty() && !near_file.empty());
+
+        set_commandline_param("echo-cancel-filter-length", FILTER_LENGTH);
+        set_commandline_param("echo-cancel-max-wait", MAX_WAIT_MS);
+        virtual_clock_set_enabled(true); // testcards are paced in real time otherwise
+        const int ret = run_fixtures(far_file, near_file, near);
+        virtual_clock_set_enabled(false);
+        commandline_params.erase("echo-cancel-filter-length");
+        commandline_params.erase("echo-cancel-max-wait");
+
+        remove(far_file.c_str());
+        remove(near_file.c_str());
+        return ret;
+#else
+        return 1;
+#endif
+}
@@ -0,0 +1,103 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "pixfmt_conv.h"
+#include "tools/ipc_frame.h"
+#include "tools/ipc_frame_ug.h"
+#include "unit_common.h"
+#include "video.h"
+
+extern "C" {
+        int ipc_frame_ug_test_box_downscale();
+}
+
+using frame_uniq = std::unique_ptr<video_frame, void (*)(video_frame *)>;
+
+static constexpr int W = 96; // whole v210 blocks after scaling
+static constexpr int H = 32;
+static constexpr int SCALE = 4;
+static constexpr unsigned char CB = 90;
+static constexpr unsigned char Y = 180;
+static constexpr unsigned char CR = 150;
+
+static frame_uniq make_uniform_frame(codec_t codec)
+{
+        frame_uniq f(vf_alloc_desc_data(video_desc{W, H, codec, 30, PROGRESSIVE, 1}), vf_free);
+        unsigned char *data = (unsigned char *) f->tiles[0].data;
+        if (codec == I420) {
+                memset(data, Y, W * H);
+                memset(data + W * H, CB, W * H / 4);
+                memset(data + W * H + W * H / 4, CR, W * H / 4);
+                return f;
+        }
+        unsigned char uyvy[W * 2];
+        for (int x = 0; x < W / 2; ++x) {
+                uyvy[4 * x] = CB;
+                uyvy[4 * x + 1] = Y;
+                uyvy[4 * x + 2] = CR;
+                uyvy[4 * x + 3] = Y;
+        }
+        decoder_t dec = get_decoder_from_to(UYVY, codec);
+        for (int y = 0; y < H; ++y) {
+                dec(data + y * vc_get_linesize(W, codec), uyvy, vc_get_linesize(W, codec), 0, 8, 16);
+        }
+        return f;
+}
+
+static bool rgb_close(const Ipc_frame *a, const Ipc_frame *b, int tolerance)
+{
+        if (a->header.width != b->header.width || a->header.height != b->header.height
+                        || a->header.data_len != b->header.data_len) {
+                return false;
+        }
+        for (int i = 0; i < a->header.data_len; ++i) {
+                if (abs((unsigned char) a->data[i] - (unsigned char) b->data[i]) > tolerance) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+/// box filter in source pixel format must match the former decimation for flat content and average details
+int ipc_frame_ug_test_box_downscale()
+{
+        Ipc_frame_uniq ref(ipc_frame_new());
+        Ipc_frame_uniq out(ipc_frame_new());
+
+        frame_uniq uyvy = make_uniform_frame(UYVY);
+        ASSERT(ipc_frame_from_ug_frame(ref.get(), uyvy.get(), RGB, SCALE));
+        ASSERT_EQUAL(W / SCALE, ref->header.width);
+        ASSERT_EQUAL(H / SCALE, ref->header.height);
+        ASSERT(ipc_frame_from_ug_frame_hq(out.get(), uyvy.get(), RGB, SCALE));
+        ASSERT(rgb_close(ref.get(), out.get(), 0));
+
+        frame_uniq i420 = make_uniform_frame(I420);
+        ASSERT(ipc_frame_from_ug_frame(out.get(), i420.get(), RGB, SCALE));
+        ASSERT(rgb_close(ref.get(), out.get(), 0));
+
+        frame_uniq v210_frame = make_uniform_frame(v210);
+        ASSERT(ipc_frame_from_ug_frame(ref.get(), v210_frame.get(), RGB, SCALE));
+        ASSERT(ipc_frame_from_ug_frame_hq(out.get(), v210_frame.get(), RGB, SCALE));
+        ASSERT(rgb_close(ref.get(), out.get(), 2)); // 10-bit vs. 8-bit intermediate
+
+        // RGBA checkerboard averages to gray
+        frame_uniq rgba(vf_alloc_desc_data(video_desc{W, H, RGBA, 30, PROGRESSIVE, 1}), vf_free);
+        for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                        memset(rgba->tiles[0].data + (y * W + x) * 4, (x + y) % 2 ? 255 : 0, 4);
+                }
+        }
+        ASSERT(ipc_frame_from_ug_frame_hq(out.get(), rgba.get(), RGB, 2));
+        ASSERT_EQUAL(W / 2 * H / 2 * 3, out->header.data_len);
+        for (int i = 0; i < out->header.data_len; ++i) {
+                ASSERT(abs((unsigned char) out->data[i] - 128) <= 1);
+        }
+        return 0;
+}
@@ -0,0 +1,61 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <vector>
+
+#include "rtp/net_impair.h"
+#include "unit_common.h"
+
+extern "C" {
+        int net_impair_test_deterministic();
+        int net_impair_test_loss_rate();
+}
+
+static void dummy_deliver(void *, void *pkt)
+{
+        free(pkt);
+}
+
+static std::vector<int> get_pattern(const char *cfg, int count)
+{
+        std::vector<int> ret;
+        struct net_impair *s = net_impair_init(cfg, "test", 0, dummy_deliver, nullptr);
+        if (s == nullptr) {
+                return ret;
+        }
+        for (int i = 0; i < count; ++i) {
+                time_ns_t deadlines[NET_IMPAIR_MAX_COPIES];
+                ret.push_back(net_impair_schedule(s, 1000, deadlines));
+        }
+        net_impair_done(s);
+        return ret;
+}
+
+/// the same seed must produce the same loss/duplication pattern
+int net_impair_test_deterministic()
+{
+        const char *cfg = "seed=42:p=2:r=30:dup=1";
+        auto first = get_pattern(cfg, 10000);
+        auto second = get_pattern(cfg, 10000);
+        ASSERT_EQUAL(10000U, first.size());
+        ASSERT(first == second);
+        auto other = get_pattern("seed=43:p=2:r=30:dup=1", 10000);
+        ASSERT(first != other);
+        return 0;
+}
+
+/// Gilbert-Elliott stationary loss is p / (p + r)
+int net_impair_test_loss_rate()
+{
+        auto pattern = get_pattern("seed=1:p=5:r=45", 100000);
+        int lost = 0;
+        for (int i : pattern) {
+                lost += i == 0;
+        }
+        double loss = (double) lost / pattern.size();
+        ASSERT_MESSAGE(std::to_string(loss), loss > 0.09 && loss < 0.11);
+        return 0;
+}
@@ -0,0 +1,90 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "rtp/net_trace.h"
+#include "unit_common.h"
+#include "utils/fs.h"
+
+extern "C" {
+        int net_trace_test_write_read();
+}
+
+/**
+ * Datagrams recorded to a pcap file must be replayed with the same
+ * timestamps, payloads, source addresses and receiving ports.
+ */
+int net_trace_test_write_read()
+{
+        const char *name = nullptr;
+        FILE *f = get_temp_file(&name);
+        ASSERT_MESSAGE("Cannot create temporary file", f != nullptr);
+        fclose(f);
+        const std::string filename = name;
+
+        struct net_trace_writer *w = net_trace_writer_acquire(filename.c_str());
+        ASSERT(w != nullptr);
+        // shared by sockets recording to the same file only
+        ASSERT(net_trace_writer_acquire(filename.c_str()) == w);
+        ASSERT(net_trace_writer_acquire((filename + "-other").c_str()) == nullptr);
+
+        struct sockaddr_in src4{};
+        src4.sin_family = AF_INET;
+        src4.sin_addr.s_addr = htonl(0x0A010203); // 10.1.2.3
+        src4.sin_port = htons(5004);
+        struct sockaddr_in6 src6_mapped{};
+        src6_mapped.sin6_family = AF_INET6;
+        src6_mapped.sin6_addr.s6_addr[10] = src6_mapped.sin6_addr.s6_addr[11] = 0xFF;
+        src6_mapped.sin6_addr.s6_addr[12] = 192;
+        src6_mapped.sin6_addr.s6_addr[13] = 168;
+        src6_mapped.sin6_addr.s6_addr[15] = 1;
+        src6_mapped.sin6_port = htons(6000);
+        struct sockaddr_in6 src6{};
+        src6.sin6_family = AF_INET6;
+        src6.sin6_addr.s6_addr[15] = 1; // ::1 - recorded as 0.0.0.0
+        src6.sin6_port = htons(7000);
+
+        const char *payloads[] = { "first datagram", "second", "third one" };
+        const struct sockaddr *srcs[] = { (struct sockaddr *) &src4, (struct sockaddr *) &src6_mapped,
+                (struct sockaddr *) &src6 };
+        const uint32_t exp_addr[] = { 0x0A010203, 0xC0A80001, 0 };
+        const uint16_t exp_port[] = { 5004, 6000, 7000 };
+        const time_ns_t ts[] = { 1, 1500 * NS_IN_MS, 3 * NS_IN_SEC + 999 };
+        for (int i = 0; i < 3; ++i) {
+                net_trace_write(w, ts[i], srcs[i], 5006 + i, payloads[i], strlen(payloads[i]));
+        }
+        net_trace_writer_release(w);
+        net_trace_writer_release(w);
+
+        struct net_trace_reader *r = net_trace_reader_init(filename.c_str());
+        ASSERT(r != nullptr);
+        for (int i = 0; i < 3; ++i) {
+                char buf[100];
+                time_ns_t read_ts = 0;
+                struct sockaddr_in src{};
+                uint16_t dst_port = 0;
+                const int len = net_trace_read(r, &read_ts, &src, &dst_port, buf, sizeof buf);
+                ASSERT_EQUAL((int) strlen(payloads[i]), len);
+                ASSERT(memcmp(buf, payloads[i], len) == 0);
+                ASSERT_EQUAL(ts[i], read_ts);
+                ASSERT_EQUAL(AF_INET, (int) src.sin_family);
+                ASSERT_EQUAL(exp_addr[i], ntohl(src.sin_addr.s_addr));
+                ASSERT_EQUAL(exp_port[i], ntohs(src.sin_port));
+                ASSERT_EQUAL(5006 + i, (int) dst_port);
+        }
+        char buf[100];
+        time_ns_t read_ts = 0;
+        struct sockaddr_in src{};
+        uint16_t dst_port = 0;
+        ASSERT_EQUAL(0, net_trace_read(r, &read_ts, &src, &dst_port, buf, sizeof buf)); // EOF
+        net_trace_reader_done(r);
+
+        remove(filename.c_str());
+        return 0;
+}
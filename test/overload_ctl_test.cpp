@@ -0,0 +1,97 @@
+/**
+ * @file   overload_ctl_test.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <algorithm>
+
+#include "tv.h"
+#include "utils/overload_ctl.h"
+#include "unit_common.h"
+
+extern "C" {
+        int overload_ctl_test_throttled_decoder();
+}
+
+/**
+ * simulates decoder too slow for the frame rate (per-level decode time
+ * given) - level must rise until it keeps up and relax when load drops
+ */
+static int simulate(struct overload_ctl *c, const time_ns_t *cost_ms, int frames, time_ns_t *now, int *max_seen)
+{
+        constexpr time_ns_t interval = 33 * NS_IN_MS;
+        time_ns_t prev_end = *now;
+        for (int i = 0; i < frames; ++i) {
+                const time_ns_t arrival = *now + i * interval;
+                if (prev_end > arrival + interval) {
+                        continue; // queue is 1 frame deep - dropped
+                }
+                const time_ns_t start = std::max(arrival, prev_end);
+                prev_end = start + cost_ms[c->level] * NS_IN_MS;
+                overload_ctl_update(c, start, prev_end, interval);
+                *max_seen = std::max(*max_seen, c->level);
+        }
+        *now = std::max(prev_end, *now + frames * interval);
+        return c->level;
+}
+
+int overload_ctl_test_throttled_decoder()
+{
+        struct overload_ctl c;
+        overload_ctl_init(&c, 3);
+        time_ns_t now = NS_IN_SEC;
+        int max_seen = 0;
+
+        const time_ns_t slow[] = { 45, 38, 25, 20 };
+        ASSERT_EQUAL(2, simulate(&c, slow, 900, &now, &max_seen));
+        ASSERT_EQUAL(2, max_seen); // must not overshoot
+
+        const time_ns_t fast[] = { 10, 8, 6, 5 };
+        ASSERT_EQUAL(0, simulate(&c, fast, 900, &now, &max_seen));
+
+        struct overload_ctl disabled;
+        overload_ctl_init(&disabled, 0);
+        max_seen = 0;
+        ASSERT_EQUAL(0, simulate(&disabled, slow, 300, &now, &max_seen));
+        return 0;
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -0,0 +1,93 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/fs.h"
+#include "utils/parallel_probe.hpp"
+#include "unit_common.h"
+
+extern "C" {
+        int parallel_probe_test_timeout_and_cache();
+        int parallel_probe_test_groups();
+}
+
+using namespace std::chrono;
+
+/// a hung probe must not delay the others and its result must not be cached
+int parallel_probe_test_timeout_and_cache()
+{
+        std::string cache_file = std::string(get_temp_dir()) + "/ug_probe_test_" + std::to_string(getpid());
+        auto calls = std::make_shared<std::atomic<int>>(0);
+        std::vector<probe_task> tasks{
+                { "capture:testcard", "1", [calls] { ++*calls; return std::string("testcard\n"); }, "" },
+                { "display:dummy", "1", [calls] { ++*calls; return std::string("dummy\n"); }, "" },
+                { "display:slow", "1", [calls] { ++*calls; std::this_thread::sleep_for(milliseconds(1500)); return std::string("slow\n"); }, "" },
+                { "compress:none", "1", [calls] { ++*calls; return std::string(); }, "" },
+        };
+
+        auto start = steady_clock::now();
+        auto res = run_probes_parallel(tasks, milliseconds(200), cache_file);
+        ASSERT(steady_clock::now() - start < milliseconds(1000));
+        ASSERT_EQUAL(4U, res.size());
+        ASSERT(res[0] == "testcard\n");
+        ASSERT(res[1] == "dummy\n");
+        ASSERT(res[2].empty());
+        ASSERT_EQUAL(4, calls->load());
+
+        tasks[2].probe = [calls] { ++*calls; return std::string("slow\n"); };
+        res = run_probes_parallel(tasks, milliseconds(200), cache_file);
+        ASSERT(res[2] == "slow\n");
+        ASSERT_EQUAL(5, calls->load()); // only the timed-out probe was rerun
+
+        tasks[1].validator = "2"; // device change
+        res = run_probes_parallel(tasks, milliseconds(200), cache_file);
+        ASSERT(res[1] == "dummy\n");
+        ASSERT_EQUAL(6, calls->load());
+
+        remove(cache_file.c_str());
+        return 0;
+}
+
+/// probes of one group must not overlap, a hung probe abandons the rest of its group only
+int parallel_probe_test_groups()
+{
+        auto running = std::make_shared<std::atomic<int>>(0);
+        auto overlap = std::make_shared<std::atomic<bool>>(false);
+        auto lib_probe = [running, overlap] {
+                if (++*running > 1) {
+                        *overlap = true;
+                }
+                std::this_thread::sleep_for(milliseconds(20));
+                --*running;
+                return std::string("lib\n");
+        };
+        std::vector<probe_task> tasks;
+        for (int i = 0; i < 6; ++i) {
+                tasks.push_back({ "capture:lib" + std::to_string(i), "1", lib_probe, "lib" });
+        }
+        tasks.push_back({ "display:hung", "1", [] { std::this_thread::sleep_for(milliseconds(1500)); return std::string("hung\n"); }, "hung" });
+        tasks.push_back({ "audio_play:hung", "1", [] { return std::string("after hung\n"); }, "hung" });
+        tasks.push_back({ "display:dummy", "1", [] { return std::string("dummy\n"); }, "" });
+
+        auto start = steady_clock::now();
+        auto res = run_probes_parallel(tasks, milliseconds(400), "");
+        ASSERT(steady_clock::now() - start < milliseconds(1000));
+        ASSERT(!overlap->load());
+        for (int i = 0; i < 6; ++i) {
+                ASSERT(res[i] == "lib\n");
+        }
+        ASSERT(res[6].empty());
+        ASSERT(res[7].empty());
+        ASSERT(res[8] == "dummy\n");
+        return 0;
+}
@@ -0,0 +1,172 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <cmath>
+#include <vector>
+
+#include "unit_common.h"
+#include "utils/path_sched.h"
+
+extern "C" {
+        int path_sched_test_configured_weights();
+        int path_sched_test_loss_and_rtt();
+        int path_sched_test_failover();
+}
+
+#define STEP (10 * NS_IN_MS)
+#define PACKETS_PER_STEP 100
+
+using std::vector;
+
+namespace {
+/// synthetic path - echoes probes after RTT unless dropped
+struct sim_path {
+        time_ns_t rtt;
+        int drop_every; ///< drop every n-th probe (0 - none)
+        bool down;
+        unsigned long long probes;
+};
+
+struct echo_event {
+        int path;
+        uint32_t seq;
+        time_ns_t sent;
+        time_ns_t arrival;
+};
+
+struct simulation {
+        struct path_sched *sched = path_sched_create();
+        vector<sim_path> paths;
+        vector<echo_event> in_flight;
+        vector<unsigned long long> packets;
+        time_ns_t now = NS_IN_SEC;
+
+        explicit simulation(const vector<double> &weights, const vector<sim_path> &p) : paths(p), packets(p.size()) {
+                for (unsigned i = 0; i < weights.size(); ++i) {
+                        path_sched_add(sched, "sim", weights[i]);
+                        path_sched_enable(sched, i, now);
+                }
+        }
+        ~simulation() {
+                path_sched_destroy(sched);
+        }
+        /// runs for given time, packet counts are reset first
+        void run(time_ns_t duration) {
+                packets.assign(paths.size(), 0);
+                for (const time_ns_t end = now + duration; now < end; now += STEP) {
+                        for (auto it = in_flight.begin(); it != in_flight.end(); ) {
+                                if (it->arrival <= now) {
+                                        path_sched_echo(sched, it->path, it->seq, it->sent, now);
+                                        it = in_flight.erase(it);
+                                } else {
+                                        ++it;
+                                }
+                        }
+                        for (unsigned i = 0; i < paths.size(); ++i) {
+                                sim_path &p = paths[i];
+                                uint32_t seq = 0;
+                                if (!path_sched_probe_due(sched, i, now, &seq)) {
+                                        continue;
+                                }
+                                p.probes += 1;
+                                if (!p.down && (p.drop_every == 0 || p.probes % p.drop_every != 0)) {
+                                        in_flight.push_back({ (int) i, seq, now, now + p.rtt });
+                                }
+                        }
+                        path_sched_update(sched, now);
+                        for (int i = 0; i < PACKETS_PER_STEP; ++i) {
+                                const int idx = path_sched_next(sched);
+                                if (idx >= 0) {
+                                        packets[idx] += 1;
+                                }
+                        }
+                }
+        }
+        double share(int path) const {
+                unsigned long long total = 0;
+                for (auto c : packets) {
+                        total += c;
+                }
+                return (double) packets[path] / total;
+        }
+        path_sched_stats stats(int path) const {
+                path_sched_stats ret{};
+                path_sched_get_stats(sched, path, &ret);
+                return ret;
+        }
+};
+} // end of anonymous namespace
+
+/// without echoes from the receiver packets are split by the configured weights
+int path_sched_test_configured_weights()
+{
+        simulation sim({ 1.0, 2.0 }, { { 0, 0, true, 0 }, { 0, 0, true, 0 } });
+        sim.run(3 * NS_IN_SEC);
+        ASSERT_EQUAL(sim.packets[0] * 2, sim.packets[1]);
+        ASSERT(!sim.stats(0).failed && !sim.stats(1).failed);
+
+        struct path_sched *empty = path_sched_create();
+        path_sched_add(empty, "disabled", 1.0);
+        path_sched_update(empty, NS_IN_SEC);
+        ASSERT_EQUAL(-1, path_sched_next(empty));
+        path_sched_destroy(empty);
+        return 0;
+}
+
+/**
+ * Probe loss decreases the share quadratically, RTT exceeding the best
+ * path by more than the slack decreases it proportionally.
+ */
+int path_sched_test_loss_and_rtt()
+{
+        simulation sim({ 1.0, 1.0, 1.0 }, {
+                        { 10 * NS_IN_MS, 0, false, 0 },
+                        { 10 * NS_IN_MS, 2, false, 0 },
+                        { 300 * NS_IN_MS, 0, false, 0 } });
+        sim.run(5 * NS_IN_SEC);
+        sim.run(2 * NS_IN_SEC);
+
+        ASSERT(fabs(sim.stats(0).loss) < 0.01);
+        ASSERT(fabs(sim.stats(1).loss - 0.5) < 0.05);
+        ASSERT_EQUAL(10 * NS_IN_MS, sim.stats(0).srtt);
+        ASSERT(std::llabs(sim.stats(2).srtt - 300 * NS_IN_MS) < NS_IN_MS);
+
+        ASSERT(fabs(sim.stats(0).weight - 1.0) < 0.01);
+        ASSERT(fabs(sim.stats(1).weight - 0.25) < 0.05);
+        ASSERT(fabs(sim.stats(2).weight - 0.1) < 0.01); // (10 ms + slack) / 300 ms
+        const double total = sim.stats(0).weight + sim.stats(1).weight + sim.stats(2).weight;
+        for (int i = 0; i < 3; ++i) {
+                ASSERT(fabs(sim.share(i) - sim.stats(i).weight / total) < 0.02);
+        }
+        return 0;
+}
+
+/// a path without echoes is excluded after the timeout and used again once it recovers
+int path_sched_test_failover()
+{
+        simulation sim({ 1.0, 1.0 }, { { 10 * NS_IN_MS, 0, false, 0 }, { 20 * NS_IN_MS, 0, false, 0 } });
+        sim.run(3 * NS_IN_SEC);
+        ASSERT(fabs(sim.share(1) - 0.5) < 0.01);
+
+        sim.paths[1].down = true;
+        sim.run(PATH_SCHED_FAIL_TIMEOUT / 2);
+        ASSERT(!sim.stats(1).failed);
+        sim.run(PATH_SCHED_FAIL_TIMEOUT / 2 + 2 * PATH_SCHED_PROBE_INTERVAL);
+        ASSERT(sim.stats(1).failed);
+        ASSERT_EQUAL(0.0, sim.stats(1).weight);
+        sim.run(NS_IN_SEC);
+        ASSERT_EQUAL(0ULL, sim.packets[1]);
+        ASSERT(sim.packets[0] > 0);
+
+        sim.paths[1].down = false;
+        sim.run(2 * PATH_SCHED_PROBE_INTERVAL);
+        ASSERT(!sim.stats(1).failed);
+        ASSERT(sim.packets[1] > 0);
+        sim.run(5 * NS_IN_SEC); // lost probes leave the window
+        sim.run(NS_IN_SEC);
+        ASSERT(fabs(sim.share(1) - 0.5) < 0.01);
+        return 0;
+}
@@ -0,0 +1,151 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "unit_common.h"
+#include "utils/pixelate.h"
+#include "video_codec.h"
+
+extern "C" {
+        int pixelate_test_block_average();
+}
+
+#define W 64
+#define H 20
+#define RECT_X 5
+#define RECT_Y 3
+#define RECT_W 30
+#define RECT_H 11
+#define BLOCK 4
+
+using std::vector;
+
+/// YCbCr 4:2:2 samples of a frame, chroma indexed by luma x
+struct planes {
+        vector<int> y, cb, cr;
+};
+
+static planes unpack_uyvy(const vector<unsigned char> &data)
+{
+        planes p{vector<int>(W * H), vector<int>(W * H), vector<int>(W * H)};
+        for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                        const unsigned char *px = &data[(y * W + x / 2 * 2) * 2];
+                        p.y[y * W + x] = px[x % 2 == 0 ? 1 : 3];
+                        p.cb[y * W + x] = px[0];
+                        p.cr[y * W + x] = px[2];
+                }
+        }
+        return p;
+}
+
+static planes unpack_v210(const vector<unsigned char> &data)
+{
+        planes p{vector<int>(W * H), vector<int>(W * H), vector<int>(W * H)};
+        const int linesize = vc_get_linesize(W, v210);
+        for (int y = 0; y < H; ++y) {
+                for (int g = 0; g < W / 6; ++g) {
+                        int f[12];
+                        for (int i = 0; i < 4; ++i) {
+                                uint32_t word = 0;
+                                memcpy(&word, &data[y * linesize + 16 * g + 4 * i], sizeof word);
+                                for (int j = 0; j < 3; ++j) {
+                                        f[3 * i + j] = (word >> (10 * j)) & 0x3FF;
+                                }
+                        }
+                        // Cb0 Y0 Cr0 Y1 Cb1 Y2 Cr1 Y3 Cb2 Y4 Cr2 Y5
+                        for (int i = 0; i < 6; ++i) {
+                                const int idx = y * W + 6 * g + i;
+                                p.y[idx] = f[2 * i + 1];
+                                p.cb[idx] = f[i / 2 * 4];
+                                p.cr[idx] = f[i / 2 * 4 + 2];
+                        }
+                }
+        }
+        return p;
+}
+
+/**
+ * Checks that samples inside the rectangle are averages of the original
+ * blocks (chroma counted once per pixel pair) and the rest is unchanged.
+ */
+static int check_blocks(const planes &in, const planes &out, int x0, int x1, int y0, int y1, int bw, int bh)
+{
+        const vector<int> planes::*comps[] = { &planes::y, &planes::cb, &planes::cr };
+        for (int c = 0; c < 3; ++c) {
+                const vector<int> &src = in.*comps[c];
+                const vector<int> &dst = out.*comps[c];
+                const int step = c == 0 ? 1 : 2;
+                for (int y = 0; y < H; ++y) {
+                        for (int x = 0; x < W; ++x) {
+                                if (x < x0 || x >= x1 || y < y0 || y >= y1) {
+                                        ASSERT_EQUAL(src[y * W + x], dst[y * W + x]);
+                                        continue;
+                                }
+                                const int bx = x0 + (x - x0) / bw * bw;
+                                const int by = y0 + (y - y0) / bh * bh;
+                                int sum = 0;
+                                int count = 0;
+                                for (int j = by; j < std::min(by + bh, y1); ++j) {
+                                        for (int i = bx; i < std::min(bx + bw, x1); i += step) {
+                                                sum += src[j * W + i];
+                                                count += 1;
+                                        }
+                                }
+                                ASSERT_EQUAL((sum + count / 2) / count, dst[y * W + x]);
+                        }
+                }
+        }
+        return 0;
+}
+
+int pixelate_test_block_average()
+{
+        struct pixelator *p = pixelator_create();
+
+        // UYVY - the rectangle is aligned to pixel pairs
+        vector<unsigned char> uyvy(vc_get_linesize(W, UYVY) * H);
+        for (auto &b : uyvy) {
+                b = rand() % 256;
+        }
+        vector<unsigned char> uyvy_in = uyvy;
+        ASSERT(pixelator_apply(p, (char *) uyvy.data(), UYVY, W, H, RECT_X, RECT_Y, RECT_W, RECT_H, BLOCK));
+        ASSERT_EQUAL(0, check_blocks(unpack_uyvy(uyvy_in), unpack_uyvy(uyvy), 4, 36, RECT_Y, RECT_Y + RECT_H, BLOCK, BLOCK));
+
+        // v210 - aligned to 6-pixel groups, including the block width
+        vector<unsigned char> v210_data(vc_get_linesize(W, v210) * H);
+        for (size_t i = 0; i < v210_data.size(); i += 4) {
+                uint32_t word = (rand() % 1024) | (rand() % 1024) << 10 | (rand() % 1024) << 20;
+                memcpy(&v210_data[i], &word, sizeof word);
+        }
+        vector<unsigned char> v210_in = v210_data;
+        ASSERT(pixelator_apply(p, (char *) v210_data.data(), v210, W, H, RECT_X, RECT_Y, RECT_W, RECT_H, BLOCK));
+        ASSERT_EQUAL(0, check_blocks(unpack_v210(v210_in), unpack_v210(v210_data), 0, 36, RECT_Y, RECT_Y + RECT_H, 6, BLOCK));
+
+        // I420 blanking - aligned to 2x2 pixels
+        vector<unsigned char> i420(W * H * 3 / 2);
+        for (auto &b : i420) {
+                b = 200;
+        }
+        ASSERT(pixelator_apply(p, (char *) i420.data(), I420, W, H, RECT_X, RECT_Y, RECT_W, RECT_H, 0));
+        for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                        const bool inside = x >= 4 && x < 36 && y >= 2 && y < 14;
+                        ASSERT_EQUAL(inside ? 16 : 200, i420[y * W + x]);
+                        const int c_idx = W * H + y / 2 * (W / 2) + x / 2;
+                        ASSERT_EQUAL(inside ? 128 : 200, i420[c_idx]);
+                        ASSERT_EQUAL(inside ? 128 : 200, i420[c_idx + W / 2 * H / 2]);
+                }
+        }
+
+        ASSERT(!pixelator_apply(p, (char *) uyvy.data(), R10k, W, H, 0, 0, W, H, BLOCK));
+        pixelator_destroy(p);
+        return 0;
+}
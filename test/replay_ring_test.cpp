@@ -0,0 +1,168 @@
+/**
+ * @file   replay_ring_test.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "rtp/rtpdec_h264.h"
+#include "rtp/rtpenc_h264.h"
+#include "types.h"
+#include "utils/macros.h"
+#include "utils/replay_ring.h"
+#include "video_codec.h"
+#include "video_compress.h"
+#include "video_frame.h"
+#include "unit_common.h"
+
+using std::shared_ptr;
+using std::vector;
+
+extern "C" {
+        int replay_ring_test_keyframe_eviction();
+}
+
+#if defined HAVE_LAVC
+#define GOP 4
+#define FRAMES 30
+
+/// keyframe detection independent of video_frame::frame_type
+static bool contains_idr(const struct video_frame *f)
+{
+        const auto *data = (const unsigned char *) f->tiles[0].data;
+        const long len = f->tiles[0].data_len;
+        for (const unsigned char *nal = rtpenc_get_first_nal(data, len, false); nal != nullptr;
+                        nal = rtpenc_get_next_nal(nal, len - (nal - data), nullptr)) {
+                if (H264_NALU_HDR_GET_TYPE(nal[0]) == NAL_H264_IDR) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+/// @returns frames encoded by libavcodec as on the sender, empty if the encoder is not available
+static vector<shared_ptr<video_frame>> encode_frames()
+{
+        vector<shared_ptr<video_frame>> ret;
+        struct compress_state *compress = nullptr;
+        if (compress_init(nullptr, "libavcodec:codec=H.264:gop=" TOSTRING(GOP), &compress) != 0) {
+                return ret;
+        }
+        std::thread consumer([&] {
+                while (shared_ptr<video_frame> f = compress_pop(compress)) {
+                        ret.push_back(f);
+                }
+        });
+        const struct video_desc desc = { 64, 64, UYVY, 30.0, PROGRESSIVE, 1 };
+        for (int i = 0; i < FRAMES; ++i) {
+                shared_ptr<video_frame> f(vf_alloc_desc_data(desc), vf_free);
+                for (unsigned j = 0; j < f->tiles[0].data_len; ++j) {
+                        f->tiles[0].data[j] = rand() % 256; // so that P-frames are not empty
+                }
+                compress_frame(compress, f);
+        }
+        compress_frame(compress, {}); // poison pill
+        consumer.join();
+        compress_done(compress);
+        return ret;
+}
+#endif // defined HAVE_LAVC
+
+/**
+ * Frames from the encoder must be marked as keyframes according to the
+ * bitstream, the ring must start with a keyframe, evict whole GOPs and
+ * the dump must produce the export layout.
+ */
+int replay_ring_test_keyframe_eviction()
+{
+#if defined HAVE_LAVC
+        vector<shared_ptr<video_frame>> frames = encode_frames();
+        if (frames.size() < FRAMES) {
+                return 0; // H.264 encoder not available
+        }
+        size_t total_len = 0;
+        for (auto &f : frames) {
+                ASSERT_EQUAL(contains_idr(f.get()) ? INTRA : OTHER, f->frame_type);
+                total_len += f->tiles[0].data_len;
+        }
+        ASSERT_MESSAGE("the stream must start with IDR", contains_idr(frames[0].get()));
+
+        const size_t cap = total_len / 3;
+        struct replay_ring *ring = replay_ring_init(3600, cap);
+        ASSERT(ring != nullptr);
+        struct replay_ring_stats stats;
+        bool evicted = false;
+        // the first GOP is fed without its keyframe - not decodable, must be skipped
+        for (unsigned i = 1; i < frames.size(); ++i) {
+                replay_ring_add_video(ring, frames[i].get());
+                replay_ring_get_stats(ring, &stats);
+                ASSERT(stats.bytes <= cap);
+                if (i < GOP) {
+                        ASSERT_EQUAL(0, stats.video_frames);
+                        continue;
+                }
+                ASSERT(stats.video_frames > 0);
+                evicted = evicted || stats.video_frames < (int) (i - GOP + 1);
+                // the ring always starts with a keyframe
+                ASSERT(contains_idr(frames[i + 1 - stats.video_frames].get()));
+        }
+        ASSERT_MESSAGE("size cap not reached", evicted);
+
+        char dir[] = "/tmp/replay_ring_test.XXXXXX";
+        ASSERT(mkdtemp(dir) != nullptr);
+        ASSERT(replay_ring_dump(ring, dir, true, true));
+        replay_ring_destroy(ring); // waits for the dump
+        const std::string info = std::string(dir) + "/video.info";
+        bool info_exists = access(info.c_str(), F_OK) == 0;
+        const std::string cmd = std::string("rm -r ") + dir;
+        ASSERT(system(cmd.c_str()) == 0);
+        ASSERT_MESSAGE("video.info not written", info_exists);
+#endif // defined HAVE_LAVC
+        return 0;
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -0,0 +1,74 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <cstdlib>
+
+#include "rtp/rtp.h"
+#include "tv.h"
+#include "unit_common.h"
+
+extern "C" {
+        int rtcp_thread_test_receiver_report();
+}
+
+#define TIMEOUT (8 * NS_IN_SEC) ///< initial RTCP interval is randomized up to 3.75 s
+
+namespace {
+struct rr_state {
+        uint32_t reporter;
+        uint32_t reportee;
+        int count;
+};
+} // end of anonymous namespace
+
+static void callback(struct rtp *session, rtp_event *e)
+{
+        auto *s = reinterpret_cast<rr_state *>(rtp_get_userdata(session));
+        if (e->type == RX_RTP) {
+                free(e->data);
+        } else if (e->type == RX_RR && s != nullptr && e->ssrc == s->reporter &&
+                        static_cast<rtcp_rr *>(e->data)->ssrc == s->reportee) {
+                s->count += 1;
+        }
+}
+
+/**
+ * Multithreaded receiver (with the RTCP thread) must report the reception
+ * of a sender's stream, the report is scheduled by the RTCP thread and sent
+ * once rtp_send_ctrl() is called.
+ */
+int rtcp_thread_test_receiver_report()
+{
+        const int port = 6000 + rand() % 1000 * 4;
+        rr_state state{};
+        struct rtp *sender = rtp_init_if("127.0.0.1", nullptr, port, port + 2, 255, 5000000, 0, callback,
+                        reinterpret_cast<uint8_t *>(&state), 4, false);
+        struct rtp *receiver = rtp_init_if("127.0.0.1", nullptr, port + 2, port, 255, 5000000, 0, callback,
+                        nullptr, 4, true);
+        ASSERT_MESSAGE("Cannot create RTP sessions", sender != nullptr && receiver != nullptr);
+        // sessions created at once may get the same random SSRC
+        ASSERT(rtp_set_my_ssrc(sender, rtp_my_ssrc(receiver) ^ 1));
+        rtp_set_option(receiver, RTP_OPT_PROMISC, TRUE);
+        state.reporter = rtp_my_ssrc(receiver);
+        state.reportee = rtp_my_ssrc(sender);
+
+        char data[100] = "";
+        const time_ns_t end = get_time_in_ns() + TIMEOUT;
+        for (uint32_t ts = 0; state.count == 0 && get_time_in_ns() < end; ts += 1000) {
+                rtp_send_data(sender, ts, 96, 0, 0, nullptr, data, sizeof data, nullptr, 0, 0);
+                struct timeval timeout = { 0, 10000 };
+                rtp_recv_r(receiver, &timeout, ts);
+                const time_ns_t now = get_time_in_ns();
+                rtp_send_ctrl(receiver, ts, nullptr, now);
+                rtp_update(receiver, now);
+                timeout = { 0, 0 };
+                rtp_recv_r(sender, &timeout, ts);
+        }
+        rtp_done(receiver);
+        rtp_done(sender);
+        ASSERT_MESSAGE("Receiver report not received", state.count > 0);
+        return 0;
+}
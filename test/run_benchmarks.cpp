@@ -0,0 +1,802 @@
+/**
+ * @file    run_benchmarks.cpp
+ * @author  Martin Pulec     <pulec@cesnet.cz>
+ *
+ * Microbenchmarks of core data structures and hot utility paths. Each
+ * benchmark prints one JSON object per line to stdout with nanoseconds per
+ * operation, throughput (where applicable) and number of heap allocations
+ * per operation so that the output can be compared between revisions.
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "audio/export.h"
+#include "capture_filter.h"
+#include "crypto/crc.h"
+#include "crypto/openssl_decrypt.h"
+#include "crypto/openssl_encrypt.h"
+#include "debug.h"
+#include "host.h"
+#include "lib_common.h"
+#include "module.h"
+#include "pdb.h"
+#include "rtp/fec.h"
+#include "rtp/ldgm.h"
+#include "rtp/pbuf.h"
+#include "rtp/rs.h"
+#include "rtp/rtp.h"
+#include "rtp/rtpenc_h264.h"
+#include "transmit.h"
+#include "tv.h"
+#include "utils/audio_buffer.h"
+#include "utils/pixelate.h"
+#include "utils/ring_buffer.h"
+#include "utils/synchronized_queue.h"
+#include "utils/uyvy_scale.h"
+#include "utils/video_pattern_generator.h"
+#include "utils/vf_split.h"
+#include "utils/video_frame_pool.h"
+#include "video.h"
+#include "tools/ipc_frame.h"
+#include "tools/ipc_frame_ug.h"
+
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::function;
+using std::map;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+/*
+ * Allocation counting - glibc exports its allocator under __libc_* names so
+ * that we can interpose the public symbols and forward to them.
+ */
+static std::atomic<long> alloc_count{0};
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size)
+{
+        alloc_count.fetch_add(1, std::memory_order_relaxed);
+        return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+        alloc_count.fetch_add(1, std::memory_order_relaxed);
+        return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+        alloc_count.fetch_add(1, std::memory_order_relaxed);
+        return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+        alloc_count.fetch_add(1, std::memory_order_relaxed);
+        *memptr = __libc_memalign(alignment, size);
+        return *memptr == nullptr ? ENOMEM : 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+        alloc_count.fetch_add(1, std::memory_order_relaxed);
+        return __libc_memalign(alignment, size);
+}
+} // extern "C"
+#define ALLOCS_COUNTED 1
+#else
+#define ALLOCS_COUNTED 0
+#endif
+
+static double min_time = 0.2; ///< minimal measured time per benchmark [s]
+static FILE *json_out;         ///< original stdout, stdout itself is redirected to stderr
+
+/**
+ * Benchmark body - performs n operations, bytes_per_op is used to compute
+ * throughput (0 if not applicable).
+ */
+struct benchmark {
+        const char *name;
+        long bytes_per_op;
+        function<void(long n)> run;
+};
+
+static void report(const char *name, long iterations, time_ns_t duration, long bytes_per_op, long allocs)
+{
+        double ns_per_op = (double) duration / iterations;
+        fprintf(json_out, "{\"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.2f", name, iterations, ns_per_op);
+        if (bytes_per_op > 0) {
+                fprintf(json_out, ", \"bytes_per_s\": %.0f", bytes_per_op * NS_IN_SEC_DBL / ns_per_op);
+        }
+        if (ALLOCS_COUNTED) {
+                fprintf(json_out, ", \"allocs_per_op\": %.3f", (double) allocs / iterations);
+        }
+        fprintf(json_out, "}\n");
+        fflush(json_out);
+}
+
+/// iterations are scaled until the run takes at least min_time
+static void run_benchmark(const struct benchmark &b)
+{
+        b.run(1); // warm-up
+        long n = 1;
+        while (true) {
+                long allocs_start = alloc_count.load();
+                const auto t0 = steady_clock::now();
+                b.run(n);
+                time_ns_t duration = duration_cast<nanoseconds>(steady_clock::now() - t0).count();
+                long allocs = alloc_count.load() - allocs_start;
+                if (duration >= min_time * NS_IN_SEC || n >= 1000000000L) {
+                        report(b.name, n, duration, b.bytes_per_op, allocs);
+                        return;
+                }
+                long next = duration > 0 ? (long) (n * min_time * NS_IN_SEC_DBL / duration * 1.2) : n * 100;
+                n = std::max(n + 1, std::min(next, n * 100));
+        }
+}
+
+/// prevents the compiler from optimizing out the computation
+template<typename T> static inline void do_not_optimize(T const &val)
+{
+        asm volatile("" : : "g"(val) : "memory");
+}
+
+/*
+ * Individual benchmarks
+ */
+#define PBUF_PKTS_PER_FRAME 100
+#define PBUF_PKT_SIZE 1200
+
+static int pbuf_dummy_decode(struct coded_data *cdata, void *, struct pbuf_stats *)
+{
+        int len = 0;
+        for ( ; cdata != nullptr; cdata = cdata->nxt) {
+                len += cdata->data->data_len;
+        }
+        do_not_optimize(len);
+        return 1;
+}
+
+/// one op = insert of a frame worth of packets, decode and removal
+static void bench_pbuf(long n)
+{
+        struct pbuf *pbuf = pbuf_init(nullptr);
+        pbuf_set_playout_delay(pbuf, 0);
+        uint16_t seq = 0;
+        for (long i = 0; i < n; ++i) {
+                for (int j = 0; j < PBUF_PKTS_PER_FRAME; ++j) {
+                        auto *pkt = (rtp_packet *) malloc(sizeof(rtp_packet) + PBUF_PKT_SIZE);
+                        memset(pkt, 0, sizeof *pkt);
+                        pkt->data = (char *) (pkt + 1);
+                        pkt->data_len = PBUF_PKT_SIZE;
+                        pkt->seq = seq++;
+                        pkt->ts = i * 3000;
+                        pkt->m = j == PBUF_PKTS_PER_FRAME - 1;
+                        pbuf_insert(pbuf, pkt);
+                }
+                time_ns_t now = get_time_in_ns();
+                pbuf_decode(pbuf, now + NS_IN_SEC, pbuf_dummy_decode, nullptr);
+                pbuf_remove(pbuf, now + 2 * NS_IN_SEC);
+        }
+        pbuf_destroy(pbuf);
+}
+
+static void bench_synchronized_queue(long n)
+{
+        synchronized_queue<int, -1> q;
+        for (long i = 0; i < n; ++i) {
+                q.push(i);
+                do_not_optimize(q.pop());
+        }
+}
+
+/// producer and consumer in separate threads, one op = one passed item
+static void bench_synchronized_queue_mt(long n)
+{
+        synchronized_queue<int, 64> q;
+        std::thread producer([&q, n]() {
+                for (long i = 0; i < n; ++i) {
+                        q.push(i);
+                }
+        });
+        for (long i = 0; i < n; ++i) {
+                do_not_optimize(q.pop());
+        }
+        producer.join();
+}
+
+#define RING_CHUNK 4096
+
+static void bench_ring_buffer(long n)
+{
+        unique_ptr<ring_buffer_t, ring_buf_deleter> ring(ring_buffer_init(16 * RING_CHUNK));
+        vector<char> in(RING_CHUNK, 'x');
+        vector<char> out(RING_CHUNK);
+        for (long i = 0; i < n; ++i) {
+                ring_buffer_write(ring.get(), in.data(), RING_CHUNK);
+                do_not_optimize(ring_buffer_read(ring.get(), out.data(), RING_CHUNK));
+        }
+}
+
+#define AUDIO_BUF_CHUNK (480 * 4 * 2) // 10 ms of 48 kHz 32-bit stereo
+
+static void bench_audio_buffer(long n)
+{
+        struct audio_buffer *buf = audio_buffer_init(48000, 4, 2, 50);
+        vector<char> in(AUDIO_BUF_CHUNK, 'x');
+        vector<char> out(AUDIO_BUF_CHUNK);
+        for (long i = 0; i < n; ++i) {
+                audio_buffer_write(buf, in.data(), AUDIO_BUF_CHUNK);
+                do_not_optimize(audio_buffer_read(buf, out.data(), AUDIO_BUF_CHUNK));
+        }
+        audio_buffer_destroy(buf);
+}
+
+#define EXPORT_CH_COUNT 8
+#define EXPORT_SAMPLE_RATE 96000
+#define EXPORT_CHUNK (EXPORT_SAMPLE_RATE / 100) // 10 ms
+#define EXPORT_OP_CHUNKS 100                    // 1 s of audio per op
+#define EXPORT_OPS_PER_FILE 3                   // fits into the exporter ring so nothing is dropped
+
+/// one op = 1 s of 96 kHz 32-bit 8-channel audio exported to a WAV file (including write-out)
+static void bench_audio_export(long n)
+{
+        const char *tmpdir = getenv("TMPDIR") != nullptr ? getenv("TMPDIR") : "/tmp";
+        string filename = string(tmpdir) + "/ug_bench_audio_export.wav";
+        vector<vector<char>> channels(EXPORT_CH_COUNT, vector<char>(EXPORT_CHUNK * 4, 'x'));
+        vector<const void *> channels_data;
+        for (auto const &ch : channels) {
+                channels_data.push_back(ch.data());
+        }
+        for (long i = 0; i < n; i += EXPORT_OPS_PER_FILE) {
+                struct audio_export *exp = audio_export_init(filename.c_str());
+                if (exp == nullptr || !audio_export_configure_raw(exp, 4, EXPORT_SAMPLE_RATE, EXPORT_CH_COUNT)) {
+                        throw std::runtime_error("cannot initialize audio export");
+                }
+                for (long j = 0; j < std::min<long>(EXPORT_OPS_PER_FILE, n - i) * EXPORT_OP_CHUNKS; ++j) {
+                        audio_export_raw_ch(exp, channels_data.data(), EXPORT_CHUNK);
+                }
+                audio_export_destroy(exp);
+        }
+        unlink(filename.c_str());
+}
+
+static void bench_video_frame_pool(long n)
+{
+        video_frame_pool pool(4);
+        pool.reconfigure(video_desc{1920, 1080, UYVY, 30, PROGRESSIVE, 1});
+        for (long i = 0; i < n; ++i) {
+                shared_ptr<video_frame> f = pool.get_frame();
+                do_not_optimize(f->tiles[0].data);
+        }
+}
+
+#define PDB_PARTICIPANTS 64
+
+/// participant database (per-sender decoder state) lookup by SSRC
+static void bench_pdb_get(long n)
+{
+        struct pdb *db = pdb_init(nullptr);
+        for (uint32_t i = 0; i < PDB_PARTICIPANTS; ++i) {
+                pdb_add(db, i * 0x9E3779B9U);
+        }
+        for (long i = 0; i < n; ++i) {
+                do_not_optimize(pdb_get(db, (i % PDB_PARTICIPANTS) * 0x9E3779B9U));
+        }
+        pdb_destroy(&db);
+}
+
+#define RTP_BENCH_BATCH 32
+#define RTP_BENCH_PAYLOAD 100
+static long rtp_bench_received;
+
+/**
+ * one op = one RTP packet sent to ourselves over loopback and received by
+ * rtp_recv_r(), incl. the lookup of its source (one of PDB_PARTICIPANTS SSRCs)
+ * in the RTP session source database
+ */
+static void bench_rtp_recv_sources(long n)
+{
+        auto callback = [](struct rtp *, rtp_event *e) {
+                if (e->type == RX_RTP) {
+                        rtp_bench_received += 1;
+                        free(e->data);
+                }
+        };
+        const int port = 5000 + rand() % 1000 * 2;
+        struct rtp *session = rtp_init("127.0.0.1", port, port, 255, 0, 0, callback, nullptr, 4, true);
+        if (session == nullptr) {
+                throw std::runtime_error("cannot initialize RTP session");
+        }
+        rtp_set_option(session, RTP_OPT_PROMISC, true);
+        rtp_set_recv_buf(session, 4 * 1024 * 1024);
+
+        unsigned char pkt[12 + RTP_BENCH_PAYLOAD] = { 0x80, 96 };
+        rtp_bench_received = 0;
+        long sent = 0;
+        while (sent < n) {
+                const long batch_end = std::min(n, sent + RTP_BENCH_BATCH);
+                for ( ; sent < batch_end; ++sent) {
+                        const uint16_t seq = htons(sent / PDB_PARTICIPANTS);
+                        const uint32_t ssrc = htonl((sent % PDB_PARTICIPANTS + 1) * 0x9E3779B9U);
+                        memcpy(pkt + 2, &seq, sizeof seq);
+                        memcpy(pkt + 8, &ssrc, sizeof ssrc);
+                        rtp_send_raw_rtp_data(session, (char *) pkt, sizeof pkt);
+                }
+                struct timeval timeout = { 0, 100000 };
+                while (rtp_bench_received < sent && rtp_recv_r(session, &timeout, 0)) {
+                }
+                if (rtp_bench_received < sent) {
+                        throw std::runtime_error("RTP packets lost on loopback");
+                }
+        }
+        rtp_done(session);
+}
+
+#define CRC_BUF_LEN (1024 * 1024)
+
+static void bench_crc32(long n)
+{
+        vector<char> buf(CRC_BUF_LEN, 'x');
+        for (long i = 0; i < n; ++i) {
+                do_not_optimize(crc32buf(buf.data(), buf.size()));
+        }
+}
+
+#define CRYPTO_PKT_LEN 1200
+#define CRYPTO_AAD_LEN 12
+
+static void bench_crypto(long n, enum openssl_mode mode, bool decrypt)
+{
+        const auto *enc = (const struct openssl_encrypt_info *) load_library("openssl_encrypt",
+                        LIBRARY_CLASS_UNDEFINED, OPENSSL_ENCRYPT_ABI_VERSION);
+        const auto *dec = (const struct openssl_decrypt_info *) load_library("openssl_decrypt",
+                        LIBRARY_CLASS_UNDEFINED, OPENSSL_DECRYPT_ABI_VERSION);
+        if (enc == nullptr || dec == nullptr) {
+                throw std::runtime_error("OpenSSL encryption not available");
+        }
+        string passphrase = string("secret:cipher=") + (mode == MODE_AES128_GCM ? "gcm" : "ctr");
+        struct openssl_encrypt *e = nullptr;
+        struct openssl_decrypt *d = nullptr;
+        if (enc->init(&e, passphrase.c_str()) != 0 || dec->init(&d, passphrase.c_str()) != 0) {
+                throw std::runtime_error("Unable to initialize encryption");
+        }
+        vector<char> plain(CRYPTO_PKT_LEN, 'x');
+        vector<char> aad(CRYPTO_AAD_LEN, 'a');
+        vector<char> cipher(CRYPTO_PKT_LEN + MAX_CRYPTO_EXCEED);
+        int cipher_len = enc->encrypt(e, plain.data(), plain.size(), aad.data(), aad.size(), cipher.data());
+        bool ok = cipher_len > 0;
+        for (long i = 0; i < n && ok; ++i) {
+                if (decrypt) {
+                        ok = dec->decrypt(d, cipher.data(), cipher_len, aad.data(), aad.size(),
+                                        plain.data(), mode) == CRYPTO_PKT_LEN;
+                } else {
+                        ok = enc->encrypt(e, plain.data(), plain.size(), aad.data(), aad.size(),
+                                        cipher.data()) > 0;
+                }
+        }
+        enc->destroy(e);
+        dec->destroy(d);
+        if (!ok) {
+                throw std::runtime_error(decrypt ? "Decryption failed" : "Encryption failed");
+        }
+}
+
+static shared_ptr<video_frame> get_fec_input_frame()
+{
+        shared_ptr<video_frame> f(vf_alloc_desc_data(video_desc{1280, 720, UYVY, 30, PROGRESSIVE, 1}), vf_free);
+        for (unsigned int i = 0; i < f->tiles[0].data_len; ++i) {
+                f->tiles[0].data[i] = i * 7;
+        }
+        return f;
+}
+
+static void bench_fec_encode(long n, fec *enc)
+{
+        auto in = get_fec_input_frame();
+        for (long i = 0; i < n; ++i) {
+                shared_ptr<video_frame> out = enc->encode(in);
+                do_not_optimize(out->tiles[0].data);
+        }
+}
+
+/// decodes a frame with every 20th symbol missing
+static void bench_fec_decode(long n, fec *enc, fec *dec)
+{
+        shared_ptr<video_frame> encoded = enc->encode(get_fec_input_frame());
+        int symbol_size = encoded->fec_params.symbol_size;
+        int len = encoded->tiles[0].data_len;
+        map<int, int> packets;
+        for (int off = 0, i = 0; off < len; off += symbol_size, ++i) {
+                if (i % 20 != 19) {
+                        packets[off] = std::min(symbol_size, len - off);
+                }
+        }
+        vector<char> received(encoded->tiles[0].data, encoded->tiles[0].data + len);
+        for (long i = 0; i < n; ++i) {
+                char *out = nullptr;
+                int out_len = 0;
+                if (!dec->decode(received.data(), len, &out, &out_len, packets)) {
+                        throw std::runtime_error("FEC decoding failed");
+                }
+                do_not_optimize(out);
+        }
+}
+
+static void bench_vf_split(long n)
+{
+        struct video_desc desc{3840, 2160, UYVY, 30, PROGRESSIVE, 1};
+        unique_ptr<video_frame, void (*)(video_frame *)> src(vf_alloc_desc_data(desc), vf_free);
+        struct video_desc out_desc = desc;
+        out_desc.width /= 2;
+        out_desc.height /= 2;
+        out_desc.tile_count = 4;
+        unique_ptr<video_frame, void (*)(video_frame *)> out(vf_alloc_desc_data(out_desc), vf_free);
+        for (long i = 0; i < n; ++i) {
+                vf_split(out.get(), src.get(), 2, 2, 0);
+        }
+}
+
+#define NAL_BUF_LEN (1024 * 1024)
+#define NAL_SIZE 1400
+
+/// synthetic Annex-B stream of NAL_SIZE-long NAL units
+static vector<unsigned char> get_annexb_buffer()
+{
+        vector<unsigned char> buf(NAL_BUF_LEN);
+        for (size_t i = 0; i < buf.size(); ++i) {
+                buf[i] = (i * 31 + 1) | 0x4; // no zero bytes, therefore no start code
+        }
+        for (size_t i = 0; i + 4 < buf.size(); i += NAL_SIZE) {
+                buf[i] = buf[i + 1] = buf[i + 2] = 0;
+                buf[i + 3] = 1;
+                buf[i + 4] = 1; // non-IDR slice
+        }
+        return buf;
+}
+
+static void bench_get_next_nal(long n)
+{
+        auto buf = get_annexb_buffer();
+        for (long i = 0; i < n; ++i) {
+                const unsigned char *endptr = nullptr;
+                const unsigned char *nal = rtpenc_get_first_nal(buf.data(), buf.size(), false);
+                const unsigned char *end = buf.data() + buf.size();
+                while (nal != nullptr) {
+                        do_not_optimize(nal);
+                        nal = rtpenc_get_next_nal(nal, end - nal, &endptr);
+                }
+        }
+}
+
+/*
+ * Synthetic in-place capture filter "bench_work[:<passes>]" to measure the
+ * capture filter chain itself (real filters are not linked to benchmarks).
+ */
+static int bench_work_init(struct module *, const char *cfg, void **state)
+{
+        *state = (void *) (intptr_t) std::max(1, atoi(cfg));
+        return 0;
+}
+
+static void bench_work_done(void *) {}
+
+static struct video_frame *bench_work_filter(void *state, struct video_frame *f)
+{
+        const int passes = (int) (intptr_t) state;
+        auto *data = (unsigned char *) f->tiles[0].data;
+        for (int p = 0; p < passes; ++p) {
+                for (unsigned i = 1; i < f->tiles[0].data_len; ++i) {
+                        data[i] = (data[i] + data[i - 1]) / 2;
+                }
+        }
+        return f;
+}
+
+static const struct capture_filter_info capture_filter_bench_work = {
+        bench_work_init,
+        bench_work_done,
+        bench_work_filter,
+        nullptr,
+        nullptr,
+};
+
+REGISTER_HIDDEN_MODULE(bench_work, &capture_filter_bench_work, LIBRARY_CLASS_CAPTURE_FILTER, CAPTURE_FILTER_ABI_VERSION);
+
+#define CF_WIDTH 1920
+#define CF_HEIGHT 1080
+
+/// one op = one testcard frame through the whole chain
+static void bench_capture_filter_chain(long n, const char *cfg)
+{
+        struct capture_filter *cf = nullptr;
+        if (capture_filter_init(nullptr, cfg, &cf) != 0) {
+                throw std::runtime_error("cannot initialize capture filter");
+        }
+        video_pattern_generator_t gen = video_pattern_generator_create("bars", CF_WIDTH, CF_HEIGHT, UYVY, 0);
+        struct video_frame *in = vf_alloc_desc(video_desc{CF_WIDTH, CF_HEIGHT, UYVY, 30, PROGRESSIVE, 1});
+        in->tiles[0].data = video_pattern_generator_next_frame(gen);
+
+        long received = 0;
+        for (long i = 0; i < n || received < n; ++i) {
+                struct video_frame *out = i < n ? capture_filter(cf, in) : capture_filter_drain(cf);
+                if (out != nullptr) {
+                        received += 1;
+                        VIDEO_FRAME_DISPOSE(out);
+                }
+        }
+
+        vf_free(in);
+        video_pattern_generator_destroy(gen);
+        capture_filter_destroy(cf);
+}
+
+/// one op = one 1080p UYVY frame scaled to a 2x2 mix cell
+static void bench_uyvy_scale(long n)
+{
+        constexpr int w = 1920;
+        constexpr int h = 1080;
+        vector<char> in(w * h * 2);
+        vector<char> out(w * h * 2);
+        for (size_t i = 0; i < in.size(); ++i) {
+                in[i] = (char) (i * 7);
+        }
+        struct uyvy_scaler *s = uyvy_scaler_create(w, h, w / 2, h / 2);
+        for (long i = 0; i < n; ++i) {
+                uyvy_scaler_scale(s, in.data(), w * 2, out.data(), w * 2, 0, h / 2);
+        }
+        uyvy_scaler_destroy(s);
+}
+
+/// planar (semi-planar) <-> packed conversions of a 1080p frame
+static void bench_semiplanar_conv(long n, codec_t in_codec, codec_t out_codec,
+                                  void (*conv)(int, int, const unsigned char *, unsigned char *))
+{
+        constexpr int w = 1920;
+        constexpr int h = 1080;
+        vector<unsigned char> in(vc_get_datalen(w, h, in_codec));
+        vector<unsigned char> out(vc_get_datalen(w, h, out_codec));
+        for (size_t i = 0; i < in.size(); ++i) {
+                in[i] = (unsigned char) (i * 7);
+        }
+        for (long i = 0; i < n; ++i) {
+                conv(w, h, in.data(), out.data());
+        }
+}
+
+/// one op = 1080p frame to RGB 1/8-scale preview thumbnail (as the preview capture filter does)
+static void bench_ipc_preview(long n, codec_t codec, bool hq)
+{
+        unique_ptr<video_frame, void (*)(video_frame *)> src(vf_alloc_desc_data(video_desc{1920, 1080, codec, 30, PROGRESSIVE, 1}), vf_free);
+        for (unsigned i = 0; i < src->tiles[0].data_len; ++i) {
+                src->tiles[0].data[i] = (char) (i * 7);
+        }
+        Ipc_frame_uniq ipc_frame(ipc_frame_new());
+        auto conv = hq ? ipc_frame_from_ug_frame_hq : ipc_frame_from_ug_frame;
+        for (long i = 0; i < n; ++i) {
+                if (!conv(ipc_frame.get(), src.get(), RGB, 8)) {
+                        throw std::runtime_error("ipc frame conversion failed");
+                }
+        }
+}
+
+#define MASK_RECTS 32
+
+/// one op = MASK_RECTS privacy masks (160x120) in a 4K frame as the blank capture filter does
+static void bench_pixelate(long n, codec_t codec, int block)
+{
+        unique_ptr<video_frame, void (*)(video_frame *)> frame(vf_alloc_desc_data(video_desc{3840, 2160, codec, 30, PROGRESSIVE, 1}), vf_free);
+        for (unsigned i = 0; i < frame->tiles[0].data_len; ++i) {
+                frame->tiles[0].data[i] = (char) (i * 7);
+        }
+        unique_ptr<pixelator, void (*)(pixelator *)> p(pixelator_create(), pixelator_destroy);
+        for (long i = 0; i < n; ++i) {
+                for (int r = 0; r < MASK_RECTS; ++r) {
+                        pixelator_apply(p.get(), frame->tiles[0].data, codec, 3840, 2160,
+                                        100 + r % 8 * 450, 100 + r / 8 * 500, 160, 120, block);
+                }
+        }
+}
+
+#define TX_BENCH_PORT 10 ///< even (RTP), packets are not received
+
+/// one op = one 1080p UYVY frame sent by tx_send() to localhost
+static void bench_tx_send(long n, const char *threads)
+{
+        set_commandline_param("tx-threads", threads);
+        struct tx *tx = tx_init(nullptr, 1500, TX_MEDIA_VIDEO, nullptr, "", RATE_UNLIMITED);
+        auto dummy_callback = [](struct rtp *, rtp_event *) {};
+        struct rtp *session = rtp_init("127.0.0.1", 0, TX_BENCH_PORT, 255, 0, 0, dummy_callback, nullptr, 4, false);
+        if (tx == nullptr || session == nullptr) {
+                throw std::runtime_error("cannot initialize transmission");
+        }
+        struct video_frame *frame = vf_alloc_desc_data(video_desc{1920, 1080, UYVY, 30, PROGRESSIVE, 1});
+        for (long i = 0; i < n; ++i) {
+                tx_send(tx, frame, session);
+        }
+        vf_free(frame);
+        rtp_done(session);
+        module_done(CAST_MODULE(tx));
+}
+
+static vector<struct benchmark> get_benchmarks()
+{
+        static unique_ptr<fec> ldgm_enc;
+        static unique_ptr<fec> ldgm_dec;
+        ldgm_enc.reset(new ldgm(256, 192, 5, 1));
+        ldgm_dec.reset(new ldgm(256, 192, 5, 1));
+#ifdef HAVE_ZFEC
+        static unique_ptr<fec> rs_enc;
+        static unique_ptr<fec> rs_dec;
+        rs_enc.reset(new rs(200, 220));
+        rs_dec.reset(new rs(200, 220));
+#endif
+
+        vector<struct benchmark> ret{
+                { "pbuf_insert_decode", PBUF_PKTS_PER_FRAME * PBUF_PKT_SIZE, bench_pbuf },
+                { "synchronized_queue", 0, bench_synchronized_queue },
+                { "synchronized_queue_mt", 0, bench_synchronized_queue_mt },
+                { "ring_buffer", RING_CHUNK, bench_ring_buffer },
+                { "audio_buffer", AUDIO_BUF_CHUNK, bench_audio_buffer },
+                { "audio_export", EXPORT_SAMPLE_RATE * EXPORT_CH_COUNT * 4, bench_audio_export },
+                { "video_frame_pool", 0, bench_video_frame_pool },
+                { "pdb_get", 0, bench_pdb_get },
+                { "rtp_recv_sources", 0, bench_rtp_recv_sources },
+                { "crc32buf", CRC_BUF_LEN, bench_crc32 },
+                { "openssl_encrypt_ctr", CRYPTO_PKT_LEN, [](long n) { bench_crypto(n, MODE_AES128_CTR, false); } },
+                { "openssl_decrypt_ctr", CRYPTO_PKT_LEN, [](long n) { bench_crypto(n, MODE_AES128_CTR, true); } },
+                { "openssl_encrypt_gcm", CRYPTO_PKT_LEN, [](long n) { bench_crypto(n, MODE_AES128_GCM, false); } },
+                { "openssl_decrypt_gcm", CRYPTO_PKT_LEN, [](long n) { bench_crypto(n, MODE_AES128_GCM, true); } },
+                { "ldgm_encode", 1280 * 720 * 2, [](long n) { bench_fec_encode(n, ldgm_enc.get()); } },
+                { "ldgm_decode", 1280 * 720 * 2, [](long n) { bench_fec_decode(n, ldgm_enc.get(), ldgm_dec.get()); } },
+#ifdef HAVE_ZFEC
+                { "rs_encode", 1280 * 720 * 2, [](long n) { bench_fec_encode(n, rs_enc.get()); } },
+                { "rs_decode", 1280 * 720 * 2, [](long n) { bench_fec_decode(n, rs_enc.get(), rs_dec.get()); } },
+#endif
+                { "vf_split_2x2", 3840 * 2160 * 2, bench_vf_split },
+                { "uyvy_scale_half", 1920 * 1080 * 2, bench_uyvy_scale },
+                { "tx_send_serial", 1920 * 1080 * 2, [](long n) { bench_tx_send(n, "1"); } },
+                { "tx_send_striped_4", 1920 * 1080 * 2, [](long n) { bench_tx_send(n, "4"); } },
+                { "ipc_preview_uyvy", 1920 * 1080 * 2, [](long n) { bench_ipc_preview(n, UYVY, false); } },
+                { "ipc_preview_uyvy_hq", 1920 * 1080 * 2, [](long n) { bench_ipc_preview(n, UYVY, true); } },
+                { "ipc_preview_v210_hq", 1920 * 1080 * 8 / 3, [](long n) { bench_ipc_preview(n, v210, true); } },
+                { "ipc_preview_rgba_hq", 1920 * 1080 * 4, [](long n) { bench_ipc_preview(n, RGBA, true); } },
+                { "pixelate_uyvy", MASK_RECTS * 160 * 120 * 2, [](long n) { bench_pixelate(n, UYVY, 16); } },
+                { "pixelate_v210", MASK_RECTS * 160 * 120 * 8 / 3, [](long n) { bench_pixelate(n, v210, 16); } },
+                { "pixelate_rgba", MASK_RECTS * 160 * 120 * 4, [](long n) { bench_pixelate(n, RGBA, 16); } },
+                { "pixelate_i420", MASK_RECTS * 160 * 120 * 3 / 2, [](long n) { bench_pixelate(n, I420, 16); } },
+                { "blank_uyvy", MASK_RECTS * 160 * 120 * 2, [](long n) { bench_pixelate(n, UYVY, 0); } },
+                { "uyvy_to_nv12", 1920 * 1080 * 2, [](long n) { bench_semiplanar_conv(n, UYVY, NV12, uyvy_to_nv12); } },
+                { "nv12_to_uyvy", 1920 * 1080 * 2, [](long n) { bench_semiplanar_conv(n, NV12, UYVY, nv12_to_uyvy); } },
+                { "v210_to_p010", 1920 * 1080 * 8 / 3, [](long n) { bench_semiplanar_conv(n, v210, P010, v210_to_p010); } },
+                { "p010_to_v210", 1920 * 1080 * 8 / 3, [](long n) { bench_semiplanar_conv(n, P010, v210, p010_to_v210); } },
+                { "rtpenc_get_next_nal", NAL_BUF_LEN, bench_get_next_nal },
+                { "capture_filter_chain_serial", CF_WIDTH * CF_HEIGHT * 2,
+                  [](long n) { bench_capture_filter_chain(n, "bench_work:2,bench_work:2,bench_work:2"); } },
+                { "capture_filter_chain_pipeline", CF_WIDTH * CF_HEIGHT * 2,
+                  [](long n) { bench_capture_filter_chain(n, "bench_work:2|bench_work:2|bench_work:2"); } },
+        };
+        return ret;
+}
+
+int main(int argc, char **argv)
+{
+        if (argc > 1 && (strcmp("-h", argv[1]) == 0 || strcmp("--help", argv[1]) == 0)) {
+                printf("Usage:\n\t%s [-V] [--min-time <s>] [ all | <benchmark_name> | -h | --help ]\n", argv[0]);
+                printf("\nwhere\n"
+                       "\t-V[V[V]] | --verbose - verbose (use UG log level verbose/debug/debug2, default fatal)\n"
+                       "\t  --min-time <s>     - minimal duration of a single benchmark (default %.1f s)\n"
+                       "\t  <benchmark_name>   - run only benchmarks containing given string\n", min_time);
+                printf("\nOutput is one JSON object per benchmark and line.\n");
+                printf("\nAvailable benchmarks:\n");
+                for (auto const &b : get_benchmarks()) {
+                        printf(" - %s\n", b.name);
+                }
+                return 0;
+        }
+
+        // keep stdout clean for the results - some code (eg. LDGM) prints directly to stdout
+        fflush(stdout);
+        json_out = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+
+        log_level = LOG_LEVEL_FATAL;
+        struct init_data *init = NULL;
+        if ((init = common_preinit(argc, argv)) == NULL) {
+                return 2;
+        }
+
+        argc -= 1;
+        argv += 1;
+        if (argc >= 1 && (strstr(argv[0], "-V") == argv[0] || strstr(argv[0], "--verbose") == argv[0])) { // handled in common_preinit
+                argc -= 1;
+                argv += 1;
+        }
+        if (argc >= 2 && strcmp(argv[0], "--min-time") == 0) {
+                min_time = atof(argv[1]);
+                argc -= 2;
+                argv += 2;
+        }
+
+        const char *filter = NULL;
+        if (argc == 1 && strcmp("all", argv[0]) != 0) {
+                filter = argv[0];
+        }
+
+        for (auto const &b : get_benchmarks()) {
+                if (filter != NULL && strstr(b.name, filter) == NULL) {
+                        continue;
+                }
+                try {
+                        run_benchmark(b);
+                } catch (std::exception const &e) {
+                        fprintf(stderr, "%s: skipped - %s\n", b.name, e.what());
+                }
+        }
+
+        common_cleanup(init);
+
+        return 0;
+}
+
+/* vim: set expandtab sw=8 tw=120: */
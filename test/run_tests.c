@@ -75,7 +75,13 @@ long packet_rate = 13600;
 #define DEFINE_QUIET_TEST(func) { #func, func, true } // original tests that print status by itselves
 #define DEFINE_TEST(func) { #func, func, false }
 
+DECLARE_TEST(capture_filter_test_drop_next);
 DECLARE_TEST(codec_conversion_test_testcard_uyvy_to_i420);
+DECLARE_TEST(codec_conversion_test_semiplanar_roundtrip);
+DECLARE_TEST(echo_ring_test_format_change);
+DECLARE_TEST(echo_ring_test_read_frame);
+DECLARE_TEST(echo_ring_test_wrap_around);
+DECLARE_TEST(echo_test_wav_fixtures);
 DECLARE_TEST(ff_codec_conversions_test_yuv444pXXle_from_to_r10k);
 DECLARE_TEST(ff_codec_conversions_test_yuv444pXXle_from_to_r12l);
 DECLARE_TEST(ff_codec_conversions_test_yuv444p16le_from_to_rg48);
@@ -85,9 +91,30 @@ DECLARE_TEST(get_framerate_test_2997);
 DECLARE_TEST(get_framerate_test_3000);
 DECLARE_TEST(get_framerate_test_free);
 DECLARE_TEST(gpujpeg_test_simple);
+DECLARE_TEST(ipc_frame_ug_test_box_downscale);
 DECLARE_TEST(libavcodec_test_get_decoder_from_uv_to_uv);
 DECLARE_TEST(misc_test_replace_all);
 DECLARE_TEST(misc_test_video_desc_io_op_symmetry);
+DECLARE_TEST(net_impair_test_deterministic);
+DECLARE_TEST(net_impair_test_loss_rate);
+DECLARE_TEST(net_trace_test_write_read);
+DECLARE_TEST(parallel_probe_test_timeout_and_cache);
+DECLARE_TEST(parallel_probe_test_groups);
+DECLARE_TEST(path_sched_test_configured_weights);
+DECLARE_TEST(path_sched_test_loss_and_rtt);
+DECLARE_TEST(path_sched_test_failover);
+DECLARE_TEST(pixelate_test_block_average);
+DECLARE_TEST(replay_ring_test_keyframe_eviction);
+DECLARE_TEST(rtcp_thread_test_receiver_report);
+DECLARE_TEST(color_engine_test_matrix_lut);
+DECLARE_TEST(color_engine_test_rg48_lut_only);
+DECLARE_TEST(overload_ctl_test_throttled_decoder);
+DECLARE_TEST(udp_timestamping_test_loopback);
+DECLARE_TEST(uyvy_scale_test_blend);
+DECLARE_TEST(uyvy_scale_test_halve);
+DECLARE_TEST(uyvy_scale_test_generic);
+DECLARE_TEST(virtual_clock_test_fast_forward);
+DECLARE_TEST(virtual_clock_test_timed_wait);
 
 struct {
         const char *name;
@@ -106,7 +133,13 @@ struct {
         DEFINE_QUIET_TEST(test_video_capture),
         DEFINE_QUIET_TEST(test_video_display),
 #endif
+        DEFINE_TEST(capture_filter_test_drop_next),
         DEFINE_TEST(codec_conversion_test_testcard_uyvy_to_i420),
+        DEFINE_TEST(codec_conversion_test_semiplanar_roundtrip),
+        DEFINE_TEST(echo_ring_test_format_change),
+        DEFINE_TEST(echo_ring_test_read_frame),
+        DEFINE_TEST(echo_ring_test_wrap_around),
+        DEFINE_TEST(echo_test_wav_fixtures),
 #if defined HAVE_LAVC
         DEFINE_TEST(ff_codec_conversions_test_yuv444pXXle_from_to_r10k),
         DEFINE_TEST(ff_codec_conversions_test_yuv444pXXle_from_to_r12l),
@@ -118,9 +151,30 @@ struct {
         DEFINE_TEST(get_framerate_test_3000),
         DEFINE_TEST(get_framerate_test_free),
         DEFINE_TEST(gpujpeg_test_simple),
+        DEFINE_TEST(ipc_frame_ug_test_box_downscale),
         DEFINE_TEST(libavcodec_test_get_decoder_from_uv_to_uv),
         DEFINE_TEST(misc_test_replace_all),
         DEFINE_TEST(misc_test_video_desc_io_op_symmetry),
+        DEFINE_TEST(net_impair_test_deterministic),
+        DEFINE_TEST(net_impair_test_loss_rate),
+        DEFINE_TEST(net_trace_test_write_read),
+        DEFINE_TEST(parallel_probe_test_timeout_and_cache),
+        DEFINE_TEST(parallel_probe_test_groups),
+        DEFINE_TEST(path_sched_test_configured_weights),
+        DEFINE_TEST(path_sched_test_loss_and_rtt),
+        DEFINE_TEST(path_sched_test_failover),
+        DEFINE_TEST(pixelate_test_block_average),
+        DEFINE_TEST(replay_ring_test_keyframe_eviction),
+        DEFINE_TEST(rtcp_thread_test_receiver_report),
+        DEFINE_TEST(color_engine_test_matrix_lut),
+        DEFINE_TEST(color_engine_test_rg48_lut_only),
+        DEFINE_TEST(overload_ctl_test_throttled_decoder),
+        DEFINE_TEST(udp_timestamping_test_loopback),
+        DEFINE_TEST(uyvy_scale_test_blend),
+        DEFINE_TEST(uyvy_scale_test_halve),
+        DEFINE_TEST(uyvy_scale_test_generic),
+        DEFINE_TEST(virtual_clock_test_fast_forward),
+        DEFINE_TEST(virtual_clock_test_timed_wait),
 };
 
 static bool test_helper(const char *name, int (*func)(), bool quiet) {
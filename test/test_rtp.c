@@ -38,10 +38,66 @@
 
 int test_rtp(void)
 {
+        uint8_t buf[64];
+        uint32_t media_ssrc = 0;
+        uint32_t ssrc = 0;
+        uint32_t probe_seq = 0;
+        uint64_t send_time = 0;
+        bool echo = false;
+        int len;
+
         printf
             ("Testing RTP .............................................................. ");
         fflush(stdout);
 
-        printf("--\n");
+        /* Test 1: keyframe requests can be found in the formatted packet  */
+        len = rtcp_format_keyframe_request(buf, sizeof buf, 0x1234, 0xABCDEF01, RTCP_PSFB_PLI, 0);
+        if (len != 20 || !rtcp_find_keyframe_request(buf, len, &media_ssrc)
+            || media_ssrc != 0xABCDEF01) {
+                printf("FAIL\n");
+                printf("  PLI round trip\n");
+                return -1;
+        }
+        len = rtcp_format_keyframe_request(buf, sizeof buf, 0x1234, 0x5678, RTCP_PSFB_FIR, 7);
+        if (len != 28 || !rtcp_find_keyframe_request(buf, len, &media_ssrc)
+            || media_ssrc != 0x5678) {
+                printf("FAIL\n");
+                printf("  FIR round trip\n");
+                return -1;
+        }
+
+        /* Test 2: truncated packets are rejected                          */
+        if (rtcp_find_keyframe_request(buf, len - 4, &media_ssrc)
+            || rtcp_format_keyframe_request(buf, 24, 0x1234, 0x5678, RTCP_PSFB_FIR, 7) != -1) {
+                printf("FAIL\n");
+                printf("  truncated packet\n");
+                return -1;
+        }
+        len = rtcp_format_keyframe_request(buf, sizeof buf, 0x1234, 0xABCDEF01, RTCP_PSFB_PLI, 0);
+        buf[10] = 0; /* PLI (following an empty RR) without the media SSRC */
+        buf[11] = 1;
+        if (rtcp_find_keyframe_request(buf, len, &media_ssrc)) {
+                printf("FAIL\n");
+                printf("  short PLI\n");
+                return -1;
+        }
+
+        /* Test 3: path probes (multi-path sending) round trip             */
+        len = rtcp_format_path_probe(buf, sizeof buf, 0x1234, true, 42, 0x0102030405060708ULL);
+        if (len != RTCP_PATH_PROBE_LEN || !rtcp_find_path_probe(buf, len, &ssrc, &echo, &probe_seq, &send_time)
+            || ssrc != 0x1234 || !echo || probe_seq != 42 || send_time != 0x0102030405060708ULL) {
+                printf("FAIL\n");
+                printf("  path probe round trip\n");
+                return -1;
+        }
+        if (rtcp_find_path_probe(buf, len - 4, &ssrc, &echo, &probe_seq, &send_time)
+            || rtcp_find_keyframe_request(buf, len, &media_ssrc)
+            || rtcp_format_path_probe(buf, len - 1, 0x1234, false, 0, 0) != -1) {
+                printf("FAIL\n");
+                printf("  truncated or mismatched path probe\n");
+                return -1;
+        }
+
+        printf("Ok\n");
         return 0;
 }
@@ -0,0 +1,90 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "rtp/net_udp.h"
+#include "rtp/rtp.h"
+#include "tv.h"
+#include "unit_common.h"
+
+extern "C" {
+        int udp_timestamping_test_loopback();
+}
+
+#define LATE_NS (10 * NS_IN_MS) ///< deadline of stream B packets is this far in the past
+
+/**
+ * RTP packets of 2 streams sent to ourselves over loopback must get both RX
+ * and TX kernel timestamps accounted to their streams, TX statistics measure
+ * the lateness against the deadline if set, non-RTP datagrams are ignored.
+ */
+int udp_timestamping_test_loopback()
+{
+#ifdef __linux__
+        const int port = 5000 + rand() % 1000 * 2;
+        socket_udp *s = udp_init("127.0.0.1", port, port, 255, 4, true);
+        ASSERT_MESSAGE("Cannot open loopback socket", s != nullptr);
+        if (!udp_set_timestamping(s, UDP_TS_SW)) {
+                udp_exit(s);
+                return 0; // not supported by the kernel
+        }
+
+        const uint32_t ssrc[] = { 0x11111111, 0x22222222 };
+        char other[] = "not an RTP datagram";
+        int received = 0;
+        int timestamped = 0;
+        for (int i = 0; i < 20; ++i) {
+                unsigned char pkt[32] = { 0x80, 96 };
+                const uint32_t pkt_ssrc = htonl(ssrc[i % 2]);
+                memcpy(pkt + 8, &pkt_ssrc, sizeof pkt_ssrc);
+                if (i % 2 == 1) {
+                        udp_set_tx_deadline(s, get_time_in_ns() - LATE_NS);
+                }
+                ASSERT(udp_send(s, (char *) pkt, sizeof pkt) == sizeof pkt);
+                ASSERT(udp_send(s, other, sizeof other) == sizeof other);
+                struct timeval timeout = { 1, 0 };
+                while (udp_not_empty(s, &timeout)) {
+                        char *data = nullptr;
+                        long long rx_ts = 0;
+                        if (udp_recv_data_ts(s, &data, &rx_ts) > 0) {
+                                received += 1;
+                                timestamped += rx_ts != 0;
+                        }
+                        free(data);
+                        timeout = { 0, 0 };
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT(received > 0);
+        ASSERT_EQUAL(received, timestamped);
+
+        struct udp_ts_stats stats{};
+        ASSERT(udp_get_ts_stats(s, &stats));
+        udp_exit(s);
+        ASSERT_EQUAL(2, stats.stream_count);
+        for (int i = 0; i < 2; ++i) {
+                const udp_ts_stream_stats &st = stats.streams[i];
+                ASSERT(st.ssrc == ssrc[0] || st.ssrc == ssrc[1]);
+                ASSERT(st.rx_count > 0 && st.rx_count <= 10);
+                ASSERT(st.tx_count > 0 && st.tx_count <= 10);
+                unsigned long long interarrival = 0;
+                for (auto c : st.rx_interarrival) {
+                        interarrival += c;
+                }
+                ASSERT_EQUAL(st.rx_count - 1, interarrival);
+                if (st.ssrc == ssrc[0]) { // no deadline - measured from the send call
+                        ASSERT(st.tx_lateness_max >= 0 && st.tx_lateness_max < LATE_NS);
+                } else {
+                        ASSERT(st.tx_lateness_sum / (long long) st.tx_count >= LATE_NS);
+                }
+        }
+#endif
+        return 0;
+}
@@ -0,0 +1,153 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "unit_common.h"
+#include "utils/uyvy_scale.h"
+
+extern "C" {
+        int uyvy_scale_test_blend();
+        int uyvy_scale_test_halve();
+        int uyvy_scale_test_generic();
+}
+
+#define PAD 16
+#define PAD_VAL 0xA5
+
+using std::vector;
+
+/// source position of output sample @ref out_idx with centers aligned, weight of the next sample in 1/256
+static int ref_pos(int out_idx, int in_len, int out_len, int *weight)
+{
+        const double pos = std::max((out_idx + 0.5) * in_len / out_len - 0.5, 0.0);
+        int idx = (int) pos;
+        *weight = (int) ((pos - idx) * 256 + 0.5);
+        if (idx >= in_len - 1) {
+                return in_len - 1;
+        }
+        if (*weight == 256) {
+                *weight = 0;
+                return idx + 1;
+        }
+        return idx;
+}
+
+static int lerp(int a, int b, int w)
+{
+        return (a * (256 - w) + b * w + 128) >> 8;
+}
+
+/// plain bilinear scale - vertical pass (rounded to 8 bits) followed by the horizontal one
+static vector<unsigned char> ref_scale(const vector<unsigned char> &in, int in_pitch, int in_w, int in_h, int out_w,
+                int out_h)
+{
+        vector<unsigned char> out(out_w * 2 * out_h);
+        for (int y = 0; y < out_h; ++y) {
+                int wv = 0;
+                const int line = ref_pos(y, in_h, out_h, &wv);
+                const int next_line = std::min(line + 1, in_h - 1);
+                auto src = [&](int off) {
+                        return lerp(in[line * in_pitch + off], in[next_line * in_pitch + off], wv);
+                };
+                for (int i = 0; i < out_w * 2; ++i) {
+                        int wh = 0;
+                        int off = 0;
+                        int off2 = 0;
+                        if (i % 2 == 1) { // Y
+                                const int idx = ref_pos(i / 2, in_w, out_w, &wh);
+                                off = idx * 2 + 1;
+                                off2 = std::min(idx + 1, in_w - 1) * 2 + 1;
+                        } else { // U or V - shared by pixel pairs
+                                const int idx = ref_pos(i / 4, in_w / 2, out_w / 2, &wh);
+                                off = idx * 4 + i % 4;
+                                off2 = std::min(idx + 1, in_w / 2 - 1) * 4 + i % 4;
+                        }
+                        out[y * out_w * 2 + i] = lerp(src(off), src(off2), wh);
+                }
+        }
+        return out;
+}
+
+/**
+ * Scales a random picture (with padded lines, in 2 line ranges) and compares
+ * the result with the scalar reference.
+ */
+static int check_scale(int in_w, int in_h, int out_w, int out_h)
+{
+        const int in_pitch = in_w * 2 + PAD;
+        const int out_pitch = out_w * 2 + PAD;
+        vector<unsigned char> in(in_pitch * in_h);
+        for (auto &c : in) {
+                c = rand() % 256;
+        }
+        vector<unsigned char> out(out_pitch * out_h, PAD_VAL);
+
+        struct uyvy_scaler *s = uyvy_scaler_create(in_w, in_h, out_w, out_h);
+        ASSERT(s != nullptr);
+        uyvy_scaler_scale(s, (const char *) in.data(), in_pitch, (char *) out.data(), out_pitch, 0, out_h / 3);
+        uyvy_scaler_scale(s, (const char *) in.data(), in_pitch, (char *) out.data(), out_pitch, out_h / 3, out_h);
+        uyvy_scaler_destroy(s);
+
+        const vector<unsigned char> ref = ref_scale(in, in_pitch, in_w, in_h, out_w, out_h);
+        for (int y = 0; y < out_h; ++y) {
+                for (int i = 0; i < out_w * 2; ++i) {
+                        ASSERT_EQUAL((int) ref[y * out_w * 2 + i], (int) out[y * out_pitch + i]);
+                }
+                for (int i = out_w * 2; i < out_pitch; ++i) {
+                        ASSERT_EQUAL_MESSAGE("Line padding overwritten", PAD_VAL, (int) out[y * out_pitch + i]);
+                }
+        }
+        return 0;
+}
+
+/// same width - lines are only blended vertically (including exact 1/2 weights)
+int uyvy_scale_test_blend()
+{
+        srand(1);
+        for (int out_h : { 48, 36, 24, 20, 77 }) {
+                if (check_scale(70, 48, 70, out_h) != 0) {
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+/// horizontal 2:1 downscale, widths not multiple of the SIMD block
+int uyvy_scale_test_halve()
+{
+        srand(2);
+        for (int in_w : { 128, 132, 1924 }) {
+                for (int out_h : { 30, 15, 22 }) {
+                        if (check_scale(in_w, 30, in_w / 2, out_h) != 0) {
+                                return -1;
+                        }
+                }
+        }
+        return 0;
+}
+
+/// arbitrary ratios, both down- and upscaling
+int uyvy_scale_test_generic()
+{
+        srand(3);
+        const int sizes[][4] = {
+                { 100, 60, 64, 50 },
+                { 64, 36, 100, 60 },
+                { 1920, 20, 640, 10 },
+                { 640, 12, 1920, 30 },
+                { 2, 1, 8, 5 },
+                { 10, 10, 2, 1 },
+        };
+        for (const auto &sz : sizes) {
+                if (check_scale(sz[0], sz[1], sz[2], sz[3]) != 0) {
+                        return -1;
+                }
+        }
+        return 0;
+}
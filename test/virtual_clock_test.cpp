@@ -0,0 +1,164 @@
+/**
+ * @file   virtual_clock_test.cpp
+ * @author Martin Pulec     <pulec@cesnet.cz>
+ */
+/*
+ * Copyright (c) 2023 CESNET, z. s. p. o.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, is permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of CESNET nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#include "config_unix.h"
+#include "config_win32.h"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <pthread.h>
+#include <thread>
+
+#include "rtp/net_udp.h"
+#include "tv.h"
+#include "utils/synchronized_queue.h"
+#include "utils/virtual_clock.h"
+#include "unit_common.h"
+
+extern "C" {
+        int virtual_clock_test_fast_forward();
+        int virtual_clock_test_timed_wait();
+}
+
+using namespace std::chrono;
+
+/**
+ * paced producer -> consumer over a blocking queue must run much faster than
+ * real time while the consumer still observes the producer's deadlines
+ */
+int virtual_clock_test_fast_forward()
+{
+        constexpr int       count    = 100;
+        constexpr time_ns_t interval = 100 * NS_IN_MS; // 10 s of virtual time
+        synchronized_queue<time_ns_t, 1> q;
+
+        virtual_clock_set_enabled(true);
+        const auto      real_start = steady_clock::now();
+        const time_ns_t start      = get_time_in_ns();
+        bool            in_time    = true;
+
+        std::thread producer([&] {
+                for (int i = 1; i <= count; ++i) {
+                        virtual_clock_sleep_until(start + i * interval);
+                        q.push(start + i * interval);
+                }
+        });
+        std::thread consumer([&] {
+                for (int i = 1; i <= count; ++i) {
+                        time_ns_t deadline = q.pop();
+                        in_time = in_time && get_time_in_ns() >= deadline;
+                }
+        });
+        producer.join();
+        consumer.join();
+        const time_ns_t virt_elapsed = get_time_in_ns() - start;
+        virtual_clock_set_enabled(false);
+
+        ASSERT(in_time);
+        ASSERT(virt_elapsed >= count * interval);
+        ASSERT_MESSAGE("virtual clock didn't fast-forward",
+                       steady_clock::now() - real_start < milliseconds(1000));
+        return 0;
+}
+
+/**
+ * timed waits (virtual_clock_cond_timedwait(), udp_not_empty()) must expire
+ * in virtual time and still be woken before the deadline by a notification
+ */
+int virtual_clock_test_timed_wait()
+{
+        pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
+        struct virtual_clock_waiters waiters{};
+        bool ready = false;
+
+        virtual_clock_set_enabled(true);
+        const auto      real_start = steady_clock::now();
+        const time_ns_t start      = get_time_in_ns();
+
+        std::atomic<bool> registered{ false };
+        std::thread notifier([&] {
+                virtual_clock_sleep_until(start); // registers as a participant
+                registered = true;
+                virtual_clock_sleep_until(start + NS_IN_SEC);
+                pthread_mutex_lock(&lock);
+                ready = true;
+                virtual_clock_wait_notify(&waiters);
+                pthread_mutex_unlock(&lock);
+                pthread_cond_signal(&cv);
+        });
+        while (!registered) {
+                std::this_thread::yield();
+        }
+        pthread_mutex_lock(&lock);
+        bool expired = false;
+        while (!ready && !expired) {
+                expired = virtual_clock_cond_timedwait(&cv, &lock, &waiters, start + 100 * NS_IN_SEC);
+        }
+        pthread_mutex_unlock(&lock);
+        notifier.join();
+        const time_ns_t woken_after = get_time_in_ns() - start;
+
+#ifdef __linux__
+        const int port = 5000 + rand() % 1000 * 2;
+        socket_udp *s = udp_init("127.0.0.1", port, port, 255, 4, true);
+        ASSERT_MESSAGE("Cannot open loopback socket", s != nullptr);
+        const time_ns_t recv_start = get_time_in_ns();
+        struct timeval timeout = { 10, 0 };
+        const bool not_empty = udp_not_empty(s, &timeout);
+        const time_ns_t recv_waited = get_time_in_ns() - recv_start;
+        udp_exit(s);
+#endif
+        virtual_clock_set_enabled(false);
+
+        ASSERT(ready);
+        ASSERT(!expired);
+        ASSERT(woken_after >= NS_IN_SEC && woken_after < 100 * NS_IN_SEC);
+#ifdef __linux__
+        ASSERT(!not_empty);
+        ASSERT(recv_waited >= 10 * NS_IN_SEC);
+#endif
+        ASSERT_MESSAGE("timed waits didn't fast-forward",
+                       steady_clock::now() - real_start < milliseconds(1000));
+        return 0;
+}
+
+/* vim: set expandtab sw=8 tw=120: */
@@ -5,14 +5,19 @@
 #include "debug.h"
 #endif
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
 #include "ipc_frame_ug.h"
 #include "ipc_frame.h"
 #include "pixfmt_conv.h"
 #include "types.h"
+#include "utils/line_accumulate.h"
 #include "video_codec.h"
 
 namespace {
@@ -36,6 +41,176 @@ void scale_frame(char *dst, char *src,
         }
 }
 
+/// intermediate (small) format of box_downscale() output, VIDEO_CODEC_NONE if unsupported
+codec_t box_downscale_codec(codec_t src)
+{
+        switch (src) {
+        case RGB:
+        case RGBA:
+                return src;
+        case UYVY:
+        case v210:
+        case I420:
+                return UYVY;
+        default:
+                return VIDEO_CODEC_NONE;
+        }
+}
+
+/**
+ * Sums f source lines starting at line y into row, components are stored in
+ * the order of the packed output format (RGB, RGBA or UYVY).
+ *
+ * @param acc8,acc10 scratch accumulators
+ */
+void box_sum_lines(std::vector<uint32_t> &row, std::vector<uint16_t> &acc8, std::vector<uint32_t> &acc10,
+                const unsigned char *src, int y, int f, int width, int height, codec_t codec)
+{
+        switch (codec) {
+        case v210: { // components of v210 words follow UYVY order (U0 Y0 V0 Y1 U2 Y2 ...)
+                const int words = (width + 5) / 6 * 4;
+                acc10.assign(3 * words, 0);
+                for (int i = 0; i < f; ++i) {
+                        line_accumulate_v210(acc10.data(), src + (size_t) (y + i) * vc_get_linesize(width, v210), words);
+                }
+                for (int i = 0; i < words; ++i) {
+                        row[3 * i] = acc10[i];
+                        row[3 * i + 1] = acc10[words + i];
+                        row[3 * i + 2] = acc10[2 * words + i];
+                }
+                break;
+        }
+        case I420: {
+                const int c_width = (width + 1) / 2;
+                const int c_height = (height + 1) / 2;
+                const unsigned char *u_plane = src + (size_t) width * height;
+                const unsigned char *v_plane = u_plane + (size_t) c_width * c_height;
+                acc8.assign(width + 2 * c_width, 0);
+                uint16_t *acc_u = acc8.data() + width;
+                uint16_t *acc_v = acc_u + c_width;
+                for (int i = 0; i < f; ++i) {
+                        line_accumulate_8(acc8.data(), src + (size_t) (y + i) * width, width);
+                        line_accumulate_8(acc_u, u_plane + (size_t) ((y + i) / 2) * c_width, c_width);
+                        line_accumulate_8(acc_v, v_plane + (size_t) ((y + i) / 2) * c_width, c_width);
+                }
+                for (int x = 0; x < width / 2; ++x) {
+                        row[4 * x] = acc_u[x];
+                        row[4 * x + 1] = acc8[2 * x];
+                        row[4 * x + 2] = acc_v[x];
+                        row[4 * x + 3] = acc8[2 * x + 1];
+                }
+                break;
+        }
+        default: { // 8-bit packed
+                const int linesize = vc_get_linesize(width, codec);
+                acc8.assign(linesize, 0);
+                for (int i = 0; i < f; ++i) {
+                        line_accumulate_8(acc8.data(), src + (size_t) (y + i) * linesize, linesize);
+                }
+                std::copy(acc8.begin(), acc8.end(), row.begin());
+        }
+        }
+}
+
+/// horizontal box filter of summed packed RGB(A) row
+template<int comps>
+void box_reduce_line(unsigned char *out, const uint32_t *row, int dst_w, int f, uint32_t div)
+{
+        for (int x = 0; x < dst_w; ++x) {
+                std::array<uint32_t, comps> sum{};
+                for (int j = 0; j < f; ++j) {
+                        for (int c = 0; c < comps; ++c) {
+                                sum[c] += row[j * comps + c];
+                        }
+                }
+                for (int c = 0; c < comps; ++c) {
+                        out[c] = (sum[c] + div / 2) / div;
+                }
+                row += f * comps;
+                out += comps;
+        }
+}
+
+/**
+ * Box-filter downscale by factor f in the source pixel format, so that only
+ * the small result needs to be converted to the destination codec. The
+ * source lines are summed vertically first (SIMD), the horizontal reduction
+ * then runs once per output line.
+ *
+ * @param[out] out    dst_h lines of box_downscale_codec(src_codec)
+ * @retval false      format not supported (or odd width with 4:2:2 output)
+ */
+bool box_downscale(std::vector<unsigned char> &out, const unsigned char *src,
+                int src_w, int src_h, codec_t src_codec, int f, int dst_w, int dst_h)
+{
+        const codec_t out_codec = box_downscale_codec(src_codec);
+        if (out_codec == VIDEO_CODEC_NONE || (out_codec == UYVY && dst_w % 2 != 0)
+                        || f > UINT16_MAX / UINT8_MAX) { // 16-bit vertical accumulator
+                return false;
+        }
+        assert(dst_w * f <= src_w && dst_h * f <= src_h);
+
+        const int comps = out_codec == UYVY ? 2 : get_bpp(out_codec); // per pixel
+        const int out_linesize = vc_get_linesize(dst_w, out_codec);
+        // v210 line has 6-pixel granularity, row must cover the whole groups
+        std::vector<uint32_t> row((size_t) (src_w + 5) / 6 * 6 * comps);
+        std::vector<uint16_t> acc8;
+        std::vector<uint32_t> acc10;
+        const uint32_t div = f * f * (src_codec == v210 ? 4 : 1);
+        out.resize((size_t) out_linesize * dst_h);
+
+        for (int y = 0; y < dst_h; ++y) {
+                box_sum_lines(row, acc8, acc10, src, y * f, f, src_w, src_h, src_codec);
+                unsigned char *out_line = out.data() + (size_t) y * out_linesize;
+                if (out_codec == UYVY) {
+                        for (int x = 0; x < dst_w / 2; ++x) {
+                                uint32_t u = 0;
+                                uint32_t v = 0;
+                                uint32_t y0 = 0;
+                                uint32_t y1 = 0;
+                                const uint32_t *in = &row[4 * x * f];
+                                for (int j = 0; j < f; ++j) {
+                                        u += in[4 * j];
+                                        v += in[4 * j + 2];
+                                }
+                                for (int j = 0; j < f; ++j) {
+                                        y0 += in[2 * j + 1];
+                                        y1 += in[2 * (f + j) + 1];
+                                }
+                                out_line[4 * x] = (u + div / 2) / div;
+                                out_line[4 * x + 1] = (y0 + div / 2) / div;
+                                out_line[4 * x + 2] = (v + div / 2) / div;
+                                out_line[4 * x + 3] = (y1 + div / 2) / div;
+                        }
+                } else if (comps == 3) {
+                        box_reduce_line<3>(out_line, row.data(), dst_w, f, div);
+                } else {
+                        box_reduce_line<4>(out_line, row.data(), dst_w, f, div);
+                }
+        }
+        return true;
+}
+
+/**
+ * Converts the box_downscale()-d frame to the destination codec.
+ * @retval false if there is no conversion available
+ */
+bool convert_downscaled(char *dst, const std::vector<unsigned char> &src, codec_t src_codec,
+                codec_t dst_codec, int width, int height)
+{
+        decoder_t dec = get_decoder_from_to(src_codec, dst_codec);
+        if (!dec) {
+                return false;
+        }
+        const int src_line_len = vc_get_linesize(width, src_codec);
+        const int dst_line_len = vc_get_linesize(width, dst_codec);
+        for (int i = 0; i < height; i++) {
+                dec((unsigned char *) dst + dst_line_len * i, src.data() + src_line_len * i,
+                                dst_line_len, 0, 8, 16);
+        }
+        return true;
+}
+
 }//anon namespace
 
 bool ipc_frame_from_ug_frame_hq(struct Ipc_frame *dst,
@@ -48,11 +223,6 @@ bool ipc_frame_from_ug_frame_hq(struct Ipc_frame *dst,
         if(!src)
                 return false;
 
-        decoder_t dec = get_decoder_from_to(src->color_spec, codec);
-        if(!dec){
-                return false;
-        }
-
         dst->header.width = src->tiles[0].width;
         dst->header.height = src->tiles[0].height;
         dst->header.color_spec = static_cast<Ipc_frame_color_spec>(codec);
@@ -70,6 +240,22 @@ bool ipc_frame_from_ug_frame_hq(struct Ipc_frame *dst,
 
         dst->header.data_len = dst_frame_size;
 
+        if(scale_factor != 0){
+                std::vector<unsigned char> small_frame;
+                if(box_downscale(small_frame, (unsigned char *) src->tiles[0].data,
+                                        src->tiles[0].width, src->tiles[0].height, src->color_spec,
+                                        scale_factor, dst->header.width, dst->header.height)){
+                        return convert_downscaled(dst->data, small_frame,
+                                        box_downscale_codec(src->color_spec), codec,
+                                        dst->header.width, dst->header.height);
+                }
+        }
+
+        decoder_t dec = get_decoder_from_to(src->color_spec, codec);
+        if(!dec){
+                return false;
+        }
+
         char *scale_src = nullptr;
         std::vector<unsigned char> rgb_frame;
 
@@ -112,6 +298,11 @@ bool ipc_frame_from_ug_frame(struct Ipc_frame *dst,
         if(!src)
                 return false;
 
+        if(scale_factor != 0 && codec == RGB && codec_is_planar(src->color_spec)){
+                // scale_frame() handles only packed formats
+                return ipc_frame_from_ug_frame_hq(dst, src, codec, scale_factor);
+        }
+
         decoder_t dec = nullptr;
         if(codec != VIDEO_CODEC_NONE){
                 dec = get_decoder_from_to(src->color_spec, codec);
@@ -22,7 +22,11 @@ bool ipc_frame_from_ug_frame(struct Ipc_frame *dst,
                 unsigned scale_factor);
 
 /**
- * @brief Same as ipc_frame_from_ug_frame, but convert pixfmt first and scale later.
+ * @brief Same as ipc_frame_from_ug_frame, but downscale with a box filter instead of decimation.
+ *
+ * Common formats (RGB, RGBA, UYVY, v210, I420) are averaged in the source
+ * pixel format and only the small result is converted, others are converted
+ * first and decimated later.
  */
 bool ipc_frame_from_ug_frame_hq(struct Ipc_frame *dst,
                 const struct video_frame *src,